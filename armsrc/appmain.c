@@ -59,6 +59,7 @@
 #include "ticks.h"
 #include "commonutil.h"
 #include "crc16.h"
+#include "bigbuf_lz4.h"
 
 
 #ifdef WITH_LCD
@@ -440,6 +441,32 @@ static void SendStatus(void) {
     reply_ng(CMD_STATUS, PM3_SUCCESS, NULL, 0);
 }
 
+// Send BigBuf as independent lz4 blocks,  each block compressed to fit one packet.
+// Blocks which don't shrink are sent as is.
+static void SendBigBufLZ4(const uint8_t *mem, uint32_t numofbytes) {
+    uint8_t cbuf[PM3_CMD_DATA_SIZE];
+
+    for (uint32_t i = 0; i < numofbytes;) {
+
+        WDT_HIT();
+
+        uint32_t srclen = 0;
+        uint32_t clen = bigbuf_lz4_pack(mem + i, numofbytes - i, cbuf, sizeof(cbuf), &srclen);
+
+        int result;
+        if (clen == srclen) {
+            result = reply_old(CMD_DOWNLOADED_BIGBUF, i, srclen, srclen, (uint8_t *)mem + i, srclen);
+        } else {
+            result = reply_old(CMD_DOWNLOADED_BIGBUF, i, clen, srclen, cbuf, clen);
+        }
+
+        if (result != PM3_SUCCESS)
+            Dbprintf("transfer to client failed ::  | bytes between %d - %d (%d) | result: %d", i, i + srclen, srclen, result);
+
+        i += srclen;
+    }
+}
+
 static void SendCapabilities(void) {
     capabilities_t capabilities;
     capabilities.version = CAPABILITIES_VERSION;
@@ -515,8 +542,10 @@ static void SendCapabilities(void) {
 #endif
 #ifdef WITH_ISO14443a
     capabilities.compiled_with_iso14443a = true;
+    capabilities.compiled_with_mf_dump_sectors = true;
 #else
     capabilities.compiled_with_iso14443a = false;
+    capabilities.compiled_with_mf_dump_sectors = false;
 #endif
 #ifdef WITH_ISO14443b
     capabilities.compiled_with_iso14443b = true;
@@ -553,6 +582,7 @@ static void SendCapabilities(void) {
 #else
     capabilities.compiled_with_lcd = false;
 #endif
+    capabilities.compiled_with_bigbuf_lz4 = true;
 
 #ifdef WITH_ZX8211
     capabilities.compiled_with_zx8211 = true;
@@ -996,6 +1026,10 @@ static void PacketReceived(PacketCommandNG *packet) {
             T55xx_ChkPwds(packet->data.asBytes[0] & 0xff, true);
             break;
         }
+        case CMD_LF_T55XX_SWEEP_PWDS: {
+            T55xx_SweepPwds(packet->data.asBytes, true);
+            break;
+        }
         case CMD_LF_PCF7931_READ: {
             ReadPCF7931(true);
             break;
@@ -1466,6 +1500,10 @@ static void PacketReceived(PacketCommandNG *packet) {
             MifareReadSector(packet->oldarg[0], packet->oldarg[1], packet->data.asBytes);
             break;
         }
+        case CMD_HF_MIFARE_DUMP_SECTORS: {
+            MifareDumpSectors((mf_dump_sectors_t *) packet->data.asBytes);
+            break;
+        }
         case CMD_HF_MIFARE_WRITEBL: {
             MifareWriteBlock(packet->oldarg[0], packet->oldarg[1], packet->data.asBytes);
             break;
@@ -2017,14 +2055,18 @@ static void PacketReceived(PacketCommandNG *packet) {
 
             // arg0 = startindex
             // arg1 = length bytes to transfer
-            // arg2 = BigBuf tracelen
+            // arg2 = download flags, BIGBUF_DL_LZ4
             //Dbprintf("transfer to client parameters: %" PRIu32 " | %" PRIu32 " | %" PRIu32, startidx, numofbytes, packet->oldarg[2]);
 
-            for (size_t i = 0; i < numofbytes; i += PM3_CMD_DATA_SIZE) {
-                size_t len = MIN((numofbytes - i), PM3_CMD_DATA_SIZE);
-                int result = reply_old(CMD_DOWNLOADED_BIGBUF, i, len, BigBuf_get_traceLen(), mem + startidx + i, len);
-                if (result != PM3_SUCCESS)
-                    Dbprintf("transfer to client failed ::  | bytes between %d - %d (%d) | result: %d", i, i + len, len, result);
+            if (packet->oldarg[2] & BIGBUF_DL_LZ4) {
+                SendBigBufLZ4(mem + startidx, numofbytes);
+            } else {
+                for (size_t i = 0; i < numofbytes; i += PM3_CMD_DATA_SIZE) {
+                    size_t len = MIN((numofbytes - i), PM3_CMD_DATA_SIZE);
+                    int result = reply_old(CMD_DOWNLOADED_BIGBUF, i, len, BigBuf_get_traceLen(), mem + startidx + i, len);
+                    if (result != PM3_SUCCESS)
+                        Dbprintf("transfer to client failed ::  | bytes between %d - %d (%d) | result: %d", i, i + len, len, result);
+                }
             }
             // Trigger a finish downloading signal with an ACK frame
             // iceman,  when did sending samplingconfig array got attached here?!?
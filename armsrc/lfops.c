@@ -2026,7 +2026,7 @@ bool brute_mem = (flags & 0x0100) >> 8;
 }
 */
 // Read one card block in page [page]
-void T55xxReadBlock(uint8_t page, bool pwd_mode, bool brute_mem, uint8_t block, uint32_t pwd, uint8_t downlink_mode, bool ledcontrol) {
+static void T55xxReadBlockEx(uint8_t page, bool pwd_mode, bool brute_mem, uint8_t block, uint32_t pwd, uint8_t downlink_mode, size_t samples, bool ledcontrol) {
     /*
     flag bits
     xxxx xxxxxxx1 0x0001 PwdMode
@@ -2051,12 +2051,8 @@ void T55xxReadBlock(uint8_t page, bool pwd_mode, bool brute_mem, uint8_t block,
 
     setDefaultSamplingConfig();
 
-    size_t samples = 12000;
-
     if (ledcontrol) LED_A_ON();
 
-    if (brute_mem) samples = 2048;
-
     //-- Set Read Flag to ensure SendCMD does not add "data" to the packet
     //-- flags |= 0x40;
 
@@ -2093,6 +2089,10 @@ void T55xxReadBlock(uint8_t page, bool pwd_mode, bool brute_mem, uint8_t block,
     setSamplingConfig(&old_config);
 }
 
+void T55xxReadBlock(uint8_t page, bool pwd_mode, bool brute_mem, uint8_t block, uint32_t pwd, uint8_t downlink_mode, bool ledcontrol) {
+    T55xxReadBlockEx(page, pwd_mode, brute_mem, block, pwd, downlink_mode, (brute_mem) ? 2048 : 12000, ledcontrol);
+}
+
 
 void T55xx_ChkPwds(uint8_t flags, bool ledcontrol) {
 
@@ -2211,6 +2211,55 @@ OUT:
     BigBuf_free();
 }
 
+// Try a batch of passwords against block 0. Every block 0 read is kept in BigBuf, above the
+// capture area, so the client can download them and run the modulation detection on each one.
+// As many passwords are tried as there is room for, the reply tells how many and where.
+void T55xx_SweepPwds(const uint8_t *data, bool ledcontrol) {
+
+    const t55xx_sweep_pwds_t *payload = (const t55xx_sweep_pwds_t *)data;
+    uint8_t downlink_mode = (payload->flags >> 3) & 0x03;
+    uint8_t count = MIN(payload->count, T55XX_SWEEP_MAX_PWDS);
+
+    // T55xxReadBlock() captures at the start of BigBuf, the slots stay out of its way
+    BigBuf_free_keep_EM();
+    uint8_t *slots = NULL;
+    uint8_t n = 0;
+    while (n < count && BigBuf_max_traceLen() >= 2 * T55XX_SWEEP_SAMPLES) {
+        slots = BigBuf_malloc(T55XX_SWEEP_SAMPLES);
+        n++;
+    }
+
+    uint8_t *buf = BigBuf_get_addr();
+    int res = (n) ? PM3_SUCCESS : PM3_EMALLOC;
+    uint8_t i = 0;
+
+    for (; i < n; i++) {
+
+        WDT_HIT();
+
+        if (BUTTON_PRESS() || data_available()) {
+            res = PM3_EOPABORTED;
+            break;
+        }
+
+        T55xxReadBlockEx(0, true, true, 0, payload->pwds[i], downlink_mode, T55XX_SWEEP_SAMPLES, ledcontrol);
+
+        // slots are handed out top down, the lowest one is the first
+        memcpy(slots + (i * T55XX_SWEEP_SAMPLES), buf, T55XX_SWEEP_SAMPLES);
+    }
+
+    t55xx_sweep_reply_t reply = {
+        .count = i,
+        .offset = (slots) ? (slots - buf) : 0,
+    };
+
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    if (ledcontrol) LEDsoff();
+    reply_ng(CMD_LF_T55XX_SWEEP_PWDS, res, (uint8_t *)&reply, sizeof(reply));
+    // the reads stay in place for the download
+    BigBuf_free_keep_EM();
+}
+
 void T55xxWakeUp(uint32_t pwd, uint8_t flags, bool ledcontrol) {
 
     flags |= 0x01 | 0x40 | 0x20; //Password | Read Call (no data) | reg_read no block
@@ -66,6 +66,7 @@ void T55xxReadBlock(uint8_t page, bool pwd_mode, bool brute_mem, uint8_t block,
                     uint8_t downlink_mode, bool ledcontrol);
 void T55xxWakeUp(uint32_t pwd, uint8_t flags, bool ledcontrol);
 void T55xx_ChkPwds(uint8_t flags, bool ledcontrol);
+void T55xx_SweepPwds(const uint8_t *data, bool ledcontrol);
 void T55xxDangerousRawTest(uint8_t *data, bool ledcontrol);
 
 void turn_read_lf_on(uint32_t delay);
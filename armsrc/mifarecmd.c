@@ -280,6 +280,200 @@ void MifareReadSector(uint8_t arg0, uint8_t arg1, uint8_t *datain) {
     set_tracing(false);
 }
 
+//-----------------------------------------------------------------------------
+// Bulk dump: select once, authenticate once per sector and key, read every
+// block the access conditions allow and pack the sector records into as few
+// responses as possible. Key A is tried first, key B only for what is left.
+//-----------------------------------------------------------------------------
+static bool mf_dump_auth(struct Crypto1State *pcs, uint8_t *uid, uint32_t *cuid, bool *authed, uint8_t blockNo, uint8_t keyType, uint8_t *key) {
+
+    if (*authed == false) {
+        if (iso14443a_select_card(uid, NULL, cuid, true, 0, true) == 0) {
+            if (g_dbglevel >= DBG_ERROR) Dbprintf("Can't select card");
+            return false;
+        }
+    }
+
+    uint64_t ui64Key = bytes_to_num(key, 6);
+    if (mifare_classic_auth(pcs, *cuid, blockNo, keyType, ui64Key, (*authed) ? AUTH_NESTED : AUTH_FIRST)) {
+        // a failed auth drops the card out of the session
+        *authed = false;
+        return false;
+    }
+    *authed = true;
+    return true;
+}
+
+// Read one block of the sector the session is authenticated for. A failed read
+// drops the card out of the session, so every retry selects and authenticates again.
+static bool mf_dump_readblock(struct Crypto1State *pcs, uint8_t *uid, uint32_t *cuid, bool *authed, uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t *dst) {
+
+    for (uint8_t tries = 0; tries < MF_DUMP_BLOCK_RETRY; tries++) {
+
+        if (*authed == false && mf_dump_auth(pcs, uid, cuid, authed, blockNo, keyType, key) == false) {
+            continue;
+        }
+
+        if (mifare_classic_readblock(pcs, *cuid, blockNo, dst) == 0) {
+            return true;
+        }
+        *authed = false;
+    }
+
+    if (g_dbglevel >= DBG_ERROR) Dbprintf("Can't read block %d", blockNo);
+    return false;
+}
+
+// A sector stops at the first block that fails, once per key session. Such a block costs
+// MF_DUMP_BLOCK_RETRY selects and authentications, about 100 ms each without a card.
+#define MF_DUMP_SECTOR_WTX      (2 * MF_DUMP_BLOCK_RETRY * 100)
+
+// read condition of a data block, 0 = key A|B, 1 = key B only, 2 = never
+static uint8_t mf_dump_read_cond(const uint8_t *trailer, uint8_t sectorNo, uint8_t blockNo) {
+    uint8_t area = (sectorNo < 32) ? blockNo : blockNo / 5;
+    uint8_t acl = ((trailer[7] >> (4 + area)) & 0x01) << 2 |
+                  ((trailer[8] >> area) & 0x01) << 1 |
+                  ((trailer[8] >> (4 + area)) & 0x01);
+    switch (acl) {
+        case 3:
+        case 5:
+            return 1;
+        case 7:
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+void MifareDumpSectors(mf_dump_sectors_t *payload) {
+
+    uint8_t uid[10] = {0x00};
+    uint32_t cuid = 0;
+    struct Crypto1State mpcs = {0, 0};
+    struct Crypto1State *pcs;
+    pcs = &mpcs;
+
+    mf_dump_sectors_resp_t resp;
+    memset(&resp, 0, sizeof(resp));
+    uint16_t used = 0;
+
+    int status = PM3_SUCCESS;
+    uint8_t end = payload->first_sector + payload->sector_count;
+    if (end > MF_DUMP_MAX_SECTORS) {
+        end = MF_DUMP_MAX_SECTORS;
+    }
+
+    iso14443a_setup(FPGA_HF_ISO14443A_READER_LISTEN);
+
+    clear_trace();
+    set_tracing(true);
+
+    LED_A_ON();
+    LED_B_OFF();
+    LED_C_OFF();
+
+    bool authed = false;
+
+    for (uint8_t sectorNo = payload->first_sector; sectorNo < end; sectorNo++) {
+
+        if (BUTTON_PRESS() || data_available()) {
+            status = PM3_EOPABORTED;
+            break;
+        }
+
+        // keep the client waiting while the retries of this sector run
+        send_wtx(MF_DUMP_SECTOR_WTX);
+
+        uint8_t blocks = NumBlocksPerSector(sectorNo);
+        uint8_t first = FirstBlockOfSector(sectorNo);
+        uint8_t trailerNo = blocks - 1;
+        uint16_t reclen = sizeof(mf_dump_sector_hdr_t) + blocks * 16;
+
+        // flush when the record doesn't fit anymore
+        if (used + reclen > sizeof(resp.data)) {
+            LED_B_ON();
+            reply_ng(CMD_HF_MIFARE_DUMP_SECTORS, PM3_SUCCESS, (uint8_t *)&resp, 2 + used);
+            LED_B_OFF();
+            memset(&resp, 0, sizeof(resp));
+            used = 0;
+        }
+
+        mf_dump_sector_hdr_t *hdr = (mf_dump_sector_hdr_t *)(resp.data + used);
+        uint8_t *data = resp.data + used + sizeof(mf_dump_sector_hdr_t);
+        uint16_t mask = 0;
+        hdr->sector = sectorNo;
+
+        // key A session, trailer first to learn the access conditions.
+        // A failed sector auth is retried from scratch by mf_dump_readblock
+        bool have_rights = false;
+        mf_dump_auth(pcs, uid, &cuid, &authed, first, MF_KEY_A, payload->keys[sectorNo][0]);
+
+        if (mf_dump_readblock(pcs, uid, &cuid, &authed, first + trailerNo, MF_KEY_A, payload->keys[sectorNo][0], data + trailerNo * 16)) {
+            mask |= (1 << trailerNo);
+            have_rights = true;
+        }
+
+        for (uint8_t b = 0; have_rights && b < trailerNo; b++) {
+            if (mf_dump_read_cond(data + trailerNo * 16, sectorNo, b) != 0) {
+                continue;
+            }
+            if (mf_dump_readblock(pcs, uid, &cuid, &authed, first + b, MF_KEY_A, payload->keys[sectorNo][0], data + b * 16) == false) {
+                break;
+            }
+            mask |= (1 << b);
+        }
+
+        // key B session, for whatever key A could not read
+        bool need_b = false;
+        for (uint8_t b = 0; b < blocks; b++) {
+            if ((mask & (1 << b)) == 0 && (have_rights == false || b == trailerNo || mf_dump_read_cond(data + trailerNo * 16, sectorNo, b) == 1)) {
+                need_b = true;
+                break;
+            }
+        }
+
+        if (need_b) {
+            mf_dump_auth(pcs, uid, &cuid, &authed, first, MF_KEY_B, payload->keys[sectorNo][1]);
+
+            for (uint8_t b = 0; b < blocks; b++) {
+                if (mask & (1 << b)) {
+                    continue;
+                }
+                if (have_rights && b != trailerNo && mf_dump_read_cond(data + trailerNo * 16, sectorNo, b) != 1) {
+                    continue;
+                }
+                if (mf_dump_readblock(pcs, uid, &cuid, &authed, first + b, MF_KEY_B, payload->keys[sectorNo][1], data + b * 16) == false) {
+                    break;
+                }
+                mask |= (1 << b);
+            }
+        }
+
+        if (g_dbglevel >= DBG_EXTENDED) Dbprintf("Dump sector %2d read mask %04x", sectorNo, mask);
+
+        hdr->read_mask = mask;
+        used += reclen;
+        resp.count++;
+    }
+
+    if (authed) {
+        if (mifare_classic_halt(pcs, cuid)) {
+            if (g_dbglevel >= DBG_ERROR) Dbprintf("Halt error");
+        }
+    }
+
+    crypto1_deinit(pcs);
+
+    resp.last = 1;
+    LED_B_ON();
+    reply_ng(CMD_HF_MIFARE_DUMP_SECTORS, status, (uint8_t *)&resp, 2 + used);
+    LED_B_OFF();
+
+    FpgaWriteConfWord(FPGA_MAJOR_MODE_OFF);
+    LEDsoff();
+    set_tracing(false);
+}
+
 // arg0 = blockNo (start)
 // arg1 = Pages (number of blocks)
 // arg2 = useKey
@@ -18,6 +18,7 @@
 #define __MIFARECMD_H
 
 #include "common.h"
+#include "pm3_cmd.h"
 
 void MifareReadBlock(uint8_t blockNo, uint8_t keyType, uint8_t *datain);
 
@@ -25,6 +26,7 @@ void MifareUReadBlock(uint8_t arg0, uint8_t arg1, uint8_t *datain);
 void MifareUC_Auth(uint8_t arg0, uint8_t *keybytes);
 void MifareUReadCard(uint8_t arg0, uint16_t arg1, uint8_t arg2, uint8_t *datain);
 void MifareReadSector(uint8_t arg0, uint8_t arg1, uint8_t *datain);
+void MifareDumpSectors(mf_dump_sectors_t *payload);
 void MifareWriteBlock(uint8_t arg0, uint8_t arg1, uint8_t *datain);
 void MifareUWriteBlockCompat(uint8_t arg0, uint8_t arg1, uint8_t *datain);
 
@@ -81,6 +81,18 @@ static void ConfigClocks(void) {
     mck_from_slck_to_pll();
 }
 
+// CRC-32 (0xEDB88320 reflected), same as common/crc32.c used by the client
+static uint32_t flash_crc32(const uint8_t *d, uint32_t n) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (uint32_t i = 0; i < n; i++) {
+        crc ^= d[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return crc;
+}
+
 static void Fatal(void) {
     for (;;) {};
 }
@@ -100,7 +112,8 @@ static void UsbPacketReceived(uint8_t *packet) {
                    DEVICE_INFO_FLAG_CURRENT_MODE_BOOTROM |
                    DEVICE_INFO_FLAG_UNDERSTANDS_START_FLASH |
                    DEVICE_INFO_FLAG_UNDERSTANDS_CHIP_INFO |
-                   DEVICE_INFO_FLAG_UNDERSTANDS_VERSION;
+                   DEVICE_INFO_FLAG_UNDERSTANDS_VERSION |
+                   DEVICE_INFO_FLAG_UNDERSTANDS_PAGE_CRC;
             if (g_common_area.flags.osimage_present)
                 arg0 |= DEVICE_INFO_FLAG_OSIMAGE_PRESENT;
 
@@ -117,11 +130,32 @@ static void UsbPacketReceived(uint8_t *packet) {
 
         case CMD_BL_VERSION: {
             ack = false;
-            arg0 = BL_VERSION_1_0_0;
+            arg0 = BL_VERSION_1_1_0;
             reply_old(CMD_BL_VERSION, arg0, 0, 0, 0, 0);
         }
         break;
 
+        case CMD_BL_PAGE_CRC: {
+            ack = false;
+            uint32_t count = (uint32_t)c->arg[1];
+            // written so that no term can wrap around
+            if ((count > BL_PAGE_CRC_MAX_BLOCKS) ||
+                    (arg0 < (uint32_t)_flash_start) ||
+                    (arg0 > (uint32_t)_flash_end) ||
+                    (count > ((uint32_t)_flash_end - arg0) / BL_PAGE_CRC_BLOCK_SIZE)) {
+                reply_old(CMD_NACK, 0, 0, 0, 0, 0);
+                break;
+            }
+
+            uint32_t crcs[BL_PAGE_CRC_MAX_BLOCKS];
+            for (uint32_t i = 0; i < count; i++) {
+                WDT_HIT();
+                crcs[i] = flash_crc32((uint8_t *)(arg0 + i * BL_PAGE_CRC_BLOCK_SIZE), BL_PAGE_CRC_BLOCK_SIZE);
+            }
+            reply_old(CMD_BL_PAGE_CRC, arg0, count, 0, crcs, count * sizeof(uint32_t));
+        }
+        break;
+
         case CMD_FINISH_WRITE: {
 #if defined ICOPYX
             if (c->arg[1] == 0xff && c->arg[2] == 0x1fd) {
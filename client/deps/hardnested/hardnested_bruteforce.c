@@ -72,6 +72,8 @@ THE SOFTWARE.
 #define DEFAULT_BRUTE_FORCE_RATE        (120000000.0) // if benchmark doesn't succeed
 #define TEST_BENCH_SIZE                 (6000)        // number of odd and even states for brute force benchmark
 #define TEST_BENCH_FILENAME             "hardnested_bf_bench_data.bin"
+#define BF_WORK_ITEMS_PER_THREAD        (8)           // split big buckets until each thread gets about this many work items
+#define BF_MIN_ODD_STATES_PER_ITEM      (64)          // don't split below this, the even states are bitsliced again for each item
 //#define WRITE_BENCH_FILE
 
 // debugging options
@@ -87,11 +89,22 @@ static uint32_t nonces_to_bruteforce = 0;
 static uint32_t bf_test_nonce[256];
 static uint8_t bf_test_nonce_2nd_byte[256];
 static uint8_t bf_test_nonce_par[256];
-static uint32_t bucket_count = 0;
-static statelist_t *buckets[128];
+
+// a work item is a bucket, or a sub range of its odd states when the bucket is too big
+typedef struct {
+    statelist_t slice;
+    uint64_t cost;
+} bf_work_item_t;
+
+static bf_work_item_t *work_items = NULL;
+static uint32_t work_item_count = 0;
+static uint32_t next_work_item = 0;
+static uint32_t threads_busy = 0;
 static uint32_t keys_found = 0;
 static uint64_t num_keys_tested;
 static uint64_t found_bs_key = 0;
+// the statics above are shared by all attacks, only one of them can brute force at a time
+static pthread_mutex_t brute_force_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 inline uint8_t trailing_zeros(uint8_t byte) {
     static const uint8_t trailing_zeros_LUT[256] = {
@@ -148,6 +161,7 @@ __attribute__((force_align_arg_pointer))
 #endif
 crack_states_thread(void *x) {
     struct arg {
+        hardnested_ctx_t *ctx;
         bool silent;
         int thread_ID;
         uint32_t cuid;
@@ -155,46 +169,120 @@ crack_states_thread(void *x) {
         uint64_t maximum_states;
         noncelist_t *nonces;
         uint8_t *best_first_bytes;
+        uint32_t num_threads;
+        uint64_t busy_time;
     } *thread_arg;
 
     thread_arg = (struct arg *)x;
+#if defined (DEBUG_BRUTE_FORCE)
     const int thread_id = thread_arg->thread_ID;
-    uint32_t current_bucket = thread_id;
-    while (current_bucket < bucket_count) {
-        statelist_t *bucket = buckets[current_bucket];
-        if (bucket) {
+#endif
+    __atomic_fetch_add(&threads_busy, 1, __ATOMIC_SEQ_CST);
+    // work items are sorted by decreasing cost. Idle threads take the next one, so the big ones
+    // are done first and the tail only consists of small items
+    uint32_t current_item;
+    while ((current_item = __atomic_fetch_add(&next_work_item, 1, __ATOMIC_SEQ_CST)) < work_item_count) {
+        statelist_t *bucket = &work_items[current_item].slice;
 #if defined (DEBUG_BRUTE_FORCE)
-            PrintAndLogEx(INFO, "Thread " _YELLOW_("%u") " starts working on bucket " _YELLOW_("%u") "\n", thread_id, current_bucket);
+        PrintAndLogEx(INFO, "Thread " _YELLOW_("%u") " starts working on item " _YELLOW_("%u") "\n", thread_id, current_item);
 #endif
-            const uint64_t key = crack_states_bitsliced(thread_arg->cuid, thread_arg->best_first_bytes, bucket, &keys_found, &num_keys_tested, nonces_to_bruteforce, bf_test_nonce_2nd_byte, thread_arg->nonces);
-            if (key != -1) {
-                __atomic_fetch_add(&keys_found, 1, __ATOMIC_SEQ_CST);
-                __atomic_fetch_add(&found_bs_key, key, __ATOMIC_SEQ_CST);
-
+        uint64_t item_start = msclock();
+        const uint64_t key = crack_states_bitsliced(thread_arg->cuid, thread_arg->best_first_bytes, bucket, &keys_found, &num_keys_tested, nonces_to_bruteforce, bf_test_nonce_2nd_byte, thread_arg->nonces);
+        thread_arg->busy_time += msclock() - item_start;
+        if (key != -1) {
+            __atomic_fetch_add(&keys_found, 1, __ATOMIC_SEQ_CST);
+            __atomic_fetch_add(&found_bs_key, key, __ATOMIC_SEQ_CST);
+
+            char progress_text[80];
+            char keystr[19];
+            sprintf(keystr, "%012" PRIX64 "  ", key);
+            sprintf(progress_text, "Brute force phase completed.  Key found: " _GREEN_("%s"), keystr);
+            hardnested_print_progress(thread_arg->ctx, thread_arg->num_acquired_nonces, progress_text, 0.0, 0);
+            break;
+        } else if (keys_found) {
+            break;
+        } else {
+            if (!thread_arg->silent) {
                 char progress_text[80];
-                char keystr[19];
-                sprintf(keystr, "%012" PRIX64 "  ", key);
-                sprintf(progress_text, "Brute force phase completed.  Key found: " _GREEN_("%s"), keystr);
-                hardnested_print_progress(thread_arg->num_acquired_nonces, progress_text, 0.0, 0);
-                break;
-            } else if (keys_found) {
-                break;
-            } else {
-                if (!thread_arg->silent) {
-                    char progress_text[80];
-                    sprintf(progress_text, "Brute force phase: %6.02f%%\t", 100.0 * (float)num_keys_tested / (float)(thread_arg->maximum_states));
-                    float remaining_bruteforce = thread_arg->nonces[thread_arg->best_first_bytes[0]].expected_num_brute_force - (float)num_keys_tested / 2;
-                    hardnested_print_progress(thread_arg->num_acquired_nonces, progress_text, remaining_bruteforce, 5000);
-                }
+                sprintf(progress_text, "Brute force phase: %6.02f%%  (%u/%u threads busy)", 100.0 * (float)num_keys_tested / (float)(thread_arg->maximum_states),
+                        __atomic_load_n(&threads_busy, __ATOMIC_SEQ_CST), thread_arg->num_threads);
+                float remaining_bruteforce = thread_arg->nonces[thread_arg->best_first_bytes[0]].expected_num_brute_force - (float)num_keys_tested / 2;
+                hardnested_print_progress(thread_arg->ctx, thread_arg->num_acquired_nonces, progress_text, remaining_bruteforce, 5000);
             }
         }
-        current_bucket += NUM_BRUTE_FORCE_THREADS;
     }
+    __atomic_fetch_sub(&threads_busy, 1, __ATOMIC_SEQ_CST);
     return NULL;
 }
 
 
-void prepare_bf_test_nonces(noncelist_t *nonces, uint8_t best_first_byte) {
+static int compare_work_items(const void *a, const void *b) {
+    const bf_work_item_t *item_a = a;
+    const bf_work_item_t *item_b = b;
+    if (item_a->cost > item_b->cost) return -1;
+    if (item_a->cost < item_b->cost) return 1;
+    return 0;
+}
+
+
+// Turn the candidate buckets into a list of work items, most expensive first. Buckets costing
+// more than the per item target are split into sub ranges of their odd states.
+static bool prepare_work_items(statelist_t *candidates, uint32_t num_threads) {
+
+    uint64_t total_cost = 0;
+    uint32_t num_items = 0;
+    for (statelist_t *p = candidates; p != NULL; p = p->next) {
+        if (p->states[ODD_STATE] != NULL && p->states[EVEN_STATE] != NULL) {
+            total_cost += (uint64_t)p->len[ODD_STATE] * p->len[EVEN_STATE];
+        }
+    }
+    uint64_t target_cost = total_cost / ((uint64_t)num_threads * BF_WORK_ITEMS_PER_THREAD) + 1;
+
+    for (int pass = 0; pass < 2; pass++) {
+        for (statelist_t *p = candidates; p != NULL; p = p->next) {
+            if (p->states[ODD_STATE] == NULL || p->states[EVEN_STATE] == NULL || p->len[ODD_STATE] == 0 || p->len[EVEN_STATE] == 0) {
+                continue;
+            }
+            uint64_t cost = (uint64_t)p->len[ODD_STATE] * p->len[EVEN_STATE];
+            uint32_t num_slices = (cost + target_cost - 1) / target_cost;
+            num_slices = MIN(num_slices, (p->len[ODD_STATE] + BF_MIN_ODD_STATES_PER_ITEM - 1) / BF_MIN_ODD_STATES_PER_ITEM);
+            num_slices = MAX(num_slices, 1);
+            if (pass == 0) {
+                num_items += num_slices;
+                continue;
+            }
+            uint32_t odd_start = 0;
+            for (uint32_t i = 0; i < num_slices; i++) {
+                uint32_t odd_end = (uint64_t)p->len[ODD_STATE] * (i + 1) / num_slices;
+                bf_work_item_t *item = &work_items[work_item_count++];
+                item->slice.states[ODD_STATE] = p->states[ODD_STATE] + odd_start;
+                item->slice.len[ODD_STATE] = odd_end - odd_start;
+                item->slice.states[EVEN_STATE] = p->states[EVEN_STATE];
+                item->slice.len[EVEN_STATE] = p->len[EVEN_STATE];
+                item->slice.next = NULL;
+                item->cost = (uint64_t)item->slice.len[ODD_STATE] * p->len[EVEN_STATE];
+                odd_start = odd_end;
+            }
+        }
+        if (pass == 0) {
+            free(work_items);
+            work_items = calloc(MAX(num_items, 1), sizeof(bf_work_item_t));
+            if (work_items == NULL) {
+                PrintAndLogEx(WARNING, "Out of memory error in brute_force. Aborting...");
+                return false;
+            }
+            work_item_count = 0;
+        }
+    }
+
+    qsort(work_items, work_item_count, sizeof(bf_work_item_t), compare_work_items);
+    next_work_item = 0;
+    threads_busy = 0;
+    return true;
+}
+
+
+static void prepare_bf_test_nonces(noncelist_t *nonces, uint8_t best_first_byte) {
     // we do bitsliced brute forcing with best_first_bytes[0] only.
     // Extract the corresponding 2nd bytes
     noncelistentry_t *test_nonce = nonces[best_first_byte].first;
@@ -294,7 +382,7 @@ static void write_benchfile(statelist_t *candidates) {
 #endif
 
 
-bool brute_force_bs(float *bf_rate, statelist_t *candidates, uint32_t cuid, uint32_t num_acquired_nonces, uint64_t maximum_states, noncelist_t *nonces, uint8_t *best_first_bytes, uint64_t *found_key) {
+static bool brute_force_bs_locked(hardnested_ctx_t *ctx, float *bf_rate, statelist_t *candidates, uint32_t cuid, uint32_t num_acquired_nonces, uint64_t maximum_states, noncelist_t *nonces, uint8_t *best_first_bytes, uint64_t *found_key) {
 #if defined (WRITE_BENCH_FILE)
     write_benchfile(candidates);
 #endif
@@ -306,24 +394,22 @@ bool brute_force_bs(float *bf_rate, statelist_t *candidates, uint32_t cuid, uint
 
     bitslice_test_nonces(nonces_to_bruteforce, bf_test_nonce, bf_test_nonce_par);
 
-    // count number of states to go
-    bucket_count = 0;
-    for (statelist_t *p = candidates; p != NULL; p = p->next) {
-        if (p->states[ODD_STATE] != NULL && p->states[EVEN_STATE] != NULL) {
-            buckets[bucket_count] = p;
-            bucket_count++;
-        }
-    }
-
-    uint64_t start_time = msclock();
-
 #if defined(__linux__) ||  defined(__APPLE__)
     if (NUM_BRUTE_FORCE_THREADS < 0)
         return false;
 #endif
 
-    pthread_t threads[NUM_BRUTE_FORCE_THREADS];
+    const uint32_t num_threads = NUM_BRUTE_FORCE_THREADS;
+
+    if (prepare_work_items(candidates, num_threads) == false) {
+        return false;
+    }
+
+    uint64_t start_time = msclock();
+
+    pthread_t threads[num_threads];
     struct args {
+        hardnested_ctx_t *ctx;
         bool silent;
         int thread_ID;
         uint32_t cuid;
@@ -331,9 +417,12 @@ bool brute_force_bs(float *bf_rate, statelist_t *candidates, uint32_t cuid, uint
         uint64_t maximum_states;
         noncelist_t *nonces;
         uint8_t *best_first_bytes;
-    } thread_args[NUM_BRUTE_FORCE_THREADS];
+        uint32_t num_threads;
+        uint64_t busy_time;
+    } thread_args[num_threads];
 
-    for (uint32_t i = 0; i < NUM_BRUTE_FORCE_THREADS; i++) {
+    for (uint32_t i = 0; i < num_threads; i++) {
+        thread_args[i].ctx = ctx;
         thread_args[i].thread_ID = i;
         thread_args[i].silent = silent;
         thread_args[i].cuid = cuid;
@@ -341,14 +430,33 @@ bool brute_force_bs(float *bf_rate, statelist_t *candidates, uint32_t cuid, uint
         thread_args[i].maximum_states = maximum_states;
         thread_args[i].nonces = nonces;
         thread_args[i].best_first_bytes = best_first_bytes;
+        thread_args[i].num_threads = num_threads;
+        thread_args[i].busy_time = 0;
         pthread_create(&threads[i], NULL, crack_states_thread, (void *)&thread_args[i]);
     }
-    for (uint32_t i = 0; i < NUM_BRUTE_FORCE_THREADS; i++) {
+    for (uint32_t i = 0; i < num_threads; i++) {
         pthread_join(threads[i], 0);
     }
 
     uint64_t elapsed_time = msclock() - start_time;
 
+    if (!silent && elapsed_time > 0) {
+        // busy time of each thread relative to the whole brute force phase. A long tail shows up as a low minimum
+        uint64_t busy_sum = 0, busy_min = UINT64_MAX;
+        for (uint32_t i = 0; i < num_threads; i++) {
+            busy_sum += thread_args[i].busy_time;
+            busy_min = MIN(busy_min, thread_args[i].busy_time);
+        }
+        char progress_text[80];
+        snprintf(progress_text, sizeof(progress_text), "Thread utilisation: avg %3.0f%%, min %3.0f%% (%u items)",
+                 100.0 * busy_sum / num_threads / elapsed_time, 100.0 * busy_min / elapsed_time, work_item_count);
+        hardnested_print_progress(ctx, num_acquired_nonces, progress_text, 0.0, 0);
+    }
+
+    free(work_items);
+    work_items = NULL;
+    work_item_count = 0;
+
     if (bf_rate != NULL)
         *bf_rate = (float)num_keys_tested / ((float)elapsed_time / 1000.0);
 
@@ -359,6 +467,15 @@ bool brute_force_bs(float *bf_rate, statelist_t *candidates, uint32_t cuid, uint
 }
 
 
+bool brute_force_bs(hardnested_ctx_t *ctx, statelist_t *candidates, uint32_t cuid, uint32_t num_acquired_nonces, uint64_t maximum_states, noncelist_t *nonces, uint8_t *best_first_bytes, uint64_t *found_key) {
+    pthread_mutex_lock(&brute_force_mutex);
+    prepare_bf_test_nonces(nonces, best_first_bytes[0]);
+    bool res = brute_force_bs_locked(ctx, NULL, candidates, cuid, num_acquired_nonces, maximum_states, nonces, best_first_bytes, found_key);
+    pthread_mutex_unlock(&brute_force_mutex);
+    return res;
+}
+
+
 static bool read_bench_data(statelist_t *test_candidates) {
 
     size_t bytes_read = 0;
@@ -445,7 +562,9 @@ float brute_force_benchmark(void) {
     }
     test_candidates[NUM_BRUTE_FORCE_THREADS - 1].next = NULL;
 
+    pthread_mutex_lock(&brute_force_mutex);
     if (!read_bench_data(test_candidates)) {
+        pthread_mutex_unlock(&brute_force_mutex);
         PrintAndLogEx(NORMAL, "Couldn't read benchmark data. Assuming brute force rate of %1.0f states per second", DEFAULT_BRUTE_FORCE_RATE);
         return DEFAULT_BRUTE_FORCE_RATE;
     }
@@ -461,7 +580,8 @@ float brute_force_benchmark(void) {
 
     float bf_rate;
     uint64_t found_key = 0;
-    brute_force_bs(&bf_rate, test_candidates, 0, 0, maximum_states, NULL, 0, &found_key);
+    brute_force_bs_locked(NULL, &bf_rate, test_candidates, 0, 0, maximum_states, NULL, 0, &found_key);
+    pthread_mutex_unlock(&brute_force_mutex);
 
     free(test_candidates[0].states[ODD_STATE]);
     free(test_candidates[0].states[EVEN_STATE]);
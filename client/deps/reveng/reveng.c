@@ -49,6 +49,10 @@
  */
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include "util.h"   /* num_CPUs */
 
 #define FILE void
 #include "reveng.h"
@@ -58,6 +62,8 @@ static void engini(int *resc, model_t **result, const poly_t divisor, int flags,
 static void calout(int *resc, model_t **result, const poly_t divisor, const poly_t init, int flags, int args, const poly_t *argpolys);
 static void calini(int *resc, model_t **result, const poly_t divisor, int flags, const poly_t xorout, int args, const poly_t *argpolys);
 static void chkres(int *resc, model_t **result, const poly_t divisor, const poly_t init, int flags, const poly_t xorout, int args, const poly_t *argpolys);
+static void pcand(int *resc, model_t **result, const poly_t gpoly, const model_t *guess, int rflags, int args, const poly_t *argpolys);
+static int psearch(int *resc, model_t **result, poly_t gpoly, const model_t *guess, const poly_t qpoly, int rflags, int args, const poly_t *argpolys, const poly_t *pworks);
 
 static const poly_t pzero = PZERO;
 
@@ -87,6 +93,10 @@ reveng(const model_t *guess, const poly_t qpoly, int rflags, int args, const pol
         if (plen(gpoly))
             pshift(&gpoly, gpoly, 0UL, 0UL, plen(gpoly) - 1UL, 1UL);
 
+        /* Word sized polys are searched on all CPUs, see psearch() */
+        if (psearch(&resc, &result, gpoly, guess, qpoly, rflags, args, argpolys, pworks))
+            goto pdone;
+
         while (piter(&gpoly) && (~rflags & R_HAVEQ || pcmp(&gpoly, &qpoly) < 0)) {
             /* For each possible poly of this size, try
              * dividing all the differences in the list.
@@ -109,18 +119,12 @@ reveng(const model_t *guess, const poly_t qpoly, int rflags, int args, const pol
              */
             if (!plen(*wptr)) {
                 /* gpoly is a candidate poly */
-                if (rflags & R_HAVEI && rflags & R_HAVEX)
-                    chkres(&resc, &result, gpoly, guess->init, guess->flags, guess->xorout, args, argpolys);
-                else if (rflags & R_HAVEI)
-                    calout(&resc, &result, gpoly, guess->init, guess->flags, args, argpolys);
-                else if (rflags & R_HAVEX)
-                    calini(&resc, &result, gpoly, guess->flags, guess->xorout, args, argpolys);
-                else
-                    engini(&resc, &result, gpoly, guess->flags, args, argpolys);
+                pcand(&resc, &result, gpoly, guess, rflags, args, argpolys);
             }
             if (!piter(&gpoly))
                 break;
         }
+pdone:
         /* Finished with gpoly and the differences list, free them.
          */
         pfree(&gpoly);
@@ -157,6 +161,219 @@ requit:
     return (result);
 }
 
+static void
+pcand(int *resc, model_t **result, const poly_t gpoly, const model_t *guess, int rflags, int args, const poly_t *argpolys) {
+    /* gpoly divides all the differences.  Search for an Init value
+     * for this poly or if Init is known, log the result.
+     */
+    if (rflags & R_HAVEI && rflags & R_HAVEX)
+        chkres(resc, result, gpoly, guess->init, guess->flags, guess->xorout, args, argpolys);
+    else if (rflags & R_HAVEI)
+        calout(resc, result, gpoly, guess->init, guess->flags, args, argpolys);
+    else if (rflags & R_HAVEX)
+        calini(resc, result, gpoly, guess->flags, guess->xorout, args, argpolys);
+    else
+        engini(resc, result, gpoly, guess->flags, args, argpolys);
+}
+
+/* Parallel poly search for widths up to 63 bits.
+ * The odd polys from the start value up to qpoly are cut into jobs
+ * which the threads take in turn.  Each job tests 64 consecutive polys
+ * at a time against the shortest difference with a bit-sliced shift
+ * register, one poly per bit of a word.  The few polys which divide it
+ * are checked against all differences with pcrc() as before.
+ * Candidates are handed to pcand() in ascending order afterwards, so
+ * the results are identical to the sequential search.
+ */
+#define R_LANES     64
+#define R_JOBPOLYS  (R_LANES << 10)
+#define R_MAXTHREADS 64
+
+typedef struct {
+    const poly_t *pworks;
+    poly_t shape;               /* gpoly, copied by every thread */
+    unsigned long width;
+    unsigned char *bits;        /* shortest difference, one term per byte */
+    unsigned long nbits;
+    uint64_t first, last;       /* odd polys, inclusive */
+    uint64_t jobs, next, tested;
+    int flags;
+    pthread_mutex_t lock;
+    uint64_t *cand;
+    size_t ncand, maxcand;
+    int oom;
+} psearch_t;
+
+static uint64_t
+psliced(const psearch_t *ps, uint64_t base) {
+    /* Remainders of the shortest difference for the polys base + 1 + 2k,
+     * k = 0..63.  base must be a multiple of 128, then terms 1..6 of the
+     * polys are the bits of k and the higher terms are those of base.
+     * Returns a mask of the polys leaving a nonzero remainder.
+     */
+    static const uint64_t lane[6] = {
+        0xAAAAAAAAAAAAAAAAULL, 0xCCCCCCCCCCCCCCCCULL, 0xF0F0F0F0F0F0F0F0ULL,
+        0xFF00FF00FF00FF00ULL, 0xFFFF0000FFFF0000ULL, 0xFFFFFFFF00000000ULL
+    };
+    uint64_t gm[R_LANES], rm[R_LANES] = {0}, carry, nz = 0;
+    unsigned long w = ps->width, i, j;
+
+    gm[0] = ~0ULL;
+    for (i = 1; i < w; ++i)
+        gm[i] = (i < 7) ? lane[i - 1] : (((base >> i) & 1) ? ~0ULL : 0ULL);
+
+    for (j = 0; j < ps->nbits; ++j) {
+        carry = rm[w - 1];
+        for (i = w - 1; i; --i)
+            rm[i] = rm[i - 1] ^ (carry & gm[i]);
+        rm[0] = (ps->bits[j] ? ~0ULL : 0ULL) ^ (carry & gm[0]);
+    }
+    for (i = 0; i < w; ++i)
+        nz |= rm[i];
+    return nz;
+}
+
+static void *
+psworker(void *arg) {
+    psearch_t *ps = arg;
+    unsigned long w = ps->width;
+    poly_t gpoly = pclone(ps->shape), rem;
+    const poly_t *wptr;
+    uint64_t job, lo, hi, base, g, active, hits, tested, prev;
+    int k, kmin, kmax;
+
+    while ((job = __atomic_fetch_add(&ps->next, 1, __ATOMIC_RELAXED)) < ps->jobs) {
+        lo = ps->first + job * (R_JOBPOLYS << 1);
+        hi = (ps->last - lo < (R_JOBPOLYS << 1)) ? ps->last : lo + (R_JOBPOLYS << 1) - 2;
+
+        for (base = lo & ~((uint64_t)(R_LANES << 1) - 1); base <= hi && !ps->oom; base += R_LANES << 1) {
+            kmin = (lo > base + 1) ? (int)((lo - base - 1) >> 1) : 0;
+            kmax = (hi < base + (R_LANES << 1) - 1) ? (int)((hi - base - 1) >> 1) : R_LANES - 1;
+            active = (~0ULL >> (R_LANES - 1 - kmax)) & (~0ULL << kmin);
+
+            hits = active & ~psliced(ps, base);
+            for (k = 0; hits; ++k, hits >>= 1) {
+                if (!(hits & 1))
+                    continue;
+                g = base + 1 + ((uint64_t)k << 1);
+                *gpoly.bitmap = (bmp_t) g << (BMP_BIT - w);
+                for (wptr = ps->pworks; plen(*wptr); ++wptr) {
+                    rem = pcrc(*wptr, gpoly, pzero, pzero, 0);
+                    if (ptst(rem)) {
+                        pfree(&rem);
+                        break;
+                    } else
+                        pfree(&rem);
+                }
+                if (plen(*wptr))
+                    continue;
+
+                pthread_mutex_lock(&ps->lock);
+                if (ps->ncand == ps->maxcand) {
+                    uint64_t *tmp = realloc(ps->cand, (ps->maxcand + 64) * sizeof(uint64_t));
+                    if (tmp) {
+                        ps->cand = tmp;
+                        ps->maxcand += 64;
+                    } else
+                        ps->oom = 1;
+                }
+                if (!ps->oom)
+                    ps->cand[ps->ncand++] = g;
+                pthread_mutex_unlock(&ps->lock);
+            }
+        }
+
+        /* report progress at the same rate as the sequential search */
+        tested = __atomic_add_fetch(&ps->tested, ((hi - lo) >> 1) + 1, __ATOMIC_RELAXED);
+        prev = tested - (((hi - lo) >> 1) + 1);
+        if (prev / (R_SPMASK + 1) != tested / (R_SPMASK + 1)) {
+            *gpoly.bitmap = (bmp_t) hi << (BMP_BIT - w);
+            uprog(gpoly, ps->flags, (unsigned long)(tested / (R_SPMASK + 1)));
+        }
+    }
+    pfree(&gpoly);
+    return NULL;
+}
+
+static int
+pcmpu64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int
+psearch(int *resc, model_t **result, poly_t gpoly, const model_t *guess, const poly_t qpoly, int rflags, int args, const poly_t *argpolys, const poly_t *pworks) {
+    /* Returns zero if the search must be done sequentially */
+    psearch_t ps;
+    pthread_t thread_id[R_MAXTHREADS];
+    unsigned long w = plen(gpoly), i;
+    uint64_t maxpoly, q;
+    int threads, started = 0;
+
+    if (w < 2 || w > 63 || w > (unsigned long) BMP_BIT)
+        return 0;
+
+    memset(&ps, 0, sizeof(ps));
+    ps.pworks = pworks;
+    ps.shape = gpoly;
+    ps.width = w;
+    ps.flags = guess->flags;
+    maxpoly = (1ULL << w) - 1;
+    ps.first = ((uint64_t)(*gpoly.bitmap >> (BMP_BIT - w)) & maxpoly) | 1;
+    ps.last = maxpoly;
+
+    if (rflags & R_HAVEQ) {
+        /* polys must compare below qpoly, shorter ones always do */
+        if (plen(qpoly) < w)
+            return 1;
+        if (plen(qpoly) == w) {
+            q = (uint64_t)(*qpoly.bitmap >> (BMP_BIT - w)) & maxpoly;
+            if (q <= ps.first)
+                return 1;
+            ps.last = (q - 1) | 1;
+            if (ps.last >= q)
+                ps.last -= 2;
+        }
+    }
+    ps.jobs = ((ps.last - ps.first) >> 1) / R_JOBPOLYS + 1;
+
+    ps.nbits = plen(*pworks);
+    ps.bits = malloc(ps.nbits + 1);
+    if (!ps.bits)
+        return 0;
+    for (i = 0; i < ps.nbits; ++i)
+        ps.bits[i] = (pworks->bitmap[i / BMP_BIT] >> (BMP_BIT - 1 - i % BMP_BIT)) & 1;
+
+    pthread_mutex_init(&ps.lock, NULL);
+    threads = num_CPUs();
+    if (threads > R_MAXTHREADS)
+        threads = R_MAXTHREADS;
+    if ((uint64_t) threads > ps.jobs)
+        threads = (int) ps.jobs;
+    for (i = 1; i < (unsigned long) threads; ++i) {
+        if (pthread_create(thread_id + started, NULL, psworker, &ps) == 0)
+            ++started;
+    }
+    psworker(&ps);
+    for (i = 0; i < (unsigned long) started; ++i)
+        pthread_join(thread_id[i], NULL);
+    pthread_mutex_destroy(&ps.lock);
+    free(ps.bits);
+
+    if (ps.oom) {
+        free(ps.cand);
+        return 0;
+    }
+
+    qsort(ps.cand, ps.ncand, sizeof(uint64_t), pcmpu64);
+    for (i = 0; i < ps.ncand; ++i) {
+        *gpoly.bitmap = (bmp_t) ps.cand[i] << (BMP_BIT - w);
+        pcand(resc, result, gpoly, guess, rflags, args, argpolys);
+    }
+    free(ps.cand);
+    return 1;
+}
+
 static poly_t *
 modpol(const poly_t init, int rflags, int args, const poly_t *argpolys) {
     /* Produce, in ascending length order, a list of differences
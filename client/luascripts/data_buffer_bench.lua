@@ -0,0 +1,141 @@
+local getopt = require('getopt')
+local ansicolors  = require('ansicolors')
+
+copyright = ''
+author = 'Proxmark3 contributors'
+version = 'v1.0.0'
+desc = [[
+This script checks the shared buffer api (core.buffer, core.transceive) and measures its
+throughput against the string based bindings (core.GetFromBigBuf, core.SendCommandNG).
+
+Without a device only the buffer api self check runs.
+]]
+example = [[
+    script run data_buffer_bench
+    script run data_buffer_bench -n 100
+]]
+usage = [[
+script run data_buffer_bench [-h] [-n <rounds>]
+]]
+arguments = [[
+    -h             : this help
+    -n <rounds>    : number of rounds per test, defaults to 20
+]]
+
+local CMD_PING = 0x0109
+local BIGBUF_BYTES = 40000
+local PING_BYTES = 256
+
+---
+-- This is only meant to be used when errors occur
+local function oops(err)
+    print('ERROR:', err)
+    core.clearCommandBuffer()
+    return nil, err
+end
+---
+-- Usage help
+local function help()
+    print(copyright)
+    print(author)
+    print(version)
+    print(desc)
+    print(ansicolors.cyan..'Usage'..ansicolors.reset)
+    print(usage)
+    print(ansicolors.cyan..'Arguments'..ansicolors.reset)
+    print(arguments)
+    print(ansicolors.cyan..'Example usage'..ansicolors.reset)
+    print(example)
+end
+---
+-- checks the buffer methods against plain Lua strings
+local function selftest()
+    local b = core.buffer(8)
+    b:set(0, 0x01, 0x02, 0x03, 0x04)
+    b:write(4, '\xAA\xBB\xCC\xDD')
+    local v = b:sub(2, 4)
+    v:set(0, 0x33)
+    local ok = #b == 8
+        and b:hex() == '01023304AABBCCDD'
+        and b:u16(0) == 0x0201 and b:u16(0, true) == 0x0102
+        and b:u32(4) == 0xDDCCBBAA and b:u32(4, true) == 0xAABBCCDD
+        and select('#', b:get(0, 8)) == 8 and select(3, b:get(0, 8)) == 0x33
+        and v:hex() == '3304AABB' and v:string(1, 2) == '\x04\xAA'
+        and core.buffer('\x10\x20'):hex() == '1020'
+        and #core.demodbuffer() >= 0 and #core.graphbuffer() % 4 == 0
+    -- views keep their parent alive
+    v = nil
+    b = core.buffer(4):sub(1, 2)
+    collectgarbage()
+    ok = ok and b:hex() == '0000'
+    print(('buffer api self check  | %s'):format(ok and 'ok' or 'failed'))
+    return ok
+end
+---
+-- prints one throughput line, t in ms
+local function report(name, units, unit, t)
+    t = math.max(t, 1) / 1000
+    print(('%-24s| %10.0f %s/s'):format(name, units / t, unit))
+end
+---
+-- device part, BigBuf downloads and echoed pings
+local function bench_device(rounds)
+    local t = core.msclock()
+    for _ = 1, rounds do
+        local s, err = core.GetFromBigBuf(0, BIGBUF_BYTES)
+        if not s then return oops(err) end
+    end
+    report('GetFromBigBuf string', rounds * BIGBUF_BYTES, 'bytes', core.msclock() - t)
+
+    local b = core.buffer(BIGBUF_BYTES)
+    t = core.msclock()
+    for _ = 1, rounds do
+        local res, err = core.GetFromBigBuf(0, BIGBUF_BYTES, b)
+        if not res then return oops(err) end
+    end
+    report('GetFromBigBuf buffer', rounds * BIGBUF_BYTES, 'bytes', core.msclock() - t)
+
+    local payload = core.buffer(PING_BYTES)
+    for i = 0, PING_BYTES - 1 do payload:set(i, i % 256) end
+    local hex = payload:hex()
+
+    t = core.msclock()
+    for _ = 1, rounds do
+        core.SendCommandNG(CMD_PING, hex)
+        local res, err = core.WaitForResponseTimeout(CMD_PING, 1000)
+        if not res then return oops(err) end
+    end
+    report('SendCommandNG ping', rounds, 'cmds', core.msclock() - t)
+
+    local requests = {}
+    for i = 1, rounds do requests[i] = { cmd = CMD_PING, data = payload } end
+    t = core.msclock()
+    local replies, list = core.transceive(requests, 1000)
+    if not replies then return oops(list) end
+    report('transceive ping', rounds, 'cmds', core.msclock() - t)
+    return replies:hex(list[rounds].offset, list[rounds].length) == hex
+end
+---
+-- The main entry point
+function main(args)
+
+    local rounds = 20
+    for o, a in getopt.getopt(args, 'hn:') do
+        if o == 'h' then return help() end
+        if o == 'n' then rounds = tonumber(a) end
+    end
+
+    print( string.rep('-', 48) )
+    if not selftest() then return oops('buffer api self check failed') end
+
+    -- a single ping tells us if there is a device to talk to
+    local res = core.transceive({ { cmd = CMD_PING } }, 1000)
+    if not res then
+        print('no device, skipping device throughput')
+    elseif not bench_device(rounds) then
+        return oops('device benchmark failed')
+    end
+    print( string.rep('-', 48) )
+end
+
+main(args)
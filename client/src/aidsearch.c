@@ -21,47 +21,19 @@
 #include "fileutils.h"
 #include "pm3_cmd.h"
 
-static int openAIDFile(json_t **root, bool verbose) {
-    json_error_t error;
-
-    char *path;
-    int res = searchFile(&path, RESOURCES_SUBDIR, "aidlist", ".json", false);
-    if (res != PM3_SUCCESS) {
-        return PM3_EFILE;
-    }
-
-    int retval = PM3_SUCCESS;
-    *root = json_load_file(path, 0, &error);
-    if (!*root) {
-        PrintAndLogEx(ERR, "json (%s) error on line %d: %s", path, error.line, error.text);
-        retval = PM3_ESOFT;
-        goto out;
-    }
-
-    if (!json_is_array(*root)) {
-        PrintAndLogEx(ERR, "Invalid json (%s) format. root must be an array.", path);
-        retval = PM3_ESOFT;
-        goto out;
-    }
-
-    PrintAndLogEx(DEBUG, "Loaded file " _YELLOW_("%s") " " _GREEN_("%zu") " records ( " _GREEN_("ok") " )", path, json_array_size(*root));
-out:
-    free(path);
-    return retval;
-}
-
-static int closeAIDFile(json_t *root) {
-    json_decref(root);
-    return PM3_SUCCESS;
-}
-
+// the list is parsed once per session and shared through the resource cache,
+// every AIDSearchInit hands out its own reference to it.
 json_t *AIDSearchInit(bool verbose) {
-    json_t *root = NULL;
-    int res = openAIDFile(&root, verbose);
-    if (res != PM3_SUCCESS)
+    json_t *root = loadResourceJSON("aidlist", false, false);
+    if (root == NULL)
+        return NULL;
+
+    if (!json_is_array(root)) {
+        PrintAndLogEx(ERR, "Invalid json (aidlist) format. root must be an array.");
         return NULL;
+    }
 
-    return root;
+    return json_incref(root);
 }
 
 json_t *AIDSearchGetElm(json_t *root, size_t elmindx) {
@@ -74,7 +46,8 @@ json_t *AIDSearchGetElm(json_t *root, size_t elmindx) {
 }
 
 int AIDSearchFree(json_t *root) {
-    return closeAIDFile(root);
+    json_decref(root);
+    return PM3_SUCCESS;
 }
 
 static const char *jsonStrGet(json_t *data, const char *name) {
@@ -94,15 +67,20 @@ static const char *jsonStrGet(json_t *data, const char *name) {
     return cstr;
 }
 
-static bool aidCompare(const char *aidlarge, const char *aidsmall) {
-    if (strcmp(aidlarge, aidsmall) == 0)
-        return true;
-
-    if (strlen(aidlarge) > strlen(aidsmall))
-        if (strncmp(aidlarge, aidsmall, strlen(aidsmall)) == 0)
-            return true;
+// longest dictionary AID which equals the requested one or is a prefix of it
+static json_t *aidLongestPrefix(const char *aid) {
+    json_t *index = getResourceJSONIndex("aidlist", "AID", false);
+    if (index == NULL)
+        return NULL;
 
-    return false;
+    json_t *elm = NULL;
+    char prefix[strlen(aid) + 1];
+    strcpy(prefix, aid);
+    for (size_t len = strlen(aid); len > 0 && elm == NULL; len--) {
+        prefix[len] = '\0';
+        elm = json_object_get(index, prefix);
+    }
+    return elm;
 }
 
 bool AIDGetFromElm(json_t *data, uint8_t *aid, size_t aidmaxlen, int *aidlen) {
@@ -121,27 +99,14 @@ bool AIDGetFromElm(json_t *data, uint8_t *aid, size_t aidmaxlen, int *aidlen) {
 int PrintAIDDescription(json_t *xroot, char *aid, bool verbose) {
     int retval = PM3_SUCCESS;
 
+    // lookups go through the index of the cached list, xroot is that same list
     json_t *root = xroot;
     if (root == NULL)
         root = AIDSearchInit(verbose);
-    if (root == NULL)
+    if (root == NULL || aid == NULL)
         goto out;
 
-    json_t *elm = NULL;
-    size_t maxaidlen = 0;
-    for (size_t elmindx = 0; elmindx < json_array_size(root); elmindx++) {
-        json_t *data = AIDSearchGetElm(root, elmindx);
-        if (data == NULL)
-            continue;
-        const char *dictaid = jsonStrGet(data, "AID");
-        if (aidCompare(aid, dictaid)) {  // dictaid may be less length than requested aid
-            if (maxaidlen < strlen(dictaid) && strlen(dictaid) <= strlen(aid)) {
-                maxaidlen = strlen(dictaid);
-                elm = data;
-            }
-        }
-    }
-
+    json_t *elm = aidLongestPrefix(aid);
     if (elm == NULL)
         goto out;
 
@@ -18,37 +18,75 @@
 #include "atrs.h"
 #include <string.h>
 #include <stdlib.h>
+#include <ctype.h>
 #include "commonutil.h"   // ARRAYLEN
 #include "ui.h" // PrintAndLogEx
 
-// get a ATR description based on the atr bytes
-// returns description of the best match
-const char *getAtrInfo(const char *atr_str) {
+// AtrTable index, built on first use.
+// Entries without ".." are plain strings and go into a hash table, the first one wins.
+// In entries with ".." every '.' matches any character. The hex ones are stored in a character trie
+// with '.' as an extra edge, the few with other characters are still compared one by one.
+// An exact match beats all wildcard ones, among these the last in the table wins.
+#define ATR_COUNT       (ARRAYLEN(AtrTable) - 1)    // last element is the default
+#define ATR_HASH_SIZE   8192                        // power of two, over twice ATR_COUNT
+#define ATR_EDGE_ANY    16                          // '.' edge, after 0-F
+
+typedef struct {
+    uint16_t next[ATR_EDGE_ANY + 1];
+    int16_t match;                      // last table entry ending here, -1 for none
+} atr_node_t;
+
+static bool atr_indexed = false;
+static int16_t atr_hash[ATR_HASH_SIZE];
+static atr_node_t *atr_trie = NULL;
+static size_t atr_trie_len = 0;
+static int16_t atr_other[ATR_COUNT];
+static size_t atr_other_len = 0;
+
+static int atr_edge(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    if (c == '.')
+        return ATR_EDGE_ANY;
+    return -1;
+}
+
+static uint32_t atr_hash_str(const char *s) {
+    uint32_t h = 0x811C9DC5;
+    while (*s) {
+        h ^= (uint8_t) * s++;
+        h *= 0x01000193;
+    }
+    return h;
+}
+
+static bool atr_wildcard_match(const char *pattern, const char *atr_str, size_t slen) {
+    if (strlen(pattern) != slen)
+        return false;
+
+    for (size_t j = 0; j < slen; j++) {
+        if (pattern[j] != '.' && pattern[j] != atr_str[j])
+            return false;
+    }
+    return true;
+}
+
+// the table walk used before the index,  kept as fallback and for the selftest
+static const char *atr_lookup_linear(const char *atr_str) {
     size_t slen = strlen(atr_str);
     int match = -1;
-    // skip last element of AtrTable
-    for (int i = 0; i < ARRAYLEN(AtrTable) - 1; ++i) {
+    for (int i = 0; i < ATR_COUNT; ++i) {
 
         if (strlen(AtrTable[i].bytes) != slen)
             continue;
 
         if (strstr(AtrTable[i].bytes, "..") != NULL) {
-            char *tmp_atr = calloc(slen, sizeof(uint8_t));
-            if (tmp_atr == NULL) {
-                PrintAndLogEx(FAILED, "failed to allocate memory");
-                return NULL;
-            }
-
-            for (int j = 0; j < slen; j++) {
-                tmp_atr[j] = AtrTable[i].bytes[j] == '.' ? '.' : atr_str[j];
-            }
-
-            if (strncmp(tmp_atr, AtrTable[i].bytes, slen) == 0) {
+            if (atr_wildcard_match(AtrTable[i].bytes, atr_str, slen)) {
                 // record partial match but continue looking for full match
                 match = i;
             }
-            free(tmp_atr);
-
         } else {
             if (strncmp(atr_str, AtrTable[i].bytes, slen) == 0) return AtrTable[i].desc;
         }
@@ -60,3 +98,179 @@ const char *getAtrInfo(const char *atr_str) {
         return AtrTable[ARRAYLEN(AtrTable) - 1].desc;
     }
 }
+
+static bool atr_trie_add(const char *pattern, int16_t idx) {
+    size_t node = 0;
+    for (const char *p = pattern; *p; p++) {
+        int e = atr_edge(*p);
+        if (atr_trie[node].next[e] == 0) {
+            if ((atr_trie_len & 0xFF) == 0) {
+                atr_node_t *tmp = realloc(atr_trie, (atr_trie_len + 0x100) * sizeof(atr_node_t));
+                if (tmp == NULL)
+                    return false;
+                atr_trie = tmp;
+            }
+            if (atr_trie_len > UINT16_MAX)
+                return false;
+            memset(&atr_trie[atr_trie_len], 0, sizeof(atr_node_t));
+            atr_trie[atr_trie_len].match = -1;
+            atr_trie[node].next[e] = atr_trie_len++;
+        }
+        node = atr_trie[node].next[e];
+    }
+    atr_trie[node].match = idx;
+    return true;
+}
+
+static bool atr_build_index(void) {
+    if (atr_indexed)
+        return true;
+
+    atr_trie = calloc(0x100, sizeof(atr_node_t));
+    if (atr_trie == NULL) {
+        PrintAndLogEx(FAILED, "failed to allocate memory");
+        return false;
+    }
+    atr_trie[0].match = -1;
+    atr_trie_len = 1;
+    atr_other_len = 0;
+    memset(atr_hash, 0xFF, sizeof(atr_hash));
+
+    for (int i = 0; i < ATR_COUNT; i++) {
+        const char *pattern = AtrTable[i].bytes;
+
+        if (strstr(pattern, "..") == NULL) {
+            uint32_t h = atr_hash_str(pattern) & (ATR_HASH_SIZE - 1);
+            while (atr_hash[h] >= 0 && strcmp(AtrTable[atr_hash[h]].bytes, pattern) != 0)
+                h = (h + 1) & (ATR_HASH_SIZE - 1);
+            if (atr_hash[h] < 0)
+                atr_hash[h] = i;
+            continue;
+        }
+
+        bool hex = true;
+        for (const char *p = pattern; *p && hex; p++)
+            hex = (atr_edge(*p) >= 0);
+
+        if (hex == false) {
+            atr_other[atr_other_len++] = i;
+        } else if (atr_trie_add(pattern, i) == false) {
+            PrintAndLogEx(FAILED, "failed to allocate memory");
+            free(atr_trie);
+            atr_trie = NULL;
+            return false;
+        }
+    }
+    atr_indexed = true;
+    return true;
+}
+
+// highest table entry below `node` matching the rest of the string
+static int atr_trie_search(size_t node, const char *s) {
+    if (*s == '\0')
+        return atr_trie[node].match;
+
+    int best = -1;
+    int e = atr_edge(*s);
+    if (e >= 0 && e < ATR_EDGE_ANY && atr_trie[node].next[e])
+        best = atr_trie_search(atr_trie[node].next[e], s + 1);
+
+    if (atr_trie[node].next[ATR_EDGE_ANY]) {
+        int m = atr_trie_search(atr_trie[node].next[ATR_EDGE_ANY], s + 1);
+        if (m > best)
+            best = m;
+    }
+    return best;
+}
+
+// get a ATR description based on the atr bytes
+// returns description of the best match
+const char *getAtrInfo(const char *atr_str) {
+    if (atr_build_index() == false)
+        return atr_lookup_linear(atr_str);
+
+    uint32_t h = atr_hash_str(atr_str) & (ATR_HASH_SIZE - 1);
+    while (atr_hash[h] >= 0) {
+        if (strcmp(AtrTable[atr_hash[h]].bytes, atr_str) == 0)
+            return AtrTable[atr_hash[h]].desc;
+        h = (h + 1) & (ATR_HASH_SIZE - 1);
+    }
+
+    int match = atr_trie_search(0, atr_str);
+
+    size_t slen = strlen(atr_str);
+    for (size_t i = 0; i < atr_other_len; i++) {
+        if (atr_other[i] > match && atr_wildcard_match(AtrTable[atr_other[i]].bytes, atr_str, slen))
+            match = atr_other[i];
+    }
+
+    if (match >= 0) {
+        return AtrTable[match].desc;
+    } else {
+        //No match, return default = last element of AtrTable
+        return AtrTable[ARRAYLEN(AtrTable) - 1].desc;
+    }
+}
+
+static bool atr_compare_lookup(const char *atr_str) {
+    const char *indexed = getAtrInfo(atr_str);
+    const char *linear = atr_lookup_linear(atr_str);
+    if (indexed != linear) {
+        PrintAndLogEx(FAILED, "ATR `%s` indexed and table walk differ", atr_str);
+        return false;
+    }
+    return true;
+}
+
+// indexed lookup against the table walk, for every table entry and variations of it
+bool AtrSelfTest(void) {
+    if (atr_build_index() == false)
+        return false;
+
+    bool res = true;
+    uint32_t lfsr = 0x5EED1234;
+    uint32_t lookups = 0;
+
+    for (int i = 0; i < ATR_COUNT && res; i++) {
+        const char *pattern = AtrTable[i].bytes;
+        size_t len = strlen(pattern);
+        char atr[len + 2];
+
+        // entry itself, every wildcard filled with random hex and a few single character changes
+        for (int v = 0; v < 8 && res; v++) {
+            strcpy(atr, pattern);
+            for (size_t j = 0; j < len; j++) {
+                lfsr = lfsr * 1103515245 + 12345;
+                if (v && atr[j] == '.')
+                    atr[j] = "0123456789ABCDEF"[(lfsr >> 16) & 0xF];
+            }
+            if (v >= 4 && len) {
+                lfsr = lfsr * 1103515245 + 12345;
+                atr[(lfsr >> 16) % len] = "0123456789ABCDEF."[(lfsr >> 8) % 17];
+            }
+            res = atr_compare_lookup(atr);
+            lookups++;
+        }
+
+        // lower case, truncated and one character longer
+        if (res) {
+            for (size_t j = 0; j < len; j++)
+                atr[j] = tolower((uint8_t)atr[j]);
+            res = atr_compare_lookup(atr);
+            strcpy(atr, pattern);
+            atr[len - 1] = '\0';
+            res = res && atr_compare_lookup(atr);
+            strcpy(atr, pattern);
+            strcat(atr, "0");
+            res = res && atr_compare_lookup(atr);
+            lookups += 3;
+        }
+    }
+    PrintAndLogEx(INFO, "entries %zu, trie nodes %zu, compared one by one %zu", ATR_COUNT, atr_trie_len, atr_other_len);
+    PrintAndLogEx(res ? SUCCESS : FAILED, "%u lookups against the table walk ( %s )", lookups, res ? _GREEN_("ok") : _RED_("fail"));
+
+    res = res && atr_compare_lookup("") && atr_compare_lookup("3B");
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(res ? SUCCESS : FAILED, "Tests [ %s ]", res ? _GREEN_("ok") : _RED_("fail"));
+    return res;
+}
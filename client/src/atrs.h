@@ -23,6 +23,7 @@
 
 #define ATRS_H__
 #include <stddef.h>
+#include <stdbool.h>
 
 typedef struct atr_s {
     const char *bytes;
@@ -30,6 +31,7 @@ typedef struct atr_s {
 } atr_t;
 
 const char *getAtrInfo(const char *atr_str);
+bool AtrSelfTest(void);
 
 // atr_t array is expected to be NULL terminated
 const static atr_t AtrTable[] = {
@@ -527,9 +527,10 @@ static int CmdrevengSearch(const char *Cmd) {
 }
 
 int CmdCrc(const char *Cmd) {
-    char c[100 + 7];
+    // room for several 32 bit samples in a search
+    char c[1024 + 7];
     snprintf(c, sizeof(c), "reveng ");
-    snprintf(c + strlen(c), sizeof(c) - strlen(c), Cmd, strlen(Cmd));
+    snprintf(c + strlen(c), sizeof(c) - strlen(c), "%s", Cmd);
 
     char *argv[MAX_ARGS];
     int argc = split(c, argv);
@@ -35,6 +35,7 @@
 #include "cmdlft55xx.h"          // print...
 #include "crypto/asn1utils.h"    // ASN1 decode / print
 #include "cmdflashmemspiffs.h"   // SPIFFS flash memory download
+#include "bigbuf_lz4.h"            // compressed download self test
 
 uint8_t g_DemodBuffer[MAX_DEMOD_BUF_LEN];
 size_t g_DemodBufferLen = 0;
@@ -1805,6 +1806,137 @@ int getSamplesEx(uint32_t start, uint32_t end, bool verbose, bool ignore_lf_conf
     return PM3_SUCCESS;
 }
 
+// Packs src with the firmware packer,  unpacks the packets with the client decoder and compares.
+// Returns the bytes sent on the wire, 0 on error
+static uint32_t samples_lz4_roundtrip(const uint8_t *src, uint32_t len) {
+
+    uint8_t *dst = calloc(len, sizeof(uint8_t));
+    if (dst == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return 0;
+    }
+
+    uint8_t cbuf[PM3_CMD_DATA_SIZE];
+    uint32_t wire = 0;
+    for (uint32_t i = 0; i < len;) {
+        uint32_t block_len = 0;
+        uint32_t packet_len = bigbuf_lz4_pack(src + i, len - i, cbuf, sizeof(cbuf), &block_len);
+
+        const uint8_t *packet = (packet_len == block_len) ? src + i : cbuf;
+        if (BigBufUnpackLZ4(dst, len, i, packet, packet_len, block_len) != PM3_SUCCESS) {
+            free(dst);
+            return 0;
+        }
+        wire += packet_len;
+        i += block_len;
+    }
+
+    bool ok = (memcmp(src, dst, len) == 0);
+    free(dst);
+    return ok ? wire : 0;
+}
+
+// Download of samples_lz4_fill() as sent by the firmware,  lz4 built with LZ4_MEMORY_USAGE=8.
+// 512 bytes of noise go as is,  the ASK part in one compressed packet
+#define SAMPLES_LZ4_VECTOR_LEN 2600
+static const uint8_t samples_lz4_vector[] = {
+    0x4F, 0xC8, 0xC7, 0xC6, 0xC5, 0x04, 0x00, 0x29, 0x4F, 0x38, 0x39, 0x3A, 0x3B, 0x04, 0x00, 0x69,
+    0x0F, 0xBC, 0x00, 0x29, 0x0F, 0x3C, 0x00, 0x11, 0x0F, 0xDC, 0x00, 0x0D, 0x0F, 0x44, 0x00, 0x0D,
+    0x0F, 0x40, 0x00, 0x0D, 0x0F, 0x20, 0x00, 0x0D, 0x0F, 0x60, 0x00, 0x2D, 0x0F, 0x40, 0x00, 0x0D,
+    0x0F, 0x20, 0x00, 0x6D, 0x0F, 0x00, 0x01, 0x0D, 0x0F, 0x20, 0x00, 0xCD, 0x0F, 0x80, 0x01, 0x6D,
+    0x0F, 0x80, 0x00, 0x2D, 0x0F, 0xA0, 0x01, 0x6D, 0x0F, 0xC0, 0x00, 0x2D, 0x0F, 0x40, 0x00, 0x0D,
+    0x0F, 0xE0, 0x00, 0x0D, 0x0F, 0x40, 0x00, 0x2D, 0x0F, 0x60, 0x00, 0x4D, 0x0F, 0xA0, 0x00, 0x0D,
+    0x0F, 0x20, 0x00, 0x6D, 0x0F, 0x00, 0x01, 0x0D, 0x0F, 0x20, 0x00, 0xCD, 0x0F, 0x80, 0x01, 0x6D,
+    0x0F, 0x80, 0x00, 0x10, 0x50, 0xC5, 0xC8, 0xC7, 0xC6, 0xC5
+};
+
+static void samples_lz4_fill(uint8_t *d, uint32_t len) {
+    uint32_t x = 0x2545F491;
+    for (uint32_t i = 0; i < len; i++) {
+        if (i < 512) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            d[i] = x & 0xFF;
+        } else {
+            uint8_t bit = (0xA5C3F00F >> ((i / 32) & 31)) & 1;
+            d[i] = bit ? 0xC8 - (i & 3) : 0x38 + (i & 3);
+        }
+    }
+}
+
+// The client decodes the firmware packets,  and the packer gives the same packets
+static bool samples_lz4_vector_test(void) {
+
+    uint8_t src[SAMPLES_LZ4_VECTOR_LEN];
+    uint8_t dst[SAMPLES_LZ4_VECTOR_LEN] = {0};
+    samples_lz4_fill(src, sizeof(src));
+
+    bool res = (BigBufUnpackLZ4(dst, sizeof(dst), 0, src, 512, 512) == PM3_SUCCESS);
+    res = res && (BigBufUnpackLZ4(dst, sizeof(dst), 512, samples_lz4_vector, sizeof(samples_lz4_vector), sizeof(dst) - 512) == PM3_SUCCESS);
+    res = res && (memcmp(src, dst, sizeof(src)) == 0);
+    PrintAndLogEx(res ? SUCCESS : FAILED, "firmware packets decode ( %s )", res ? _GREEN_("ok") : _RED_("fail"));
+
+    uint8_t cbuf[PM3_CMD_DATA_SIZE];
+    uint32_t block_len = 0;
+    bool pack = (bigbuf_lz4_pack(src, sizeof(src), cbuf, sizeof(cbuf), &block_len) == 512) && (block_len == 512);
+    uint32_t packet_len = bigbuf_lz4_pack(src + 512, sizeof(src) - 512, cbuf, sizeof(cbuf), &block_len);
+    pack = pack && (block_len == sizeof(src) - 512) && (packet_len == sizeof(samples_lz4_vector));
+    pack = pack && (memcmp(cbuf, samples_lz4_vector, sizeof(samples_lz4_vector)) == 0);
+    PrintAndLogEx(pack ? SUCCESS : FAILED, "packer gives the firmware packets ( %s )", pack ? _GREEN_("ok") : _RED_("fail"));
+
+    return res && pack;
+}
+
+static int samples_lz4_selftest(void) {
+
+    bool res = samples_lz4_vector_test();
+
+    // incompressible data goes through the stored as is path
+    uint8_t *noise = calloc(4096, sizeof(uint8_t));
+    if (noise == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+
+    uint32_t x = 0x2545F491;
+    for (uint32_t i = 0; i < 4096; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        noise[i] = x & 0xFF;
+    }
+
+    uint32_t wire = samples_lz4_roundtrip(noise, 4096);
+    bool rnd = (wire == 4096);
+    PrintAndLogEx(rnd ? SUCCESS : FAILED, "random data, 4096 bytes, %u on the wire ( %s )", wire, rnd ? _GREEN_("ok") : _RED_("fail"));
+    free(noise);
+    res = res && rnd;
+
+    // a loaded trace,  as the device holds it, 8 bits per sample
+    if (g_GraphTraceLen) {
+        uint8_t *samples = calloc(g_GraphTraceLen, sizeof(uint8_t));
+        if (samples == NULL) {
+            PrintAndLogEx(WARNING, "Failed to allocate memory");
+            return PM3_EMALLOC;
+        }
+
+        for (uint32_t i = 0; i < g_GraphTraceLen; i++) {
+            int v = g_GraphBuffer[i] + 127;
+            samples[i] = (v < 0) ? 0 : (v > 255) ? 255 : v;
+        }
+
+        wire = samples_lz4_roundtrip(samples, g_GraphTraceLen);
+        bool trace = (wire != 0);
+        PrintAndLogEx(trace ? SUCCESS : FAILED, "trace, %zu bytes, %u on the wire ( %s )", g_GraphTraceLen, wire, trace ? _GREEN_("ok") : _RED_("fail"));
+        free(samples);
+        res = res && trace;
+    }
+
+    PrintAndLogEx(res ? SUCCESS : FAILED, "Compressed download tests [ %s ]", res ? _GREEN_("ok") : _RED_("fail"));
+    return res ? PM3_SUCCESS : PM3_ESOFT;
+}
+
 static int CmdSamples(const char *Cmd) {
 
     CLIParserContext *ctx;
@@ -1812,18 +1944,26 @@ static int CmdSamples(const char *Cmd) {
                   "Get raw samples for graph window (GraphBuffer) from device.\n"
                   "If 0, then get whole big buffer from device.",
                   "data samples\n"
-                  "data samples -n 10000"
+                  "data samples -n 10000\n"
+                  "data samples -t          --> self test of the compressed download,  a loaded trace is round tripped too"
                  );
     void *argtable[] = {
         arg_param_begin,
         arg_int0("n", NULL, "<dec>", "num of samples (512 - 40000)"),
         arg_lit0("v", "verbose", "verbose"),
+        arg_lit0("t", "test", "self test of the compressed download"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
     int n = arg_get_int_def(ctx, 1, 0);
     bool verbose = arg_get_lit(ctx, 2);
+    bool selftest = arg_get_lit(ctx, 3);
     CLIParserFree(ctx);
+
+    if (selftest) {
+        return samples_lz4_selftest();
+    }
+
     return getSamples(n, verbose);
 }
 
@@ -684,6 +684,119 @@ static int FastDumpWithEcFill(uint8_t numsectors) {
     return PM3_SUCCESS;
 }
 
+// Copies the sector records of one bulk dump response into carddata
+static int mfDumpSectorsParse(PacketResponseNG *resp, uint8_t numSectors, uint8_t keyA[][6], uint8_t keyB[][6], uint8_t carddata[][16], uint8_t *seen) {
+
+    if (resp->length < 2) {
+        PrintAndLogEx(ERR, "short dump response, %u bytes", resp->length);
+        return PM3_ESOFT;
+    }
+
+    mf_dump_sectors_resp_t *r = (mf_dump_sectors_resp_t *)resp->data.asBytes;
+    uint16_t len = resp->length - 2;
+    uint16_t used = 0;
+    for (uint8_t i = 0; i < r->count; i++) {
+        mf_dump_sector_hdr_t hdr;
+        if (used + sizeof(hdr) > len) {
+            PrintAndLogEx(ERR, "dump response truncated after %u sectors", *seen);
+            return PM3_ESOFT;
+        }
+        memcpy(&hdr, r->data + used, sizeof(hdr));
+        if (hdr.sector >= numSectors) {
+            PrintAndLogEx(ERR, "unexpected sector %u in dump response", hdr.sector);
+            return PM3_ESOFT;
+        }
+
+        uint8_t blocks = mfNumBlocksPerSector(hdr.sector);
+        if (used + sizeof(hdr) + blocks * 16 > len) {
+            PrintAndLogEx(ERR, "dump response truncated in sector %u", hdr.sector);
+            return PM3_ESOFT;
+        }
+
+        uint8_t *data = r->data + used + sizeof(hdr);
+        for (uint8_t b = 0; b < blocks; b++) {
+            if ((hdr.read_mask & (1 << b)) == 0) {
+                PrintAndLogEx(FAILED, "could not read block %2d of sector %2d", b, hdr.sector);
+                continue;
+            }
+
+            uint8_t *blk = carddata[mfFirstBlockOfSector(hdr.sector) + b];
+            memcpy(blk, data + b * 16, 16);
+            if (b == blocks - 1) { // sector trailer. Fill in the keys.
+                memcpy(blk, keyA[hdr.sector], 6);
+                memcpy(blk + 10, keyB[hdr.sector], 6);
+            }
+            PrintAndLogEx(SUCCESS, "successfully read block %2d of sector %2d.", b, hdr.sector);
+        }
+        used += sizeof(hdr) + blocks * 16;
+        (*seen)++;
+    }
+    return PM3_SUCCESS;
+}
+
+// Bulk dump, the device authenticates once per sector and streams back every
+// readable block. Returns PM3_ENOTIMPL when the firmware doesn't support it.
+static int mfDumpSectorsBulk(uint8_t numSectors, uint8_t keyA[][6], uint8_t keyB[][6], uint8_t carddata[][16]) {
+
+    if (g_pm3_capabilities.compiled_with_mf_dump_sectors == false) {
+        return PM3_ENOTIMPL;
+    }
+
+    mf_dump_sectors_t payload;
+    memset(&payload, 0, sizeof(payload));
+    payload.first_sector = 0;
+    payload.sector_count = numSectors;
+    for (uint8_t s = 0; s < numSectors; s++) {
+        memcpy(payload.keys[s][0], keyA[s], 6);
+        memcpy(payload.keys[s][1], keyB[s], 6);
+    }
+
+    PrintAndLogEx(INFO, "Dumping all blocks from card...");
+
+    clearCommandBuffer();
+    SendCommandNG(CMD_HF_MIFARE_DUMP_SECTORS, (uint8_t *)&payload, sizeof(payload));
+
+    // the device asks for more time (WTX) before every sector, the timeout only covers the transfer.
+    // On a timeout or a bad packet the device is stopped and its remaining replies are drained
+    int res = PM3_SUCCESS;
+    bool stopped = false;
+    uint8_t seen = 0;
+    PacketResponseNG resp;
+    for (;;) {
+        if (WaitForResponseTimeout(CMD_HF_MIFARE_DUMP_SECTORS, &resp, 2500) == false) {
+            if (stopped) {
+                break;
+            }
+            PrintAndLogEx(WARNING, "command execute timeout, dump incomplete");
+            res = PM3_ETIMEOUT;
+            stopped = true;
+            SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            continue;
+        }
+
+        if (stopped == false) {
+            int pres = mfDumpSectorsParse(&resp, numSectors, keyA, keyB, carddata, &seen);
+            if (pres != PM3_SUCCESS) {
+                res = pres;
+                stopped = true;
+                SendCommandNG(CMD_BREAK_LOOP, NULL, 0);
+            }
+        }
+
+        if (resp.length >= 2 && ((mf_dump_sectors_resp_t *)resp.data.asBytes)->last) {
+            if (res == PM3_SUCCESS) {
+                res = resp.status;
+            }
+            break;
+        }
+    }
+
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(WARNING, "dump interrupted after %u sectors, saving what was read", seen);
+    }
+    return res;
+}
+
 static int CmdHF14AMfDump(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf mf dump",
@@ -815,6 +928,13 @@ static int CmdHF14AMfDump(const char *Cmd) {
 
     fclose(f);
 
+    // one pipelined transfer, block by block when the firmware doesn't support it.
+    // An interrupted transfer still saves the blocks read, like the block by block dump does
+    if (mfDumpSectorsBulk(numSectors, keyA, keyB, carddata) != PM3_ENOTIMPL) {
+        goto out;
+    }
+    PrintAndLogEx(INFO, "bulk dump not supported by device firmware, falling back to block by block");
+
     PrintAndLogEx(INFO, "Reading sector access bits...");
     PrintAndLogEx(INFO, "." NOLF);
 
@@ -936,6 +1056,7 @@ static int CmdHF14AMfDump(const char *Cmd) {
         }
     }
 
+out:
     PrintAndLogEx(SUCCESS, "time: %" PRIu64 " seconds\n", (msclock() - t1) / 1000);
 
     PrintAndLogEx(SUCCESS, "\nSucceeded in dumping all blocks");
@@ -1827,6 +1948,103 @@ jumptoend:
     return PM3_SUCCESS;
 }
 
+#define HARDNESTED_MAX_FILES    16
+#define HARDNESTED_DEFAULT_JOBS 1
+
+// Offline cracking of several nonce files. Each worker takes the next file from the queue,
+// collecting nonces and reducing the key space run in parallel while the brute force phases take turns.
+typedef struct {
+    char filename[FILE_PATH_SIZE];
+    int res;
+    bool found;
+    uint64_t foundkey;
+} hardnested_file_job_t;
+
+typedef struct {
+    hardnested_file_job_t *jobs;
+    uint32_t count;
+    uint32_t next;
+    uint8_t *trgkey;
+} hardnested_file_queue_t;
+
+static void *hardnested_file_worker(void *arg) {
+    hardnested_file_queue_t *q = (hardnested_file_queue_t *)arg;
+
+    uint32_t i;
+    while ((i = __atomic_fetch_add(&q->next, 1, __ATOMIC_SEQ_CST)) < q->count) {
+        hardnested_file_job_t *job = &q->jobs[i];
+
+        const char *label = strrchr(job->filename, PATHSEP[0]);
+        label = (label == NULL) ? job->filename : label + 1;
+
+        hardnested_ctx_t *hctx = hardnested_ctx_new(label);
+        if (hctx == NULL) {
+            job->res = PM3_EMALLOC;
+            continue;
+        }
+
+        job->res = hardnested_read_nonces(hctx, job->filename);
+        if (job->res == PM3_SUCCESS) {
+            hardnested_set_target_key(hctx, q->trgkey);
+            job->found = hardnested_crack(hctx, &job->foundkey);
+        }
+        hardnested_ctx_free(hctx);
+    }
+    return NULL;
+}
+
+static int hardnested_crack_files(char filenames[][FILE_PATH_SIZE], uint32_t count, uint32_t jobs, uint8_t *trgkey) {
+
+    hardnested_file_job_t *file_jobs = calloc(count, sizeof(hardnested_file_job_t));
+    if (file_jobs == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        memcpy(file_jobs[i].filename, filenames[i], FILE_PATH_SIZE);
+    }
+
+    hardnested_file_queue_t queue = {
+        .jobs = file_jobs,
+        .count = count,
+        .next = 0,
+        .trgkey = trgkey
+    };
+
+    jobs = MAX(1, MIN(jobs, count));
+    uint32_t fit = hardnested_max_parallel();
+    if (jobs > fit) {
+        PrintAndLogEx(WARNING, "Not enough free memory for %u attacks at a time, using " _YELLOW_("%u"), jobs, fit);
+        jobs = fit;
+    }
+    PrintAndLogEx(INFO, "Cracking " _YELLOW_("%u") " nonce files, " _YELLOW_("%u") " at a time", count, jobs);
+
+    pthread_t threads[HARDNESTED_MAX_FILES];
+    for (uint32_t i = 0; i < jobs; i++) {
+        pthread_create(&threads[i], NULL, hardnested_file_worker, &queue);
+    }
+    for (uint32_t i = 0; i < jobs; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    PrintAndLogEx(NORMAL, "");
+    int res = PM3_SUCCESS;
+    for (uint32_t i = 0; i < count; i++) {
+        if (file_jobs[i].res != PM3_SUCCESS) {
+            PrintAndLogEx(FAILED, "%s -- couldn't read nonces", file_jobs[i].filename);
+            res = PM3_EFILE;
+        } else if (file_jobs[i].found) {
+            PrintAndLogEx(SUCCESS, "%s -- found valid key [ " _GREEN_("%012" PRIx64) " ]", file_jobs[i].filename, file_jobs[i].foundkey);
+        } else {
+            PrintAndLogEx(FAILED, "%s -- key not found", file_jobs[i].filename);
+        }
+    }
+
+    free(file_jobs);
+    return res;
+}
+
 static int CmdHF14AMfNestedHard(const char *Cmd) {
 
     CLIParserContext *ctx;
@@ -1841,9 +2059,11 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
                   "hf mf hardnested --blk 0 -a -k FFFFFFFFFFFF --tblk 4 --ta\n"
                   "hf mf hardnested --blk 0 -a -k FFFFFFFFFFFF --tblk 4 --ta -w\n"
                   "hf mf hardnested --blk 0 -a -k FFFFFFFFFFFF --tblk 4 --ta -f nonces.bin -w -s\n"
+                  "hf mf hardnested --blk 0 -a -k FFFFFFFFFFFF --tblk 4 --ta -f nonces.bin --append --lz4\n"
                   "hf mf hardnested -r\n"
                   "hf mf hardnested -r --tk a0a1a2a3a4a5\n"
                   "hf mf hardnested -t --tk a0a1a2a3a4a5\n"
+                  "hf mf hardnested -f s1.bin -f s2.bin -f s3.bin -j 2\n"
                   "hf mf hardnested --blk 0 -a -k a0a1a2a3a4a5 --tblk 4 --ta --tk FFFFFFFFFFFF"
                  );
 
@@ -1858,11 +2078,14 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
         arg_lit0(NULL, "tb",             "Target key B"),
         arg_str0(NULL, "tk",    "<hex>", "Target key, 12 hex bytes"), // 8
         arg_str0("u",  "uid",   "<hex>", "R/W `hf-mf-<UID>-nonces.bin` instead of default name"),
-        arg_str0("f",  "file",  "<fn>",  "R/W <name> instead of default name"),
+        arg_strn("f",  "file",  "<fn>",  0, HARDNESTED_MAX_FILES, "R/W <name> instead of default name. Several files are read and cracked in parallel"),
         arg_lit0("r",  "read",           "Read `hf-mf-<UID>-nonces.bin` if tag present, otherwise `nonces.bin`, and start attack"),
         arg_lit0("s",  "slow",           "Slower acquisition (required by some non standard cards)"),
         arg_lit0("t",  "tests",          "Run tests"),
         arg_lit0("w",  "wr",             "Acquire nonces and UID, and write them to file `hf-mf-<UID>-nonces.bin`"),
+        arg_int0("j",  "jobs",  "<dec>", "Number of nonce files to crack in parallel, about 1.2GB each (def 1)"),
+        arg_lit0(NULL, "append",         "Append nonces as a new session to an existing nonce file (implies -w)"),
+        arg_lit0(NULL, "lz4",            "LZ4 compress nonce blocks written to file"),
 
         arg_lit0(NULL, "in", "None (use CPU regular instruction set)"),
 #if defined(COMPILER_HAS_SIMD_X86)
@@ -1915,27 +2138,44 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
     char uid[14] = {0};
     CLIParamStrToBuf(arg_get_str(ctx, 9), (uint8_t *)uid, sizeof(uid), &uidlen);
 
-    int fnlen = 0;
     char filename[FILE_PATH_SIZE] = {0};
-    CLIParamStrToBuf(arg_get_str(ctx, 10), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+    char filenames[HARDNESTED_MAX_FILES][FILE_PATH_SIZE] = {{0}};
+    struct arg_str *files = arg_get_str(ctx, 10);
+    uint32_t nfiles = files->count;
+    for (uint32_t i = 0; i < nfiles; i++) {
+        strncpy(filenames[i], files->sval[i], FILE_PATH_SIZE - 1);
+    }
+    if (nfiles) {
+        memcpy(filename, filenames[0], FILE_PATH_SIZE);
+    }
 
     bool nonce_file_read = arg_get_lit(ctx, 11);
     bool slow = arg_get_lit(ctx, 12);
     bool tests = arg_get_lit(ctx, 13);
     bool nonce_file_write = arg_get_lit(ctx, 14);
+    uint32_t jobs = arg_get_u32_def(ctx, 15, HARDNESTED_DEFAULT_JOBS);
+
+    uint8_t nonce_file_mode = 0;
+    if (arg_get_lit(ctx, 16)) {
+        nonce_file_mode |= HARDNESTED_NFW_APPEND;
+        nonce_file_write = true;
+    }
+    if (arg_get_lit(ctx, 17)) {
+        nonce_file_mode |= HARDNESTED_NFW_LZ4;
+    }
 
-    bool in = arg_get_lit(ctx, 15);
+    bool in = arg_get_lit(ctx, 18);
 #if defined(COMPILER_HAS_SIMD_X86)
-    bool im = arg_get_lit(ctx, 16);
-    bool is = arg_get_lit(ctx, 17);
-    bool ia = arg_get_lit(ctx, 18);
-    bool i2 = arg_get_lit(ctx, 19);
+    bool im = arg_get_lit(ctx, 19);
+    bool is = arg_get_lit(ctx, 20);
+    bool ia = arg_get_lit(ctx, 21);
+    bool i2 = arg_get_lit(ctx, 22);
 #endif
 #if defined(COMPILER_HAS_SIMD_AVX512)
-    bool i5 = arg_get_lit(ctx, 20);
+    bool i5 = arg_get_lit(ctx, 23);
 #endif
 #if defined(COMPILER_HAS_SIMD_NEON)
-    bool ie = arg_get_lit(ctx, 16);
+    bool ie = arg_get_lit(ctx, 19);
 #endif
     CLIParserFree(ctx);
 
@@ -1969,6 +2209,15 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
 
     bool know_target_key = (trg_keylen);
 
+    // several pre-acquired nonce files, no tag needed
+    if (nfiles > 1) {
+        if (nonce_file_write || tests || uidlen) {
+            PrintAndLogEx(WARNING, "Several files can only be used for reading nonces");
+            return PM3_EINVARG;
+        }
+        return hardnested_crack_files(filenames, nfiles, jobs, know_target_key ? trg_key : NULL);
+    }
+
     if (nonce_file_read) {
         char *fptr = GenerateFilename("hf-mf-", "-nonces.bin");
         if (fptr == NULL)
@@ -2019,7 +2268,7 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
                   tests);
 
     uint64_t foundkey = 0;
-    int16_t isOK = mfnestedhard(blockno, keytype, key, trg_blockno, trg_keytype, know_target_key ? trg_key : NULL, nonce_file_read, nonce_file_write, slow, tests, &foundkey, filename);
+    int16_t isOK = mfnestedhard(blockno, keytype, key, trg_blockno, trg_keytype, know_target_key ? trg_key : NULL, nonce_file_read, nonce_file_write, slow, tests, &foundkey, filename, nonce_file_mode);
 
     if ((tests == 0) && IfPm3Iso14443a()) {
         DropField();
@@ -2041,6 +2290,153 @@ static int CmdHF14AMfNestedHard(const char *Cmd) {
     return 0;
 }
 
+// autopwn runs the brute force phase of hardnested attacks in the background while the
+// remaining sectors are attacked. Nonces for the next target are acquired while earlier
+// targets are cracked, as many attacks are alive as memory allows (hardnested_max_parallel)
+#define AUTOPWN_HARDNESTED_JOBS 4
+
+typedef struct {
+    hardnested_ctx_t *ctx;
+    pthread_t thread;
+    bool active;
+    bool done;
+    bool found;
+    uint8_t sector;
+    uint8_t keytype;
+    uint32_t seq;
+    uint64_t foundkey;
+} autopwn_hardnested_job_t;
+
+// Try a found key on all sectors with unknown keys
+static void autopwn_try_key(uint8_t sector_cnt, uint8_t *key, sector_t *e_sector) {
+    uint64_t key64 = 0;
+    // <!> The fast check --> mfCheckKeys_fast(sector_cnt, true, true, 2, 1, key, e_sector, false);
+    // <!> Returns false keys, so we just stick to the slower mfchk.
+    for (int i = 0; i < sector_cnt; i++) {
+        for (int j = MF_KEY_A; j <= MF_KEY_B; j++) {
+            // Check if the sector key is already broken
+            if (e_sector[i].foundKey[j])
+                continue;
+
+            // Check if the key works
+            if (mfCheckKeys(mfFirstBlockOfSector(i), j, true, 1, key, &key64) == PM3_SUCCESS) {
+                e_sector[i].Key[j] = bytes_to_num(key, 6);
+                e_sector[i].foundKey[j] = 'R';
+                PrintAndLogEx(SUCCESS, "target sector %3u key type %c -- found valid key [ " _GREEN_("%s") " ]",
+                              i,
+                              (j == MF_KEY_B) ? 'B' : 'A',
+                              sprint_hex_inrow(key, 6)
+                             );
+            }
+        }
+    }
+}
+
+static void *autopwn_hardnested_worker(void *arg) {
+    autopwn_hardnested_job_t *job = (autopwn_hardnested_job_t *)arg;
+    job->found = hardnested_crack(job->ctx, &job->foundkey);
+    __atomic_store_n(&job->done, true, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void autopwn_hardnested_start(autopwn_hardnested_job_t *jobs, hardnested_ctx_t *ctx, uint8_t sector, uint8_t keytype) {
+    static uint32_t seq = 0;
+    for (uint32_t i = 0; i < AUTOPWN_HARDNESTED_JOBS; i++) {
+        autopwn_hardnested_job_t *job = &jobs[i];
+        if (job->active) {
+            continue;
+        }
+        job->ctx = ctx;
+        job->sector = sector;
+        job->keytype = keytype;
+        job->seq = seq++;
+        job->found = false;
+        job->foundkey = 0;
+        job->done = false;
+        job->active = true;
+        pthread_create(&job->thread, NULL, autopwn_hardnested_worker, job);
+        return;
+    }
+}
+
+// Collect the result of one background attack. Without wait only a finished attack is collected.
+// A new key is stored in e_sector and, unless sector_cnt is 0, tried on all unknown sectors right away.
+static void autopwn_hardnested_collect(autopwn_hardnested_job_t *job, sector_t *e_sector, uint8_t sector_cnt, bool wait) {
+    if (job->active == false) {
+        return;
+    }
+
+    if (wait == false && __atomic_load_n(&job->done, __ATOMIC_ACQUIRE) == false) {
+        return;
+    }
+
+    pthread_join(job->thread, NULL);
+    hardnested_ctx_free(job->ctx);
+    job->ctx = NULL;
+    job->active = false;
+
+    if (job->found == false) {
+        PrintAndLogEx(FAILED, "target sector %3u key type %c -- hardnested attack didn't find the key",
+                      job->sector,
+                      (job->keytype == MF_KEY_B) ? 'B' : 'A'
+                     );
+        return;
+    }
+
+    // found meanwhile by key reuse
+    if (e_sector[job->sector].foundKey[job->keytype]) {
+        return;
+    }
+
+    uint8_t key[6];
+    num_to_bytes(job->foundkey, 6, key);
+    e_sector[job->sector].Key[job->keytype] = job->foundkey;
+    e_sector[job->sector].foundKey[job->keytype] = 'H';
+    PrintAndLogEx(SUCCESS, "target sector %3u key type %c -- found valid key [ " _GREEN_("%s") " ]",
+                  job->sector,
+                  (job->keytype == MF_KEY_B) ? 'B' : 'A',
+                  sprint_hex_inrow(key, sizeof(key))
+                 );
+
+    if (sector_cnt) {
+        autopwn_try_key(sector_cnt, key, e_sector);
+    }
+}
+
+// Collect the finished attacks, or all of them with wait. Returns the number still running
+static uint32_t autopwn_hardnested_collect_all(autopwn_hardnested_job_t *jobs, sector_t *e_sector, uint8_t sector_cnt, bool wait) {
+    uint32_t running = 0;
+    for (uint32_t i = 0; i < AUTOPWN_HARDNESTED_JOBS; i++) {
+        autopwn_hardnested_collect(&jobs[i], e_sector, sector_cnt, wait);
+        if (jobs[i].active) {
+            running++;
+        }
+    }
+    return running;
+}
+
+// Wait for the oldest attacks until fewer than limit are running, leaving room for one more
+static void autopwn_hardnested_make_room(autopwn_hardnested_job_t *jobs, uint32_t limit, sector_t *e_sector, uint8_t sector_cnt) {
+    while (autopwn_hardnested_collect_all(jobs, e_sector, sector_cnt, false) >= limit) {
+        autopwn_hardnested_job_t *oldest = NULL;
+        for (uint32_t i = 0; i < AUTOPWN_HARDNESTED_JOBS; i++) {
+            if (jobs[i].active && (oldest == NULL || jobs[i].seq < oldest->seq)) {
+                oldest = &jobs[i];
+            }
+        }
+        autopwn_hardnested_collect(oldest, e_sector, sector_cnt, true);
+    }
+}
+
+static bool autopwn_hardnested_running(autopwn_hardnested_job_t *jobs, uint8_t sector, uint8_t keytype) {
+    for (uint32_t i = 0; i < AUTOPWN_HARDNESTED_JOBS; i++) {
+        if (jobs[i].active && jobs[i].sector == sector && jobs[i].keytype == keytype) {
+            return true;
+        }
+    }
+    return false;
+}
+
 static int CmdHF14AMfAutoPWN(const char *Cmd) {
 
     CLIParserContext *ctx;
@@ -2206,7 +2602,6 @@ static int CmdHF14AMfAutoPWN(const char *Cmd) {
     uint8_t tmp_key[6] = {0};
 
     // Nested and Hardnested returned status
-    uint64_t foundkey = 0;
     int isOK = 0;
     int current_sector_i = 0, current_key_type_i = 0;
     // Dumping and transfere to simulater memory
@@ -2527,40 +2922,42 @@ noValidKeyFound:
     // Clear the needed variables
     num_to_bytes(0, 6, tmp_key);
     bool nested_failed = false;
+    autopwn_hardnested_job_t hn_jobs[AUTOPWN_HARDNESTED_JOBS] = {0};
+    uint32_t hn_limit = MIN(hardnested_max_parallel(), AUTOPWN_HARDNESTED_JOBS);
+    bool hn_deferred[MIFARE_4K_MAXSECTOR] = {0};
+    bool hn_second_pass = false;
 
     // Iterate over each sector and key(A/B)
+hn_again:
     for (current_sector_i = 0; current_sector_i < sector_cnt; current_sector_i++) {
         for (current_key_type_i = 0; current_key_type_i < 2; current_key_type_i++) {
 
+            // The second round only revisits the B keys left for the background attacks
+            if (hn_second_pass && (current_key_type_i == MF_KEY_A || hn_deferred[current_sector_i] == false))
+                continue;
+
             // If the key is already known, just skip it
             if (e_sector[current_sector_i].foundKey[current_key_type_i] == 0) {
 
                 // Try the found keys are reused
                 if (bytes_to_num(tmp_key, 6) != 0) {
-                    // <!> The fast check --> mfCheckKeys_fast(sector_cnt, true, true, 2, 1, tmp_key, e_sector, false);
-                    // <!> Returns false keys, so we just stick to the slower mfchk.
-                    for (int i = 0; i < sector_cnt; i++) {
-                        for (int j = MF_KEY_A; j <= MF_KEY_B; j++) {
-                            // Check if the sector key is already broken
-                            if (e_sector[i].foundKey[j])
-                                continue;
-
-                            // Check if the key works
-                            if (mfCheckKeys(mfFirstBlockOfSector(i), j, true, 1, tmp_key, &key64) == PM3_SUCCESS) {
-                                e_sector[i].Key[j] = bytes_to_num(tmp_key, 6);
-                                e_sector[i].foundKey[j] = 'R';
-                                PrintAndLogEx(SUCCESS, "target sector %3u key type %c -- found valid key [ " _GREEN_("%s") " ]",
-                                              i,
-                                              (j == MF_KEY_B) ? 'B' : 'A',
-                                              sprint_hex_inrow(tmp_key, sizeof(tmp_key))
-                                             );
-                            }
-                        }
-                    }
+                    autopwn_try_key(sector_cnt, tmp_key, e_sector);
                 }
                 // Clear the last found key
                 num_to_bytes(0, 6, tmp_key);
 
+                // Pick up the keys of finished background hardnested attacks, they are tried on all sectors right away
+                autopwn_hardnested_collect_all(hn_jobs, e_sector, sector_cnt, false);
+                if (e_sector[current_sector_i].foundKey[current_key_type_i])
+                    continue;
+
+                // The A key of this sector is still cracking and may allow reading the B key.
+                // Don't wait for it, come back to the B key once the background attacks are done
+                if (current_key_type_i == MF_KEY_B && autopwn_hardnested_running(hn_jobs, current_sector_i, MF_KEY_A)) {
+                    hn_deferred[current_sector_i] = true;
+                    continue;
+                }
+
                 if (current_key_type_i == MF_KEY_B) {
                     if (e_sector[current_sector_i].foundKey[0] && !e_sector[current_sector_i].foundKey[1]) {
                         if (verbose) {
@@ -2630,12 +3027,14 @@ tryNested:
                         switch (isOK) {
                             case PM3_ETIMEOUT: {
                                 PrintAndLogEx(ERR, "\nError: No response from Proxmark3.");
+                                autopwn_hardnested_collect_all(hn_jobs, e_sector, 0, true);
                                 free(e_sector);
                                 free(fptr);
                                 return PM3_ESOFT;
                             }
                             case PM3_EOPABORTED: {
                                 PrintAndLogEx(WARNING, "\nButton pressed. Aborted.");
+                                autopwn_hardnested_collect_all(hn_jobs, e_sector, 0, true);
                                 free(e_sector);
                                 free(fptr);
                                 return PM3_EOPABORTED;
@@ -2667,6 +3066,7 @@ tryNested:
                             }
                             default: {
                                 PrintAndLogEx(ERR, "unknown Error.\n");
+                                autopwn_hardnested_collect_all(hn_jobs, e_sector, 0, true);
                                 free(e_sector);
                                 free(fptr);
                                 return PM3_ESOFT;
@@ -2683,9 +3083,28 @@ tryHardnested: // If the nested attack fails then we try the hardnested attack
                                           slow ? "Yes" : "No");
                         }
 
-                        isOK = mfnestedhard(mfFirstBlockOfSector(sectorno), keytype, key, mfFirstBlockOfSector(current_sector_i), current_key_type_i, NULL, false, false, slow, 0, &foundkey, NULL);
+                        // each attack holds about 1.2GB of nonce tables. The nonces for this target are acquired
+                        // while the earlier targets crack, as long as memory allows one more attack
+                        autopwn_hardnested_make_room(hn_jobs, hn_limit, e_sector, sector_cnt);
+                        if (e_sector[current_sector_i].foundKey[current_key_type_i])
+                            continue;
+
+                        char label[24];
+                        snprintf(label, sizeof(label), "sector %u key %c", current_sector_i, (current_key_type_i == MF_KEY_B) ? 'B' : 'A');
+                        hardnested_ctx_t *hctx = hardnested_ctx_new(label);
+                        if (hctx == NULL) {
+                            autopwn_hardnested_collect_all(hn_jobs, e_sector, 0, true);
+                            free(e_sector);
+                            free(fptr);
+                            return PM3_EMALLOC;
+                        }
+
+                        isOK = hardnested_acquire(hctx, mfFirstBlockOfSector(sectorno), keytype, key, mfFirstBlockOfSector(current_sector_i), current_key_type_i, false, slow, NULL);
                         DropField();
+
                         if (isOK) {
+                            hardnested_ctx_free(hctx);
+                            autopwn_hardnested_collect_all(hn_jobs, e_sector, 0, true);
                             switch (isOK) {
                                 case 1: {
                                     PrintAndLogEx(ERR, "\nError: No response from Proxmark3");
@@ -2704,10 +3123,8 @@ tryHardnested: // If the nested attack fails then we try the hardnested attack
                             return PM3_ESOFT;
                         }
 
-                        // Copy the found key to the tmp_key variale (for the following print statement, and the mfCheckKeys above)
-                        num_to_bytes(foundkey, 6, tmp_key);
-                        e_sector[current_sector_i].Key[current_key_type_i] = foundkey;
-                        e_sector[current_sector_i].foundKey[current_key_type_i] = 'H';
+                        // The key is collected later on, the next targets are attacked meanwhile
+                        autopwn_hardnested_start(hn_jobs, hctx, current_sector_i, current_key_type_i);
                     }
 
                     if (has_staticnonce == NONCE_STATIC) {
@@ -2724,12 +3141,14 @@ tryStaticnested:
                         switch (isOK) {
                             case PM3_ETIMEOUT: {
                                 PrintAndLogEx(ERR, "\nError: No response from Proxmark3");
+                                autopwn_hardnested_collect_all(hn_jobs, e_sector, 0, true);
                                 free(e_sector);
                                 free(fptr);
                                 return PM3_ESOFT;
                             }
                             case PM3_EOPABORTED: {
                                 PrintAndLogEx(WARNING, "\nButton pressed, user aborted");
+                                autopwn_hardnested_collect_all(hn_jobs, e_sector, 0, true);
                                 free(e_sector);
                                 free(fptr);
                                 return PM3_EOPABORTED;
@@ -2758,6 +3177,18 @@ tryStaticnested:
         }
     }
 
+    // Wait for the background attacks, then revisit the B keys that were left for them
+    autopwn_hardnested_collect_all(hn_jobs, e_sector, sector_cnt, true);
+    if (hn_second_pass == false) {
+        hn_second_pass = true;
+        for (uint8_t i = 0; i < sector_cnt; i++) {
+            if (hn_deferred[i]) {
+                num_to_bytes(0, 6, tmp_key);
+                goto hn_again;
+            }
+        }
+    }
+
 all_found:
 
     // Show the results to the user
@@ -2838,7 +3269,53 @@ all_found:
     return PM3_SUCCESS;
 }
 
-static int mfLoadKeys(uint8_t **pkeyBlock, uint32_t *pkeycnt, uint8_t *userkey, int userkeylen, const char *filename, int fnlen) {
+#define MF_MAX_DICTIONARIES 8
+
+static uint8_t mfGetDictionaryNames(struct arg_str *arg, char filenames[][FILE_PATH_SIZE]) {
+    uint8_t cnt = 0;
+    for (int i = 0; i < arg->count && cnt < MF_MAX_DICTIONARIES; i++) {
+        if (strlen(arg->sval[i]) == 0)
+            continue;
+        strncpy(filenames[cnt], arg->sval[i], FILE_PATH_SIZE - 1);
+        filenames[cnt][FILE_PATH_SIZE - 1] = '\0';
+        cnt++;
+    }
+    return cnt;
+}
+
+// let the dictionaries know which of their keys worked, they are tried first next time
+static void mfUpdateDictionaryHits(char filenames[][FILE_PATH_SIZE], uint8_t fncnt, sector_t *e_sector, uint8_t sectorcnt) {
+    if (fncnt == 0)
+        return;
+
+    uint8_t keys[MIFARE_4K_MAXSECTOR * 2 * 6];
+    uint32_t keycnt = 0;
+    for (uint8_t i = 0; i < sectorcnt; i++) {
+        for (uint8_t j = 0; j < 2; j++) {
+            if (e_sector[i].foundKey[j] == 0)
+                continue;
+
+            uint8_t key[6];
+            num_to_bytes(e_sector[i].Key[j], 6, key);
+
+            // count a key once per card
+            bool seen = false;
+            for (uint32_t k = 0; k < keycnt && seen == false; k++) {
+                seen = (memcmp(keys + (k * 6), key, 6) == 0);
+            }
+            if (seen == false) {
+                memcpy(keys + (keycnt * 6), key, 6);
+                keycnt++;
+            }
+        }
+    }
+
+    for (uint8_t i = 0; i < fncnt && keycnt; i++) {
+        updateFileDICTIONARYhits(filenames[i], 6, keys, keycnt);
+    }
+}
+
+static int mfLoadKeys(uint8_t **pkeyBlock, uint32_t *pkeycnt, uint8_t *userkey, int userkeylen, char filenames[][FILE_PATH_SIZE], uint8_t fncnt) {
     // Handle Keys
     *pkeycnt = 0;
     *pkeyBlock = NULL;
@@ -2878,11 +3355,16 @@ static int mfLoadKeys(uint8_t **pkeyBlock, uint32_t *pkeycnt, uint8_t *userkey,
     }
     *pkeycnt += ARRAYLEN(g_mifare_default_keys);
 
-    // Handle user supplied dictionary file
-    if (fnlen > 0) {
+    // Handle user supplied dictionary files
+    if (fncnt > 0) {
+        const char *names[MF_MAX_DICTIONARIES];
+        for (uint8_t i = 0; i < fncnt; i++) {
+            names[i] = filenames[i];
+        }
+
         uint32_t loaded_numKeys = 0;
         uint8_t *keyBlock_tmp = NULL;
-        int res = loadFileDICTIONARY_safe(filename, (void **) &keyBlock_tmp, 6, &loaded_numKeys);
+        int res = loadFileDICTIONARY_merged(names, fncnt, (void **) &keyBlock_tmp, 6, &loaded_numKeys);
         if (res != PM3_SUCCESS || loaded_numKeys == 0 || *pkeyBlock == NULL) {
             PrintAndLogEx(FAILED, "An error occurred while loading the dictionary!");
             free(keyBlock_tmp);
@@ -2914,6 +3396,7 @@ static int CmdHF14AMfChk_fast(const char *Cmd) {
                   "hf mf fchk --2k -k FFFFFFFFFFFF                --> Key recovery against MIFARE 2k\n"
                   "hf mf fchk --4k -k FFFFFFFFFFFF                --> Key recovery against MIFARE 4k\n"
                   "hf mf fchk --1k -f mfc_default_keys.dic        --> Target 1K using default dictionary file\n"
+                  "hf mf fchk --1k -f my.dic -f mfc_default_keys  --> Target 1K using two dictionary files\n"
                   "hf mf fchk --1k --emu                          --> Target 1K, write keys to emulator memory\n"
                   "hf mf fchk --1k --dump                         --> Target 1K, write keys to file\n"
                   "hf mf fchk --1k --mem                          --> Target 1K, use dictionary from flash memory");
@@ -2928,7 +3411,7 @@ static int CmdHF14AMfChk_fast(const char *Cmd) {
         arg_lit0(NULL, "emu", "Fill simulator keys from found keys"),
         arg_lit0(NULL, "dump", "Dump found keys to binary file"),
         arg_lit0(NULL, "mem", "Use dictionary from flashmemory"),
-        arg_str0("f", "file", "<fn>", "filename of dictionary"),
+        arg_strn("f", "file", "<fn>", 0, MF_MAX_DICTIONARIES, "filename of dictionary, several files are merged"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -2946,9 +3429,8 @@ static int CmdHF14AMfChk_fast(const char *Cmd) {
     bool createDumpFile = arg_get_lit(ctx, 7);
     bool use_flashmemory = arg_get_lit(ctx, 8);
 
-    int fnlen = 0;
-    char filename[FILE_PATH_SIZE] = {0};
-    CLIParamStrToBuf(arg_get_str(ctx, 9), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+    char filenames[MF_MAX_DICTIONARIES][FILE_PATH_SIZE] = {{0}};
+    uint8_t fncnt = mfGetDictionaryNames(arg_get_str(ctx, 9), filenames);
 
     CLIParserFree(ctx);
 
@@ -2977,7 +3459,7 @@ static int CmdHF14AMfChk_fast(const char *Cmd) {
 
     uint8_t *keyBlock = NULL;
     uint32_t keycnt = 0;
-    int ret = mfLoadKeys(&keyBlock, &keycnt, key, keylen, filename, fnlen);
+    int ret = mfLoadKeys(&keyBlock, &keycnt, key, keylen, filenames, fncnt);
     if (ret != PM3_SUCCESS) {
         return ret;
     }
@@ -3057,6 +3539,10 @@ out:
 
         printKeyTable(sectorsCnt, e_sector);
 
+        if (use_flashmemory == false) {
+            mfUpdateDictionaryHits(filenames, fncnt, e_sector, sectorsCnt);
+        }
+
         if (use_flashmemory && found_keys == (sectorsCnt << 1)) {
             PrintAndLogEx(SUCCESS, "Card dumped as well. run " _YELLOW_("`%s %c`"),
                           "hf mf esave",
@@ -3132,7 +3618,7 @@ static int CmdHF14AMfChk(const char *Cmd) {
         arg_lit0(NULL, "4k", "MIFARE Classic 4k / S70"),
         arg_lit0(NULL, "emu", "Fill simulator keys from found keys"),
         arg_lit0(NULL, "dump", "Dump found keys to binary file"),
-        arg_str0("f", "file", "<fn>", "Filename of dictionary"),
+        arg_strn("f", "file", "<fn>", 0, MF_MAX_DICTIONARIES, "Filename of dictionary, several files are merged"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -3161,9 +3647,8 @@ static int CmdHF14AMfChk(const char *Cmd) {
     bool transferToEml = arg_get_lit(ctx, 10);
     bool createDumpFile = arg_get_lit(ctx, 11);
 
-    int fnlen = 0;
-    char filename[FILE_PATH_SIZE] = {0};
-    CLIParamStrToBuf(arg_get_str(ctx, 12), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+    char filenames[MF_MAX_DICTIONARIES][FILE_PATH_SIZE] = {{0}};
+    uint8_t fncnt = mfGetDictionaryNames(arg_get_str(ctx, 12), filenames);
 
     CLIParserFree(ctx);
     bool singleSector = blockNo > -1;
@@ -3218,7 +3703,7 @@ static int CmdHF14AMfChk(const char *Cmd) {
 
     uint8_t *keyBlock = NULL;
     uint32_t keycnt = 0;
-    int ret = mfLoadKeys(&keyBlock, &keycnt, key, keylen, filename, fnlen);
+    int ret = mfLoadKeys(&keyBlock, &keycnt, key, keylen, filenames, fncnt);
     if (ret != PM3_SUCCESS) {
         return ret;
     }
@@ -3340,6 +3825,8 @@ out:
     else
         printKeyTable(SectorsCnt, e_sector);
 
+    mfUpdateDictionaryHits(filenames, fncnt, e_sector, SectorsCnt);
+
     if (transferToEml) {
         // fast push mode
         g_conn.block_after_ACK = true;
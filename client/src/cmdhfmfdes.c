@@ -47,6 +47,7 @@
 #include "generator.h"
 #include "mifare/aiddesfire.h"
 #include "util.h"
+#include "emv/emvjson.h"   // JsonSaveStr
 
 #define MAX_KEY_LEN        24
 #define MAX_KEYS_LIST_LEN  1024
@@ -842,14 +843,23 @@ static void DesFill2bPattern(
     (*startPattern)++;
 }
 
+static int DesChkReselect(DesfireContext_t *dctx, uint32_t aid) {
+    DropField();
+    return DesfireSelectAIDHex(dctx, aid, false, 0);
+}
+
+static const DesfireChkOps_t DesChkCardOps = {
+    .authenticate = DesfireAuthenticate,
+    .reselect = DesChkReselect,
+    .aborted = kbd_enter_pressed,
+};
+
 static int AuthCheckDesfire(DesfireContext_t *dctx,
                             DesfireSecureChannel secureChannel,
                             const uint8_t *aid,
-                            uint8_t deskeyList[MAX_KEYS_LIST_LEN][8], uint32_t deskeyListLen,
-                            uint8_t aeskeyList[MAX_KEYS_LIST_LEN][16], uint32_t aeskeyListLen,
-                            uint8_t k3kkeyList[MAX_KEYS_LIST_LEN][24], uint32_t k3kkeyListLen,
-                            uint8_t cmdKdfAlgo, uint8_t kdfInputLen, uint8_t *kdfInput,
+                            DesfireChkKeyList_t keyLists[DESFIRE_CHK_KEY_TYPES],
                             uint8_t foundKeys[4][0xE][24 + 1],
+                            DesfireChkPosition_t *pos,
                             bool *result,
                             bool verbose) {
 
@@ -862,7 +872,7 @@ static int AuthCheckDesfire(DesfireContext_t *dctx,
         return PM3_ESOFT;
     }
 
-    int usedkeys[0xF] = {0};
+    bool usedkeys[DESFIRE_CHK_KEY_NUMS] = {0};
     bool des = false;
     bool tdes = false;
     bool aes = false;
@@ -893,7 +903,7 @@ static int AuthCheckDesfire(DesfireContext_t *dctx,
     }
 
     // always check master key
-    usedkeys[0] = 1;
+    usedkeys[0] = true;
 
     if (curaid != 0) {
         FileList_t fileList = {{0}};
@@ -904,21 +914,21 @@ static int AuthCheckDesfire(DesfireContext_t *dctx,
             if (filescount > 0) {
                 for (int i = 0; i < filescount; i++) {
                     if (fileList[i].fileSettings.rAccess < 0x0e)
-                        usedkeys[fileList[i].fileSettings.rAccess] = 1;
+                        usedkeys[fileList[i].fileSettings.rAccess] = true;
                     if (fileList[i].fileSettings.wAccess < 0x0e)
-                        usedkeys[fileList[i].fileSettings.wAccess] = 1;
+                        usedkeys[fileList[i].fileSettings.wAccess] = true;
                     if (fileList[i].fileSettings.rwAccess < 0x0e)
-                        usedkeys[fileList[i].fileSettings.rwAccess] = 1;
+                        usedkeys[fileList[i].fileSettings.rwAccess] = true;
                     if (fileList[i].fileSettings.chAccess < 0x0e)
-                        usedkeys[fileList[i].fileSettings.chAccess] = 1;
+                        usedkeys[fileList[i].fileSettings.chAccess] = true;
                 }
             } else {
                 for (int i = 0; i < 0xE; i++)
-                    usedkeys[i] = 1;
+                    usedkeys[i] = true;
             }
         } else {
             for (int i = 0; i < 0xE; i++)
-                usedkeys[i] = 1;
+                usedkeys[i] = true;
         }
     }
 
@@ -926,162 +936,251 @@ static int AuthCheckDesfire(DesfireContext_t *dctx,
         PrintAndLogEx(INFO, "Check: %s %s %s %s " NOLF, (des) ? "DES" : "", (tdes) ? "2TDEA" : "", (k3kdes) ? "3TDEA" : "", (aes) ? "AES" : "");
         PrintAndLogEx(NORMAL, "keys: " NOLF);
         for (int i = 0; i < 0xE; i++)
-            if (usedkeys[i] == 1)
+            if (usedkeys[i])
                 PrintAndLogEx(NORMAL, "%02x " NOLF, i);
         PrintAndLogEx(NORMAL, "");
     }
 
-    bool badlen = false;
-
-    if (des) {
-
-        for (uint8_t keyno = 0; keyno < 0xE; keyno++) {
+    // only the key types the application uses
+    DesfireChkKeyList_t lists[DESFIRE_CHK_KEY_TYPES];
+    memcpy(lists, keyLists, sizeof(lists));
+    bool enabled[DESFIRE_CHK_KEY_TYPES] = {des, tdes, aes, k3kdes};
+    for (int i = 0; i < DESFIRE_CHK_KEY_TYPES; i++) {
+        if (enabled[i] == false)
+            lists[i].count = 0;
+    }
 
-            if (usedkeys[keyno] == 1 && foundKeys[0][keyno][0] == 0) {
-                for (uint32_t curkey = 0; curkey < deskeyListLen; curkey++) {
-                    DesfireSetKeyNoClear(dctx, keyno, T_DES, deskeyList[curkey]);
-                    res = DesfireAuthenticate(dctx, secureChannel, false);
-                    if (res == PM3_SUCCESS) {
-                        PrintAndLogEx(SUCCESS, "AID 0x%06X, Found DES Key %02u          : " _GREEN_("%s"), curaid, keyno, sprint_hex(deskeyList[curkey], 8));
-                        foundKeys[0][keyno][0] = 0x01;
-                        *result = true;
-                        memcpy(&foundKeys[0][keyno][1], deskeyList[curkey], 8);
-                        break;
-                    } else if (res < 7) {
-                        badlen = true;
-                        DropField();
-                        res = DesfireSelectAIDHex(dctx, curaid, false, 0);
-                        if (res != PM3_SUCCESS) {
-                            return res;
-                        }
-                        break;
-                    }
-                }
-                if (badlen == true) {
-                    badlen = false;
-                    break;
-                }
-            }
-        }
+    res = DesfireCheckKeyLists(dctx, secureChannel, curaid, &DesChkCardOps, lists, usedkeys, foundKeys, pos, result);
+    if (res == PM3_EOPABORTED) {
+        PrintAndLogEx(WARNING, "\naborted via keyboard!");
+    }
+    if (res != PM3_SUCCESS) {
+        DropField();
+        return res;
     }
 
-    if (tdes) {
+    DropField();
+    return PM3_SUCCESS;
+}
 
-        for (uint8_t keyno = 0; keyno < 0xE; keyno++) {
+// Where the current key lists come from. Enough to load the same keys again when a search is resumed.
+typedef struct {
+    uint8_t stage;      // 0 - key from the command line, 1 - pattern or dictionary keys
+    uint32_t pattern;   // 2-byte pattern mode, first pattern of the lists
+    size_t dictPos[3];  // dictionary mode, file offsets of the des / aes / k3kdes lists. SIZE_MAX when a list is exhausted
+} DesChkChunk_t;
 
-            if (usedkeys[keyno] == 1 && foundKeys[1][keyno][0] == 0) {
-                for (uint32_t curkey = 0; curkey < aeskeyListLen; curkey++) {
-                    DesfireSetKeyNoClear(dctx, keyno, T_3DES, aeskeyList[curkey]);
-                    res = DesfireAuthenticate(dctx, secureChannel, false);
-                    if (res == PM3_SUCCESS) {
-                        PrintAndLogEx(SUCCESS, "AID 0x%06X, Found 2TDEA Key %02u        : " _GREEN_("%s"), curaid, keyno, sprint_hex(aeskeyList[curkey], 16));
-                        foundKeys[1][keyno][0] = 0x01;
-                        *result = true;
-                        memcpy(&foundKeys[1][keyno][1], aeskeyList[curkey], 16);
-                        break;
-                    } else if (res < 7) {
-                        badlen = true;
-                        DropField();
-                        res = DesfireSelectAIDHex(dctx, curaid, false, 0);
-                        if (res != PM3_SUCCESS) {
-                            return res;
-                        }
-                        break;
-                    }
-                }
-                if (badlen == true) {
-                    badlen = false;
-                    break;
-                }
-            }
+typedef struct {
+    uint8_t key[MAX_KEY_LEN];
+    int keylen;
+    bool pattern1b;
+    bool pattern2b;
+    char *dict;
+    uint8_t deskeyList[MAX_KEYS_LIST_LEN][8];
+    uint8_t aeskeyList[MAX_KEYS_LIST_LEN][16];
+    uint8_t k3kkeyList[MAX_KEYS_LIST_LEN][MAX_KEY_LEN];
+    uint32_t deskeyListLen;
+    uint32_t aeskeyListLen;
+    uint32_t k3kkeyListLen;
+} DesChkKeys_t;
+
+static void DesChkFirstChunk(DesChkKeys_t *keys, uint32_t startPattern, DesChkChunk_t *chunk) {
+    memset(chunk, 0, sizeof(DesChkChunk_t));
+    chunk->stage = (keys->keylen > 0) ? 0 : 1;
+    chunk->pattern = startPattern;
+}
+
+// Fills the key lists for a chunk. Returns false when there is no chunk after this one.
+static bool DesChkLoadChunk(DesChkKeys_t *keys, const DesChkChunk_t *chunk, DesChkChunk_t *next) {
+    keys->deskeyListLen = 0;
+    keys->aeskeyListLen = 0;
+    keys->k3kkeyListLen = 0;
+
+    memcpy(next, chunk, sizeof(DesChkChunk_t));
+
+    if (chunk->stage == 0) {
+        if (keys->keylen == 8) {
+            memcpy(keys->deskeyList[0], keys->key, 8);
+            keys->deskeyListLen = 1;
+        } else if (keys->keylen == 16) {
+            memcpy(keys->aeskeyList[0], keys->key, 16);
+            keys->aeskeyListLen = 1;
+        } else if (keys->keylen == 24) {
+            memcpy(keys->k3kkeyList[0], keys->key, 24);
+            keys->k3kkeyListLen = 1;
         }
+        next->stage = 1;
+        return (keys->pattern1b || keys->pattern2b || keys->dict != NULL);
     }
 
-    if (aes) {
-
-        for (uint8_t keyno = 0; keyno < 0xE; keyno++) {
+    // 1-byte pattern search mode
+    if (keys->pattern1b) {
+        for (uint32_t i = 0; i < 0x100; i++)
+            memset(keys->aeskeyList[i], i, 16);
+        for (uint32_t i = 0; i < 0x100; i++)
+            memset(keys->deskeyList[i], i, 8);
+        for (uint32_t i = 0; i < 0x100; i++)
+            memset(keys->k3kkeyList[i], i, 24);
+        keys->aeskeyListLen = 0x100;
+        keys->deskeyListLen = 0x100;
+        keys->k3kkeyListLen = 0x100;
+        return false;
+    }
 
-            if (usedkeys[keyno] == 1 && foundKeys[2][keyno][0] == 0) {
-                for (uint32_t curkey = 0; curkey < aeskeyListLen; curkey++) {
-                    DesfireSetKeyNoClear(dctx, keyno, T_AES, aeskeyList[curkey]);
-                    res = DesfireAuthenticate(dctx, secureChannel, false);
-                    if (res == PM3_SUCCESS) {
-                        PrintAndLogEx(SUCCESS, "AID 0x%06X, Found AES Key %02u          : " _GREEN_("%s"), curaid, keyno, sprint_hex(aeskeyList[curkey], 16));
-                        foundKeys[2][keyno][0] = 0x01;
-                        *result = true;
-                        memcpy(&foundKeys[2][keyno][1], aeskeyList[curkey], 16);
-                        break;
-                    } else if (res < 7) {
-                        badlen = true;
-                        DropField();
-                        res = DesfireSelectAIDHex(dctx, curaid, false, 0);
-                        if (res != PM3_SUCCESS) {
-                            return res;
-                        }
-                        break;
-                    }
-                }
-                if (badlen == true) {
-                    badlen = false;
-                    break;
-                }
+    // 2-byte pattern search mode
+    if (keys->pattern2b) {
+        next->pattern = chunk->pattern;
+        DesFill2bPattern(keys->deskeyList, &keys->deskeyListLen, keys->aeskeyList, &keys->aeskeyListLen, keys->k3kkeyList, &keys->k3kkeyListLen, &next->pattern);
+        return (next->pattern < 0x10000);
+    }
+
+    // dictionary mode. every list walks the file on its own, a line can hold keys of several lengths
+    if (keys->dict != NULL) {
+        void *lists[3] = {keys->deskeyList, keys->aeskeyList, keys->k3kkeyList};
+        size_t listsizes[3] = {sizeof(keys->deskeyList), sizeof(keys->aeskeyList), sizeof(keys->k3kkeyList)};
+        uint8_t keylens[3] = {8, 16, 24};
+        uint32_t *listlens[3] = {&keys->deskeyListLen, &keys->aeskeyListLen, &keys->k3kkeyListLen};
+        bool more = false;
+
+        for (int i = 0; i < 3; i++) {
+            next->dictPos[i] = SIZE_MAX;
+            if (chunk->dictPos[i] == SIZE_MAX)
+                continue;
+
+            size_t endpos = 0;
+            uint32_t keycnt = 0;
+            int res = loadFileDICTIONARYEx(keys->dict, lists[i], listsizes[i], NULL, keylens[i], &keycnt, chunk->dictPos[i], &endpos, false);
+            if (res != PM3_SUCCESS && res != 1)
+                continue;
+
+            *listlens[i] = keycnt;
+            if (endpos != 0) {
+                next->dictPos[i] = endpos;
+                more = true;
             }
         }
+        return more;
     }
 
-    if (k3kdes) {
+    return false;
+}
+
+// Resumable search. The state names the options it was made with and the card, a mismatch starts over.
+typedef struct {
+    uint32_t aidIndex;
+    DesChkChunk_t chunk;
+    DesfireChkPosition_t pos;
+} DesChkCursor_t;
+
+static void DesChkOptionsStr(DesChkKeys_t *keys, uint32_t startPattern, const uint8_t *aid, int aidlength, uint8_t kdfAlgo, uint8_t *kdfInput, int kdfInputLen, char *str, size_t maxlen) {
+    // sprint_hex_inrow has one static buffer, one call per snprintf
+    size_t len = snprintf(str, maxlen, "key=%s", sprint_hex_inrow(keys->key, keys->keylen));
+    len += snprintf(str + len, maxlen - len, " p1b=%d p2b=%d start=%04x dict=%s", keys->pattern1b, keys->pattern2b, startPattern, (keys->dict) ? keys->dict : "");
+    len += snprintf(str + len, maxlen - len, " aid=%s", (aidlength) ? sprint_hex_inrow(aid, 3) : "");
+    snprintf(str + len, maxlen - len, " kdf=%u kdfi=%s", kdfAlgo, sprint_hex_inrow(kdfInput, kdfInputLen));
+}
 
-        for (uint8_t keyno = 0; keyno < 0xE; keyno++) {
+static int DesChkSaveState(const char *fn, const char *options, DesfireContext_t *dctx, DesChkCursor_t *cursor, uint8_t foundKeys[4][0xE][24 + 1], bool result) {
+    json_t *root = json_object();
+    JsonSaveStr(root, "$.Created", "proxmark3");
+    JsonSaveStr(root, "$.FileType", "mfdes chk state");
+    JsonSaveStr(root, "$.Options", options);
+    JsonSaveBufAsHexCompact(root, "$.UID", dctx->uid, dctx->uidlen);
+    JsonSaveInt(root, "$.AIDIndex", cursor->aidIndex);
+    JsonSaveInt(root, "$.Chunk.Stage", cursor->chunk.stage);
+    JsonSaveInt(root, "$.Chunk.Pattern", cursor->chunk.pattern);
+    for (int i = 0; i < 3; i++) {
+        char path[40] = {0};
+        snprintf(path, sizeof(path), "$.Chunk.Dict%d", i);
+        // exhausted lists are saved as -1
+        JsonSaveInt(root, path, (cursor->chunk.dictPos[i] == SIZE_MAX) ? -1 : (int)cursor->chunk.dictPos[i]);
+    }
+    JsonSaveInt(root, "$.Position.KeyType", cursor->pos.type);
+    JsonSaveInt(root, "$.Position.KeyNum", cursor->pos.keyNum);
+    JsonSaveInt(root, "$.Position.KeyIndex", cursor->pos.keyIndex);
+    JsonSaveBoolean(root, "$.Result", result);
+    JsonSaveBufAsHexCompact(root, "$.FoundKeys", (uint8_t *)foundKeys, 4 * 0xE * (24 + 1));
+
+    int res = saveFileJSONrootEx(fn, root, JSON_INDENT(2), false, true);
+    json_decref(root);
+    if (res == PM3_SUCCESS)
+        PrintAndLogEx(INFO, "progress saved to " _YELLOW_("%s") ", run the same command again to resume", fn);
+    return res;
+}
 
-            if (usedkeys[keyno] == 1 && foundKeys[3][keyno][0] == 0) {
-                for (uint32_t curkey = 0; curkey < k3kkeyListLen; curkey++) {
-                    DesfireSetKeyNoClear(dctx, keyno, T_3K3DES, k3kkeyList[curkey]);
-                    res = DesfireAuthenticate(dctx, secureChannel, false);
-                    if (res == PM3_SUCCESS) {
-                        PrintAndLogEx(SUCCESS, "AID 0x%06X, Found 3TDEA Key %02u        : " _GREEN_("%s"), curaid, keyno, sprint_hex(k3kkeyList[curkey], 24));
-                        foundKeys[3][keyno][0] = 0x01;
-                        *result = true;
-                        memcpy(&foundKeys[3][keyno][1], k3kkeyList[curkey], 16);
-                        break;
-                    } else if (res < 7) {
-                        badlen = true;
-                        DropField();
-                        res = DesfireSelectAIDHex(dctx, curaid, false, 0);
-                        if (res != PM3_SUCCESS) {
-                            return res;
-                        }
-                        break;
-                    }
-                }
+static json_int_t DesChkJsonInt(json_t *root, const char *path) {
+    json_t *jelm = json_path_get(root, path);
+    return (json_is_integer(jelm)) ? json_integer_value(jelm) : 0;
+}
 
-                if (badlen == true) {
-                    break;
-                }
+static bool DesChkLoadState(const char *fn, const char *options, DesfireContext_t *dctx, DesChkCursor_t *cursor, uint8_t foundKeys[4][0xE][24 + 1], bool *result) {
+    char path[FILE_PATH_SIZE + 6] = {0};
+    snprintf(path, sizeof(path), "%s%s", fn, str_endswith(fn, ".json") ? "" : ".json");
+    if (fileExists(path) == false)
+        return false;
+
+    json_error_t error;
+    json_t *root = json_load_file(path, 0, &error);
+    if (root == NULL) {
+        PrintAndLogEx(WARNING, "can't read state file " _YELLOW_("%s") ", starting over", path);
+        return false;
+    }
+
+    bool res = false;
+    json_t *jopt = json_path_get(root, "$.Options");
+    uint8_t uid[10] = {0};
+    size_t uidlen = 0;
+    JsonLoadBufAsHex(root, "$.UID", uid, sizeof(uid), &uidlen);
+
+    if (json_is_string(jopt) == false || strcmp(json_string_value(jopt), options) != 0) {
+        PrintAndLogEx(WARNING, "state file was made with other options, starting over");
+    } else if (uidlen != dctx->uidlen || memcmp(uid, dctx->uid, uidlen) != 0) {
+        PrintAndLogEx(WARNING, "state file belongs to card " _YELLOW_("%s") ", starting over", sprint_hex_inrow(uid, uidlen));
+    } else {
+        size_t foundlen = 0;
+        uint8_t found[4 * 0xE * (24 + 1)] = {0};
+        if (JsonLoadBufAsHex(root, "$.FoundKeys", found, sizeof(found), &foundlen) == 0 && foundlen == sizeof(found)) {
+            memcpy(foundKeys, found, sizeof(found));
+            cursor->aidIndex = DesChkJsonInt(root, "$.AIDIndex");
+            cursor->chunk.stage = DesChkJsonInt(root, "$.Chunk.Stage");
+            cursor->chunk.pattern = DesChkJsonInt(root, "$.Chunk.Pattern");
+            for (int i = 0; i < 3; i++) {
+                char jpath[40] = {0};
+                snprintf(jpath, sizeof(jpath), "$.Chunk.Dict%d", i);
+                json_int_t pos = DesChkJsonInt(root, jpath);
+                cursor->chunk.dictPos[i] = (pos < 0) ? SIZE_MAX : (size_t)pos;
             }
+            cursor->pos.type = DesChkJsonInt(root, "$.Position.KeyType");
+            cursor->pos.keyNum = DesChkJsonInt(root, "$.Position.KeyNum");
+            cursor->pos.keyIndex = DesChkJsonInt(root, "$.Position.KeyIndex");
+            *result = json_is_true(json_path_get(root, "$.Result"));
+            res = true;
         }
     }
-    DropField();
-    return PM3_SUCCESS;
+
+    json_decref(root);
+    return res;
 }
 
 static int CmdHF14aDesChk(const char *Cmd) {
     int res;
-    uint8_t deskeyList[MAX_KEYS_LIST_LEN][8] = {{0}};
-    uint8_t aeskeyList[MAX_KEYS_LIST_LEN][16] = {{0}};
-    uint8_t k3kkeyList[MAX_KEYS_LIST_LEN][MAX_KEY_LEN] = {{0}};
-    uint32_t deskeyListLen = 0;
-    uint32_t aeskeyListLen = 0;
-    uint32_t k3kkeyListLen = 0;
+    DesChkKeys_t *keys = calloc(1, sizeof(DesChkKeys_t));
+    if (keys == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
     uint8_t foundKeys[4][0xE][24 + 1] = {{{0}}};
 
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "hf mfdes chk",
-                  "Checks keys with MIFARE DESFire card.",
+                  "Checks keys with MIFARE DESFire card.\n"
+                  "With `--state` the search can be stopped with <Enter> and picked up again by running the same command.",
                   "hf mfdes chk --aid 123456 -k 000102030405060708090a0b0c0d0e0f  -> check key on aid 0x123456\n"
                   "hf mfdes chk -d mfdes_default_keys                          -> check keys from dictionary against all existing aid on card\n"
                   "hf mfdes chk -d mfdes_default_keys --aid 123456        -> check keys from dictionary against aid 0x123456\n"
                   "hf mfdes chk --aid 123456 --pattern1b -j keys          -> check all 1-byte keys pattern on aid 0x123456 and save found keys to json\n"
-                  "hf mfdes chk --aid 123456 --pattern2b --startp2b FA00  -> check all 2-byte keys pattern on aid 0x123456. Start from key FA00FA00...FA00");
+                  "hf mfdes chk --aid 123456 --pattern2b --startp2b FA00  -> check all 2-byte keys pattern on aid 0x123456. Start from key FA00FA00...FA00\n"
+                  "hf mfdes chk --aid 123456 --pattern2b --state p2b      -> same, progress kept in p2b.json when interrupted");
 
     void *argtable[] = {
         arg_param_begin,
@@ -1096,6 +1195,7 @@ static int CmdHF14aDesChk(const char *Cmd) {
         arg_int0(NULL, "kdf",        "<0|1|2>", "Key Derivation Function (KDF) (0=None, 1=AN10922, 2=Gallagher)"),
         arg_str0("i",  "kdfi",       "<hex>", "KDF input (1-31 hex bytes)"),
         arg_lit0("a",  "apdu",       "Show APDU requests and responses"),
+        arg_str0(NULL, "state",      "<fn>",  "Resume from / save progress to this json file"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, false);
@@ -1106,23 +1206,18 @@ static int CmdHF14aDesChk(const char *Cmd) {
     uint8_t aid[3] = {0};
     CLIGetHexWithReturn(ctx, 1, aid, &aidlength);
     swap24(aid);
-    uint8_t vkey[16] = {0};
+    uint8_t vkey[MAX_KEY_LEN] = {0};
     int vkeylen = 0;
     CLIGetHexWithReturn(ctx, 2, vkey, &vkeylen);
 
     if (vkeylen > 0) {
-        if (vkeylen == 8) {
-            memcpy(&deskeyList[deskeyListLen], vkey, 8);
-            deskeyListLen++;
-        } else if (vkeylen == 16) {
-            memcpy(&aeskeyList[aeskeyListLen], vkey, 16);
-            aeskeyListLen++;
-        } else if (vkeylen == 24) {
-            memcpy(&k3kkeyList[k3kkeyListLen], vkey, 16);
-            k3kkeyListLen++;
+        if (vkeylen == 8 || vkeylen == 16 || vkeylen == 24) {
+            memcpy(keys->key, vkey, vkeylen);
+            keys->keylen = vkeylen;
         } else {
             PrintAndLogEx(ERR, "Specified key must have 8, 16 or 24 bytes length.");
             CLIParserFree(ctx);
+            free(keys);
             return PM3_EINVARG;
         }
     }
@@ -1132,21 +1227,24 @@ static int CmdHF14aDesChk(const char *Cmd) {
     if (CLIParamStrToBuf(arg_get_str(ctx, 3), dict_filename, FILE_PATH_SIZE, &dict_filenamelen)) {
         PrintAndLogEx(FAILED, "File name too long or invalid.");
         CLIParserFree(ctx);
+        free(keys);
         return PM3_EINVARG;
     }
 
-    bool pattern1b = arg_get_lit(ctx, 4);
-    bool pattern2b = arg_get_lit(ctx, 5);
+    keys->pattern1b = arg_get_lit(ctx, 4);
+    keys->pattern2b = arg_get_lit(ctx, 5);
 
-    if (pattern1b && pattern2b) {
+    if (keys->pattern1b && keys->pattern2b) {
         PrintAndLogEx(ERR, "Pattern search mode must be 2-byte or 1-byte only.");
         CLIParserFree(ctx);
+        free(keys);
         return PM3_EINVARG;
     }
 
-    if (dict_filenamelen && (pattern1b || pattern2b)) {
+    if (dict_filenamelen && (keys->pattern1b || keys->pattern2b)) {
         PrintAndLogEx(ERR, "Pattern search mode and dictionary mode can't be used in one command.");
         CLIParserFree(ctx);
+        free(keys);
         return PM3_EINVARG;
     }
 
@@ -1160,9 +1258,10 @@ static int CmdHF14aDesChk(const char *Cmd) {
         } else {
             PrintAndLogEx(ERR, "Pattern must be 2-byte length.");
             CLIParserFree(ctx);
+            free(keys);
             return PM3_EINVARG;
         }
-        if (!pattern2b)
+        if (!keys->pattern2b)
             PrintAndLogEx(WARNING, "Pattern entered, but search mode not is 2-byte search.");
     }
 
@@ -1171,6 +1270,7 @@ static int CmdHF14aDesChk(const char *Cmd) {
     if (CLIParamStrToBuf(arg_get_str(ctx, 7), jsonname, sizeof(jsonname), &jsonnamelen)) {
         PrintAndLogEx(ERR, "Invalid json name.");
         CLIParserFree(ctx);
+        free(keys);
         return PM3_EINVARG;
     }
     jsonname[jsonnamelen] = 0;
@@ -1184,63 +1284,47 @@ static int CmdHF14aDesChk(const char *Cmd) {
     int kdfInputLen = 0;
     CLIGetHexWithReturn(ctx, 10, kdfInput, &kdfInputLen);
 
-    CLIParserFree(ctx);
-    SetAPDULogging(APDULogging);
-
-    // 1-byte pattern search mode
-    if (pattern1b) {
-        for (uint32_t i = 0; i < 0x100; i++)
-            memset(aeskeyList[i], i, 16);
-        for (uint32_t i = 0; i < 0x100; i++)
-            memset(deskeyList[i], i, 8);
-        for (uint32_t i = 0; i < 0x100; i++)
-            memset(k3kkeyList[i], i, 24);
-        aeskeyListLen = 0x100;
-        deskeyListLen = 0x100;
-        k3kkeyListLen = 0x100;
-    }
-
-    // 2-byte pattern search mode
-    if (pattern2b) {
-        DesFill2bPattern(deskeyList, &deskeyListLen, aeskeyList, &aeskeyListLen, k3kkeyList, &k3kkeyListLen, &startPattern);
+    char statename[FILE_PATH_SIZE] = {0};
+    int statenamelen = 0;
+    if (CLIParamStrToBuf(arg_get_str(ctx, 12), (uint8_t *)statename, sizeof(statename), &statenamelen)) {
+        PrintAndLogEx(ERR, "Invalid state file name.");
+        CLIParserFree(ctx);
+        free(keys);
+        return PM3_EINVARG;
     }
 
-    // dictionary mode
-    size_t endFilePosition = 0;
-    if (dict_filenamelen) {
-
-        res = loadFileDICTIONARYEx((char *)dict_filename, deskeyList, sizeof(deskeyList), NULL, 8, &deskeyListLen, 0, &endFilePosition, true);
-        if (res == PM3_SUCCESS && endFilePosition)
-            PrintAndLogEx(SUCCESS, "First part of des dictionary successfully loaded.");
-
-        endFilePosition = 0;
-        res = loadFileDICTIONARYEx((char *)dict_filename, aeskeyList, sizeof(aeskeyList), NULL, 16, &aeskeyListLen, 0, &endFilePosition, true);
-        if (res == PM3_SUCCESS && endFilePosition)
-            PrintAndLogEx(SUCCESS, "First part of aes dictionary successfully loaded.");
+    CLIParserFree(ctx);
+    SetAPDULogging(APDULogging);
 
-        endFilePosition = 0;
-        res = loadFileDICTIONARYEx((char *)dict_filename, k3kkeyList, sizeof(k3kkeyList), NULL, 24, &k3kkeyListLen, 0, &endFilePosition, true);
-        if (res == PM3_SUCCESS && endFilePosition)
-            PrintAndLogEx(SUCCESS, "First part of k3kdes dictionary successfully loaded.");
+    if (dict_filenamelen)
+        keys->dict = (char *)dict_filename;
 
-        endFilePosition = 0;
+    // first chunk of keys, also tells if there is anything to check at all
+    DesChkChunk_t firstChunk, nextChunk;
+    DesChkFirstChunk(keys, startPattern, &firstChunk);
+    DesChkLoadChunk(keys, &firstChunk, &nextChunk);
+    if (firstChunk.stage == 0 && (keys->pattern1b || keys->pattern2b || keys->dict)) {
+        // the key from the command line goes first, report what the pattern or dictionary adds
+        DesChkChunk_t chunk = nextChunk;
+        DesChkLoadChunk(keys, &chunk, &nextChunk);
     }
 
-    if (aeskeyListLen == 0 && deskeyListLen == 0 && k3kkeyListLen == 0) {
+    if (keys->aeskeyListLen == 0 && keys->deskeyListLen == 0 && keys->k3kkeyListLen == 0 && keys->keylen == 0) {
         PrintAndLogEx(ERR, "No keys provided. Nothing to check.");
+        free(keys);
         return PM3_EINVARG;
     }
 
-    if (aeskeyListLen != 0) {
-        PrintAndLogEx(INFO, "Loaded " _YELLOW_("%"PRIu32) " aes keys", aeskeyListLen);
+    if (keys->aeskeyListLen != 0) {
+        PrintAndLogEx(INFO, "Loaded " _YELLOW_("%"PRIu32) " aes keys", keys->aeskeyListLen);
     }
 
-    if (deskeyListLen != 0) {
-        PrintAndLogEx(INFO, "Loaded "  _YELLOW_("%"PRIu32) " des keys", deskeyListLen);
+    if (keys->deskeyListLen != 0) {
+        PrintAndLogEx(INFO, "Loaded "  _YELLOW_("%"PRIu32) " des keys", keys->deskeyListLen);
     }
 
-    if (k3kkeyListLen != 0) {
-        PrintAndLogEx(INFO, "Loaded " _YELLOW_("%"PRIu32) " k3kdes keys", k3kkeyListLen);
+    if (keys->k3kkeyListLen != 0) {
+        PrintAndLogEx(INFO, "Loaded " _YELLOW_("%"PRIu32) " k3kdes keys", keys->k3kkeyListLen);
     }
 
     if (verbose == false)
@@ -1265,6 +1349,7 @@ static int CmdHF14aDesChk(const char *Cmd) {
     if (res != PM3_SUCCESS) {
         PrintAndLogEx(ERR, "Can't select PICC level.");
         DropField();
+        free(keys);
         return PM3_ESOFT;
     }
 
@@ -1273,6 +1358,7 @@ static int CmdHF14aDesChk(const char *Cmd) {
     if (res != PM3_SUCCESS) {
         PrintAndLogEx(ERR, "Can't get list of applications on tag");
         DropField();
+        free(keys);
         return PM3_ESOFT;
     }
 
@@ -1281,52 +1367,81 @@ static int CmdHF14aDesChk(const char *Cmd) {
         app_ids_len = 3;
     }
 
-    for (uint32_t x = 0; x < app_ids_len / 3; x++) {
-
-        uint32_t curaid = (app_ids[x * 3] & 0xFF) + ((app_ids[(x * 3) + 1] & 0xFF) << 8) + ((app_ids[(x * 3) + 2] & 0xFF) << 16);
-        PrintAndLogEx(ERR, "Checking aid 0x%06X...", curaid);
+    char options[300] = {0};
+    DesChkOptionsStr(keys, startPattern, aid, aidlength, cmdKDFAlgo, kdfInput, kdfInputLen, options, sizeof(options));
 
-        res = AuthCheckDesfire(&dctx, secureChannel, &app_ids[x * 3], deskeyList, deskeyListLen, aeskeyList, aeskeyListLen, k3kkeyList, k3kkeyListLen, cmdKDFAlgo, kdfInputLen, kdfInput, foundKeys, &result, (verbose == false));
-        if (res == PM3_EOPABORTED) {
-            break;
+    DesChkCursor_t cursor = {0};
+    DesChkFirstChunk(keys, startPattern, &cursor.chunk);
+    if (statenamelen && DesChkLoadState(statename, options, &dctx, &cursor, foundKeys, &result)) {
+        if (cursor.aidIndex < app_ids_len / 3) {
+            PrintAndLogEx(INFO, "resuming from " _YELLOW_("%s") ", aid %u of %zu", statename, cursor.aidIndex + 1, app_ids_len / 3);
+        } else {
+            PrintAndLogEx(INFO, "state file " _YELLOW_("%s") " holds a finished search, starting over", statename);
+            memset(&cursor, 0, sizeof(cursor));
+            DesChkFirstChunk(keys, startPattern, &cursor.chunk);
+            memset(foundKeys, 0, sizeof(foundKeys));
+            result = false;
         }
+    }
 
-        if (pattern2b && startPattern < 0x10000) {
-            if (verbose == false)
-                PrintAndLogEx(NORMAL, "p" NOLF);
-
-            aeskeyListLen = 0;
-            deskeyListLen = 0;
-            k3kkeyListLen = 0;
-            DesFill2bPattern(deskeyList, &deskeyListLen, aeskeyList, &aeskeyListLen, k3kkeyList, &k3kkeyListLen, &startPattern);
-            continue;
-        }
+    DesfireChkKeyList_t lists[DESFIRE_CHK_KEY_TYPES] = {
+        {T_DES,    "DES",   (uint8_t *)keys->deskeyList, 8,           0},
+        {T_3DES,   "2TDEA", (uint8_t *)keys->aeskeyList, 16,          0},
+        {T_AES,    "AES",   (uint8_t *)keys->aeskeyList, 16,          0},
+        {T_3K3DES, "3TDEA", (uint8_t *)keys->k3kkeyList, MAX_KEY_LEN, 0},
+    };
 
-        if (dict_filenamelen) {
-            if (verbose == false)
-                PrintAndLogEx(NORMAL, "d" NOLF);
+    bool aborted = false;
+    for (; cursor.aidIndex < app_ids_len / 3 && aborted == false; cursor.aidIndex++) {
 
-            uint32_t keycnt = 0;
-            res = loadFileDICTIONARYEx((char *)dict_filename, deskeyList, sizeof(deskeyList), NULL, 16, &keycnt, endFilePosition, &endFilePosition, false);
-            if (res == PM3_SUCCESS && endFilePosition)
-                deskeyListLen = keycnt;
+        uint32_t curaid = (app_ids[cursor.aidIndex * 3] & 0xFF) + ((app_ids[(cursor.aidIndex * 3) + 1] & 0xFF) << 8) + ((app_ids[(cursor.aidIndex * 3) + 2] & 0xFF) << 16);
+        PrintAndLogEx(ERR, "Checking aid 0x%06X...", curaid);
 
-            keycnt = 0;
-            res = loadFileDICTIONARYEx((char *)dict_filename, aeskeyList, sizeof(aeskeyList), NULL, 16, &keycnt, endFilePosition, &endFilePosition, false);
-            if (res == PM3_SUCCESS && endFilePosition)
-                aeskeyListLen = keycnt;
+        // every chunk of keys against this aid
+        bool more = true;
+        while (more) {
+            more = DesChkLoadChunk(keys, &cursor.chunk, &nextChunk);
+            lists[0].count = keys->deskeyListLen;
+            lists[1].count = keys->aeskeyListLen;
+            lists[2].count = keys->aeskeyListLen;
+            lists[3].count = keys->k3kkeyListLen;
+
+            res = AuthCheckDesfire(&dctx, secureChannel, &app_ids[cursor.aidIndex * 3], lists, foundKeys, &cursor.pos, &result, (verbose == false));
+            if (res == PM3_EOPABORTED) {
+                aborted = true;
+                break;
+            }
+            if (res != PM3_SUCCESS)
+                break;
 
-            keycnt = 0;
-            res = loadFileDICTIONARYEx((char *)dict_filename, k3kkeyList, sizeof(k3kkeyList), NULL, 16, &keycnt, endFilePosition, &endFilePosition, false);
-            if (res == PM3_SUCCESS && endFilePosition)
-                k3kkeyListLen = keycnt;
+            memset(&cursor.pos, 0, sizeof(cursor.pos));
+            cursor.chunk = nextChunk;
+            if (more && verbose == false)
+                PrintAndLogEx(NORMAL, "%c" NOLF, (keys->dict) ? 'd' : 'p');
+        }
 
-            continue;
+        if (aborted == false) {
+            memset(&cursor.pos, 0, sizeof(cursor.pos));
+            DesChkFirstChunk(keys, startPattern, &cursor.chunk);
         }
     }
     if (verbose == false)
         PrintAndLogEx(NORMAL, "");
 
+    if (statenamelen) {
+        if (aborted) {
+            // the aid loop already moved on, step back to the one that was interrupted
+            cursor.aidIndex--;
+            DesChkSaveState(statename, options, &dctx, &cursor, foundKeys, result);
+        } else {
+            // past the last aid, the next run starts over
+            DesChkCursor_t done = {0};
+            done.aidIndex = app_ids_len / 3;
+            DesChkSaveState(statename, options, &dctx, &done, foundKeys, result);
+        }
+    }
+    free(keys);
+
     // save keys to json
     if ((jsonnamelen > 0) && result) {
         DropField();
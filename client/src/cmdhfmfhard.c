@@ -30,7 +30,14 @@
 #include <locale.h>
 #include <math.h>
 #include <time.h> // MingW
+#include <pthread.h>
 #include <bzlib.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #include "commonutil.h"  // ARRAYLEN
 #include "comms.h"
@@ -44,6 +51,9 @@
 #include "hardnested_bf_core.h"
 #include "hardnested_bitarray_core.h"
 #include "fileutils.h"
+#include "util.h"       // FILE_PATH_SIZE
+#include "lz4/lz4.h"
+#include "crc64.h"
 
 #define NUM_CHECK_BITFLIPS_THREADS      (num_CPUs())
 #define NUM_REDUCTION_WORKING_THREADS   (num_CPUs())
@@ -67,19 +77,179 @@ typedef enum {
     ODD_STATE = 1
 } odd_even_t;
 
-static uint32_t num_acquired_nonces = 0;
-static uint64_t start_time = 0;
+#define CHECK_1ST_BYTES 0x01
+#define CHECK_2ND_BYTES 0x02
+
+#define QUEUE_LEN                       4
+
+//-----------------------------------------------------------------------------
+// Nonce files
+//
+// v1: cuid (4), target block (1), target key type (1), followed by 9 byte records
+//     {nt_enc1 (4), nt_enc2 (4), par_enc (1)} up to the end of the file.
+// v2: file header, followed by blocks appended while nonces come in. Every block
+//     repeats the session metadata, so several acquisitions of a card can share
+//     one file. Payloads are v1 records, optionally LZ4 compressed.
+//-----------------------------------------------------------------------------
+#define NONCE_FILE_MAGIC                "PM3NONC2"
+#define NONCE_FILE_VERSION              2
+#define NONCE_BLOCK_MAGIC               0x4b4c424e  // "NBLK"
+#define NONCE_BLOCK_FLAG_LZ4            0x01
+#define NONCE_RECORD_SIZE               9
+#define NONCE_BLOCK_RECORDS             1024
+#define NONCE_SUM_UNKNOWN               0xffff
+
+typedef struct {
+    char magic[8];
+    uint16_t version;
+    uint16_t flags;
+    uint32_t reserved;
+} PACKED nonce_file_hdr_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t cuid;
+    uint8_t trg_block;
+    uint8_t trg_key;
+    uint8_t flags;
+    uint8_t reserved;
+    uint32_t session;           // unix time the acquisition started, shared by its blocks
+    uint32_t timestamp;         // unix time the block was written
+    uint32_t records;
+    uint32_t payload_len;       // bytes following the header
+    uint16_t first_byte_sum;    // Sum(a0) once known, NONCE_SUM_UNKNOWN before
+    uint16_t reserved2;
+} PACKED nonce_block_hdr_t;
+
+typedef struct {
+    FILE *f;
+    uint32_t cuid;
+    uint8_t trg_block;
+    uint8_t trg_key;
+    bool lz4;
+    uint32_t session;
+    uint32_t records;
+    uint8_t buf[NONCE_BLOCK_RECORDS * NONCE_RECORD_SIZE];
+} nonce_writer_t;
+
+//-----------------------------------------------------------------------------
+// Candidate files
+//
+// Reduced candidate state lists are kept next to the nonce file (`<nonce file>.cand`) when an
+// attack fails. Every list is keyed by the first byte it was generated for, its partial sums
+// (0xff for the plain bitflip lists) and odd/even. Bitflip properties only ever remove states,
+// so a list from an earlier, smaller nonce set is a superset of the current one and only needs
+// to be filtered again. Lists stored for the identical nonce set are used as they are.
+// The file name only depends on the card, so the header also records the target block and key
+// type. Lists for another target are useless and the file is ignored. The header also holds the
+// length and crc64 of the nonce file the lists were made with. The file is only used while the
+// nonce file still starts with those bytes, i.e. it is the same one or had sessions appended.
+//-----------------------------------------------------------------------------
+#define CAND_FILE_MAGIC                 "PM3CAND3"
+#define CAND_FILE_EXT                   ".cand"
+#define CAND_PART_SUM_NONE              0xff
+
+typedef struct {
+    char magic[8];
+    uint32_t cuid;
+    uint8_t trg_block;
+    uint8_t trg_key;
+    uint32_t num_nonces;
+    uint32_t entries;
+    uint32_t nonce_file_len;
+    uint64_t nonce_file_hash;
+} PACKED cand_file_hdr_t;
+
+typedef struct {
+    uint64_t nonce_hash;        // nonce set the list was reduced with
+    uint8_t first_byte;
+    uint8_t part_sum_a0;
+    uint8_t part_sum_a8;
+    uint8_t odd_even;
+    uint32_t len;               // followed by len states
+} PACKED cand_entry_hdr_t;
+
+typedef struct {
+    cand_entry_hdr_t hdr;
+    uint32_t *sl;
+} cand_cache_entry_t;
+
+typedef enum {
+    TO_BE_DONE,
+    WORK_IN_PROGRESS,
+    COMPLETED
+} work_status_t;
+
+typedef struct {
+    uint32_t *sl;
+    uint32_t len;
+    work_status_t cache_status;
+} sl_cache_entry_t;
+
+// State of a single attack. Several attacks can run at the same time, they only share
+// the bitflip tables (read-only once loaded) and the brute forcer.
+struct hardnested_ctx_s {
+    char label[24];
+    uint32_t num_acquired_nonces;
+    uint64_t start_time;
+    uint64_t last_print_time;
+    float brute_force_per_second;
+    uint8_t hardnested_stage;
+    uint64_t known_target_key;
+    uint32_t test_state[2];
+    uint16_t real_sum_a8;
+#ifdef DEBUG_KEY_ELIMINATION
+    char failstr[250];
+#endif
+    uint32_t *part_sum_a0_bitarrays[2][NUM_PART_SUMS];
+    uint32_t *part_sum_a8_bitarrays[2][NUM_PART_SUMS];
+    uint32_t *sum_a0_bitarrays[2][NUM_SUMS];
+    uint32_t part_sum_count[2][NUM_PART_SUMS][NUM_PART_SUMS];
+    float my_p_K[NUM_SUMS];
+    const float *p_K;
+    uint32_t cuid;
+    noncelist_t nonces[256];
+    uint8_t best_first_bytes[256];
+    uint64_t maximum_states;
+    uint8_t best_first_byte_smallest_bitarray;
+    uint16_t first_byte_Sum;
+    uint16_t first_byte_num;
+    uint8_t nonce_seen[0x10000 / 8];  // (1st byte, 2nd byte) pairs already in the nonce lists
+    uint8_t nonce_file_mode;
+    bool write_stats;
+    FILE *fstats;
+    uint32_t *all_bitflips_bitarray[2];
+    uint32_t num_all_bitflips_bitarray[2];
+    bool all_bitflips_bitarray_dirty[2];
+    uint64_t last_sample_clock;
+    uint64_t sample_period;     // fastest batch of nonces seen so far, in ms
+    uint32_t samples_per_step;  // batches of nonces analysed at once
+    uint64_t num_keys_tested;
+    float reduction_queue[QUEUE_LEN];
+    statelist_t *candidates;
+    pthread_mutex_t statelist_cache_mutex;
+    pthread_mutex_t book_of_work_mutex;
+    sl_cache_entry_t sl_cache[NUM_PART_SUMS][NUM_PART_SUMS][2];
+    work_status_t book_of_work[NUM_PART_SUMS][NUM_PART_SUMS][NUM_PART_SUMS][NUM_PART_SUMS];
+    bool holds_bitflip_bitarrays;
+    bool attack_memory_allocated;
+    uint8_t trg_block;                      // target of the nonces
+    uint8_t trg_key;
+    char cand_filename[FILE_PATH_SIZE];     // persisted candidate lists, empty when not used
+    uint64_t nonce_hash;
+    uint32_t nonce_file_len;                // nonce file the attack runs on
+    uint64_t nonce_file_hash;
+    cand_cache_entry_t *cand_cache;
+    uint32_t cand_cache_len;
+    uint32_t cand_cache_hits;
+};
+
+// bitflip tables, shared by all attacks
 static uint16_t effective_bitflip[2][0x400];
 static uint16_t num_effective_bitflips[2] = {0, 0};
 static uint16_t all_effective_bitflip[0x400];
 static uint16_t num_all_effective_bitflips = 0;
 static uint16_t num_1st_byte_effective_bitflips = 0;
-#define CHECK_1ST_BYTES 0x01
-#define CHECK_2ND_BYTES 0x02
-static uint8_t hardnested_stage = CHECK_1ST_BYTES;
-static uint64_t known_target_key;
-static uint32_t test_state[2] = {0, 0};
-static float brute_force_per_second;
 
 static void get_SIMD_instruction_set(char *instruction_set) {
     switch (GetSIMDInstrAuto()) {
@@ -114,13 +284,17 @@ static void get_SIMD_instruction_set(char *instruction_set) {
     }
 }
 
-static void print_progress_header(void) {
+static void print_progress_header(hardnested_ctx_t *ctx) {
     char progress_text[80];
     char instr_set[12] = "";
     get_SIMD_instruction_set(instr_set);
     sprintf(progress_text, "Start using " _YELLOW_("%d") " threads and " _YELLOW_("%s") " SIMD core", num_CPUs(), instr_set);
 
-    PrintAndLogEx(INFO, "Hardnested attack starting...");
+    if (ctx->label[0] != '\0') {
+        PrintAndLogEx(INFO, "Hardnested attack " _YELLOW_("%s") " starting...", ctx->label);
+    } else {
+        PrintAndLogEx(INFO, "Hardnested attack starting...");
+    }
     PrintAndLogEx(INFO, "---------+---------+---------------------------------------------------------+-----------------+-------");
     PrintAndLogEx(INFO, "         |         |                                                         | Expected to brute force");
     PrintAndLogEx(INFO, " Time    | #nonces | Activity                                                | #states         | time ");
@@ -128,12 +302,14 @@ static void print_progress_header(void) {
     PrintAndLogEx(INFO, "       0 |       0 | %-73s |                 |", progress_text);
 }
 
-void hardnested_print_progress(uint32_t nonces, const char *activity, float brute_force, uint64_t min_diff_print_time) {
-    static uint64_t last_print_time = 0;
-    if (msclock() - last_print_time > min_diff_print_time) {
-        last_print_time = msclock();
-        uint64_t total_time = msclock() - start_time;
-        float brute_force_time = brute_force / brute_force_per_second;
+void hardnested_print_progress(hardnested_ctx_t *ctx, uint32_t nonces, const char *activity, float brute_force, uint64_t min_diff_print_time) {
+    if (ctx == NULL) {
+        return;
+    }
+    if (min_diff_print_time == 0 || msclock() - ctx->last_print_time > min_diff_print_time) {
+        ctx->last_print_time = msclock();
+        uint64_t total_time = msclock() - ctx->start_time;
+        float brute_force_time = brute_force / ctx->brute_force_per_second;
         char brute_force_time_string[20];
         if (brute_force_time < 90) {
             sprintf(brute_force_time_string, "%2.0fs", brute_force_time);
@@ -144,7 +320,11 @@ void hardnested_print_progress(uint32_t nonces, const char *activity, float brut
         } else {
             sprintf(brute_force_time_string, "%2.0fd", brute_force_time / (60 * 60 * 24));
         }
-        PrintAndLogEx(INFO, " %7.0f | %7u | %-55s | %15.0f | %5s", (float)total_time / 1000.0, nonces, activity, brute_force, brute_force_time_string);
+        if (ctx->label[0] != '\0') {
+            PrintAndLogEx(INFO, " %7.0f | %7u | %-55s | %15.0f | %5s | %s", (float)total_time / 1000.0, nonces, activity, brute_force, brute_force_time_string, ctx->label);
+        } else {
+            PrintAndLogEx(INFO, " %7.0f | %7u | %-55s | %15.0f | %5s", (float)total_time / 1000.0, nonces, activity, brute_force, brute_force_time_string);
+        }
     }
 }
 
@@ -219,6 +399,8 @@ static inline uint32_t next_state(uint32_t *bitarray, uint32_t state) {
 
 static uint32_t *bitflip_bitarrays[2][0x400];
 static uint32_t count_bitflip_bitarrays[2][0x400];
+static pthread_mutex_t bitflip_bitarrays_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t bitflip_bitarrays_users = 0;
 
 static int compare_count_bitflip_bitarrays(const void *b1, const void *b2) {
     uint64_t count1 = (uint64_t)count_bitflip_bitarrays[ODD_STATE][*(uint16_t *)b1] * count_bitflip_bitarrays[EVEN_STATE][*(uint16_t *)b1];
@@ -247,7 +429,7 @@ static void init_bunzip2(bz_stream *compressed_stream, char *input_buffer, uint3
 
 }
 
-static void init_bitflip_bitarrays(void) {
+static void load_bitflip_bitarrays(void) {
 #if defined (DEBUG_REDUCTION)
     uint8_t line = 0;
 #endif
@@ -370,27 +552,52 @@ static void init_bitflip_bitarrays(void) {
         PrintAndLogEx(INFO, "%03x ",  all_effective_bitflip[i]);
     }
 #endif
-    char progress_text[80];
-    sprintf(progress_text, "Using %d precalculated bitflip state tables", num_all_effective_bitflips);
-    hardnested_print_progress(0, progress_text, (float)(1LL << 47), 0);
 }
 
-static void free_bitflip_bitarrays(void) {
+static void unload_bitflip_bitarrays(void) {
     for (int16_t bitflip = 0x3ff; bitflip > 0x000; bitflip--) {
         free_bitarray(bitflip_bitarrays[ODD_STATE][bitflip]);
+        bitflip_bitarrays[ODD_STATE][bitflip] = NULL;
     }
     for (int16_t bitflip = 0x3ff; bitflip > 0x000; bitflip--) {
         free_bitarray(bitflip_bitarrays[EVEN_STATE][bitflip]);
+        bitflip_bitarrays[EVEN_STATE][bitflip] = NULL;
     }
 }
 
+// The bitflip tables are only needed while nonces are acquired. They are loaded by the first
+// attack needing them and freed when the last one is done with them.
+static void init_bitflip_bitarrays(hardnested_ctx_t *ctx) {
+    if (ctx->holds_bitflip_bitarrays) {
+        return;
+    }
+    pthread_mutex_lock(&bitflip_bitarrays_mutex);
+    if (bitflip_bitarrays_users++ == 0) {
+        load_bitflip_bitarrays();
+    }
+    pthread_mutex_unlock(&bitflip_bitarrays_mutex);
+    ctx->holds_bitflip_bitarrays = true;
+
+    char progress_text[80];
+    sprintf(progress_text, "Using %d precalculated bitflip state tables", num_all_effective_bitflips);
+    hardnested_print_progress(ctx, 0, progress_text, (float)(1LL << 47), 0);
+}
+
+static void free_bitflip_bitarrays(hardnested_ctx_t *ctx) {
+    if (ctx->holds_bitflip_bitarrays == false) {
+        return;
+    }
+    pthread_mutex_lock(&bitflip_bitarrays_mutex);
+    if (--bitflip_bitarrays_users == 0) {
+        unload_bitflip_bitarrays();
+    }
+    pthread_mutex_unlock(&bitflip_bitarrays_mutex);
+    ctx->holds_bitflip_bitarrays = false;
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // sum property bitarrays
 
-static uint32_t *part_sum_a0_bitarrays[2][NUM_PART_SUMS];
-static uint32_t *part_sum_a8_bitarrays[2][NUM_PART_SUMS];
-static uint32_t *sum_a0_bitarrays[2][NUM_SUMS];
-
 static uint16_t PartialSumProperty(uint32_t state, odd_even_t odd_even) {
     uint16_t sum = 0;
     for (uint16_t j = 0; j < 16; j++) {
@@ -414,15 +621,15 @@ static uint16_t PartialSumProperty(uint32_t state, odd_even_t odd_even) {
     return sum;
 }
 
-static void init_part_sum_bitarrays(void) {
+static void init_part_sum_bitarrays(hardnested_ctx_t *ctx) {
     for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
         for (uint16_t part_sum_a0 = 0; part_sum_a0 < NUM_PART_SUMS; part_sum_a0++) {
-            part_sum_a0_bitarrays[odd_even][part_sum_a0] = (uint32_t *)malloc_bitarray(sizeof(uint32_t) * (1 << 19));
-            if (part_sum_a0_bitarrays[odd_even][part_sum_a0] == NULL) {
+            ctx->part_sum_a0_bitarrays[odd_even][part_sum_a0] = (uint32_t *)malloc_bitarray(sizeof(uint32_t) * (1 << 19));
+            if (ctx->part_sum_a0_bitarrays[odd_even][part_sum_a0] == NULL) {
                 PrintAndLogEx(ERR, "Out of memory error in init_part_suma0_statelists(). Aborting...\n");
                 exit(4);
             }
-            clear_bitarray24(part_sum_a0_bitarrays[odd_even][part_sum_a0]);
+            clear_bitarray24(ctx->part_sum_a0_bitarrays[odd_even][part_sum_a0]);
         }
     }
     for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
@@ -430,19 +637,19 @@ static void init_part_sum_bitarrays(void) {
         for (uint32_t state = 0; state < (1 << 20); state++) {
             uint16_t part_sum_a0 = PartialSumProperty(state, odd_even) / 2;
             for (uint16_t low_bits = 0; low_bits < 1 << 4; low_bits++) {
-                set_bit24(part_sum_a0_bitarrays[odd_even][part_sum_a0], state << 4 | low_bits);
+                set_bit24(ctx->part_sum_a0_bitarrays[odd_even][part_sum_a0], state << 4 | low_bits);
             }
         }
     }
 
     for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
         for (uint16_t part_sum_a8 = 0; part_sum_a8 < NUM_PART_SUMS; part_sum_a8++) {
-            part_sum_a8_bitarrays[odd_even][part_sum_a8] = (uint32_t *)malloc_bitarray(sizeof(uint32_t) * (1 << 19));
-            if (part_sum_a8_bitarrays[odd_even][part_sum_a8] == NULL) {
+            ctx->part_sum_a8_bitarrays[odd_even][part_sum_a8] = (uint32_t *)malloc_bitarray(sizeof(uint32_t) * (1 << 19));
+            if (ctx->part_sum_a8_bitarrays[odd_even][part_sum_a8] == NULL) {
                 PrintAndLogEx(ERR, "Out of memory error in init_part_suma8_statelists(). Aborting...\n");
                 exit(4);
             }
-            clear_bitarray24(part_sum_a8_bitarrays[odd_even][part_sum_a8]);
+            clear_bitarray24(ctx->part_sum_a8_bitarrays[odd_even][part_sum_a8]);
         }
     }
     for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
@@ -450,36 +657,36 @@ static void init_part_sum_bitarrays(void) {
         for (uint32_t state = 0; state < (1 << 20); state++) {
             uint16_t part_sum_a8 = PartialSumProperty(state, odd_even) / 2;
             for (uint16_t high_bits = 0; high_bits < 1 << 4; high_bits++) {
-                set_bit24(part_sum_a8_bitarrays[odd_even][part_sum_a8], state | high_bits << 20);
+                set_bit24(ctx->part_sum_a8_bitarrays[odd_even][part_sum_a8], state | high_bits << 20);
             }
         }
     }
 }
 
-static void free_part_sum_bitarrays(void) {
+static void free_part_sum_bitarrays(hardnested_ctx_t *ctx) {
     for (int16_t part_sum_a8 = (NUM_PART_SUMS - 1); part_sum_a8 >= 0; part_sum_a8--) {
-        free_bitarray(part_sum_a8_bitarrays[ODD_STATE][part_sum_a8]);
+        free_bitarray(ctx->part_sum_a8_bitarrays[ODD_STATE][part_sum_a8]);
     }
     for (int16_t part_sum_a8 = (NUM_PART_SUMS - 1); part_sum_a8 >= 0; part_sum_a8--) {
-        free_bitarray(part_sum_a8_bitarrays[EVEN_STATE][part_sum_a8]);
+        free_bitarray(ctx->part_sum_a8_bitarrays[EVEN_STATE][part_sum_a8]);
     }
     for (int16_t part_sum_a0 = (NUM_PART_SUMS - 1); part_sum_a0 >= 0; part_sum_a0--) {
-        free_bitarray(part_sum_a0_bitarrays[ODD_STATE][part_sum_a0]);
+        free_bitarray(ctx->part_sum_a0_bitarrays[ODD_STATE][part_sum_a0]);
     }
     for (int16_t part_sum_a0 = (NUM_PART_SUMS - 1); part_sum_a0 >= 0; part_sum_a0--) {
-        free_bitarray(part_sum_a0_bitarrays[EVEN_STATE][part_sum_a0]);
+        free_bitarray(ctx->part_sum_a0_bitarrays[EVEN_STATE][part_sum_a0]);
     }
 }
 
-static void init_sum_bitarrays(void) {
+static void init_sum_bitarrays(hardnested_ctx_t *ctx) {
     for (uint16_t sum_a0 = 0; sum_a0 < NUM_SUMS; sum_a0++) {
         for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
-            sum_a0_bitarrays[odd_even][sum_a0] = (uint32_t *)malloc_bitarray(sizeof(uint32_t) * (1 << 19));
-            if (sum_a0_bitarrays[odd_even][sum_a0] == NULL) {
+            ctx->sum_a0_bitarrays[odd_even][sum_a0] = (uint32_t *)malloc_bitarray(sizeof(uint32_t) * (1 << 19));
+            if (ctx->sum_a0_bitarrays[odd_even][sum_a0] == NULL) {
                 PrintAndLogEx(ERR, "Out of memory error in init_sum_bitarrays(). Aborting...\n");
                 exit(4);
             }
-            clear_bitarray24(sum_a0_bitarrays[odd_even][sum_a0]);
+            clear_bitarray24(ctx->sum_a0_bitarrays[odd_even][sum_a0]);
         }
     }
     for (uint8_t p = 0; p < NUM_PART_SUMS; p++) {
@@ -487,55 +694,39 @@ static void init_sum_bitarrays(void) {
             uint16_t sum_a0 = 2 * p * (16 - 2 * q) + (16 - 2 * p) * 2 * q;
             uint16_t sum_a0_idx = 0;
             while (sums[sum_a0_idx] != sum_a0) sum_a0_idx++;
-            bitarray_OR(sum_a0_bitarrays[EVEN_STATE][sum_a0_idx], part_sum_a0_bitarrays[EVEN_STATE][q]);
-            bitarray_OR(sum_a0_bitarrays[ODD_STATE][sum_a0_idx], part_sum_a0_bitarrays[ODD_STATE][p]);
+            bitarray_OR(ctx->sum_a0_bitarrays[EVEN_STATE][sum_a0_idx], ctx->part_sum_a0_bitarrays[EVEN_STATE][q]);
+            bitarray_OR(ctx->sum_a0_bitarrays[ODD_STATE][sum_a0_idx], ctx->part_sum_a0_bitarrays[ODD_STATE][p]);
         }
     }
 
 }
 
-static void free_sum_bitarrays(void) {
+static void free_sum_bitarrays(hardnested_ctx_t *ctx) {
     for (int8_t sum_a0 = NUM_SUMS - 1; sum_a0 >= 0; sum_a0--) {
-        free_bitarray(sum_a0_bitarrays[ODD_STATE][sum_a0]);
-        free_bitarray(sum_a0_bitarrays[EVEN_STATE][sum_a0]);
+        free_bitarray(ctx->sum_a0_bitarrays[ODD_STATE][sum_a0]);
+        free_bitarray(ctx->sum_a0_bitarrays[EVEN_STATE][sum_a0]);
     }
 }
 
-#ifdef DEBUG_KEY_ELIMINATION
-static char failstr[250] = "";
-#endif
-
 static const float p_K0[NUM_SUMS] = { // the probability that a random nonce has a Sum Property K
     0.0290, 0.0083, 0.0006, 0.0339, 0.0048, 0.0934, 0.0119, 0.0489, 0.0602, 0.4180, 0.0602, 0.0489, 0.0119, 0.0934, 0.0048, 0.0339, 0.0006, 0.0083, 0.0290
 };
-static float my_p_K[NUM_SUMS];
-static const float *p_K;
-
-static uint32_t cuid;
-static noncelist_t nonces[256];
-static uint8_t best_first_bytes[256];
-static uint64_t maximum_states = 0;
-static uint8_t best_first_byte_smallest_bitarray = 0;
-static uint16_t first_byte_Sum = 0;
-static uint16_t first_byte_num = 0;
-static bool write_stats = false;
-static FILE *fstats = NULL;
-static uint32_t *all_bitflips_bitarray[2];
-static uint32_t num_all_bitflips_bitarray[2];
-static bool all_bitflips_bitarray_dirty[2];
-static uint64_t last_sample_clock = 0;
-static uint64_t sample_period = 0;
-static uint64_t num_keys_tested = 0;
-static statelist_t *candidates = NULL;
-
-static int add_nonce(uint32_t nonce_enc, uint8_t par_enc) {
+
+
+static int add_nonce(hardnested_ctx_t *ctx, uint32_t nonce_enc, uint8_t par_enc) {
+    uint16_t pair = nonce_enc >> 16;
+    if (ctx->nonce_seen[pair >> 3] & (1 << (pair & 7))) {
+        return (0);
+    }
+    ctx->nonce_seen[pair >> 3] |= (1 << (pair & 7));
+
     uint8_t first_byte = nonce_enc >> 24;
-    noncelistentry_t *p1 = nonces[first_byte].first;
+    noncelistentry_t *p1 = ctx->nonces[first_byte].first;
     noncelistentry_t *p2 = NULL;
 
     if (p1 == NULL) { // first nonce with this 1st byte
-        first_byte_num++;
-        first_byte_Sum += evenparity32((nonce_enc & 0xff000000) | (par_enc & 0x08));
+        ctx->first_byte_num++;
+        ctx->first_byte_Sum += evenparity32((nonce_enc & 0xff000000) | (par_enc & 0x08));
     }
 
     while (p1 != NULL && (p1->nonce_enc & 0x00ff0000) < (nonce_enc & 0x00ff0000)) {
@@ -545,13 +736,13 @@ static int add_nonce(uint32_t nonce_enc, uint8_t par_enc) {
 
     if (p1 == NULL) {                                                          // need to add at the end of the list
         if (p2 == NULL) {           // list is empty yet. Add first entry.
-            p2 = nonces[first_byte].first = calloc(1, sizeof(noncelistentry_t));
+            p2 = ctx->nonces[first_byte].first = calloc(1, sizeof(noncelistentry_t));
         } else {                    // add new entry at end of existing list.
             p2 = p2->next = calloc(1, sizeof(noncelistentry_t));
         }
     } else if ((p1->nonce_enc & 0x00ff0000) != (nonce_enc & 0x00ff0000)) {     // found distinct 2nd byte. Need to insert.
         if (p2 == NULL) {           // need to insert at start of list
-            p2 = nonces[first_byte].first = calloc(1, sizeof(noncelistentry_t));
+            p2 = ctx->nonces[first_byte].first = calloc(1, sizeof(noncelistentry_t));
         } else {
             p2 = p2->next = calloc(1, sizeof(noncelistentry_t));
         }
@@ -564,44 +755,59 @@ static int add_nonce(uint32_t nonce_enc, uint8_t par_enc) {
     p2->nonce_enc = nonce_enc;
     p2->par_enc = par_enc;
 
-    nonces[first_byte].num++;
-    nonces[first_byte].Sum += evenparity32((nonce_enc & 0x00ff0000) | (par_enc & 0x04));
-    nonces[first_byte].sum_a8_guess_dirty = true;   // indicates that we need to recalculate the Sum(a8) probability for this first byte
+    ctx->nonces[first_byte].num++;
+    ctx->nonces[first_byte].Sum += evenparity32((nonce_enc & 0x00ff0000) | (par_enc & 0x04));
+    ctx->nonces[first_byte].sum_a8_guess_dirty = true;   // indicates that we need to recalculate the Sum(a8) probability for this first byte
     return (1); // new nonce added
 }
 
-static void init_nonce_memory(void) {
+// Adds nonce records {nt_enc1 (4), nt_enc2 (4), par_enc (1)} as acquired or stored in a file.
+// Returns the number of new nonces.
+static uint32_t add_nonce_records(hardnested_ctx_t *ctx, const uint8_t *records, size_t count) {
+    uint32_t added = 0;
+    for (size_t i = 0; i < count; i++, records += NONCE_RECORD_SIZE) {
+        uint32_t nt_enc1 = MemBeToUint4byte(records);
+        uint32_t nt_enc2 = MemBeToUint4byte(records + 4);
+        uint8_t par_enc = records[8];
+        added += add_nonce(ctx, nt_enc1, par_enc >> 4);
+        added += add_nonce(ctx, nt_enc2, par_enc & 0x0f);
+    }
+    return added;
+}
+
+static void init_nonce_memory(hardnested_ctx_t *ctx) {
     for (uint16_t i = 0; i < 256; i++) {
-        nonces[i].num = 0;
-        nonces[i].Sum = 0;
-        nonces[i].first = NULL;
+        ctx->nonces[i].num = 0;
+        ctx->nonces[i].Sum = 0;
+        ctx->nonces[i].first = NULL;
         for (uint8_t j = 0; j < NUM_SUMS; j++) {
-            nonces[i].sum_a8_guess[j].sum_a8_idx = j;
-            nonces[i].sum_a8_guess[j].prob = 0.0;
+            ctx->nonces[i].sum_a8_guess[j].sum_a8_idx = j;
+            ctx->nonces[i].sum_a8_guess[j].prob = 0.0;
         }
-        nonces[i].sum_a8_guess_dirty = false;
+        ctx->nonces[i].sum_a8_guess_dirty = false;
         for (uint16_t bitflip = 0x000; bitflip < 0x400; bitflip++) {
-            nonces[i].BitFlips[bitflip] = 0;
+            ctx->nonces[i].BitFlips[bitflip] = 0;
         }
-        nonces[i].states_bitarray[EVEN_STATE] = (uint32_t *)malloc_bitarray(sizeof(uint32_t) * (1 << 19));
-        if (nonces[i].states_bitarray[EVEN_STATE] == NULL) {
+        ctx->nonces[i].states_bitarray[EVEN_STATE] = (uint32_t *)malloc_bitarray(sizeof(uint32_t) * (1 << 19));
+        if (ctx->nonces[i].states_bitarray[EVEN_STATE] == NULL) {
             PrintAndLogEx(ERR, "Out of memory error in init_nonce_memory(). Aborting...\n");
             exit(4);
         }
-        set_bitarray24(nonces[i].states_bitarray[EVEN_STATE]);
-        nonces[i].num_states_bitarray[EVEN_STATE] = 1 << 24;
-        nonces[i].states_bitarray[ODD_STATE] = (uint32_t *)malloc_bitarray(sizeof(uint32_t) * (1 << 19));
-        if (nonces[i].states_bitarray[ODD_STATE] == NULL) {
+        set_bitarray24(ctx->nonces[i].states_bitarray[EVEN_STATE]);
+        ctx->nonces[i].num_states_bitarray[EVEN_STATE] = 1 << 24;
+        ctx->nonces[i].states_bitarray[ODD_STATE] = (uint32_t *)malloc_bitarray(sizeof(uint32_t) * (1 << 19));
+        if (ctx->nonces[i].states_bitarray[ODD_STATE] == NULL) {
             PrintAndLogEx(ERR, "Out of memory error in init_nonce_memory(). Aborting...\n");
             exit(4);
         }
-        set_bitarray24(nonces[i].states_bitarray[ODD_STATE]);
-        nonces[i].num_states_bitarray[ODD_STATE] = 1 << 24;
-        nonces[i].all_bitflips_dirty[EVEN_STATE] = false;
-        nonces[i].all_bitflips_dirty[ODD_STATE] = false;
+        set_bitarray24(ctx->nonces[i].states_bitarray[ODD_STATE]);
+        ctx->nonces[i].num_states_bitarray[ODD_STATE] = 1 << 24;
+        ctx->nonces[i].all_bitflips_dirty[EVEN_STATE] = false;
+        ctx->nonces[i].all_bitflips_dirty[ODD_STATE] = false;
     }
-    first_byte_num = 0;
-    first_byte_Sum = 0;
+    ctx->first_byte_num = 0;
+    ctx->first_byte_Sum = 0;
+    memset(ctx->nonce_seen, 0, sizeof(ctx->nonce_seen));
 }
 
 static void free_nonce_list(noncelistentry_t *p) {
@@ -613,13 +819,13 @@ static void free_nonce_list(noncelistentry_t *p) {
     }
 }
 
-static void free_nonces_memory(void) {
+static void free_nonces_memory(hardnested_ctx_t *ctx) {
     for (uint16_t i = 0; i < 256; i++) {
-        free_nonce_list(nonces[i].first);
+        free_nonce_list(ctx->nonces[i].first);
     }
     for (int i = 255; i >= 0; i--) {
-        free_bitarray(nonces[i].states_bitarray[ODD_STATE]);
-        free_bitarray(nonces[i].states_bitarray[EVEN_STATE]);
+        free_bitarray(ctx->nonces[i].states_bitarray[ODD_STATE]);
+        free_bitarray(ctx->nonces[i].states_bitarray[EVEN_STATE]);
     }
 }
 
@@ -671,45 +877,43 @@ static double p_hypergeometric(uint16_t i_K, uint16_t n, uint16_t k) {
     }
 }
 
-static float sum_probability(uint16_t i_K, uint16_t n, uint16_t k) {
+static float sum_probability(hardnested_ctx_t *ctx, uint16_t i_K, uint16_t n, uint16_t k) {
     if (k > sums[i_K]) {
         return 0.0;
     }
 
     double p_T_is_k_when_S_is_K = p_hypergeometric(i_K, n, k);
-    double p_S_is_K = p_K[i_K];
+    double p_S_is_K = ctx->p_K[i_K];
     double p_T_is_k = 0;
     for (uint8_t i = 0; i < NUM_SUMS; i++) {
-        p_T_is_k += p_K[i] * p_hypergeometric(i, n, k);
+        p_T_is_k += ctx->p_K[i] * p_hypergeometric(i, n, k);
     }
     return (p_T_is_k_when_S_is_K * p_S_is_K / p_T_is_k);
 }
 
-static uint32_t part_sum_count[2][NUM_PART_SUMS][NUM_PART_SUMS];
-
-static void init_allbitflips_array(void) {
+static void init_allbitflips_array(hardnested_ctx_t *ctx) {
     for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
-        uint32_t *bitset = all_bitflips_bitarray[odd_even] = (uint32_t *)malloc_bitarray(sizeof(uint32_t) * (1 << 19));
+        uint32_t *bitset = ctx->all_bitflips_bitarray[odd_even] = (uint32_t *)malloc_bitarray(sizeof(uint32_t) * (1 << 19));
         if (bitset == NULL) {
             PrintAndLogEx(WARNING, "Out of memory in init_allbitflips_array(). Aborting...");
             exit(4);
         }
         set_bitarray24(bitset);
-        all_bitflips_bitarray_dirty[odd_even] = false;
-        num_all_bitflips_bitarray[odd_even] = 1 << 24;
+        ctx->all_bitflips_bitarray_dirty[odd_even] = false;
+        ctx->num_all_bitflips_bitarray[odd_even] = 1 << 24;
     }
 }
 
-static void update_allbitflips_array(void) {
-    if (hardnested_stage & CHECK_2ND_BYTES) {
+static void update_allbitflips_array(hardnested_ctx_t *ctx) {
+    if (ctx->hardnested_stage & CHECK_2ND_BYTES) {
         for (uint16_t i = 0; i < 256; i++) {
             for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
-                if (nonces[i].all_bitflips_dirty[odd_even]) {
-                    uint32_t old_count = num_all_bitflips_bitarray[odd_even];
-                    num_all_bitflips_bitarray[odd_even] = count_bitarray_low20_AND(all_bitflips_bitarray[odd_even], nonces[i].states_bitarray[odd_even]);
-                    nonces[i].all_bitflips_dirty[odd_even] = false;
-                    if (num_all_bitflips_bitarray[odd_even] != old_count) {
-                        all_bitflips_bitarray_dirty[odd_even] = true;
+                if (ctx->nonces[i].all_bitflips_dirty[odd_even]) {
+                    uint32_t old_count = ctx->num_all_bitflips_bitarray[odd_even];
+                    ctx->num_all_bitflips_bitarray[odd_even] = count_bitarray_low20_AND(ctx->all_bitflips_bitarray[odd_even], ctx->nonces[i].states_bitarray[odd_even]);
+                    ctx->nonces[i].all_bitflips_dirty[odd_even] = false;
+                    if (ctx->num_all_bitflips_bitarray[odd_even] != old_count) {
+                        ctx->all_bitflips_bitarray_dirty[odd_even] = true;
                     }
                 }
             }
@@ -717,20 +921,20 @@ static void update_allbitflips_array(void) {
     }
 }
 
-static uint32_t estimated_num_states_part_sum_coarse(uint16_t part_sum_a0_idx, uint16_t part_sum_a8_idx, odd_even_t odd_even) {
-    return part_sum_count[odd_even][part_sum_a0_idx][part_sum_a8_idx];
+static uint32_t estimated_num_states_part_sum_coarse(hardnested_ctx_t *ctx, uint16_t part_sum_a0_idx, uint16_t part_sum_a8_idx, odd_even_t odd_even) {
+    return ctx->part_sum_count[odd_even][part_sum_a0_idx][part_sum_a8_idx];
 }
 
-static uint32_t estimated_num_states_part_sum(uint8_t first_byte, uint16_t part_sum_a0_idx, uint16_t part_sum_a8_idx, odd_even_t odd_even) {
+static uint32_t estimated_num_states_part_sum(hardnested_ctx_t *ctx, uint8_t first_byte, uint16_t part_sum_a0_idx, uint16_t part_sum_a8_idx, odd_even_t odd_even) {
     if (odd_even == ODD_STATE) {
-        return count_bitarray_AND3(part_sum_a0_bitarrays[odd_even][part_sum_a0_idx],
-                                   part_sum_a8_bitarrays[odd_even][part_sum_a8_idx],
-                                   nonces[first_byte].states_bitarray[odd_even]);
+        return count_bitarray_AND3(ctx->part_sum_a0_bitarrays[odd_even][part_sum_a0_idx],
+                                   ctx->part_sum_a8_bitarrays[odd_even][part_sum_a8_idx],
+                                   ctx->nonces[first_byte].states_bitarray[odd_even]);
     } else {
-        return count_bitarray_AND4(part_sum_a0_bitarrays[odd_even][part_sum_a0_idx],
-                                   part_sum_a8_bitarrays[odd_even][part_sum_a8_idx],
-                                   nonces[first_byte].states_bitarray[odd_even],
-                                   nonces[first_byte ^ 0x80].states_bitarray[odd_even]);
+        return count_bitarray_AND4(ctx->part_sum_a0_bitarrays[odd_even][part_sum_a0_idx],
+                                   ctx->part_sum_a8_bitarrays[odd_even][part_sum_a8_idx],
+                                   ctx->nonces[first_byte].states_bitarray[odd_even],
+                                   ctx->nonces[first_byte ^ 0x80].states_bitarray[odd_even]);
     }
 
     // estimate reduction by all_bitflips_match()
@@ -742,7 +946,7 @@ static uint32_t estimated_num_states_part_sum(uint8_t first_byte, uint16_t part_
     // }
 }
 
-static uint64_t estimated_num_states(uint8_t first_byte, uint16_t sum_a0, uint16_t sum_a8) {
+static uint64_t estimated_num_states(hardnested_ctx_t *ctx, uint8_t first_byte, uint16_t sum_a0, uint16_t sum_a8) {
     uint64_t num_states = 0;
     for (uint8_t p = 0; p < NUM_PART_SUMS; p++) {
         for (uint8_t q = 0; q < NUM_PART_SUMS; q++) {
@@ -750,8 +954,8 @@ static uint64_t estimated_num_states(uint8_t first_byte, uint16_t sum_a0, uint16
                 for (uint8_t r = 0; r < NUM_PART_SUMS; r++) {
                     for (uint8_t s = 0; s < NUM_PART_SUMS; s++) {
                         if (2 * r * (16 - 2 * s) + (16 - 2 * r) * 2 * s == sum_a8) {
-                            num_states += (uint64_t)estimated_num_states_part_sum(first_byte, p, r, ODD_STATE)
-                                          * estimated_num_states_part_sum(first_byte, q, s, EVEN_STATE);
+                            num_states += (uint64_t)estimated_num_states_part_sum(ctx, first_byte, p, r, ODD_STATE)
+                                          * estimated_num_states_part_sum(ctx, first_byte, q, s, EVEN_STATE);
                         }
                     }
                 }
@@ -761,7 +965,7 @@ static uint64_t estimated_num_states(uint8_t first_byte, uint16_t sum_a0, uint16
     return num_states;
 }
 
-static uint64_t estimated_num_states_coarse(uint16_t sum_a0, uint16_t sum_a8) {
+static uint64_t estimated_num_states_coarse(hardnested_ctx_t *ctx, uint16_t sum_a0, uint16_t sum_a8) {
     uint64_t num_states = 0;
     for (uint8_t p = 0; p < NUM_PART_SUMS; p++) {
         for (uint8_t q = 0; q < NUM_PART_SUMS; q++) {
@@ -769,8 +973,8 @@ static uint64_t estimated_num_states_coarse(uint16_t sum_a0, uint16_t sum_a8) {
                 for (uint8_t r = 0; r < NUM_PART_SUMS; r++) {
                     for (uint8_t s = 0; s < NUM_PART_SUMS; s++) {
                         if (2 * r * (16 - 2 * s) + (16 - 2 * r) * 2 * s == sum_a8) {
-                            num_states += (uint64_t)estimated_num_states_part_sum_coarse(p, r, ODD_STATE)
-                                          * estimated_num_states_part_sum_coarse(q, s, EVEN_STATE);
+                            num_states += (uint64_t)estimated_num_states_part_sum_coarse(ctx, p, r, ODD_STATE)
+                                          * estimated_num_states_part_sum_coarse(ctx, q, s, EVEN_STATE);
                         }
                     }
                 }
@@ -780,51 +984,54 @@ static uint64_t estimated_num_states_coarse(uint16_t sum_a0, uint16_t sum_a8) {
     return num_states;
 }
 
-static void update_p_K(void) {
-    if (hardnested_stage & CHECK_2ND_BYTES) {
+static void update_p_K(hardnested_ctx_t *ctx) {
+    if (ctx->hardnested_stage & CHECK_2ND_BYTES) {
         uint64_t total_count = 0;
-        uint16_t sum_a0 = sums[first_byte_Sum];
+        uint16_t sum_a0 = sums[ctx->first_byte_Sum];
         for (uint8_t sum_a8_idx = 0; sum_a8_idx < NUM_SUMS; sum_a8_idx++) {
             uint16_t sum_a8 = sums[sum_a8_idx];
-            total_count += estimated_num_states_coarse(sum_a0, sum_a8);
+            total_count += estimated_num_states_coarse(ctx, sum_a0, sum_a8);
         }
         for (uint8_t sum_a8_idx = 0; sum_a8_idx < NUM_SUMS; sum_a8_idx++) {
             uint16_t sum_a8 = sums[sum_a8_idx];
-            float f = estimated_num_states_coarse(sum_a0, sum_a8);
-            my_p_K[sum_a8_idx] = f / total_count;
+            float f = estimated_num_states_coarse(ctx, sum_a0, sum_a8);
+            ctx->my_p_K[sum_a8_idx] = f / total_count;
         }
         // PrintAndLogEx(INFO,  "my_p_K = [");
         // for (uint8_t sum_a8_idx = 0; sum_a8_idx < NUM_SUMS; sum_a8_idx++) {
         // PrintAndLogEx(INFO, "%7.4f ", my_p_K[sum_a8_idx]);
         // }
-        p_K = my_p_K;
+        ctx->p_K = ctx->my_p_K;
     }
 }
 
-static void update_sum_bitarrays(odd_even_t odd_even) {
-    if (all_bitflips_bitarray_dirty[odd_even]) {
+static void update_sum_bitarrays(hardnested_ctx_t *ctx, odd_even_t odd_even) {
+    if (ctx->all_bitflips_bitarray_dirty[odd_even]) {
         for (uint8_t part_sum = 0; part_sum < NUM_PART_SUMS; part_sum++) {
-            bitarray_AND(part_sum_a0_bitarrays[odd_even][part_sum], all_bitflips_bitarray[odd_even]);
-            bitarray_AND(part_sum_a8_bitarrays[odd_even][part_sum], all_bitflips_bitarray[odd_even]);
+            bitarray_AND(ctx->part_sum_a0_bitarrays[odd_even][part_sum], ctx->all_bitflips_bitarray[odd_even]);
+            bitarray_AND(ctx->part_sum_a8_bitarrays[odd_even][part_sum], ctx->all_bitflips_bitarray[odd_even]);
         }
         for (uint16_t i = 0; i < 256; i++) {
-            nonces[i].num_states_bitarray[odd_even] = count_bitarray_AND(nonces[i].states_bitarray[odd_even], all_bitflips_bitarray[odd_even]);
+            ctx->nonces[i].num_states_bitarray[odd_even] = count_bitarray_AND(ctx->nonces[i].states_bitarray[odd_even], ctx->all_bitflips_bitarray[odd_even]);
         }
         for (uint8_t part_sum_a0 = 0; part_sum_a0 < NUM_PART_SUMS; part_sum_a0++) {
             for (uint8_t part_sum_a8 = 0; part_sum_a8 < NUM_PART_SUMS; part_sum_a8++) {
-                part_sum_count[odd_even][part_sum_a0][part_sum_a8]
-                += count_bitarray_AND2(part_sum_a0_bitarrays[odd_even][part_sum_a0], part_sum_a8_bitarrays[odd_even][part_sum_a8]);
+                ctx->part_sum_count[odd_even][part_sum_a0][part_sum_a8]
+                += count_bitarray_AND2(ctx->part_sum_a0_bitarrays[odd_even][part_sum_a0], ctx->part_sum_a8_bitarrays[odd_even][part_sum_a8]);
             }
         }
-        all_bitflips_bitarray_dirty[odd_even] = false;
+        ctx->all_bitflips_bitarray_dirty[odd_even] = false;
     }
 }
 
+typedef struct {
+    float expected_num_brute_force;
+    uint8_t first_byte;
+} first_byte_score_t;
+
 static int compare_expected_num_brute_force(const void *b1, const void *b2) {
-    uint8_t index1 = *(uint8_t *)b1;
-    uint8_t index2 = *(uint8_t *)b2;
-    float score1 = nonces[index1].expected_num_brute_force;
-    float score2 = nonces[index2].expected_num_brute_force;
+    float score1 = ((first_byte_score_t *)b1)->expected_num_brute_force;
+    float score2 = ((first_byte_score_t *)b2)->expected_num_brute_force;
     return (score1 > score2) - (score1 < score2);
 }
 
@@ -835,73 +1042,81 @@ static int compare_sum_a8_guess(const void *b1, const void *b2) {
 
 }
 
-static float check_smallest_bitflip_bitarrays(void) {
+static float check_smallest_bitflip_bitarrays(hardnested_ctx_t *ctx) {
     uint64_t smallest = 1LL << 48;
     // initialize best_first_bytes, do a rough estimation on remaining states
     for (uint16_t i = 0; i < 256; i++) {
-        uint32_t num_odd = nonces[i].num_states_bitarray[ODD_STATE];
-        uint32_t num_even = nonces[i].num_states_bitarray[EVEN_STATE]; // * (float)nonces[i^0x80].num_states_bitarray[EVEN_STATE] / num_all_bitflips_bitarray[EVEN_STATE];
+        uint32_t num_odd = ctx->nonces[i].num_states_bitarray[ODD_STATE];
+        uint32_t num_even = ctx->nonces[i].num_states_bitarray[EVEN_STATE]; // * (float)nonces[i^0x80].num_states_bitarray[EVEN_STATE] / num_all_bitflips_bitarray[EVEN_STATE];
         if ((uint64_t)num_odd * num_even < smallest) {
             smallest = (uint64_t)num_odd * num_even;
-            best_first_byte_smallest_bitarray = i;
+            ctx->best_first_byte_smallest_bitarray = i;
         }
     }
 
 #if defined (DEBUG_REDUCTION)
-    uint32_t num_odd = nonces[best_first_byte_smallest_bitarray].num_states_bitarray[ODD_STATE];
-    uint32_t num_even = nonces[best_first_byte_smallest_bitarray].num_states_bitarray[EVEN_STATE]; // * (float)nonces[best_first_byte_smallest_bitarray^0x80].num_states_bitarray[EVEN_STATE] / num_all_bitflips_bitarray[EVEN_STATE];
-    PrintAndLogEx(INFO, "0x%02x: %8d * %8d = %12" PRIu64 " (2^%1.1f)\n", best_first_byte_smallest_bitarray, num_odd, num_even, (uint64_t)num_odd * num_even, log((uint64_t)num_odd * num_even) / log(2.0));
+    uint32_t num_odd = ctx->nonces[ctx->best_first_byte_smallest_bitarray].num_states_bitarray[ODD_STATE];
+    uint32_t num_even = ctx->nonces[ctx->best_first_byte_smallest_bitarray].num_states_bitarray[EVEN_STATE]; // * (float)nonces[best_first_byte_smallest_bitarray^0x80].num_states_bitarray[EVEN_STATE] / num_all_bitflips_bitarray[EVEN_STATE];
+    PrintAndLogEx(INFO, "0x%02x: %8d * %8d = %12" PRIu64 " (2^%1.1f)\n", ctx->best_first_byte_smallest_bitarray, num_odd, num_even, (uint64_t)num_odd * num_even, log((uint64_t)num_odd * num_even) / log(2.0));
 #endif
     return (float)smallest / 2.0;
 }
 
-static void update_expected_brute_force(uint8_t best_byte) {
+static void update_expected_brute_force(hardnested_ctx_t *ctx, uint8_t best_byte) {
 
     float total_prob = 0.0;
     for (uint8_t i = 0; i < NUM_SUMS; i++) {
-        total_prob += nonces[best_byte].sum_a8_guess[i].prob;
+        total_prob += ctx->nonces[best_byte].sum_a8_guess[i].prob;
     }
     // linear adjust probabilities to result in total_prob = 1.0;
     for (uint8_t i = 0; i < NUM_SUMS; i++) {
-        nonces[best_byte].sum_a8_guess[i].prob /= total_prob;
+        ctx->nonces[best_byte].sum_a8_guess[i].prob /= total_prob;
     }
     float prob_all_failed = 1.0;
-    nonces[best_byte].expected_num_brute_force = 0.0;
+    ctx->nonces[best_byte].expected_num_brute_force = 0.0;
     for (uint8_t i = 0; i < NUM_SUMS; i++) {
-        nonces[best_byte].expected_num_brute_force += nonces[best_byte].sum_a8_guess[i].prob * (float)nonces[best_byte].sum_a8_guess[i].num_states / 2.0;
-        prob_all_failed -= nonces[best_byte].sum_a8_guess[i].prob;
-        nonces[best_byte].expected_num_brute_force += prob_all_failed * (float)nonces[best_byte].sum_a8_guess[i].num_states / 2.0;
+        ctx->nonces[best_byte].expected_num_brute_force += ctx->nonces[best_byte].sum_a8_guess[i].prob * (float)ctx->nonces[best_byte].sum_a8_guess[i].num_states / 2.0;
+        prob_all_failed -= ctx->nonces[best_byte].sum_a8_guess[i].prob;
+        ctx->nonces[best_byte].expected_num_brute_force += prob_all_failed * (float)ctx->nonces[best_byte].sum_a8_guess[i].num_states / 2.0;
     }
     return;
 }
 
-static float sort_best_first_bytes(void) {
+static float sort_best_first_bytes(hardnested_ctx_t *ctx) {
 
     // initialize best_first_bytes, do a rough estimation on remaining states for each Sum_a8 property
     // and the expected number of states to brute force
     for (uint16_t i = 0; i < 256; i++) {
-        best_first_bytes[i] = i;
+        ctx->best_first_bytes[i] = i;
         float prob_all_failed = 1.0;
-        nonces[i].expected_num_brute_force = 0.0;
+        ctx->nonces[i].expected_num_brute_force = 0.0;
         for (uint8_t j = 0; j < NUM_SUMS; j++) {
-            nonces[i].sum_a8_guess[j].num_states = estimated_num_states_coarse(sums[first_byte_Sum], sums[nonces[i].sum_a8_guess[j].sum_a8_idx]);
-            nonces[i].expected_num_brute_force += nonces[i].sum_a8_guess[j].prob * (float)nonces[i].sum_a8_guess[j].num_states / 2.0;
-            prob_all_failed -= nonces[i].sum_a8_guess[j].prob;
-            nonces[i].expected_num_brute_force += prob_all_failed * (float)nonces[i].sum_a8_guess[j].num_states / 2.0;
+            ctx->nonces[i].sum_a8_guess[j].num_states = estimated_num_states_coarse(ctx, sums[ctx->first_byte_Sum], sums[ctx->nonces[i].sum_a8_guess[j].sum_a8_idx]);
+            ctx->nonces[i].expected_num_brute_force += ctx->nonces[i].sum_a8_guess[j].prob * (float)ctx->nonces[i].sum_a8_guess[j].num_states / 2.0;
+            prob_all_failed -= ctx->nonces[i].sum_a8_guess[j].prob;
+            ctx->nonces[i].expected_num_brute_force += prob_all_failed * (float)ctx->nonces[i].sum_a8_guess[j].num_states / 2.0;
         }
     }
 
     // sort based on expected number of states to brute force
-    qsort(best_first_bytes, 256, 1, compare_expected_num_brute_force);
+    first_byte_score_t scores[256];
+    for (uint16_t i = 0; i < 256; i++) {
+        scores[i].expected_num_brute_force = ctx->nonces[ctx->best_first_bytes[i]].expected_num_brute_force;
+        scores[i].first_byte = ctx->best_first_bytes[i];
+    }
+    qsort(scores, 256, sizeof(first_byte_score_t), compare_expected_num_brute_force);
+    for (uint16_t i = 0; i < 256; i++) {
+        ctx->best_first_bytes[i] = scores[i].first_byte;
+    }
 
     // PrintAndLogEx(INFO, "refine estimations: ");
 #define NUM_REFINES 1
     // refine scores for the best:
     for (uint16_t i = 0; i < NUM_REFINES; i++) {
         // PrintAndLogEx(INFO, "%d...", i);
-        uint16_t first_byte = best_first_bytes[i];
-        for (uint8_t j = 0; j < NUM_SUMS && nonces[first_byte].sum_a8_guess[j].prob > 0.05; j++) {
-            nonces[first_byte].sum_a8_guess[j].num_states = estimated_num_states(first_byte, sums[first_byte_Sum], sums[nonces[first_byte].sum_a8_guess[j].sum_a8_idx]);
+        uint16_t first_byte = ctx->best_first_bytes[i];
+        for (uint8_t j = 0; j < NUM_SUMS && ctx->nonces[first_byte].sum_a8_guess[j].prob > 0.05; j++) {
+            ctx->nonces[first_byte].sum_a8_guess[j].num_states = estimated_num_states(ctx, first_byte, sums[ctx->first_byte_Sum], sums[ctx->nonces[first_byte].sum_a8_guess[j].sum_a8_idx]);
         }
         // while (nonces[first_byte].sum_a8_guess[0].num_states == 0
         // || nonces[first_byte].sum_a8_guess[1].num_states == 0
@@ -935,11 +1150,11 @@ static float sort_best_first_bytes(void) {
         // nonces[first_byte].sum_a8_guess[j].num_states = estimated_num_states(first_byte, sums[first_byte_Sum], sums[nonces[first_byte].sum_a8_guess[j].sum_a8_idx]);
         // }
         float prob_all_failed = 1.0;
-        nonces[first_byte].expected_num_brute_force = 0.0;
+        ctx->nonces[first_byte].expected_num_brute_force = 0.0;
         for (uint8_t j = 0; j < NUM_SUMS; j++) {
-            nonces[first_byte].expected_num_brute_force += nonces[first_byte].sum_a8_guess[j].prob * (float)nonces[first_byte].sum_a8_guess[j].num_states / 2.0;
-            prob_all_failed -= nonces[first_byte].sum_a8_guess[j].prob;
-            nonces[first_byte].expected_num_brute_force += prob_all_failed * (float)nonces[first_byte].sum_a8_guess[j].num_states / 2.0;
+            ctx->nonces[first_byte].expected_num_brute_force += ctx->nonces[first_byte].sum_a8_guess[j].prob * (float)ctx->nonces[first_byte].sum_a8_guess[j].num_states / 2.0;
+            prob_all_failed -= ctx->nonces[first_byte].sum_a8_guess[j].prob;
+            ctx->nonces[first_byte].expected_num_brute_force += prob_all_failed * (float)ctx->nonces[first_byte].sum_a8_guess[j].num_states / 2.0;
         }
     }
 
@@ -947,25 +1162,24 @@ static float sort_best_first_bytes(void) {
     float least_expected_brute_force = (1LL << 48);
     uint8_t best_byte = 0;
     for (uint16_t i = 0; i < 10; i++) {
-        uint16_t first_byte = best_first_bytes[i];
-        if (nonces[first_byte].expected_num_brute_force < least_expected_brute_force) {
-            least_expected_brute_force = nonces[first_byte].expected_num_brute_force;
+        uint16_t first_byte = ctx->best_first_bytes[i];
+        if (ctx->nonces[first_byte].expected_num_brute_force < least_expected_brute_force) {
+            least_expected_brute_force = ctx->nonces[first_byte].expected_num_brute_force;
             best_byte = i;
         }
     }
     if (best_byte != 0) {
         // PrintAndLogEx(INFO, "0x%02x <-> 0x%02x", best_first_bytes[0], best_first_bytes[best_byte]);
-        uint8_t tmp = best_first_bytes[0];
-        best_first_bytes[0] = best_first_bytes[best_byte];
-        best_first_bytes[best_byte] = tmp;
+        uint8_t tmp = ctx->best_first_bytes[0];
+        ctx->best_first_bytes[0] = ctx->best_first_bytes[best_byte];
+        ctx->best_first_bytes[best_byte] = tmp;
     }
 
-    return nonces[best_first_bytes[0]].expected_num_brute_force;
+    return ctx->nonces[ctx->best_first_bytes[0]].expected_num_brute_force;
 }
 
-static float update_reduction_rate(float last, bool init) {
-#define QUEUE_LEN 4
-    static float queue[QUEUE_LEN];
+static float update_reduction_rate(hardnested_ctx_t *ctx, float last, bool init) {
+    float *queue = ctx->reduction_queue;
 
     for (uint16_t i = 0; i < QUEUE_LEN - 1; i++) {
         if (init) {
@@ -1000,108 +1214,352 @@ static float update_reduction_rate(float last, bool init) {
     float reduction_rate = -1.0 * dev_xy / dev_x2;  // the negative slope of the linear regression
 
 #if defined (DEBUG_REDUCTION)
-    PrintAndLogEx(INFO, "update_reduction_rate(%1.0f) = %1.0f per sample, brute_force_per_sample = %1.0f\n", last, reduction_rate, brute_force_per_second * (float)sample_period / 1000.0);
+    PrintAndLogEx(INFO, "update_reduction_rate(%1.0f) = %1.0f per sample, brute_force_per_sample = %1.0f\n", last, reduction_rate, ctx->brute_force_per_second * (float)ctx->sample_period / 1000.0);
 #endif
     return reduction_rate;
 }
 
-static bool shrink_key_space(float *brute_forces) {
+static bool shrink_key_space(hardnested_ctx_t *ctx, float *brute_forces) {
 #if defined(DEBUG_REDUCTION)
-    PrintAndLogEx(INFO, "shrink_key_space() with stage = 0x%02x\n", hardnested_stage);
+    PrintAndLogEx(INFO, "shrink_key_space() with stage = 0x%02x\n", ctx->hardnested_stage);
 #endif
-    float brute_forces1 = check_smallest_bitflip_bitarrays();
+    float brute_forces1 = check_smallest_bitflip_bitarrays(ctx);
     float brute_forces2 = (float)(1LL << 47);
-    if (hardnested_stage & CHECK_2ND_BYTES) {
-        brute_forces2 = sort_best_first_bytes();
+    if (ctx->hardnested_stage & CHECK_2ND_BYTES) {
+        brute_forces2 = sort_best_first_bytes(ctx);
     }
     *brute_forces = MIN(brute_forces1, brute_forces2);
-    float reduction_rate = update_reduction_rate(*brute_forces, false);
+    float reduction_rate = update_reduction_rate(ctx, *brute_forces, false);
 
 //iceman 2018
-    return ((hardnested_stage & CHECK_2ND_BYTES) &&
+    return ((ctx->hardnested_stage & CHECK_2ND_BYTES) &&
             reduction_rate >= 0.0 &&
-            (reduction_rate < brute_force_per_second * (float)sample_period / 1000.0  || *brute_forces < 0xF00000));
+            (reduction_rate < ctx->brute_force_per_second * (float)(__atomic_load_n(&ctx->sample_period, __ATOMIC_RELAXED) * ctx->samples_per_step) / 1000.0  || *brute_forces < 0xF00000));
 
 }
 
-static void estimate_sum_a8(void) {
-    if (first_byte_num == 256) {
+static void estimate_sum_a8(hardnested_ctx_t *ctx) {
+    if (ctx->first_byte_num == 256) {
         for (uint16_t i = 0; i < 256; i++) {
-            if (nonces[i].sum_a8_guess_dirty) {
+            if (ctx->nonces[i].sum_a8_guess_dirty) {
                 for (uint8_t j = 0; j < NUM_SUMS; j++) {
-                    uint16_t sum_a8_idx = nonces[i].sum_a8_guess[j].sum_a8_idx;
-                    nonces[i].sum_a8_guess[j].prob = sum_probability(sum_a8_idx, nonces[i].num, nonces[i].Sum);
+                    uint16_t sum_a8_idx = ctx->nonces[i].sum_a8_guess[j].sum_a8_idx;
+                    ctx->nonces[i].sum_a8_guess[j].prob = sum_probability(ctx, sum_a8_idx, ctx->nonces[i].num, ctx->nonces[i].Sum);
                 }
-                qsort(nonces[i].sum_a8_guess, NUM_SUMS, sizeof(guess_sum_a8_t), compare_sum_a8_guess);
-                nonces[i].sum_a8_guess_dirty = false;
+                qsort(ctx->nonces[i].sum_a8_guess, NUM_SUMS, sizeof(guess_sum_a8_t), compare_sum_a8_guess);
+                ctx->nonces[i].sum_a8_guess_dirty = false;
             }
         }
     }
 }
 
-static int read_nonce_file(char *filename) {
+// map a whole nonce file, falls back to reading it in one go where mmap isn't available
+static uint8_t *nonce_file_map(const char *filename, size_t *len, bool *mapped) {
+    *len = 0;
+    *mapped = false;
+
+    struct stat st;
+    if (stat(filename, &st) != 0 || st.st_size == 0) {
+        return NULL;
+    }
+    *len = st.st_size;
+
+#ifndef _WIN32
+    int fd = open(filename, O_RDONLY);
+    if (fd >= 0) {
+        void *data = mmap(NULL, *len, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data != MAP_FAILED) {
+            *mapped = true;
+            return data;
+        }
+    }
+#endif
+
+    FILE *f = fopen(filename, "rb");
+    if (f == NULL) {
+        return NULL;
+    }
+    uint8_t *data = calloc(*len, sizeof(uint8_t));
+    if (data && fread(data, 1, *len, f) != *len) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    return data;
+}
+
+static void nonce_file_unmap(uint8_t *data, size_t len, bool mapped) {
+#ifndef _WIN32
+    if (mapped) {
+        munmap(data, len);
+        return;
+    }
+#endif
+    (void)len;
+    (void)mapped;
+    free(data);
+}
+
+static int read_nonce_file_v2(hardnested_ctx_t *ctx, const uint8_t *data, size_t len, uint8_t *trgBlockNo, uint8_t *trgKeyType) {
+
+    const nonce_file_hdr_t *fh = (const nonce_file_hdr_t *)data;
+    if (fh->version != NONCE_FILE_VERSION) {
+        PrintAndLogEx(ERR, "Unsupported nonce file version %u", fh->version);
+        return 1;
+    }
+
+    size_t pos = sizeof(nonce_file_hdr_t);
+    uint32_t blocks = 0, sessions = 0, last_session = 0, first_time = 0, last_time = 0;
+    uint16_t sum_a0 = NONCE_SUM_UNKNOWN;
+    uint8_t *raw = NULL;
+
+    while (pos + sizeof(nonce_block_hdr_t) <= len) {
+        nonce_block_hdr_t bh;
+        memcpy(&bh, data + pos, sizeof(bh));
+        pos += sizeof(bh);
+
+        if (bh.magic != NONCE_BLOCK_MAGIC || bh.payload_len > len - pos || bh.records > UINT32_MAX / NONCE_RECORD_SIZE) {
+            PrintAndLogEx(WARNING, "Nonce file truncated or corrupt after %u blocks", blocks);
+            break;
+        }
+
+        const uint8_t *payload = data + pos;
+        pos += bh.payload_len;
+
+        if (blocks == 0) {
+            ctx->cuid = bh.cuid;
+            *trgBlockNo = bh.trg_block;
+            *trgKeyType = bh.trg_key;
+            first_time = bh.session;
+        } else if (bh.cuid != ctx->cuid || bh.trg_block != *trgBlockNo || bh.trg_key != *trgKeyType) {
+            PrintAndLogEx(WARNING, "Skipping block for cuid %08x, block %u, key %c", bh.cuid, bh.trg_block, bh.trg_key ? 'B' : 'A');
+            continue;
+        }
+
+        uint32_t raw_len = bh.records * NONCE_RECORD_SIZE;
+        if (bh.flags & NONCE_BLOCK_FLAG_LZ4) {
+            uint8_t *tmp = realloc(raw, raw_len);
+            if (tmp == NULL) {
+                free(raw);
+                return 1;
+            }
+            raw = tmp;
+            if (LZ4_decompress_safe((const char *)payload, (char *)raw, bh.payload_len, raw_len) != (int)raw_len) {
+                PrintAndLogEx(WARNING, "Nonce file block %u fails to decompress, skipping", blocks);
+                continue;
+            }
+            payload = raw;
+        } else if (bh.payload_len != raw_len) {
+            PrintAndLogEx(WARNING, "Nonce file block %u has a wrong length, skipping", blocks);
+            continue;
+        }
+
+        add_nonce_records(ctx, payload, bh.records);
+        ctx->num_acquired_nonces += 2 * bh.records;
+
+        if (blocks == 0 || bh.session != last_session) {
+            sessions++;
+            last_session = bh.session;
+        }
+        if (bh.first_byte_sum != NONCE_SUM_UNKNOWN) {
+            sum_a0 = bh.first_byte_sum;
+        }
+        last_time = bh.timestamp;
+        blocks++;
+    }
+    free(raw);
+
+    if (blocks == 0) {
+        PrintAndLogEx(ERR, "No nonces in file");
+        return 1;
+    }
+
+    char progress_string[80];
+    time_t t = first_time;
+    char first_str[26] = {0};
+    strftime(first_str, sizeof(first_str), "%Y-%m-%d %H:%M:%S", localtime(&t));
+    snprintf(progress_string, sizeof(progress_string), "%u session%s, %u blocks, first %s, %us span", sessions, (sessions > 1) ? "s" : "", blocks, first_str, last_time - first_time);
+    hardnested_print_progress(ctx, ctx->num_acquired_nonces, progress_string, (float)(1LL << 47), 0);
+    if (sum_a0 != NONCE_SUM_UNKNOWN) {
+        snprintf(progress_string, sizeof(progress_string), "Sum(a0) recorded at acquisition = %u", sum_a0);
+        hardnested_print_progress(ctx, ctx->num_acquired_nonces, progress_string, (float)(1LL << 47), 0);
+    }
+    return PM3_SUCCESS;
+}
+
+static int read_nonce_file(hardnested_ctx_t *ctx, char *filename) {
 
     if (filename == NULL) {
         PrintAndLogEx(WARNING, "Filename is NULL");
         return 1;
     }
-    FILE *fnonces = NULL;
     char progress_text[80] = "";
-    uint8_t read_buf[9];
 
-    num_acquired_nonces = 0;
-    if ((fnonces = fopen(filename, "rb")) == NULL) {
+    ctx->num_acquired_nonces = 0;
+
+    size_t len = 0;
+    bool mapped = false;
+    uint8_t *data = nonce_file_map(filename, &len, &mapped);
+    if (data == NULL) {
         PrintAndLogEx(WARNING, "Could not open file " _YELLOW_("%s"), filename);
         return 1;
     }
 
     snprintf(progress_text, 80, "Reading nonces from file " _YELLOW_("%s"), filename);
-    hardnested_print_progress(0, progress_text, (float)(1LL << 47), 0);
-    size_t bytes_read = fread(read_buf, 1, 6, fnonces);
-    if (bytes_read != 6) {
-        PrintAndLogEx(ERR, "File reading error.");
-        fclose(fnonces);
-        return 1;
-    }
-    cuid = bytes_to_num(read_buf, 4);
-    uint8_t trgBlockNo = bytes_to_num(read_buf + 4, 1);
-    uint8_t trgKeyType = bytes_to_num(read_buf + 5, 1);
+    hardnested_print_progress(ctx, 0, progress_text, (float)(1LL << 47), 0);
+
+    uint8_t trgBlockNo = 0;
+    uint8_t trgKeyType = 0;
+    if (len >= sizeof(nonce_file_hdr_t) && memcmp(data, NONCE_FILE_MAGIC, 8) == 0) {
+        if (read_nonce_file_v2(ctx, data, len, &trgBlockNo, &trgKeyType) != PM3_SUCCESS) {
+            nonce_file_unmap(data, len, mapped);
+            return 1;
+        }
+    } else {
+        if (len < 6) {
+            PrintAndLogEx(ERR, "File reading error.");
+            nonce_file_unmap(data, len, mapped);
+            return 1;
+        }
+        ctx->cuid = bytes_to_num(data, 4);
+        trgBlockNo = data[4];
+        trgKeyType = data[5];
 
-    bytes_read = fread(read_buf, 1, 9, fnonces);
-    while (bytes_read == 9) {
-        uint32_t nt_enc1 = bytes_to_num(read_buf, 4);
-        uint32_t nt_enc2 = bytes_to_num(read_buf + 4, 4);
-        uint8_t par_enc = bytes_to_num(read_buf + 8, 1);
-        add_nonce(nt_enc1, par_enc >> 4);
-        add_nonce(nt_enc2, par_enc & 0x0f);
-        num_acquired_nonces += 2;
-        bytes_read = fread(read_buf, 1, 9, fnonces);
+        size_t records = (len - 6) / NONCE_RECORD_SIZE;
+        add_nonce_records(ctx, data + 6, records);
+        ctx->num_acquired_nonces += 2 * records;
     }
-    fclose(fnonces);
+    nonce_file_unmap(data, len, mapped);
+    ctx->trg_block = trgBlockNo;
+    ctx->trg_key = trgKeyType;
 
     char progress_string[80];
-    sprintf(progress_string, "Read %u nonces from file. cuid = %08x", num_acquired_nonces, cuid);
-    hardnested_print_progress(num_acquired_nonces, progress_string, (float)(1LL << 47), 0);
+    sprintf(progress_string, "Read %u nonces from file. cuid = %08x", ctx->num_acquired_nonces, ctx->cuid);
+    hardnested_print_progress(ctx, ctx->num_acquired_nonces, progress_string, (float)(1LL << 47), 0);
     sprintf(progress_string, "Target Block=%d, Keytype=%c", trgBlockNo, trgKeyType == 0 ? 'A' : 'B');
-    hardnested_print_progress(num_acquired_nonces, progress_string, (float)(1LL << 47), 0);
+    hardnested_print_progress(ctx, ctx->num_acquired_nonces, progress_string, (float)(1LL << 47), 0);
 
     bool got_match = false;
     for (uint8_t i = 0; i < NUM_SUMS; i++) {
-        if (first_byte_Sum == sums[i]) {
-            first_byte_Sum = i;
+        if (ctx->first_byte_Sum == sums[i]) {
+            ctx->first_byte_Sum = i;
             got_match = true;
             break;
         }
     }
     if (got_match == false) {
-        PrintAndLogEx(FAILED, "No match for the First_Byte_Sum (%u), is the card a genuine MFC Ev1? ", first_byte_Sum);
+        PrintAndLogEx(FAILED, "No match for the First_Byte_Sum (%u), is the card a genuine MFC Ev1? ", ctx->first_byte_Sum);
         return 1;
     }
     return PM3_SUCCESS;
 }
 
-static noncelistentry_t *SearchFor2ndByte(uint8_t b1, uint8_t b2) {
-    noncelistentry_t *p = nonces[b1].first;
+// Opens a v2 nonce file for writing. With append, a new session is added to an
+// existing v2 file, otherwise the file is (re)created.
+static int nonce_writer_open(nonce_writer_t *w, const char *filename, bool append, bool lz4, uint32_t cuid, uint8_t trg_block, uint8_t trg_key) {
+    memset(w, 0, sizeof(nonce_writer_t));
+    w->cuid = cuid;
+    w->trg_block = trg_block;
+    w->trg_key = trg_key;
+    w->lz4 = lz4;
+    w->session = (uint32_t)time(NULL);
+
+    if (append && fileExists(filename)) {
+        w->f = fopen(filename, "r+b");
+        if (w->f == NULL) {
+            return PM3_EFILE;
+        }
+        nonce_file_hdr_t fh;
+        if (fread(&fh, 1, sizeof(fh), w->f) != sizeof(fh) || memcmp(fh.magic, NONCE_FILE_MAGIC, 8) || fh.version != NONCE_FILE_VERSION) {
+            PrintAndLogEx(WARNING, "Can only append to v2 nonce files");
+            fclose(w->f);
+            w->f = NULL;
+            return PM3_EFILE;
+        }
+        fseek(w->f, 0, SEEK_END);
+        return PM3_SUCCESS;
+    }
+
+    w->f = fopen(filename, "wb");
+    if (w->f == NULL) {
+        return PM3_EFILE;
+    }
+    nonce_file_hdr_t fh;
+    memset(&fh, 0, sizeof(fh));
+    memcpy(fh.magic, NONCE_FILE_MAGIC, 8);
+    fh.version = NONCE_FILE_VERSION;
+    fwrite(&fh, 1, sizeof(fh), w->f);
+    fflush(w->f);
+    return PM3_SUCCESS;
+}
+
+static void nonce_writer_flush(nonce_writer_t *w, uint16_t first_byte_sum) {
+    if (w->f == NULL || w->records == 0) {
+        return;
+    }
+
+    nonce_block_hdr_t bh;
+    memset(&bh, 0, sizeof(bh));
+    bh.magic = NONCE_BLOCK_MAGIC;
+    bh.cuid = w->cuid;
+    bh.trg_block = w->trg_block;
+    bh.trg_key = w->trg_key;
+    bh.session = w->session;
+    bh.timestamp = (uint32_t)time(NULL);
+    bh.records = w->records;
+    bh.first_byte_sum = first_byte_sum;
+
+    uint32_t raw_len = w->records * NONCE_RECORD_SIZE;
+    uint8_t *payload = w->buf;
+    bh.payload_len = raw_len;
+
+    char *packed = NULL;
+    if (w->lz4) {
+        int bound = LZ4_compressBound(raw_len);
+        packed = calloc(bound, sizeof(char));
+        if (packed) {
+            int packed_len = LZ4_compress_default((const char *)w->buf, packed, raw_len, bound);
+            // nonces are close to random, keep the raw block when it doesn't pay off
+            if (packed_len > 0 && (uint32_t)packed_len < raw_len) {
+                bh.flags |= NONCE_BLOCK_FLAG_LZ4;
+                bh.payload_len = packed_len;
+                payload = (uint8_t *)packed;
+            }
+        }
+    }
+
+    fwrite(&bh, 1, sizeof(bh), w->f);
+    fwrite(payload, 1, bh.payload_len, w->f);
+    fflush(w->f);
+    free(packed);
+    w->records = 0;
+}
+
+static void nonce_writer_add(nonce_writer_t *w, const uint8_t *records, uint32_t count, uint16_t first_byte_sum) {
+    while (count) {
+        uint32_t n = MIN(count, NONCE_BLOCK_RECORDS - w->records);
+        memcpy(w->buf + w->records * NONCE_RECORD_SIZE, records, n * NONCE_RECORD_SIZE);
+        w->records += n;
+        records += n * NONCE_RECORD_SIZE;
+        count -= n;
+        if (w->records == NONCE_BLOCK_RECORDS) {
+            nonce_writer_flush(w, first_byte_sum);
+        }
+    }
+}
+
+static void nonce_writer_close(nonce_writer_t *w, uint16_t first_byte_sum) {
+    if (w->f == NULL) {
+        return;
+    }
+    nonce_writer_flush(w, first_byte_sum);
+    fclose(w->f);
+    w->f = NULL;
+}
+
+static noncelistentry_t *SearchFor2ndByte(hardnested_ctx_t *ctx, uint8_t b1, uint8_t b2) {
+    noncelistentry_t *p = ctx->nonces[b1].first;
     while (p != NULL) {
         if ((p->nonce_enc >> 16 & 0xff) == b2) {
             return p;
@@ -1111,8 +1569,16 @@ static noncelistentry_t *SearchFor2ndByte(uint8_t b1, uint8_t b2) {
     return NULL;
 }
 
-static bool timeout(void) {
-    return (msclock() > last_sample_clock + sample_period);
+typedef struct {
+    hardnested_ctx_t *ctx;
+    uint8_t first_byte;
+    uint8_t last_byte;
+    bool time_budget;
+    uint8_t bitflips_to_go;
+} check_bitflips_args_t;
+
+static bool timeout(hardnested_ctx_t *ctx) {
+    return (msclock() > ctx->last_sample_clock + __atomic_load_n(&ctx->sample_period, __ATOMIC_RELAXED));
 }
 
 
@@ -1123,15 +1589,17 @@ __attribute__((force_align_arg_pointer))
 #endif
 #endif
 *check_for_BitFlipProperties_thread(void *args) {
-    uint8_t first_byte = ((uint8_t *)args)[0];
-    uint8_t last_byte = ((uint8_t *)args)[1];
-    uint8_t time_budget = ((uint8_t *)args)[2];
+    check_bitflips_args_t *thread_args = (check_bitflips_args_t *)args;
+    hardnested_ctx_t *ctx = thread_args->ctx;
+    uint8_t first_byte = thread_args->first_byte;
+    uint8_t last_byte = thread_args->last_byte;
+    bool time_budget = thread_args->time_budget;
 
-    if (hardnested_stage & CHECK_1ST_BYTES) {
+    if (ctx->hardnested_stage & CHECK_1ST_BYTES) {
         // for (uint16_t bitflip = 0x001; bitflip < 0x200; bitflip++) {
         for (uint16_t bitflip_idx = 0; bitflip_idx < num_1st_byte_effective_bitflips; bitflip_idx++) {
             uint16_t bitflip = all_effective_bitflip[bitflip_idx];
-            if (time_budget && timeout()) {
+            if (time_budget && timeout(ctx)) {
 #if defined (DEBUG_REDUCTION)
                 PrintAndLogEx(INFO, "break at bitflip_idx " _YELLOW_("%d") " ...", bitflip_idx);
 #endif
@@ -1139,24 +1607,24 @@ __attribute__((force_align_arg_pointer))
             }
             for (uint16_t i = first_byte; i <= last_byte; i++) {
 
-                if (nonces[i].BitFlips[bitflip] == 0 && nonces[i].BitFlips[bitflip ^ 0x100] == 0
-                        && nonces[i].first != NULL && nonces[i ^ (bitflip & 0xff)].first != NULL) {
+                if (ctx->nonces[i].BitFlips[bitflip] == 0 && ctx->nonces[i].BitFlips[bitflip ^ 0x100] == 0
+                        && ctx->nonces[i].first != NULL && ctx->nonces[i ^ (bitflip & 0xff)].first != NULL) {
 
-                    uint8_t parity1 = (nonces[i].first->par_enc) >> 3;                  // parity of first byte
-                    uint8_t parity2 = (nonces[i ^ (bitflip & 0xff)].first->par_enc) >> 3; // parity of nonce with bits flipped
+                    uint8_t parity1 = (ctx->nonces[i].first->par_enc) >> 3;                  // parity of first byte
+                    uint8_t parity2 = (ctx->nonces[i ^ (bitflip & 0xff)].first->par_enc) >> 3; // parity of nonce with bits flipped
 
                     if ((parity1 == parity2 && !(bitflip & 0x100))          // bitflip
                             || (parity1 != parity2 && (bitflip & 0x100))) {     // not bitflip
 
-                        nonces[i].BitFlips[bitflip] = 1;
+                        ctx->nonces[i].BitFlips[bitflip] = 1;
 
                         for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
 
                             if (bitflip_bitarrays[odd_even][bitflip] != NULL) {
-                                uint32_t old_count = nonces[i].num_states_bitarray[odd_even];
-                                nonces[i].num_states_bitarray[odd_even] = count_bitarray_AND(nonces[i].states_bitarray[odd_even], bitflip_bitarrays[odd_even][bitflip]);
-                                if (nonces[i].num_states_bitarray[odd_even] != old_count) {
-                                    nonces[i].all_bitflips_dirty[odd_even] = true;
+                                uint32_t old_count = ctx->nonces[i].num_states_bitarray[odd_even];
+                                ctx->nonces[i].num_states_bitarray[odd_even] = count_bitarray_AND(ctx->nonces[i].states_bitarray[odd_even], bitflip_bitarrays[odd_even][bitflip]);
+                                if (ctx->nonces[i].num_states_bitarray[odd_even] != old_count) {
+                                    ctx->nonces[i].all_bitflips_dirty[odd_even] = true;
                                 }
                                 // PrintAndLogEx(INFO, "bitflip: %d old: %d, new: %d ", bitflip, old_count, nonces[i].num_states_bitarray[odd_even]);
                             }
@@ -1164,16 +1632,16 @@ __attribute__((force_align_arg_pointer))
                     }
                 }
             }
-            ((uint8_t *)args)[1] = num_1st_byte_effective_bitflips - bitflip_idx - 1;  // bitflips still to go in stage 1
+            thread_args->bitflips_to_go = num_1st_byte_effective_bitflips - bitflip_idx - 1;  // bitflips still to go in stage 1
         }
     }
 
-    ((uint8_t *)args)[1] = 0;  // stage 1 definitely completed
+    thread_args->bitflips_to_go = 0;  // stage 1 definitely completed
 
-    if (hardnested_stage & CHECK_2ND_BYTES) {
+    if (ctx->hardnested_stage & CHECK_2ND_BYTES) {
         for (uint16_t bitflip_idx = num_1st_byte_effective_bitflips; bitflip_idx < num_all_effective_bitflips; bitflip_idx++) {
             uint16_t bitflip = all_effective_bitflip[bitflip_idx];
-            if (time_budget && timeout()) {
+            if (time_budget && timeout(ctx)) {
 #if defined (DEBUG_REDUCTION)
                 PrintAndLogEx(INFO, "break at bitflip_idx " _YELLOW_("%d") " ...", bitflip_idx);
 #endif
@@ -1181,22 +1649,22 @@ __attribute__((force_align_arg_pointer))
             }
             for (uint16_t i = first_byte; i <= last_byte; i++) {
                 // Check for Bit Flip Property of 2nd bytes
-                if (nonces[i].BitFlips[bitflip] == 0) {
+                if (ctx->nonces[i].BitFlips[bitflip] == 0) {
                     for (uint16_t j = 0; j < 256; j++) { // for each 2nd Byte
-                        noncelistentry_t *byte1 = SearchFor2ndByte(i, j);
-                        noncelistentry_t *byte2 = SearchFor2ndByte(i, j ^ (bitflip & 0xff));
+                        noncelistentry_t *byte1 = SearchFor2ndByte(ctx, i, j);
+                        noncelistentry_t *byte2 = SearchFor2ndByte(ctx, i, j ^ (bitflip & 0xff));
                         if (byte1 != NULL && byte2 != NULL) {
                             uint8_t parity1 = byte1->par_enc >> 2 & 0x01; // parity of 2nd byte
                             uint8_t parity2 = byte2->par_enc >> 2 & 0x01; // parity of 2nd byte with bits flipped
                             if ((parity1 == parity2 && !(bitflip & 0x100)) // bitflip
                                     || (parity1 != parity2 && (bitflip & 0x100))) { // not bitflip
-                                nonces[i].BitFlips[bitflip] = 1;
+                                ctx->nonces[i].BitFlips[bitflip] = 1;
                                 for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
                                     if (bitflip_bitarrays[odd_even][bitflip] != NULL) {
-                                        uint32_t old_count = nonces[i].num_states_bitarray[odd_even];
-                                        nonces[i].num_states_bitarray[odd_even] = count_bitarray_AND(nonces[i].states_bitarray[odd_even], bitflip_bitarrays[odd_even][bitflip]);
-                                        if (nonces[i].num_states_bitarray[odd_even] != old_count) {
-                                            nonces[i].all_bitflips_dirty[odd_even] = true;
+                                        uint32_t old_count = ctx->nonces[i].num_states_bitarray[odd_even];
+                                        ctx->nonces[i].num_states_bitarray[odd_even] = count_bitarray_AND(ctx->nonces[i].states_bitarray[odd_even], bitflip_bitarrays[odd_even][bitflip]);
+                                        if (ctx->nonces[i].num_states_bitarray[odd_even] != old_count) {
+                                            ctx->nonces[i].all_bitflips_dirty[odd_even] = true;
                                         }
                                     }
                                 }
@@ -1214,23 +1682,25 @@ __attribute__((force_align_arg_pointer))
     return NULL;
 }
 
-static void check_for_BitFlipProperties(bool time_budget) {
+static void check_for_BitFlipProperties(hardnested_ctx_t *ctx, bool time_budget) {
     // create and run worker threads
     pthread_t thread_id[NUM_CHECK_BITFLIPS_THREADS];
 
-    uint8_t args[NUM_CHECK_BITFLIPS_THREADS][3];
+    check_bitflips_args_t args[NUM_CHECK_BITFLIPS_THREADS];
     uint16_t bytes_per_thread = (256 + (NUM_CHECK_BITFLIPS_THREADS / 2)) / NUM_CHECK_BITFLIPS_THREADS;
     for (uint32_t i = 0; i < NUM_CHECK_BITFLIPS_THREADS; i++) {
-        args[i][0] = i * bytes_per_thread;
-        args[i][1] = MIN(args[i][0] + bytes_per_thread - 1, 255);
-        args[i][2] = time_budget;
+        args[i].ctx = ctx;
+        args[i].first_byte = i * bytes_per_thread;
+        args[i].last_byte = MIN(args[i].first_byte + bytes_per_thread - 1, 255);
+        args[i].time_budget = time_budget;
+        args[i].bitflips_to_go = args[i].last_byte;
     }
-    // args[][] is uint8_t so max 255, no need to check it
-    // args[NUM_CHECK_BITFLIPS_THREADS - 1][1] = MAX(args[NUM_CHECK_BITFLIPS_THREADS - 1][1], 255);
+    // first_byte and last_byte are uint8_t so max 255, no need to check it
+    // args[NUM_CHECK_BITFLIPS_THREADS - 1].last_byte = MAX(args[NUM_CHECK_BITFLIPS_THREADS - 1].last_byte, 255);
 
     // start threads
     for (uint32_t i = 0; i < NUM_CHECK_BITFLIPS_THREADS; i++) {
-        pthread_create(&thread_id[i], NULL, check_for_BitFlipProperties_thread, args[i]);
+        pthread_create(&thread_id[i], NULL, check_for_BitFlipProperties_thread, &args[i]);
     }
 
     // wait for threads to terminate:
@@ -1238,39 +1708,39 @@ static void check_for_BitFlipProperties(bool time_budget) {
         pthread_join(thread_id[i], NULL);
     }
 
-    if (hardnested_stage & CHECK_2ND_BYTES) {
-        hardnested_stage &= ~CHECK_1ST_BYTES; // we are done with 1st stage, except...
+    if (ctx->hardnested_stage & CHECK_2ND_BYTES) {
+        ctx->hardnested_stage &= ~CHECK_1ST_BYTES; // we are done with 1st stage, except...
         for (uint32_t i = 0; i < NUM_CHECK_BITFLIPS_THREADS; i++) {
-            if (args[i][1] != 0) {
-                hardnested_stage |= CHECK_1ST_BYTES;  // ... when any of the threads didn't complete in time
+            if (args[i].bitflips_to_go != 0) {
+                ctx->hardnested_stage |= CHECK_1ST_BYTES;  // ... when any of the threads didn't complete in time
                 break;
             }
         }
     }
 #if defined (DEBUG_REDUCTION)
-    if (hardnested_stage & CHECK_1ST_BYTES) PrintAndLogEx(INFO, "stage 1 not completed yet\n");
+    if (ctx->hardnested_stage & CHECK_1ST_BYTES) PrintAndLogEx(INFO, "stage 1 not completed yet\n");
 #endif
 }
 
-static void update_nonce_data(bool time_budget) {
-    check_for_BitFlipProperties(time_budget);
-    update_allbitflips_array();
-    update_sum_bitarrays(EVEN_STATE);
-    update_sum_bitarrays(ODD_STATE);
-    update_p_K();
-    estimate_sum_a8();
+static void update_nonce_data(hardnested_ctx_t *ctx, bool time_budget) {
+    check_for_BitFlipProperties(ctx, time_budget);
+    update_allbitflips_array(ctx);
+    update_sum_bitarrays(ctx, EVEN_STATE);
+    update_sum_bitarrays(ctx, ODD_STATE);
+    update_p_K(ctx);
+    estimate_sum_a8(ctx);
 }
 
-static void apply_sum_a0(void) {
-    uint32_t old_count = num_all_bitflips_bitarray[EVEN_STATE];
-    num_all_bitflips_bitarray[EVEN_STATE] = count_bitarray_AND(all_bitflips_bitarray[EVEN_STATE], sum_a0_bitarrays[EVEN_STATE][first_byte_Sum]);
-    if (num_all_bitflips_bitarray[EVEN_STATE] != old_count) {
-        all_bitflips_bitarray_dirty[EVEN_STATE] = true;
+static void apply_sum_a0(hardnested_ctx_t *ctx) {
+    uint32_t old_count = ctx->num_all_bitflips_bitarray[EVEN_STATE];
+    ctx->num_all_bitflips_bitarray[EVEN_STATE] = count_bitarray_AND(ctx->all_bitflips_bitarray[EVEN_STATE], ctx->sum_a0_bitarrays[EVEN_STATE][ctx->first_byte_Sum]);
+    if (ctx->num_all_bitflips_bitarray[EVEN_STATE] != old_count) {
+        ctx->all_bitflips_bitarray_dirty[EVEN_STATE] = true;
     }
-    old_count = num_all_bitflips_bitarray[ODD_STATE];
-    num_all_bitflips_bitarray[ODD_STATE] = count_bitarray_AND(all_bitflips_bitarray[ODD_STATE], sum_a0_bitarrays[ODD_STATE][first_byte_Sum]);
-    if (num_all_bitflips_bitarray[ODD_STATE] != old_count) {
-        all_bitflips_bitarray_dirty[ODD_STATE] = true;
+    old_count = ctx->num_all_bitflips_bitarray[ODD_STATE];
+    ctx->num_all_bitflips_bitarray[ODD_STATE] = count_bitarray_AND(ctx->all_bitflips_bitarray[ODD_STATE], ctx->sum_a0_bitarrays[ODD_STATE][ctx->first_byte_Sum]);
+    if (ctx->num_all_bitflips_bitarray[ODD_STATE] != old_count) {
+        ctx->all_bitflips_bitarray_dirty[ODD_STATE] = true;
     }
 }
 
@@ -1295,74 +1765,74 @@ static void simulate_MFplus_RNG(uint32_t test_cuid, uint64_t test_key, uint32_t
     }
 }
 
-static int simulate_acquire_nonces(void) {
+static int simulate_acquire_nonces(hardnested_ctx_t *ctx) {
     time_t time1 = time(NULL);
-    last_sample_clock = 0;
-    sample_period = 1000; // for simulation
-    hardnested_stage = CHECK_1ST_BYTES;
+    ctx->last_sample_clock = 0;
+    ctx->sample_period = 1000; // for simulation
+    ctx->hardnested_stage = CHECK_1ST_BYTES;
     bool acquisition_completed = false;
     uint32_t total_num_nonces = 0;
     float brute_force_depth;
     bool reported_suma8 = false;
 
-    cuid = (rand() & 0xff) << 24 | (rand() & 0xff) << 16 | (rand() & 0xff) << 8 | (rand() & 0xff);
-    if (known_target_key == -1) {
-        known_target_key = ((uint64_t)rand() & 0xfff) << 36 | ((uint64_t)rand() & 0xfff) << 24 | ((uint64_t)rand() & 0xfff) << 12 | ((uint64_t)rand() & 0xfff);
+    ctx->cuid = (rand() & 0xff) << 24 | (rand() & 0xff) << 16 | (rand() & 0xff) << 8 | (rand() & 0xff);
+    if (ctx->known_target_key == -1) {
+        ctx->known_target_key = ((uint64_t)rand() & 0xfff) << 36 | ((uint64_t)rand() & 0xfff) << 24 | ((uint64_t)rand() & 0xfff) << 12 | ((uint64_t)rand() & 0xfff);
     }
 
     char progress_text[80];
-    sprintf(progress_text, "Simulating key %012" PRIx64 ", cuid %08" PRIx32 " ...", known_target_key, cuid);
-    hardnested_print_progress(0, progress_text, (float)(1LL << 47), 0);
-    fprintf(fstats, "%012" PRIx64 ";%" PRIx32 ";", known_target_key, cuid);
+    sprintf(progress_text, "Simulating key %012" PRIx64 ", cuid %08" PRIx32 " ...", ctx->known_target_key, ctx->cuid);
+    hardnested_print_progress(ctx, 0, progress_text, (float)(1LL << 47), 0);
+    fprintf(ctx->fstats, "%012" PRIx64 ";%" PRIx32 ";", ctx->known_target_key, ctx->cuid);
 
-    num_acquired_nonces = 0;
+    ctx->num_acquired_nonces = 0;
 
     do {
         uint32_t nt_enc = 0;
         uint8_t par_enc = 0;
 
         for (uint16_t i = 0; i < 113; i++) {
-            simulate_MFplus_RNG(cuid, known_target_key, &nt_enc, &par_enc);
-            num_acquired_nonces += add_nonce(nt_enc, par_enc);
+            simulate_MFplus_RNG(ctx->cuid, ctx->known_target_key, &nt_enc, &par_enc);
+            ctx->num_acquired_nonces += add_nonce(ctx, nt_enc, par_enc);
             total_num_nonces++;
         }
 
-        last_sample_clock = msclock();
+        ctx->last_sample_clock = msclock();
 
-        if (first_byte_num == 256) {
-            if (hardnested_stage == CHECK_1ST_BYTES) {
+        if (ctx->first_byte_num == 256) {
+            if (ctx->hardnested_stage == CHECK_1ST_BYTES) {
 
                 bool got_match = false;
                 for (uint8_t i = 0; i < NUM_SUMS; i++) {
-                    if (first_byte_Sum == sums[i]) {
-                        first_byte_Sum = i;
+                    if (ctx->first_byte_Sum == sums[i]) {
+                        ctx->first_byte_Sum = i;
                         got_match = true;
                         break;
                     }
                 }
 
                 if (got_match == false) {
-                    PrintAndLogEx(FAILED, "No match for the First_Byte_Sum (%u), is the card a genuine MFC Ev1? ", first_byte_Sum);
+                    PrintAndLogEx(FAILED, "No match for the First_Byte_Sum (%u), is the card a genuine MFC Ev1? ", ctx->first_byte_Sum);
                     return PM3_ESOFT;
                 }
 
-                hardnested_stage |= CHECK_2ND_BYTES;
-                apply_sum_a0();
+                ctx->hardnested_stage |= CHECK_2ND_BYTES;
+                apply_sum_a0(ctx);
             }
-            update_nonce_data(true);
-            acquisition_completed = shrink_key_space(&brute_force_depth);
+            update_nonce_data(ctx, true);
+            acquisition_completed = shrink_key_space(ctx, &brute_force_depth);
             if (!reported_suma8) {
                 char progress_string[80];
-                sprintf(progress_string, "Apply Sum property. Sum(a0) = %d", sums[first_byte_Sum]);
-                hardnested_print_progress(num_acquired_nonces, progress_string, brute_force_depth, 0);
+                sprintf(progress_string, "Apply Sum property. Sum(a0) = %d", sums[ctx->first_byte_Sum]);
+                hardnested_print_progress(ctx, ctx->num_acquired_nonces, progress_string, brute_force_depth, 0);
                 reported_suma8 = true;
             } else {
-                hardnested_print_progress(num_acquired_nonces, "Apply bit flip properties", brute_force_depth, 0);
+                hardnested_print_progress(ctx, ctx->num_acquired_nonces, "Apply bit flip properties", brute_force_depth, 0);
             }
         } else {
-            update_nonce_data(true);
-            acquisition_completed = shrink_key_space(&brute_force_depth);
-            hardnested_print_progress(num_acquired_nonces, "Apply bit flip properties", brute_force_depth, 0);
+            update_nonce_data(ctx, true);
+            acquisition_completed = shrink_key_space(ctx, &brute_force_depth);
+            hardnested_print_progress(ctx, ctx->num_acquired_nonces, "Apply bit flip properties", brute_force_depth, 0);
         }
     } while (!acquisition_completed);
 
@@ -1373,176 +1843,234 @@ static int simulate_acquire_nonces(void) {
     // difftime(end_time, time1)!=0.0?(float)total_num_nonces*60.0/difftime(end_time, time1):INFINITY
     // );
 
-    fprintf(fstats, "%" PRIu32 ";%" PRIu32 ";%1.0f;", total_num_nonces, num_acquired_nonces, difftime(end_time, time1));
+    fprintf(ctx->fstats, "%" PRIu32 ";%" PRIu32 ";%1.0f;", total_num_nonces, ctx->num_acquired_nonces, difftime(end_time, time1));
     return PM3_SUCCESS;
 }
 
-static int acquire_nonces(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, bool nonce_file_write, bool slow, char *filename) {
-
-    last_sample_clock = msclock();
-    hardnested_stage = CHECK_1ST_BYTES;
-    num_acquired_nonces = 0;
+// Nonce acquisition is pipelined: a producer thread keeps the Proxmark3 busy collecting batches of
+// encrypted nonces while the calling thread analyses whatever has arrived so far.
+#define NONCE_QUEUE_LEN     64      // batches, must be a power of 2
+
+typedef struct {
+    uint16_t num_nonces;
+    uint8_t data[PM3_CMD_DATA_SIZE];
+} nonce_batch_t;
+
+typedef struct {
+    hardnested_ctx_t *ctx;
+    uint8_t blockNo;
+    uint8_t keyType;
+    uint8_t *key;
+    uint8_t trgBlockNo;
+    uint8_t trgKeyType;
+    bool slow;
+    // single producer, single consumer ring
+    nonce_batch_t batches[NONCE_QUEUE_LEN];
+    uint32_t head;      // written by the producer only
+    uint32_t tail;      // written by the consumer only
+    bool stop;          // consumer -> producer
+    bool finished;      // producer -> consumer
+    int res;
+} nonce_acquisition_t;
+
+static bool wait_for_queue_space(nonce_acquisition_t *acq) {
+    while (acq->head - __atomic_load_n(&acq->tail, __ATOMIC_ACQUIRE) == NONCE_QUEUE_LEN) {
+        if (__atomic_load_n(&acq->stop, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+        msleep(1);
+    }
+    return true;
+}
 
-    // initial rough estimate. Will be refined.
-    sample_period = 2000;
+static void *acquire_nonces_producer(void *arg) {
+    nonce_acquisition_t *acq = (nonce_acquisition_t *)arg;
+    hardnested_ctx_t *ctx = acq->ctx;
 
     bool initialize = true;
-    bool field_off = false;
-    bool acquisition_completed = false;
-    bool reported_suma8 = false;
-
-    float brute_force_depth;
-
-    FILE *fnonces = NULL;
+    uint64_t last_clock = msclock();
     PacketResponseNG resp;
 
-    uint8_t write_buf[9];
-    char progress_text[80];
+    while (__atomic_load_n(&acq->stop, __ATOMIC_ACQUIRE) == false) {
 
-    do {
+        uint32_t flags = 0;
+        flags |= initialize ? 0x0001 : 0;
+        flags |= acq->slow ? 0x0002 : 0;
+        clearCommandBuffer();
+        SendCommandMIX(CMD_HF_MIFARE_ACQ_ENCRYPTED_NONCES, acq->blockNo + acq->keyType * 0x100, acq->trgBlockNo + acq->trgKeyType * 0x100, flags, acq->key, 6);
 
-        if (field_off) {
-            DropField();
+        if (WaitForResponseTimeout(CMD_ACK, &resp, 3000) == false) {
+            acq->res = 1;
             break;
         }
 
-        uint32_t flags = 0;
-        flags |= initialize ? 0x0001 : 0;
-        flags |= slow ? 0x0002 : 0;
-        flags |= field_off ? 0x0004 : 0;
-        clearCommandBuffer();
-        SendCommandMIX(CMD_HF_MIFARE_ACQ_ENCRYPTED_NONCES, blockNo + keyType * 0x100, trgBlockNo + trgKeyType * 0x100, flags, key, 6);
+        // error during nested_hard
+        if (resp.oldarg[0]) {
+            acq->res = resp.oldarg[0];
+            break;
+        }
 
         if (initialize) {
+            ctx->cuid = resp.oldarg[1];
+            initialize = false;
+        }
 
-            if (WaitForResponseTimeout(CMD_ACK, &resp, 3000) == false) {
-                DropField();
-                return 1;
-            }
+        uint64_t now = msclock();
+        if (now - last_clock < __atomic_load_n(&ctx->sample_period, __ATOMIC_RELAXED)) {
+            __atomic_store_n(&ctx->sample_period, now - last_clock, __ATOMIC_RELAXED);
+        }
+        last_clock = now;
 
-            // error during nested_hard
-            if (resp.oldarg[0]) {
-                DropField();
-                return resp.oldarg[0];
-            }
+        if (wait_for_queue_space(acq) == false) {
+            break;
+        }
 
-            cuid = resp.oldarg[1];
-            if (nonce_file_write && fnonces == NULL) {
+        nonce_batch_t *batch = &acq->batches[acq->head % NONCE_QUEUE_LEN];
+        batch->num_nonces = resp.oldarg[2];
+        memcpy(batch->data, resp.data.asBytes, sizeof(batch->data));
+        __atomic_store_n(&acq->head, acq->head + 1, __ATOMIC_RELEASE);
+    }
 
-                if ((fnonces = fopen(filename, "wb")) == NULL) {
-                    PrintAndLogEx(WARNING, "Could not create file " _YELLOW_("%s"), filename);
-                    DropField();
-                    return 3;
-                }
+    DropField();
+    __atomic_store_n(&acq->finished, true, __ATOMIC_RELEASE);
+    return NULL;
+}
 
-                snprintf(progress_text, 80, "Writing acquired nonces to binary file " _YELLOW_("%s"), filename);
-                hardnested_print_progress(0, progress_text, (float)(1LL << 47), 0);
-                num_to_bytes(cuid, 4, write_buf);
-                fwrite(write_buf, 1, 4, fnonces);
-                fwrite(&trgBlockNo, 1, 1, fnonces);
-                fwrite(&trgKeyType, 1, 1, fnonces);
-                fflush(fnonces);
-            }
-        }
+static int acquire_nonces(hardnested_ctx_t *ctx, uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, bool nonce_file_write, bool slow, char *filename) {
 
-        if (initialize == false) {
+    ctx->last_sample_clock = msclock();
+    ctx->hardnested_stage = CHECK_1ST_BYTES;
+    ctx->num_acquired_nonces = 0;
 
-            uint16_t num_sampled_nonces = resp.oldarg[2];
-            uint8_t *bufp = resp.data.asBytes;
+    // initial rough estimate. Will be refined.
+    ctx->sample_period = 2000;
 
-            for (uint16_t i = 0; i < num_sampled_nonces; i += 2) {
-                uint32_t nt_enc1 = bytes_to_num(bufp, 4);
-                uint32_t nt_enc2 = bytes_to_num(bufp + 4, 4);
-                uint8_t par_enc = bytes_to_num(bufp + 8, 1);
+    nonce_acquisition_t *acq = calloc(1, sizeof(nonce_acquisition_t));
+    if (acq == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+    acq->ctx = ctx;
+    acq->blockNo = blockNo;
+    acq->keyType = keyType;
+    acq->key = key;
+    acq->trgBlockNo = trgBlockNo;
+    acq->trgKeyType = trgKeyType;
+    acq->slow = slow;
 
-                //PrintAndLogEx(INFO, "Encrypted nonce: %08x, encrypted_parity: %02x\n", nt_enc1, par_enc >> 4);
-                num_acquired_nonces += add_nonce(nt_enc1, par_enc >> 4);
-                //PrintAndLogEx(INFO, "Encrypted nonce: %08x, encrypted_parity: %02x\n", nt_enc2, par_enc & 0x0f);
-                num_acquired_nonces += add_nonce(nt_enc2, par_enc & 0x0f);
+    pthread_t producer;
+    if (pthread_create(&producer, NULL, acquire_nonces_producer, acq) != 0) {
+        free(acq);
+        return PM3_ESOFT;
+    }
 
-                if (nonce_file_write) {
-                    fwrite(bufp, 1, 9, fnonces);
-                    fflush(fnonces);
-                }
-                bufp += 9;
-            }
-            //total_num_nonces += num_sampled_nonces;
-
-            if (first_byte_num == 256) {
-                if (hardnested_stage == CHECK_1ST_BYTES) {
-                    bool got_match = false;
-                    for (uint8_t i = 0; i < NUM_SUMS; i++) {
-                        if (first_byte_Sum == sums[i]) {
-                            first_byte_Sum = i;
-                            got_match = true;
-                            break;
-                        }
-                    }
+    bool acquisition_completed = false;
+    bool reported_suma8 = false;
+    int res = PM3_SUCCESS;
 
-                    if (got_match == false) {
-                        PrintAndLogEx(FAILED, "No match for the First_Byte_Sum (%u), is the card a genuine MFC Ev1? ", first_byte_Sum);
-                        return 4;
-                    }
+    float brute_force_depth;
 
-                    hardnested_stage |= CHECK_2ND_BYTES;
-                    apply_sum_a0();
-                }
-                update_nonce_data(true);
-                acquisition_completed = shrink_key_space(&brute_force_depth);
-                if (!reported_suma8) {
-                    char progress_string[80];
-                    sprintf(progress_string, "Apply Sum property. Sum(a0) = %d", sums[first_byte_Sum]);
-                    hardnested_print_progress(num_acquired_nonces, progress_string, brute_force_depth, 0);
-                    reported_suma8 = true;
-                } else {
-                    hardnested_print_progress(num_acquired_nonces, "Apply bit flip properties", brute_force_depth, 0);
-                }
-            } else {
-                update_nonce_data(true);
-                acquisition_completed = shrink_key_space(&brute_force_depth);
-                hardnested_print_progress(num_acquired_nonces, "Apply bit flip properties", brute_force_depth, 0);
+    nonce_writer_t *writer = NULL;
+    char progress_text[80];
+
+    do {
+        // check finished before head, the last batches may arrive just before the producer quits
+        bool producer_finished = __atomic_load_n(&acq->finished, __ATOMIC_ACQUIRE);
+        uint32_t head = __atomic_load_n(&acq->head, __ATOMIC_ACQUIRE);
+        uint32_t tail = acq->tail;
+
+        if (head == tail) {
+            if (producer_finished) {
+                res = acq->res;
+                break;
             }
+            msleep(1);
+            continue;
         }
 
-        if (acquisition_completed) {
-            field_off = true; // switch off field with next SendCommandOLD and then finish
+        if (nonce_file_write && writer == NULL) {
+
+            writer = calloc(1, sizeof(nonce_writer_t));
+            if (writer == NULL ||
+                    nonce_writer_open(writer, filename, ctx->nonce_file_mode & HARDNESTED_NFW_APPEND, ctx->nonce_file_mode & HARDNESTED_NFW_LZ4, ctx->cuid, trgBlockNo, trgKeyType) != PM3_SUCCESS) {
+                PrintAndLogEx(WARNING, "Could not create file " _YELLOW_("%s"), filename);
+                free(writer);
+                writer = NULL;
+                res = 3;
+                break;
+            }
+
+            snprintf(progress_text, 80, "Writing acquired nonces to binary file " _YELLOW_("%s"), filename);
+            hardnested_print_progress(ctx, 0, progress_text, (float)(1LL << 47), 0);
         }
 
-        if (initialize == false) {
+        ctx->last_sample_clock = msclock();
 
-            if (WaitForResponseTimeout(CMD_ACK, &resp, 3000) == false) {
-                if (nonce_file_write) {
-                    fclose(fnonces);
-                }
-                DropField();
-                return 1;
-            }
+        // take everything that has arrived, the stop criterion is scaled by the number of batches
+        ctx->samples_per_step = head - tail;
+        uint16_t sum_a0 = (ctx->hardnested_stage & CHECK_2ND_BYTES) ? sums[ctx->first_byte_Sum] : NONCE_SUM_UNKNOWN;
+        for (; tail != head; tail++) {
+            nonce_batch_t *batch = &acq->batches[tail % NONCE_QUEUE_LEN];
+            uint32_t records = batch->num_nonces / 2;
 
-            // error during nested_hard
-            if (resp.oldarg[0]) {
-                if (nonce_file_write) {
-                    fclose(fnonces);
-                }
-                DropField();
-                return resp.oldarg[0];
+            ctx->num_acquired_nonces += add_nonce_records(ctx, batch->data, records);
+
+            if (writer != NULL) {
+                nonce_writer_add(writer, batch->data, records, sum_a0);
             }
         }
+        __atomic_store_n(&acq->tail, tail, __ATOMIC_RELEASE);
+
+        if (ctx->first_byte_num == 256) {
+            if (ctx->hardnested_stage == CHECK_1ST_BYTES) {
+                bool got_match = false;
+                for (uint8_t i = 0; i < NUM_SUMS; i++) {
+                    if (ctx->first_byte_Sum == sums[i]) {
+                        ctx->first_byte_Sum = i;
+                        got_match = true;
+                        break;
+                    }
+                }
 
-        initialize = false;
+                if (got_match == false) {
+                    PrintAndLogEx(FAILED, "No match for the First_Byte_Sum (%u), is the card a genuine MFC Ev1? ", ctx->first_byte_Sum);
+                    res = 4;
+                    break;
+                }
 
-        if (msclock() - last_sample_clock < sample_period) {
-            sample_period = msclock() - last_sample_clock;
+                ctx->hardnested_stage |= CHECK_2ND_BYTES;
+                apply_sum_a0(ctx);
+            }
+            update_nonce_data(ctx, true);
+            acquisition_completed = shrink_key_space(ctx, &brute_force_depth);
+            if (!reported_suma8) {
+                char progress_string[80];
+                sprintf(progress_string, "Apply Sum property. Sum(a0) = %d", sums[ctx->first_byte_Sum]);
+                hardnested_print_progress(ctx, ctx->num_acquired_nonces, progress_string, brute_force_depth, 0);
+                reported_suma8 = true;
+            } else {
+                hardnested_print_progress(ctx, ctx->num_acquired_nonces, "Apply bit flip properties", brute_force_depth, 0);
+            }
+        } else {
+            update_nonce_data(ctx, true);
+            acquisition_completed = shrink_key_space(ctx, &brute_force_depth);
+            hardnested_print_progress(ctx, ctx->num_acquired_nonces, "Apply bit flip properties", brute_force_depth, 0);
         }
 
-        last_sample_clock = msclock();
+    } while (acquisition_completed == false);
 
-    } while (field_off || acquisition_completed == false);
+    // the producer switches off the field
+    __atomic_store_n(&acq->stop, true, __ATOMIC_RELEASE);
+    pthread_join(producer, NULL);
+    free(acq);
+    ctx->samples_per_step = 1;
 
-    if (nonce_file_write) {
-        fclose(fnonces);
+    if (writer != NULL) {
+        nonce_writer_close(writer, (ctx->hardnested_stage & CHECK_2ND_BYTES) ? sums[ctx->first_byte_Sum] : NONCE_SUM_UNKNOWN);
+        free(writer);
     }
 
-    return PM3_SUCCESS;
+    return res;
 }
 
 static inline bool invariant_holds(uint_fast8_t byte_diff, uint_fast32_t state1, uint_fast32_t state2, uint_fast8_t bit, uint_fast8_t state_bit) {
@@ -1608,61 +2136,46 @@ static inline bool remaining_bits_match(uint_fast8_t num_common_bits, uint_fast8
     return true; // valid state
 }
 
-static pthread_mutex_t statelist_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_mutex_t book_of_work_mutex = PTHREAD_MUTEX_INITIALIZER;
-
-typedef enum {
-    TO_BE_DONE,
-    WORK_IN_PROGRESS,
-    COMPLETED
-} work_status_t;
-
-static struct sl_cache_entry {
-    uint32_t *sl;
-    uint32_t len;
-    work_status_t cache_status;
-} sl_cache[NUM_PART_SUMS][NUM_PART_SUMS][2];
-
-static void init_statelist_cache(void) {
-    pthread_mutex_lock(&statelist_cache_mutex);
+static void init_statelist_cache(hardnested_ctx_t *ctx) {
+    pthread_mutex_lock(&ctx->statelist_cache_mutex);
     for (uint16_t i = 0; i < NUM_PART_SUMS; i++) {
         for (uint16_t j = 0; j < NUM_PART_SUMS; j++) {
             for (uint16_t k = 0; k < 2; k++) {
-                sl_cache[i][j][k].sl = NULL;
-                sl_cache[i][j][k].len = 0;
-                sl_cache[i][j][k].cache_status = TO_BE_DONE;
+                ctx->sl_cache[i][j][k].sl = NULL;
+                ctx->sl_cache[i][j][k].len = 0;
+                ctx->sl_cache[i][j][k].cache_status = TO_BE_DONE;
             }
         }
     }
-    pthread_mutex_unlock(&statelist_cache_mutex);
+    pthread_mutex_unlock(&ctx->statelist_cache_mutex);
 }
 
-static void free_statelist_cache(void) {
-    pthread_mutex_lock(&statelist_cache_mutex);
+static void free_statelist_cache(hardnested_ctx_t *ctx) {
+    pthread_mutex_lock(&ctx->statelist_cache_mutex);
     for (uint16_t i = 0; i < NUM_PART_SUMS; i++) {
         for (uint16_t j = 0; j < NUM_PART_SUMS; j++) {
             for (uint16_t k = 0; k < 2; k++) {
-                free(sl_cache[i][j][k].sl);
+                free(ctx->sl_cache[i][j][k].sl);
             }
         }
     }
-    pthread_mutex_unlock(&statelist_cache_mutex);
+    pthread_mutex_unlock(&ctx->statelist_cache_mutex);
 }
 
 
 #ifdef DEBUG_KEY_ELIMINATION
-static inline bool bitflips_match(uint8_t byte, uint32_t state, odd_even_t odd_even, bool quiet)
+static inline bool bitflips_match(hardnested_ctx_t *ctx, uint8_t byte, uint32_t state, odd_even_t odd_even, bool quiet)
 #else
-static inline bool bitflips_match(uint8_t byte, uint32_t state, odd_even_t odd_even)
+static inline bool bitflips_match(hardnested_ctx_t *ctx, uint8_t byte, uint32_t state, odd_even_t odd_even)
 #endif
 {
-    uint32_t *bitset = nonces[byte].states_bitarray[odd_even];
+    uint32_t *bitset = ctx->nonces[byte].states_bitarray[odd_even];
     bool possible = test_bit24(bitset, state);
     if (!possible) {
 #ifdef DEBUG_KEY_ELIMINATION
-        if (!quiet && known_target_key != -1 && state == test_state[odd_even]) {
+        if (!quiet && ctx->known_target_key != -1 && state == ctx->test_state[odd_even]) {
             PrintAndLogEx(INFO, "Initial state lists: " _YELLOW_("%s") " test state eliminated by bitflip property.", odd_even == EVEN_STATE ? "even" : "odd");
-            sprintf(failstr, "Initial " _YELLOW_("%s") " byte Bitflip property", odd_even == EVEN_STATE ? "even" : "odd");
+            sprintf(ctx->failstr, "Initial " _YELLOW_("%s") " byte Bitflip property", odd_even == EVEN_STATE ? "even" : "odd");
         }
 #endif
         return false;
@@ -1675,7 +2188,7 @@ static uint_fast8_t reverse(uint_fast8_t b) {
     return (b * 0x0202020202ULL & 0x010884422010ULL) % 1023;
 }
 
-static bool all_bitflips_match(uint8_t byte, uint32_t state, odd_even_t odd_even) {
+static bool all_bitflips_match(hardnested_ctx_t *ctx, uint8_t byte, uint32_t state, odd_even_t odd_even) {
     uint32_t masks[2][8] = {
         {0x00fffff0, 0x00fffff8, 0x00fffff8, 0x00fffffc, 0x00fffffc, 0x00fffffe, 0x00fffffe, 0x00ffffff},
         {0x00fffff0, 0x00fffff0, 0x00fffff8, 0x00fffff8, 0x00fffffc, 0x00fffffc, 0x00fffffe, 0x00fffffe}
@@ -1691,9 +2204,9 @@ static bool all_bitflips_match(uint8_t byte, uint32_t state, odd_even_t odd_even
             if (remaining_bits_match(num_common, bytes_diff, state, (state & mask) | remaining_bits, odd_even)) {
 
 # ifdef DEBUG_KEY_ELIMINATION
-                if (bitflips_match(byte2, (state & mask) | remaining_bits, odd_even, true))
+                if (bitflips_match(ctx, byte2, (state & mask) | remaining_bits, odd_even, true))
 # else
-                if (bitflips_match(byte2, (state & mask) | remaining_bits, odd_even))
+                if (bitflips_match(ctx, byte2, (state & mask) | remaining_bits, odd_even))
 # endif
                 {
                     found_match = true;
@@ -1705,15 +2218,15 @@ static bool all_bitflips_match(uint8_t byte, uint32_t state, odd_even_t odd_even
         if (!found_match) {
 
 # ifdef DEBUG_KEY_ELIMINATION
-            if (known_target_key != -1 && state == test_state[odd_even]) {
+            if (ctx->known_target_key != -1 && state == ctx->test_state[odd_even]) {
                 PrintAndLogEx(INFO, "all_bitflips_match() 1st Byte: %s test state (0x%06x): Eliminated. Bytes = %02x, %02x, Common Bits = %d\n",
                               odd_even == ODD_STATE ? "odd" : "even",
-                              test_state[odd_even],
+                              ctx->test_state[odd_even],
                               byte,
                               byte2,
                               num_common);
-                if (failstr[0] == '\0') {
-                    sprintf(failstr, "Other 1st Byte %s, all_bitflips_match(), no match", odd_even ? "odd" : "even");
+                if (ctx->failstr[0] == '\0') {
+                    sprintf(ctx->failstr, "Other 1st Byte %s, all_bitflips_match(), no match", odd_even ? "odd" : "even");
                 }
             }
 # endif
@@ -1723,10 +2236,10 @@ static bool all_bitflips_match(uint8_t byte, uint32_t state, odd_even_t odd_even
     return true;
 }
 
-static void bitarray_to_list(uint8_t byte, uint32_t *bitarray, uint32_t *state_list, uint32_t *len, odd_even_t odd_even) {
+static void bitarray_to_list(hardnested_ctx_t *ctx, uint8_t byte, uint32_t *bitarray, uint32_t *state_list, uint32_t *len, odd_even_t odd_even) {
     uint32_t *p = state_list;
     for (uint32_t state = next_state(bitarray, -1L); state < (1 << 24); state = next_state(bitarray, state)) {
-        if (all_bitflips_match(byte, state, odd_even)) {
+        if (all_bitflips_match(ctx, byte, state, odd_even)) {
             *p++ = state;
         }
     }
@@ -1735,16 +2248,258 @@ static void bitarray_to_list(uint8_t byte, uint32_t *bitarray, uint32_t *state_l
     *len = p - state_list;
 }
 
-static void add_cached_states(statelist_t *cands, uint16_t part_sum_a0, uint16_t part_sum_a8, odd_even_t odd_even) {
-    cands->states[odd_even] = sl_cache[part_sum_a0 / 2][part_sum_a8 / 2][odd_even].sl;
-    cands->len[odd_even] = sl_cache[part_sum_a0 / 2][part_sum_a8 / 2][odd_even].len;
+// order independent hash of the nonce set, taken before the nonces are XORed with the cuid
+static uint64_t nonce_set_hash(hardnested_ctx_t *ctx) {
+    uint64_t hash = 0;
+    for (uint16_t i = 0; i < 256; i++) {
+        for (noncelistentry_t *p = ctx->nonces[i].first; p != NULL; p = p->next) {
+            uint8_t rec[5];
+            num_to_bytes(p->nonce_enc, 4, rec);
+            rec[4] = p->par_enc;
+            crc64(rec, sizeof(rec), &hash);
+        }
+    }
+    return hash;
+}
+
+// crc64 over the first max bytes of a nonce file, *len returns how many there were
+static bool nonce_file_crc(const char *filename, uint32_t max, uint32_t *len, uint64_t *hash) {
+    size_t flen = 0;
+    bool mapped = false;
+    uint8_t *data = nonce_file_map(filename, &flen, &mapped);
+    if (data == NULL) {
+        return false;
+    }
+    *len = MIN(flen, max);
+    *hash = 0;
+    crc64(data, *len, hash);
+    nonce_file_unmap(data, flen, mapped);
+    return true;
+}
+
+static void cand_cache_free(hardnested_ctx_t *ctx) {
+    for (uint32_t i = 0; i < ctx->cand_cache_len; i++) {
+        free(ctx->cand_cache[i].sl);
+    }
+    free(ctx->cand_cache);
+    ctx->cand_cache = NULL;
+    ctx->cand_cache_len = 0;
+}
+
+static cand_cache_entry_t *cand_cache_find(hardnested_ctx_t *ctx, uint8_t first_byte, uint8_t part_sum_a0, uint8_t part_sum_a8, odd_even_t odd_even) {
+    for (uint32_t i = 0; i < ctx->cand_cache_len; i++) {
+        cand_entry_hdr_t *h = &ctx->cand_cache[i].hdr;
+        if (h->first_byte == first_byte && h->part_sum_a0 == part_sum_a0 && h->part_sum_a8 == part_sum_a8 && h->odd_even == odd_even) {
+            return &ctx->cand_cache[i];
+        }
+    }
+    return NULL;
+}
+
+static void cand_cache_put(hardnested_ctx_t *ctx, uint8_t first_byte, uint8_t part_sum_a0, uint8_t part_sum_a8, odd_even_t odd_even, const uint32_t *sl, uint32_t len) {
+    uint32_t *copy = NULL;
+    if (len) {
+        copy = malloc(sizeof(uint32_t) * (len + 1));
+        if (copy == NULL) {
+            return;
+        }
+        memcpy(copy, sl, sizeof(uint32_t) * (len + 1));
+    }
+
+    cand_cache_entry_t *e = cand_cache_find(ctx, first_byte, part_sum_a0, part_sum_a8, odd_even);
+    if (e == NULL) {
+        cand_cache_entry_t *tmp = realloc(ctx->cand_cache, sizeof(cand_cache_entry_t) * (ctx->cand_cache_len + 1));
+        if (tmp == NULL) {
+            free(copy);
+            return;
+        }
+        ctx->cand_cache = tmp;
+        e = &ctx->cand_cache[ctx->cand_cache_len++];
+        e->hdr.first_byte = first_byte;
+        e->hdr.part_sum_a0 = part_sum_a0;
+        e->hdr.part_sum_a8 = part_sum_a8;
+        e->hdr.odd_even = odd_even;
+    } else {
+        free(e->sl);
+    }
+    e->hdr.nonce_hash = ctx->nonce_hash;
+    e->hdr.len = len;
+    e->sl = copy;
 }
 
+// Takes over a persisted list into *sl / *len, filtered with the current bitflip properties
+// unless it was reduced with the very same nonces. Returns false if there is none.
+static bool cand_cache_reuse(hardnested_ctx_t *ctx, uint8_t first_byte, uint8_t part_sum_a0, uint8_t part_sum_a8, odd_even_t odd_even, uint32_t **sl, uint32_t *len) {
+    cand_cache_entry_t *e = cand_cache_find(ctx, first_byte, part_sum_a0, part_sum_a8, odd_even);
+    if (e == NULL) {
+        return false;
+    }
 
-static void add_matching_states(statelist_t *cands, uint8_t part_sum_a0, uint8_t part_sum_a8, odd_even_t odd_even) {
+    __atomic_add_fetch(&ctx->cand_cache_hits, 1, __ATOMIC_RELAXED);
+
+    *sl = NULL;
+    *len = 0;
+    if (e->hdr.len == 0) {
+        return true;
+    }
+
+    uint32_t *list = malloc(sizeof(uint32_t) * (e->hdr.len + 1));
+    if (list == NULL) {
+        return false;
+    }
+
+    uint32_t *p = list;
+    if (e->hdr.nonce_hash == ctx->nonce_hash) {
+        memcpy(list, e->sl, sizeof(uint32_t) * e->hdr.len);
+        p += e->hdr.len;
+    } else {
+        uint32_t *bitset = ctx->nonces[first_byte].states_bitarray[odd_even];
+        for (uint32_t i = 0; i < e->hdr.len; i++) {
+            uint32_t state = e->sl[i];
+            if (test_bit24(bitset, state) && all_bitflips_match(ctx, first_byte, state, odd_even)) {
+                *p++ = state;
+            }
+        }
+    }
+    *p = 0xffffffff;
+    *len = p - list;
+
+    if (*len == 0) {
+        free(list);
+    } else {
+        *sl = list;
+    }
+    return true;
+}
+
+static void cand_cache_load(hardnested_ctx_t *ctx, const char *nonce_filename) {
+    cand_cache_free(ctx);
+    ctx->cand_cache_hits = 0;
+    ctx->nonce_hash = nonce_set_hash(ctx);
+    snprintf(ctx->cand_filename, sizeof(ctx->cand_filename), "%s" CAND_FILE_EXT, nonce_filename);
+
+    if (nonce_file_crc(nonce_filename, UINT32_MAX, &ctx->nonce_file_len, &ctx->nonce_file_hash) == false) {
+        ctx->cand_filename[0] = '\0';
+        return;
+    }
+
+    FILE *f = fopen(ctx->cand_filename, "rb");
+    if (f == NULL) {
+        return;
+    }
+
+    cand_file_hdr_t fh;
+    if (fread(&fh, 1, sizeof(fh), f) != sizeof(fh) || memcmp(fh.magic, CAND_FILE_MAGIC, 8)) {
+        PrintAndLogEx(WARNING, "Ignoring candidate file " _YELLOW_("%s") ", unknown format", ctx->cand_filename);
+        fclose(f);
+        return;
+    }
+    if (fh.cuid != ctx->cuid) {
+        PrintAndLogEx(WARNING, "Ignoring candidate file " _YELLOW_("%s") ", it belongs to another card", ctx->cand_filename);
+        fclose(f);
+        return;
+    }
+    if (fh.trg_block != ctx->trg_block || fh.trg_key != ctx->trg_key) {
+        PrintAndLogEx(WARNING, "Ignoring candidate file " _YELLOW_("%s") ", it belongs to block %u key %c", ctx->cand_filename, fh.trg_block, fh.trg_key ? 'B' : 'A');
+        fclose(f);
+        return;
+    }
+
+    // the nonces the lists were made with must still be in the nonce file
+    uint32_t prefix_len = 0;
+    uint64_t prefix_hash = 0;
+    if (nonce_file_crc(nonce_filename, fh.nonce_file_len, &prefix_len, &prefix_hash) == false ||
+            prefix_len != fh.nonce_file_len || prefix_hash != fh.nonce_file_hash) {
+        PrintAndLogEx(WARNING, "Ignoring candidate file " _YELLOW_("%s") ", it was made with other nonces", ctx->cand_filename);
+        fclose(f);
+        return;
+    }
+
+    for (uint32_t i = 0; i < fh.entries; i++) {
+        cand_entry_hdr_t eh;
+        if (fread(&eh, 1, sizeof(eh), f) != sizeof(eh) || eh.len >= (1 << 24)) {
+            break;
+        }
+        uint32_t *sl = malloc(sizeof(uint32_t) * (eh.len + 1));
+        if (sl == NULL) {
+            break;
+        }
+        if (fread(sl, sizeof(uint32_t), eh.len, f) != eh.len) {
+            free(sl);
+            break;
+        }
+        sl[eh.len] = 0xffffffff;
+
+        cand_cache_entry_t *tmp = realloc(ctx->cand_cache, sizeof(cand_cache_entry_t) * (ctx->cand_cache_len + 1));
+        if (tmp == NULL) {
+            free(sl);
+            break;
+        }
+        ctx->cand_cache = tmp;
+        ctx->cand_cache[ctx->cand_cache_len].hdr = eh;
+        ctx->cand_cache[ctx->cand_cache_len].sl = sl;
+        ctx->cand_cache_len++;
+    }
+    fclose(f);
+
+    char progress_text[80];
+    snprintf(progress_text, sizeof(progress_text), "Loaded %u candidate lists from a run with %u nonces", ctx->cand_cache_len, fh.num_nonces);
+    hardnested_print_progress(ctx, ctx->num_acquired_nonces, progress_text, (float)(1LL << 47), 0);
+}
+
+static void cand_cache_save(hardnested_ctx_t *ctx) {
+    if (ctx->cand_filename[0] == '\0' || ctx->cand_cache_len == 0) {
+        return;
+    }
+
+    FILE *f = fopen(ctx->cand_filename, "wb");
+    if (f == NULL) {
+        PrintAndLogEx(WARNING, "Could not create file " _YELLOW_("%s"), ctx->cand_filename);
+        return;
+    }
+
+    cand_file_hdr_t fh;
+    memcpy(fh.magic, CAND_FILE_MAGIC, 8);
+    fh.cuid = ctx->cuid;
+    fh.trg_block = ctx->trg_block;
+    fh.trg_key = ctx->trg_key;
+    fh.num_nonces = ctx->num_acquired_nonces;
+    fh.entries = ctx->cand_cache_len;
+    fh.nonce_file_len = ctx->nonce_file_len;
+    fh.nonce_file_hash = ctx->nonce_file_hash;
+    fwrite(&fh, 1, sizeof(fh), f);
+    for (uint32_t i = 0; i < ctx->cand_cache_len; i++) {
+        fwrite(&ctx->cand_cache[i].hdr, 1, sizeof(cand_entry_hdr_t), f);
+        if (ctx->cand_cache[i].hdr.len) {
+            fwrite(ctx->cand_cache[i].sl, sizeof(uint32_t), ctx->cand_cache[i].hdr.len, f);
+        }
+    }
+    fclose(f);
+
+    char progress_text[80];
+    snprintf(progress_text, sizeof(progress_text), "Saved %u candidate lists for the next run", ctx->cand_cache_len);
+    hardnested_print_progress(ctx, ctx->num_acquired_nonces, progress_text, 0.0, 0);
+}
+
+static void add_cached_states(hardnested_ctx_t *ctx, statelist_t *cands, uint16_t part_sum_a0, uint16_t part_sum_a8, odd_even_t odd_even) {
+    cands->states[odd_even] = ctx->sl_cache[part_sum_a0 / 2][part_sum_a8 / 2][odd_even].sl;
+    cands->len[odd_even] = ctx->sl_cache[part_sum_a0 / 2][part_sum_a8 / 2][odd_even].len;
+}
+
+
+static void add_matching_states(hardnested_ctx_t *ctx, statelist_t *cands, uint8_t part_sum_a0, uint8_t part_sum_a8, odd_even_t odd_even) {
 
     const uint32_t worstcase_size = 1 << 20;
 
+    if (cand_cache_reuse(ctx, ctx->best_first_bytes[0], part_sum_a0, part_sum_a8, odd_even, &cands->states[odd_even], &cands->len[odd_even])) {
+        pthread_mutex_lock(&ctx->statelist_cache_mutex);
+        ctx->sl_cache[part_sum_a0 / 2][part_sum_a8 / 2][odd_even].sl = cands->states[odd_even];
+        ctx->sl_cache[part_sum_a0 / 2][part_sum_a8 / 2][odd_even].len = cands->len[odd_even];
+        ctx->sl_cache[part_sum_a0 / 2][part_sum_a8 / 2][odd_even].cache_status = COMPLETED;
+        pthread_mutex_unlock(&ctx->statelist_cache_mutex);
+        return;
+    }
+
     cands->states[odd_even] = (uint32_t *)malloc(sizeof(uint32_t) * worstcase_size);
     if (cands->states[odd_even] == NULL) {
         PrintAndLogEx(ERR, "Out of memory error in add_matching_states() - statelist.\n");
@@ -1758,13 +2513,13 @@ static void add_matching_states(statelist_t *cands, uint8_t part_sum_a0, uint8_t
         exit(4);
     }
 
-    uint32_t *bitarray_a0 = part_sum_a0_bitarrays[odd_even][part_sum_a0 / 2];
-    uint32_t *bitarray_a8 = part_sum_a8_bitarrays[odd_even][part_sum_a8 / 2];
-    uint32_t *bitarray_bitflips = nonces[best_first_bytes[0]].states_bitarray[odd_even];
+    uint32_t *bitarray_a0 = ctx->part_sum_a0_bitarrays[odd_even][part_sum_a0 / 2];
+    uint32_t *bitarray_a8 = ctx->part_sum_a8_bitarrays[odd_even][part_sum_a8 / 2];
+    uint32_t *bitarray_bitflips = ctx->nonces[ctx->best_first_bytes[0]].states_bitarray[odd_even];
 
     bitarray_AND4(cands_bitarray, bitarray_a0, bitarray_a8, bitarray_bitflips);
 
-    bitarray_to_list(best_first_bytes[0], cands_bitarray, cands->states[odd_even], &(cands->len[odd_even]), odd_even);
+    bitarray_to_list(ctx, ctx->best_first_bytes[0], cands_bitarray, cands->states[odd_even], &(cands->len[odd_even]), odd_even);
 
     if (cands->len[odd_even] == 0) {
         free(cands->states[odd_even]);
@@ -1774,21 +2529,21 @@ static void add_matching_states(statelist_t *cands, uint8_t part_sum_a0, uint8_t
     }
     free_bitarray(cands_bitarray);
 
-    pthread_mutex_lock(&statelist_cache_mutex);
-    sl_cache[part_sum_a0 / 2][part_sum_a8 / 2][odd_even].sl = cands->states[odd_even];
-    sl_cache[part_sum_a0 / 2][part_sum_a8 / 2][odd_even].len = cands->len[odd_even];
-    sl_cache[part_sum_a0 / 2][part_sum_a8 / 2][odd_even].cache_status = COMPLETED;
-    pthread_mutex_unlock(&statelist_cache_mutex);
+    pthread_mutex_lock(&ctx->statelist_cache_mutex);
+    ctx->sl_cache[part_sum_a0 / 2][part_sum_a8 / 2][odd_even].sl = cands->states[odd_even];
+    ctx->sl_cache[part_sum_a0 / 2][part_sum_a8 / 2][odd_even].len = cands->len[odd_even];
+    ctx->sl_cache[part_sum_a0 / 2][part_sum_a8 / 2][odd_even].cache_status = COMPLETED;
+    pthread_mutex_unlock(&ctx->statelist_cache_mutex);
     return;
 }
 
-static statelist_t *add_more_candidates(void) {
+static statelist_t *add_more_candidates(hardnested_ctx_t *ctx) {
     statelist_t *new_candidates;
-    if (candidates == NULL) {
-        candidates = (statelist_t *)calloc(sizeof(statelist_t), sizeof(uint8_t));
-        new_candidates = candidates;
+    if (ctx->candidates == NULL) {
+        ctx->candidates = (statelist_t *)calloc(sizeof(statelist_t), sizeof(uint8_t));
+        new_candidates = ctx->candidates;
     } else {
-        new_candidates = candidates;
+        new_candidates = ctx->candidates;
         while (new_candidates->next != NULL) {
             new_candidates = new_candidates->next;
         }
@@ -1802,18 +2557,22 @@ static statelist_t *add_more_candidates(void) {
     return new_candidates;
 }
 
-static void add_bitflip_candidates(uint8_t byte) {
-    statelist_t *candidates1 = add_more_candidates();
+static void add_bitflip_candidates(hardnested_ctx_t *ctx, uint8_t byte) {
+    statelist_t *candidates1 = add_more_candidates(ctx);
 
     for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
-        uint32_t worstcase_size = nonces[byte].num_states_bitarray[odd_even] + 1;
+        if (cand_cache_reuse(ctx, byte, CAND_PART_SUM_NONE, CAND_PART_SUM_NONE, odd_even, &candidates1->states[odd_even], &candidates1->len[odd_even])) {
+            continue;
+        }
+
+        uint32_t worstcase_size = ctx->nonces[byte].num_states_bitarray[odd_even] + 1;
         candidates1->states[odd_even] = (uint32_t *)calloc(worstcase_size, sizeof(uint32_t));
         if (candidates1->states[odd_even] == NULL) {
             PrintAndLogEx(ERR, "Out of memory error in add_bitflip_candidates()");
             exit(4);
         }
 
-        bitarray_to_list(byte, nonces[byte].states_bitarray[odd_even], candidates1->states[odd_even], &(candidates1->len[odd_even]), odd_even);
+        bitarray_to_list(ctx, byte, ctx->nonces[byte].states_bitarray[odd_even], candidates1->states[odd_even], &(candidates1->len[odd_even]), odd_even);
 
         // slim down the allocated memory.
         if (candidates1->len[odd_even] + 1 < worstcase_size) {
@@ -1823,16 +2582,16 @@ static void add_bitflip_candidates(uint8_t byte) {
     return;
 }
 
-static bool TestIfKeyExists(uint64_t key) {
+static bool TestIfKeyExists(hardnested_ctx_t *ctx, uint64_t key) {
     struct Crypto1State *pcs;
     pcs = crypto1_create(key);
-    crypto1_byte(pcs, (cuid >> 24) ^ best_first_bytes[0], true);
+    crypto1_byte(pcs, (ctx->cuid >> 24) ^ ctx->best_first_bytes[0], true);
 
     uint32_t state_odd = pcs->odd & 0x00ffffff;
     uint32_t state_even = pcs->even & 0x00ffffff;
 
     uint64_t count = 0;
-    for (statelist_t *p = candidates; p != NULL; p = p->next) {
+    for (statelist_t *p = ctx->candidates; p != NULL; p = p->next) {
         bool found_odd = false;
         bool found_even = false;
         uint32_t *p_odd = p->states[ODD_STATE];
@@ -1854,27 +2613,32 @@ static bool TestIfKeyExists(uint64_t key) {
             count += (uint64_t)(p_odd - p->states[ODD_STATE]) * (uint64_t)(p_even - p->states[EVEN_STATE]);
         }
         if (found_odd && found_even) {
-            num_keys_tested += count;
-            hardnested_print_progress(num_acquired_nonces, "(Test: Key found)", 0.0, 0);
+            ctx->num_keys_tested += count;
+            hardnested_print_progress(ctx, ctx->num_acquired_nonces, "(Test: Key found)", 0.0, 0);
             crypto1_destroy(pcs);
             return true;
         }
     }
 
-    num_keys_tested += count;
-    hardnested_print_progress(num_acquired_nonces, "(Test: Key NOT found)", 0.0, 0);
+    ctx->num_keys_tested += count;
+    hardnested_print_progress(ctx, ctx->num_acquired_nonces, "(Test: Key NOT found)", 0.0, 0);
     crypto1_destroy(pcs);
     return false;
 }
 
-static work_status_t book_of_work[NUM_PART_SUMS][NUM_PART_SUMS][NUM_PART_SUMS][NUM_PART_SUMS];
+typedef struct {
+    hardnested_ctx_t *ctx;
+    uint16_t sum_a0_idx;
+    uint16_t sum_a8_idx;
+    uint16_t thread_number;
+} generate_candidates_args_t;
 
-static void init_book_of_work(void) {
+static void init_book_of_work(hardnested_ctx_t *ctx) {
     for (uint8_t p = 0; p < NUM_PART_SUMS; p++) {
         for (uint8_t q = 0; q < NUM_PART_SUMS; q++) {
             for (uint8_t r = 0; r < NUM_PART_SUMS; r++) {
                 for (uint8_t s = 0; s < NUM_PART_SUMS; s++) {
-                    book_of_work[p][q][r][s] = TO_BE_DONE;
+                    ctx->book_of_work[p][q][r][s] = TO_BE_DONE;
                 }
             }
         }
@@ -1888,10 +2652,11 @@ __attribute__((force_align_arg_pointer))
 #endif
 #endif
 *generate_candidates_worker_thread(void *args) {
-    uint16_t *sum_args = (uint16_t *)args;
-    uint16_t sum_a0 = sums[sum_args[0]];
-    uint16_t sum_a8 = sums[sum_args[1]];
-    // uint16_t my_thread_number = sums[2];
+    generate_candidates_args_t *thread_args = (generate_candidates_args_t *)args;
+    hardnested_ctx_t *ctx = thread_args->ctx;
+    uint16_t sum_a0 = sums[thread_args->sum_a0_idx];
+    uint16_t sum_a8 = sums[thread_args->sum_a8_idx];
+    // uint16_t my_thread_number = thread_args->thread_number;
 
     bool there_might_be_more_work = true;
     do {
@@ -1904,34 +2669,34 @@ __attribute__((force_align_arg_pointer))
                     for (uint8_t r = 0; r < NUM_PART_SUMS; r++) {
                         for (uint8_t s = 0; s < NUM_PART_SUMS; s++) {
                             if (2 * r * (16 - 2 * s) + (16 - 2 * r) * 2 * s == sum_a8) {
-                                pthread_mutex_lock(&book_of_work_mutex);
-                                if (book_of_work[p][q][r][s] != TO_BE_DONE) {  // this has been done or is currently been done by another thread. Look for some other work.
-                                    pthread_mutex_unlock(&book_of_work_mutex);
+                                pthread_mutex_lock(&ctx->book_of_work_mutex);
+                                if (ctx->book_of_work[p][q][r][s] != TO_BE_DONE) {  // this has been done or is currently been done by another thread. Look for some other work.
+                                    pthread_mutex_unlock(&ctx->book_of_work_mutex);
                                     continue;
                                 }
 
-                                pthread_mutex_lock(&statelist_cache_mutex);
-                                if (sl_cache[p][r][ODD_STATE].cache_status == WORK_IN_PROGRESS
-                                        || sl_cache[q][s][EVEN_STATE].cache_status == WORK_IN_PROGRESS) { // defer until not blocked by another thread.
-                                    pthread_mutex_unlock(&statelist_cache_mutex);
-                                    pthread_mutex_unlock(&book_of_work_mutex);
+                                pthread_mutex_lock(&ctx->statelist_cache_mutex);
+                                if (ctx->sl_cache[p][r][ODD_STATE].cache_status == WORK_IN_PROGRESS
+                                        || ctx->sl_cache[q][s][EVEN_STATE].cache_status == WORK_IN_PROGRESS) { // defer until not blocked by another thread.
+                                    pthread_mutex_unlock(&ctx->statelist_cache_mutex);
+                                    pthread_mutex_unlock(&ctx->book_of_work_mutex);
                                     there_might_be_more_work = true;
                                     continue;
                                 }
 
                                 // we finally can do some work.
-                                book_of_work[p][q][r][s] = WORK_IN_PROGRESS;
-                                statelist_t *current_candidates = add_more_candidates();
+                                ctx->book_of_work[p][q][r][s] = WORK_IN_PROGRESS;
+                                statelist_t *current_candidates = add_more_candidates(ctx);
 
                                 // Check for cached results and add them first
                                 bool odd_completed = false;
-                                if (sl_cache[p][r][ODD_STATE].cache_status == COMPLETED) {
-                                    add_cached_states(current_candidates, 2 * p, 2 * r, ODD_STATE);
+                                if (ctx->sl_cache[p][r][ODD_STATE].cache_status == COMPLETED) {
+                                    add_cached_states(ctx, current_candidates, 2 * p, 2 * r, ODD_STATE);
                                     odd_completed = true;
                                 }
                                 bool even_completed = false;
-                                if (sl_cache[q][s][EVEN_STATE].cache_status == COMPLETED) {
-                                    add_cached_states(current_candidates, 2 * q, 2 * s, EVEN_STATE);
+                                if (ctx->sl_cache[q][s][EVEN_STATE].cache_status == COMPLETED) {
+                                    add_cached_states(ctx, current_candidates, 2 * q, 2 * s, EVEN_STATE);
                                     even_completed = true;
                                 }
 
@@ -1957,50 +2722,50 @@ __attribute__((force_align_arg_pointer))
                                 }
 
                                 if (work_required == false) {
-                                    pthread_mutex_unlock(&statelist_cache_mutex);
-                                    pthread_mutex_unlock(&book_of_work_mutex);
+                                    pthread_mutex_unlock(&ctx->statelist_cache_mutex);
+                                    pthread_mutex_unlock(&ctx->book_of_work_mutex);
                                 } else {
                                     // we really need to calculate something
                                     if (even_completed) { // we had one cache hit with non-zero even states
                                         // PrintAndLogEx(INFO, "Thread #%u: start working on  odd states p=%2d, r=%2d...", my_thread_number, p, r);
-                                        sl_cache[p][r][ODD_STATE].cache_status = WORK_IN_PROGRESS;
-                                        pthread_mutex_unlock(&statelist_cache_mutex);
-                                        pthread_mutex_unlock(&book_of_work_mutex);
-                                        add_matching_states(current_candidates, 2 * p, 2 * r, ODD_STATE);
+                                        ctx->sl_cache[p][r][ODD_STATE].cache_status = WORK_IN_PROGRESS;
+                                        pthread_mutex_unlock(&ctx->statelist_cache_mutex);
+                                        pthread_mutex_unlock(&ctx->book_of_work_mutex);
+                                        add_matching_states(ctx, current_candidates, 2 * p, 2 * r, ODD_STATE);
                                         work_required = false;
                                     } else if (odd_completed) { // we had one cache hit with non-zero odd_states
                                         // PrintAndLogEx(INFO, "Thread #%u: start working on even states q=%2d, s=%2d...", my_thread_number, q, s);
-                                        sl_cache[q][s][EVEN_STATE].cache_status = WORK_IN_PROGRESS;
-                                        pthread_mutex_unlock(&statelist_cache_mutex);
-                                        pthread_mutex_unlock(&book_of_work_mutex);
-                                        add_matching_states(current_candidates, 2 * q, 2 * s, EVEN_STATE);
+                                        ctx->sl_cache[q][s][EVEN_STATE].cache_status = WORK_IN_PROGRESS;
+                                        pthread_mutex_unlock(&ctx->statelist_cache_mutex);
+                                        pthread_mutex_unlock(&ctx->book_of_work_mutex);
+                                        add_matching_states(ctx, current_candidates, 2 * q, 2 * s, EVEN_STATE);
                                         work_required = false;
                                     }
                                 }
 
                                 if (work_required) { // we had no cached result. Need to calculate both odd and even
-                                    sl_cache[p][r][ODD_STATE].cache_status = WORK_IN_PROGRESS;
-                                    sl_cache[q][s][EVEN_STATE].cache_status = WORK_IN_PROGRESS;
-                                    pthread_mutex_unlock(&statelist_cache_mutex);
-                                    pthread_mutex_unlock(&book_of_work_mutex);
+                                    ctx->sl_cache[p][r][ODD_STATE].cache_status = WORK_IN_PROGRESS;
+                                    ctx->sl_cache[q][s][EVEN_STATE].cache_status = WORK_IN_PROGRESS;
+                                    pthread_mutex_unlock(&ctx->statelist_cache_mutex);
+                                    pthread_mutex_unlock(&ctx->book_of_work_mutex);
 
-                                    add_matching_states(current_candidates, 2 * p, 2 * r, ODD_STATE);
+                                    add_matching_states(ctx, current_candidates, 2 * p, 2 * r, ODD_STATE);
                                     if (current_candidates->len[ODD_STATE]) {
                                         // PrintAndLogEx(INFO, "Thread #%u: start working on even states q=%2d, s=%2d...", my_thread_number, q, s);
-                                        add_matching_states(current_candidates, 2 * q, 2 * s, EVEN_STATE);
+                                        add_matching_states(ctx, current_candidates, 2 * q, 2 * s, EVEN_STATE);
                                     } else { // no need to calculate even states yet
-                                        pthread_mutex_lock(&statelist_cache_mutex);
-                                        sl_cache[q][s][EVEN_STATE].cache_status = TO_BE_DONE;
-                                        pthread_mutex_unlock(&statelist_cache_mutex);
+                                        pthread_mutex_lock(&ctx->statelist_cache_mutex);
+                                        ctx->sl_cache[q][s][EVEN_STATE].cache_status = TO_BE_DONE;
+                                        pthread_mutex_unlock(&ctx->statelist_cache_mutex);
                                         current_candidates->len[EVEN_STATE] = 0;
                                         current_candidates->states[EVEN_STATE] = NULL;
                                     }
                                 }
 
                                 // update book of work
-                                pthread_mutex_lock(&book_of_work_mutex);
-                                book_of_work[p][q][r][s] = COMPLETED;
-                                pthread_mutex_unlock(&book_of_work_mutex);
+                                pthread_mutex_lock(&ctx->book_of_work_mutex);
+                                ctx->book_of_work[p][q][r][s] = COMPLETED;
+                                pthread_mutex_unlock(&ctx->book_of_work_mutex);
 
                                 // if ((uint64_t)current_candidates->len[ODD_STATE] * current_candidates->len[EVEN_STATE]) {
                                 // PrintAndLogEx(INFO, "Candidates for p=%2u, q=%2u, r=%2u, s=%2u: %" PRIu32 " * %" PRIu32 " = %" PRIu64 " (2^%0.1f)\n",
@@ -2028,24 +2793,21 @@ __attribute__((force_align_arg_pointer))
 }
 
 
-static void generate_candidates(uint8_t sum_a0_idx, uint8_t sum_a8_idx) {
-
-    // create mutexes for accessing the statelist cache and our "book of work"
-    pthread_mutex_init(&statelist_cache_mutex, NULL);
-    pthread_mutex_init(&book_of_work_mutex, NULL);
+static void generate_candidates(hardnested_ctx_t *ctx, uint8_t sum_a0_idx, uint8_t sum_a8_idx) {
 
-    init_statelist_cache();
-    init_book_of_work();
+    init_statelist_cache(ctx);
+    init_book_of_work(ctx);
 
     // create and run worker threads
     pthread_t thread_id[NUM_REDUCTION_WORKING_THREADS];
 
-    uint16_t sums1[NUM_REDUCTION_WORKING_THREADS][3];
+    generate_candidates_args_t sums1[NUM_REDUCTION_WORKING_THREADS];
     for (uint32_t i = 0; i < NUM_REDUCTION_WORKING_THREADS; i++) {
-        sums1[i][0] = sum_a0_idx;
-        sums1[i][1] = sum_a8_idx;
-        sums1[i][2] = i + 1;
-        pthread_create(thread_id + i, NULL, generate_candidates_worker_thread, sums1[i]);
+        sums1[i].ctx = ctx;
+        sums1[i].sum_a0_idx = sum_a0_idx;
+        sums1[i].sum_a8_idx = sum_a8_idx;
+        sums1[i].thread_number = i + 1;
+        pthread_create(thread_id + i, NULL, generate_candidates_worker_thread, &sums1[i]);
     }
 
     // wait for threads to terminate:
@@ -2053,20 +2815,37 @@ static void generate_candidates(uint8_t sum_a0_idx, uint8_t sum_a8_idx) {
         pthread_join(thread_id[i], NULL);
     }
 
-    maximum_states = 0;
-    for (statelist_t *sl = candidates; sl != NULL; sl = sl->next) {
-        maximum_states += (uint64_t)sl->len[ODD_STATE] * sl->len[EVEN_STATE];
+    ctx->maximum_states = 0;
+    for (statelist_t *sl = ctx->candidates; sl != NULL; sl = sl->next) {
+        ctx->maximum_states += (uint64_t)sl->len[ODD_STATE] * sl->len[EVEN_STATE];
     }
 
     for (uint8_t i = 0; i < NUM_SUMS; i++) {
-        if (nonces[best_first_bytes[0]].sum_a8_guess[i].sum_a8_idx == sum_a8_idx) {
-            nonces[best_first_bytes[0]].sum_a8_guess[i].num_states = maximum_states;
+        if (ctx->nonces[ctx->best_first_bytes[0]].sum_a8_guess[i].sum_a8_idx == sum_a8_idx) {
+            ctx->nonces[ctx->best_first_bytes[0]].sum_a8_guess[i].num_states = ctx->maximum_states;
             break;
         }
     }
-    update_expected_brute_force(best_first_bytes[0]);
+    update_expected_brute_force(ctx, ctx->best_first_bytes[0]);
 
-    hardnested_print_progress(num_acquired_nonces, "Apply Sum(a8) and all bytes bitflip properties", nonces[best_first_bytes[0]].expected_num_brute_force, 0);
+    hardnested_print_progress(ctx, ctx->num_acquired_nonces, "Apply Sum(a8) and all bytes bitflip properties", ctx->nonces[ctx->best_first_bytes[0]].expected_num_brute_force, 0);
+}
+
+// keep the lists of the last Sum(a8) guess for a later run with more nonces
+static void cand_cache_harvest(hardnested_ctx_t *ctx) {
+    if (ctx->cand_filename[0] == '\0') {
+        return;
+    }
+    for (uint16_t i = 0; i < NUM_PART_SUMS; i++) {
+        for (uint16_t j = 0; j < NUM_PART_SUMS; j++) {
+            for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
+                sl_cache_entry_t *e = &ctx->sl_cache[i][j][odd_even];
+                if (e->cache_status == COMPLETED) {
+                    cand_cache_put(ctx, ctx->best_first_bytes[0], 2 * i, 2 * j, odd_even, e->sl, e->len);
+                }
+            }
+        }
+    }
 }
 
 static void free_candidates_memory(statelist_t *sl) {
@@ -2079,28 +2858,28 @@ static void free_candidates_memory(statelist_t *sl) {
     free(sl);
 }
 
-static void pre_XOR_nonces(void) {
+static void pre_XOR_nonces(hardnested_ctx_t *ctx) {
     // prepare acquired nonces for faster brute forcing.
 
     // XOR the cryptoUID and its parity
     for (uint16_t i = 0; i < 256; i++) {
-        noncelistentry_t *test_nonce = nonces[i].first;
+        noncelistentry_t *test_nonce = ctx->nonces[i].first;
         while (test_nonce != NULL) {
-            test_nonce->nonce_enc ^= cuid;
-            test_nonce->par_enc ^= oddparity8(cuid >>  0 & 0xff) << 0;
-            test_nonce->par_enc ^= oddparity8(cuid >>  8 & 0xff) << 1;
-            test_nonce->par_enc ^= oddparity8(cuid >> 16 & 0xff) << 2;
-            test_nonce->par_enc ^= oddparity8(cuid >> 24 & 0xff) << 3;
+            test_nonce->nonce_enc ^= ctx->cuid;
+            test_nonce->par_enc ^= oddparity8(ctx->cuid >>  0 & 0xff) << 0;
+            test_nonce->par_enc ^= oddparity8(ctx->cuid >>  8 & 0xff) << 1;
+            test_nonce->par_enc ^= oddparity8(ctx->cuid >> 16 & 0xff) << 2;
+            test_nonce->par_enc ^= oddparity8(ctx->cuid >> 24 & 0xff) << 3;
             test_nonce = test_nonce->next;
         }
     }
 }
 
-static bool brute_force(uint64_t *found_key) {
-    if (known_target_key != -1) {
-        TestIfKeyExists(known_target_key);
+static bool brute_force(hardnested_ctx_t *ctx, uint64_t *found_key) {
+    if (ctx->known_target_key != -1) {
+        TestIfKeyExists(ctx, ctx->known_target_key);
     }
-    return brute_force_bs(NULL, candidates, cuid, num_acquired_nonces, maximum_states, nonces, best_first_bytes, found_key);
+    return brute_force_bs(ctx, ctx->candidates, ctx->cuid, ctx->num_acquired_nonces, ctx->maximum_states, ctx->nonces, ctx->best_first_bytes, found_key);
 }
 
 static uint16_t SumProperty(struct Crypto1State *s) {
@@ -2109,349 +2888,384 @@ static uint16_t SumProperty(struct Crypto1State *s) {
     return (sum_odd * (16 - sum_even) + (16 - sum_odd) * sum_even);
 }
 
-static void Tests(void) {
+static void Tests(hardnested_ctx_t *ctx) {
 
-    if (known_target_key == -1)
+    if (ctx->known_target_key == -1)
         return;
 
     for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
-        uint32_t *bitset = nonces[best_first_bytes[0]].states_bitarray[odd_even];
-        if (!test_bit24(bitset, test_state[odd_even])) {
+        uint32_t *bitset = ctx->nonces[ctx->best_first_bytes[0]].states_bitarray[odd_even];
+        if (!test_bit24(bitset, ctx->test_state[odd_even])) {
             PrintAndLogEx(WARNING, "BUG: known target key's " _YELLOW_("%s") " state is not member of first nonce byte's ( 0x%02x ) states_bitarray!",
                           odd_even == EVEN_STATE ? "even" : "odd ",
-                          best_first_bytes[0]);
+                          ctx->best_first_bytes[0]);
         }
     }
     for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
-        uint32_t *bitset = all_bitflips_bitarray[odd_even];
-        if (!test_bit24(bitset, test_state[odd_even])) {
+        uint32_t *bitset = ctx->all_bitflips_bitarray[odd_even];
+        if (!test_bit24(bitset, ctx->test_state[odd_even])) {
             PrintAndLogEx(WARNING, "BUG: known target key's " _YELLOW_("%s") " state is not member of all_bitflips_bitarray!",
                           odd_even == EVEN_STATE ? "even" : "odd ");
         }
     }
 }
 
-static void Tests2(void) {
+static void Tests2(hardnested_ctx_t *ctx) {
 
-    if (known_target_key == -1)
+    if (ctx->known_target_key == -1)
         return;
 
     for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
-        uint32_t *bitset = nonces[best_first_byte_smallest_bitarray].states_bitarray[odd_even];
-        if (!test_bit24(bitset, test_state[odd_even])) {
+        uint32_t *bitset = ctx->nonces[ctx->best_first_byte_smallest_bitarray].states_bitarray[odd_even];
+        if (!test_bit24(bitset, ctx->test_state[odd_even])) {
             PrintAndLogEx(WARNING, "BUG: known target key's " _YELLOW_("%s") " state is not member of first nonce byte's ( 0x%02x ) states_bitarray!",
                           odd_even == EVEN_STATE ? "even" : "odd ",
-                          best_first_byte_smallest_bitarray);
+                          ctx->best_first_byte_smallest_bitarray);
         }
     }
 
     for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
-        uint32_t *bitset = all_bitflips_bitarray[odd_even];
-        if (!test_bit24(bitset, test_state[odd_even])) {
+        uint32_t *bitset = ctx->all_bitflips_bitarray[odd_even];
+        if (!test_bit24(bitset, ctx->test_state[odd_even])) {
             PrintAndLogEx(WARNING, "BUG: known target key's " _YELLOW_("%s") " state is not member of all_bitflips_bitarray!",
                           odd_even == EVEN_STATE ? "even" : "odd ");
         }
     }
 }
 
-static uint16_t real_sum_a8 = 0;
-
-static void set_test_state(uint8_t byte) {
+static void set_test_state(hardnested_ctx_t *ctx, uint8_t byte) {
     struct Crypto1State *pcs;
-    pcs = crypto1_create(known_target_key);
-    crypto1_byte(pcs, (cuid >> 24) ^ byte, true);
-    test_state[ODD_STATE] = pcs->odd & 0x00ffffff;
-    test_state[EVEN_STATE] = pcs->even & 0x00ffffff;
-    real_sum_a8 = SumProperty(pcs);
+    pcs = crypto1_create(ctx->known_target_key);
+    crypto1_byte(pcs, (ctx->cuid >> 24) ^ byte, true);
+    ctx->test_state[ODD_STATE] = pcs->odd & 0x00ffffff;
+    ctx->test_state[EVEN_STATE] = pcs->even & 0x00ffffff;
+    ctx->real_sum_a8 = SumProperty(pcs);
     crypto1_destroy(pcs);
 }
 
-static void init_it_all(void) {
-    memset(nonces, 0, sizeof(nonces));
-    maximum_states = 0;
-    best_first_byte_smallest_bitarray = 0;
-    first_byte_Sum = 0;
-    first_byte_num = 0;
-    write_stats = false;
-    all_bitflips_bitarray[0] = NULL;
-    all_bitflips_bitarray[1] = NULL;
-    num_all_bitflips_bitarray[0] = 0;
-    num_all_bitflips_bitarray[1] = 0;
-    all_bitflips_bitarray_dirty[0] = false;
-    all_bitflips_bitarray_dirty[1] = false;
-    last_sample_clock = 0;
-    sample_period = 0;
-    num_keys_tested = 0;
-    candidates = NULL;
-    num_acquired_nonces = 0;
-    start_time = 0;
-    num_effective_bitflips[0] = 0;
-    num_effective_bitflips[1] = 0;
-    num_all_effective_bitflips = 0;
-    num_1st_byte_effective_bitflips = 0;
-    hardnested_stage = CHECK_1ST_BYTES;
-    known_target_key = 0;
-    test_state[0] = 0;
-    test_state[1] = 0;
-    brute_force_per_second = 0;
-    init_book_of_work();
-    real_sum_a8 = 0;
-
-    memset(effective_bitflip, 0, sizeof(effective_bitflip));
-    memset(all_effective_bitflip, 0, sizeof(all_effective_bitflip));
-    memset(bitflip_bitarrays, 0, sizeof(bitflip_bitarrays));
-    memset(count_bitflip_bitarrays, 0, sizeof(count_bitflip_bitarrays));
-    memset(part_sum_a0_bitarrays, 0, sizeof(part_sum_a0_bitarrays));
-    memset(part_sum_a8_bitarrays, 0, sizeof(part_sum_a8_bitarrays));
-    memset(sum_a0_bitarrays, 0, sizeof(sum_a0_bitarrays));
-}
-
-int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *trgkey, bool nonce_file_read, bool nonce_file_write, bool slow, int tests, uint64_t *foundkey, char *filename) {
-    char progress_text[80];
-    char instr_set[12] = {0};
+// Approximate memory of one attack, the 2 x 256 per first byte state bitarrays dominate
+#define HARDNESTED_CTX_MEM      ((uint64_t)(2 * 256 + 2 * 2 * NUM_PART_SUMS + 2 * NUM_SUMS + 2) * (sizeof(uint32_t) << 19))
+
+// Memory the system can hand out without swapping. MemAvailable counts the reclaimable page cache,
+// the free pages alone (_SC_AVPHYS_PAGES) are mostly eaten by the cache and leave room for one attack
+static uint64_t hardnested_mem_available(void) {
+    FILE *f = fopen("/proc/meminfo", "r");
+    if (f != NULL) {
+        char line[128];
+        unsigned long long kb = 0;
+        bool found = false;
+        while (fgets(line, sizeof(line), f) != NULL) {
+            if (sscanf(line, "MemAvailable: %llu kB", &kb) == 1) {
+                found = true;
+                break;
+            }
+        }
+        fclose(f);
+        if (found) {
+            return (uint64_t)kb * 1024;
+        }
+    }
+#if defined(_SC_AVPHYS_PAGES)
+    long pages = sysconf(_SC_AVPHYS_PAGES);
+    long pagesize = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && pagesize > 0) {
+        return (uint64_t)pages * pagesize;
+    }
+#endif
+    return 0;
+}
 
-    get_SIMD_instruction_set(instr_set);
+uint32_t hardnested_max_parallel(void) {
+    uint64_t n = hardnested_mem_available() / HARDNESTED_CTX_MEM;
+    return (n > 1) ? (uint32_t)MIN(n, UINT32_MAX) : 1;
+}
 
-    // initialize static arrays
-    memset(part_sum_count, 0, sizeof(part_sum_count));
-    init_it_all();
+hardnested_ctx_t *hardnested_ctx_new(const char *label) {
+    hardnested_ctx_t *ctx = calloc(1, sizeof(hardnested_ctx_t));
+    if (ctx == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return NULL;
+    }
+    if (label != NULL) {
+        snprintf(ctx->label, sizeof(ctx->label), "%s", label);
+    }
+    ctx->hardnested_stage = CHECK_1ST_BYTES;
+    ctx->known_target_key = -1;
+    ctx->samples_per_step = 1;
+    ctx->p_K = p_K0;
+    pthread_mutex_init(&ctx->statelist_cache_mutex, NULL);
+    pthread_mutex_init(&ctx->book_of_work_mutex, NULL);
+    init_book_of_work(ctx);
+    return ctx;
+}
 
-    srand((unsigned) time(NULL));
-    brute_force_per_second = brute_force_benchmark();
-    write_stats = false;
+static void free_attack_memory(hardnested_ctx_t *ctx) {
+    free_bitflip_bitarrays(ctx);
+    if (ctx->attack_memory_allocated) {
+        free_nonces_memory(ctx);
+        free_bitarray(ctx->all_bitflips_bitarray[ODD_STATE]);
+        free_bitarray(ctx->all_bitflips_bitarray[EVEN_STATE]);
+        free_sum_bitarrays(ctx);
+        free_part_sum_bitarrays(ctx);
+        ctx->attack_memory_allocated = false;
+    }
+    cand_cache_free(ctx);
+}
 
-    if (tests) {
-        // set the correct locale for the stats printing
-        write_stats = true;
-        setlocale(LC_NUMERIC, "");
-        if ((fstats = fopen("hardnested_stats.txt", "a")) == NULL) {
-            PrintAndLogEx(WARNING, "Could not create/open file " _YELLOW_("hardnested_stats.txt"));
-            return PM3_EFILE;
-        }
+void hardnested_ctx_free(hardnested_ctx_t *ctx) {
+    if (ctx == NULL) {
+        return;
+    }
+    free_attack_memory(ctx);
+    pthread_mutex_destroy(&ctx->statelist_cache_mutex);
+    pthread_mutex_destroy(&ctx->book_of_work_mutex);
+    free(ctx);
+}
 
-        for (uint32_t i = 0; i < tests; i++) {
-            start_time = msclock();
-            print_progress_header();
-            sprintf(progress_text, "Brute force benchmark: %1.0f million (2^%1.1f) keys/s", brute_force_per_second / 1000000, log(brute_force_per_second) / log(2.0));
-            hardnested_print_progress(0, progress_text, (float)(1LL << 47), 0);
-            sprintf(progress_text, "Starting Test #%" PRIu32 " ...", i + 1);
-            hardnested_print_progress(0, progress_text, (float)(1LL << 47), 0);
+// benchmark, print the header and allocate everything needed to collect nonces
+static void init_attack(hardnested_ctx_t *ctx) {
+    char progress_text[80];
+    ctx->brute_force_per_second = brute_force_benchmark();
+    ctx->start_time = msclock();
+    print_progress_header(ctx);
+    sprintf(progress_text, "Brute force benchmark: %1.0f million (2^%1.1f) keys/s", ctx->brute_force_per_second / 1000000, log(ctx->brute_force_per_second) / log(2.0));
+    hardnested_print_progress(ctx, 0, progress_text, (float)(1LL << 47), 0);
+}
+
+static void init_attack_memory(hardnested_ctx_t *ctx) {
+    init_bitflip_bitarrays(ctx);
+    init_part_sum_bitarrays(ctx);
+    init_sum_bitarrays(ctx);
+    init_allbitflips_array(ctx);
+    init_nonce_memory(ctx);
+    ctx->attack_memory_allocated = true;
+    update_reduction_rate(ctx, 0.0, true);
+}
+
+int hardnested_acquire(hardnested_ctx_t *ctx, uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, bool nonce_file_write, bool slow, char *filename) {
+    init_attack(ctx);
+    init_attack_memory(ctx);
+    int res = acquire_nonces(ctx, blockNo, keyType, key, trgBlockNo, trgKeyType, nonce_file_write, slow, filename);
+    if (res != 0) {
+        free_attack_memory(ctx);
+        return res;
+    }
+    ctx->trg_block = trgBlockNo;
+    ctx->trg_key = trgKeyType;
+    // the tables are not needed for the brute force phase. Let other attacks have the memory.
+    free_bitflip_bitarrays(ctx);
+    // lists stored by an earlier run on this file are only used when it was appended to
+    if (nonce_file_write) {
+        cand_cache_load(ctx, filename);
+    }
+    return res;
+}
 
-            if (trgkey != NULL) {
-                known_target_key = bytes_to_num(trgkey, 6);
-            } else {
-                known_target_key = -1;
-            }
+int hardnested_read_nonces(hardnested_ctx_t *ctx, char *filename) {
+    init_attack(ctx);
+    init_attack_memory(ctx);
+    if (read_nonce_file(ctx, filename) != 0) {
+        free_attack_memory(ctx);
+        return 3;
+    }
+    ctx->hardnested_stage = CHECK_1ST_BYTES | CHECK_2ND_BYTES;
+    update_nonce_data(ctx, false);
+    float brute_force_depth;
+    shrink_key_space(ctx, &brute_force_depth);
+    free_bitflip_bitarrays(ctx);
+    cand_cache_load(ctx, filename);
+    return PM3_SUCCESS;
+}
 
-            init_bitflip_bitarrays();
-            init_part_sum_bitarrays();
-            init_sum_bitarrays();
-            init_allbitflips_array();
-            init_nonce_memory();
-            update_reduction_rate(0.0, true);
+// a known target key turns on the key space checks (Tests) and the Sum(a8) verification
+void hardnested_set_nonce_file_mode(hardnested_ctx_t *ctx, uint8_t mode) {
+    ctx->nonce_file_mode = mode;
+}
 
-            if (simulate_acquire_nonces() != PM3_SUCCESS) {
-                return 3;
-            }
+void hardnested_set_target_key(hardnested_ctx_t *ctx, uint8_t *trgkey) {
+    ctx->known_target_key = (trgkey != NULL) ? bytes_to_num(trgkey, 6) : -1;
+}
 
-            set_test_state(best_first_bytes[0]);
+bool hardnested_crack(hardnested_ctx_t *ctx, uint64_t *foundkey) {
+    char progress_text[80];
 
-            Tests();
-            free_bitflip_bitarrays();
+    if (ctx->attack_memory_allocated == false) {
+        return false;
+    }
 
-            fprintf(fstats, "%" PRIu16 ";%1.1f;", sums[first_byte_Sum], log(p_K0[first_byte_Sum]) / log(2.0));
-            fprintf(fstats, "%" PRIu16 ";%1.1f;", sums[nonces[best_first_bytes[0]].sum_a8_guess[0].sum_a8_idx], log(p_K[nonces[best_first_bytes[0]].sum_a8_guess[0].sum_a8_idx]) / log(2.0));
-            fprintf(fstats, "%" PRIu16 ";", real_sum_a8);
+    if (ctx->known_target_key != -1) {
+        set_test_state(ctx, ctx->best_first_bytes[0]);
+    }
 
-#ifdef DEBUG_KEY_ELIMINATION
-            failstr[0] = '\0';
-#endif
-            bool key_found = false;
-            num_keys_tested = 0;
-            uint32_t num_odd = nonces[best_first_byte_smallest_bitarray].num_states_bitarray[ODD_STATE];
-            uint32_t num_even = nonces[best_first_byte_smallest_bitarray].num_states_bitarray[EVEN_STATE];
-            float expected_brute_force1 = (float)num_odd * num_even / 2.0;
-            float expected_brute_force2 = nonces[best_first_bytes[0]].expected_num_brute_force;
-            fprintf(fstats, "%1.1f;%1.1f;", log(expected_brute_force1) / log(2.0), log(expected_brute_force2) / log(2.0));
-
-            if (expected_brute_force1 < expected_brute_force2) {
-                hardnested_print_progress(num_acquired_nonces, "(Ignoring Sum(a8) properties)", expected_brute_force1, 0);
-                set_test_state(best_first_byte_smallest_bitarray);
-                add_bitflip_candidates(best_first_byte_smallest_bitarray);
-                Tests2();
-                maximum_states = 0;
-                for (statelist_t *sl = candidates; sl != NULL; sl = sl->next) {
-                    maximum_states += (uint64_t)sl->len[ODD_STATE] * sl->len[EVEN_STATE];
-                }
+    Tests(ctx);
+    free_bitflip_bitarrays(ctx);
 
-                best_first_bytes[0] = best_first_byte_smallest_bitarray;
-                pre_XOR_nonces();
-                prepare_bf_test_nonces(nonces, best_first_bytes[0]);
+    if (ctx->write_stats) {
+        fprintf(ctx->fstats, "%" PRIu16 ";%1.1f;", sums[ctx->first_byte_Sum], log(p_K0[ctx->first_byte_Sum]) / log(2.0));
+        fprintf(ctx->fstats, "%" PRIu16 ";%1.1f;", sums[ctx->nonces[ctx->best_first_bytes[0]].sum_a8_guess[0].sum_a8_idx], log(ctx->p_K[ctx->nonces[ctx->best_first_bytes[0]].sum_a8_guess[0].sum_a8_idx]) / log(2.0));
+        fprintf(ctx->fstats, "%" PRIu16 ";", ctx->real_sum_a8);
+    }
 
-                key_found = brute_force(foundkey);
-                free(candidates->states[ODD_STATE]);
-                free(candidates->states[EVEN_STATE]);
-                free_candidates_memory(candidates);
-                candidates = NULL;
-            } else {
-                pre_XOR_nonces();
-                prepare_bf_test_nonces(nonces, best_first_bytes[0]);
-                for (uint8_t j = 0; j < NUM_SUMS && !key_found; j++) {
-                    float expected_brute_force = nonces[best_first_bytes[0]].expected_num_brute_force;
-                    sprintf(progress_text, "(%d. guess: Sum(a8) = %" PRIu16 ")", j + 1, sums[nonces[best_first_bytes[0]].sum_a8_guess[j].sum_a8_idx]);
-                    hardnested_print_progress(num_acquired_nonces, progress_text, expected_brute_force, 0);
-                    if (sums[nonces[best_first_bytes[0]].sum_a8_guess[j].sum_a8_idx] != real_sum_a8) {
-                        sprintf(progress_text, "(Estimated Sum(a8) is WRONG! Correct Sum(a8) = %" PRIu16 ")", real_sum_a8);
-                        hardnested_print_progress(num_acquired_nonces, progress_text, expected_brute_force, 0);
-                    }
-                    generate_candidates(first_byte_Sum, nonces[best_first_bytes[0]].sum_a8_guess[j].sum_a8_idx);
-
-                    key_found = brute_force(foundkey);
-                    free_statelist_cache();
-                    free_candidates_memory(candidates);
-                    candidates = NULL;
-                    if (!key_found) {
-                        // update the statistics
-                        nonces[best_first_bytes[0]].sum_a8_guess[j].prob = 0;
-                        nonces[best_first_bytes[0]].sum_a8_guess[j].num_states = 0;
-                        // and calculate new expected number of brute forces
-                        update_expected_brute_force(best_first_bytes[0]);
-                    }
-                }
-            }
 #ifdef DEBUG_KEY_ELIMINATION
-            fprintf(fstats, "%1.1f;%1.0f;%c;%s\n",
-                    log(num_keys_tested) / log(2.0),
-                    (float)num_keys_tested / brute_force_per_second,
-                    key_found ? 'Y' : 'N',
-                    failstr
-                   );
-#else
-            fprintf(fstats, "%1.0f;%d\n",
-                    log(num_keys_tested) / log(2.0),
-                    (float)num_keys_tested / brute_force_per_second,
-                    key_found
-                   );
+    ctx->failstr[0] = '\0';
 #endif
+    bool key_found = false;
+    ctx->num_keys_tested = 0;
+    uint32_t num_odd = ctx->nonces[ctx->best_first_byte_smallest_bitarray].num_states_bitarray[ODD_STATE];
+    uint32_t num_even = ctx->nonces[ctx->best_first_byte_smallest_bitarray].num_states_bitarray[EVEN_STATE];
+    float expected_brute_force1 = (float)num_odd * num_even / 2.0;
+    float expected_brute_force2 = ctx->nonces[ctx->best_first_bytes[0]].expected_num_brute_force;
+
+    if (ctx->write_stats) {
+        fprintf(ctx->fstats, "%1.1f;%1.1f;", log(expected_brute_force1) / log(2.0), log(expected_brute_force2) / log(2.0));
+    }
 
-            free_nonces_memory();
-            free_bitarray(all_bitflips_bitarray[ODD_STATE]);
-            free_bitarray(all_bitflips_bitarray[EVEN_STATE]);
-            free_sum_bitarrays();
-            free_part_sum_bitarrays();
+    if (expected_brute_force1 < expected_brute_force2) {
+        hardnested_print_progress(ctx, ctx->num_acquired_nonces, "(Ignoring Sum(a8) properties)", expected_brute_force1, 0);
+        set_test_state(ctx, ctx->best_first_byte_smallest_bitarray);
+        add_bitflip_candidates(ctx, ctx->best_first_byte_smallest_bitarray);
+        Tests2(ctx);
+        ctx->maximum_states = 0;
+
+        for (statelist_t *sl = ctx->candidates; sl != NULL; sl = sl->next) {
+            ctx->maximum_states += (uint64_t)sl->len[ODD_STATE] * sl->len[EVEN_STATE];
         }
-        fclose(fstats);
+
+        ctx->best_first_bytes[0] = ctx->best_first_byte_smallest_bitarray;
+        pre_XOR_nonces(ctx);
+
+        key_found = brute_force(ctx, foundkey);
+        if (ctx->cand_filename[0] != '\0') {
+            for (odd_even_t odd_even = EVEN_STATE; odd_even <= ODD_STATE; odd_even++) {
+                cand_cache_put(ctx, ctx->best_first_bytes[0], CAND_PART_SUM_NONE, CAND_PART_SUM_NONE, odd_even, ctx->candidates->states[odd_even], ctx->candidates->len[odd_even]);
+            }
+        }
+        free(ctx->candidates->states[ODD_STATE]);
+        free(ctx->candidates->states[EVEN_STATE]);
+        free_candidates_memory(ctx->candidates);
+        ctx->candidates = NULL;
     } else {
-        start_time = msclock();
-        print_progress_header();
-        sprintf(progress_text, "Brute force benchmark: %1.0f million (2^%1.1f) keys/s", brute_force_per_second / 1000000, log(brute_force_per_second) / log(2.0));
-        hardnested_print_progress(0, progress_text, (float)(1LL << 47), 0);
-        init_bitflip_bitarrays();
-        init_part_sum_bitarrays();
-        init_sum_bitarrays();
-        init_allbitflips_array();
-        init_nonce_memory();
-        update_reduction_rate(0.0, true);
 
-        if (nonce_file_read) {  // use pre-acquired data from file nonces.bin
-            if (read_nonce_file(filename) != 0) {
-                free_bitflip_bitarrays();
-                free_nonces_memory();
-                free_bitarray(all_bitflips_bitarray[ODD_STATE]);
-                free_bitarray(all_bitflips_bitarray[EVEN_STATE]);
-                free_sum_bitarrays();
-                free_part_sum_bitarrays();
-                return 3;
+        pre_XOR_nonces(ctx);
+
+        for (uint8_t j = 0; j < NUM_SUMS && !key_found; j++) {
+            float expected_brute_force = ctx->nonces[ctx->best_first_bytes[0]].expected_num_brute_force;
+            sprintf(progress_text, "(%d. guess: Sum(a8) = %" PRIu16 ")", j + 1, sums[ctx->nonces[ctx->best_first_bytes[0]].sum_a8_guess[j].sum_a8_idx]);
+            hardnested_print_progress(ctx, ctx->num_acquired_nonces, progress_text, expected_brute_force, 0);
+
+            if (ctx->known_target_key != -1 && sums[ctx->nonces[ctx->best_first_bytes[0]].sum_a8_guess[j].sum_a8_idx] != ctx->real_sum_a8) {
+                sprintf(progress_text, "(Estimated Sum(a8) is WRONG! Correct Sum(a8) = %" PRIu16 ")", ctx->real_sum_a8);
+                hardnested_print_progress(ctx, ctx->num_acquired_nonces, progress_text, expected_brute_force, 0);
             }
-            hardnested_stage = CHECK_1ST_BYTES | CHECK_2ND_BYTES;
-            update_nonce_data(false);
-            float brute_force_depth;
-            shrink_key_space(&brute_force_depth);
-        } else { // acquire nonces.
-            uint16_t is_OK = acquire_nonces(blockNo, keyType, key, trgBlockNo, trgKeyType, nonce_file_write, slow, filename);
-            if (is_OK != 0) {
-                free_bitflip_bitarrays();
-                free_nonces_memory();
-                free_bitarray(all_bitflips_bitarray[ODD_STATE]);
-                free_bitarray(all_bitflips_bitarray[EVEN_STATE]);
-                free_sum_bitarrays();
-                free_part_sum_bitarrays();
-                return is_OK;
+
+            generate_candidates(ctx, ctx->first_byte_Sum, ctx->nonces[ctx->best_first_bytes[0]].sum_a8_guess[j].sum_a8_idx);
+            key_found = brute_force(ctx, foundkey);
+            cand_cache_harvest(ctx);
+            free_statelist_cache(ctx);
+            free_candidates_memory(ctx->candidates);
+            ctx->candidates = NULL;
+            if (!key_found) {
+                // update the statistics
+                ctx->nonces[ctx->best_first_bytes[0]].sum_a8_guess[j].prob = 0;
+                ctx->nonces[ctx->best_first_bytes[0]].sum_a8_guess[j].num_states = 0;
+                // and calculate new expected number of brute forces
+                update_expected_brute_force(ctx, ctx->best_first_bytes[0]);
             }
         }
+    }
 
-        if (trgkey != NULL) {
-            known_target_key = bytes_to_num(trgkey, 6);
-            set_test_state(best_first_bytes[0]);
-        } else {
-            known_target_key = -1;
-        }
+    if (ctx->write_stats) {
+#ifdef DEBUG_KEY_ELIMINATION
+        fprintf(ctx->fstats, "%1.1f;%1.0f;%c;%s\n",
+                log(ctx->num_keys_tested) / log(2.0),
+                (float)ctx->num_keys_tested / ctx->brute_force_per_second,
+                key_found ? 'Y' : 'N',
+                ctx->failstr
+               );
+#else
+        fprintf(ctx->fstats, "%1.0f;%d\n",
+                log(ctx->num_keys_tested) / log(2.0),
+                (float)ctx->num_keys_tested / ctx->brute_force_per_second,
+                key_found
+               );
+#endif
+    }
 
-        Tests();
+    if (ctx->cand_cache_hits) {
+        sprintf(progress_text, "Reused %u persisted candidate lists", ctx->cand_cache_hits);
+        hardnested_print_progress(ctx, ctx->num_acquired_nonces, progress_text, 0.0, 0);
+    }
+    if (key_found == false) {
+        cand_cache_save(ctx);
+    }
 
-        free_bitflip_bitarrays();
-        bool key_found = false;
-        num_keys_tested = 0;
-        uint32_t num_odd = nonces[best_first_byte_smallest_bitarray].num_states_bitarray[ODD_STATE];
-        uint32_t num_even = nonces[best_first_byte_smallest_bitarray].num_states_bitarray[EVEN_STATE];
-        float expected_brute_force1 = (float)num_odd * num_even / 2.0;
-        float expected_brute_force2 = nonces[best_first_bytes[0]].expected_num_brute_force;
+    free_attack_memory(ctx);
+    return key_found;
+}
 
-        if (expected_brute_force1 < expected_brute_force2) {
-            hardnested_print_progress(num_acquired_nonces, "(Ignoring Sum(a8) properties)", expected_brute_force1, 0);
-            set_test_state(best_first_byte_smallest_bitarray);
-            add_bitflip_candidates(best_first_byte_smallest_bitarray);
-            Tests2();
-            maximum_states = 0;
+int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *trgkey, bool nonce_file_read, bool nonce_file_write, bool slow, int tests, uint64_t *foundkey, char *filename, uint8_t nonce_file_mode) {
+    char progress_text[80];
 
-            for (statelist_t *sl = candidates; sl != NULL; sl = sl->next) {
-                maximum_states += (uint64_t)sl->len[ODD_STATE] * sl->len[EVEN_STATE];
-            }
+    srand((unsigned) time(NULL));
 
-            best_first_bytes[0] = best_first_byte_smallest_bitarray;
-            pre_XOR_nonces();
-            prepare_bf_test_nonces(nonces, best_first_bytes[0]);
+    if (tests) {
+        // set the correct locale for the stats printing
+        setlocale(LC_NUMERIC, "");
+        FILE *fstats = fopen("hardnested_stats.txt", "a");
+        if (fstats == NULL) {
+            PrintAndLogEx(WARNING, "Could not create/open file " _YELLOW_("hardnested_stats.txt"));
+            return PM3_EFILE;
+        }
 
-            key_found = brute_force(foundkey);
-            free(candidates->states[ODD_STATE]);
-            free(candidates->states[EVEN_STATE]);
-            free_candidates_memory(candidates);
-            candidates = NULL;
-        } else {
+        for (uint32_t i = 0; i < tests; i++) {
+            hardnested_ctx_t *ctx = hardnested_ctx_new(NULL);
+            if (ctx == NULL) {
+                fclose(fstats);
+                return PM3_EMALLOC;
+            }
+            ctx->write_stats = true;
+            ctx->fstats = fstats;
 
-            pre_XOR_nonces();
-            prepare_bf_test_nonces(nonces, best_first_bytes[0]);
+            init_attack(ctx);
+            sprintf(progress_text, "Starting Test #%" PRIu32 " ...", i + 1);
+            hardnested_print_progress(ctx, 0, progress_text, (float)(1LL << 47), 0);
 
-            for (uint8_t j = 0; j < NUM_SUMS && !key_found; j++) {
-                float expected_brute_force = nonces[best_first_bytes[0]].expected_num_brute_force;
-                sprintf(progress_text, "(%d. guess: Sum(a8) = %" PRIu16 ")", j + 1, sums[nonces[best_first_bytes[0]].sum_a8_guess[j].sum_a8_idx]);
-                hardnested_print_progress(num_acquired_nonces, progress_text, expected_brute_force, 0);
+            hardnested_set_target_key(ctx, trgkey);
 
-                if (trgkey != NULL && sums[nonces[best_first_bytes[0]].sum_a8_guess[j].sum_a8_idx] != real_sum_a8) {
-                    sprintf(progress_text, "(Estimated Sum(a8) is WRONG! Correct Sum(a8) = %" PRIu16 ")", real_sum_a8);
-                    hardnested_print_progress(num_acquired_nonces, progress_text, expected_brute_force, 0);
-                }
+            init_attack_memory(ctx);
 
-                generate_candidates(first_byte_Sum, nonces[best_first_bytes[0]].sum_a8_guess[j].sum_a8_idx);
-                key_found = brute_force(foundkey);
-                free_statelist_cache();
-                free_candidates_memory(candidates);
-                candidates = NULL;
-                if (!key_found) {
-                    // update the statistics
-                    nonces[best_first_bytes[0]].sum_a8_guess[j].prob = 0;
-                    nonces[best_first_bytes[0]].sum_a8_guess[j].num_states = 0;
-                    // and calculate new expected number of brute forces
-                    update_expected_brute_force(best_first_bytes[0]);
-                }
+            if (simulate_acquire_nonces(ctx) != PM3_SUCCESS) {
+                hardnested_ctx_free(ctx);
+                fclose(fstats);
+                return 3;
             }
+
+            hardnested_crack(ctx, foundkey);
+            hardnested_ctx_free(ctx);
+        }
+        fclose(fstats);
+    } else {
+        hardnested_ctx_t *ctx = hardnested_ctx_new(NULL);
+        if (ctx == NULL) {
+            return PM3_EMALLOC;
+        }
+
+        hardnested_set_nonce_file_mode(ctx, nonce_file_mode);
+
+        int res;
+        if (nonce_file_read) {  // use pre-acquired data from file nonces.bin
+            res = hardnested_read_nonces(ctx, filename);
+        } else { // acquire nonces.
+            res = hardnested_acquire(ctx, blockNo, keyType, key, trgBlockNo, trgKeyType, nonce_file_write, slow, filename);
+        }
+        if (res != 0) {
+            hardnested_ctx_free(ctx);
+            return res;
         }
 
-        free_nonces_memory();
-        free_bitarray(all_bitflips_bitarray[ODD_STATE]);
-        free_bitarray(all_bitflips_bitarray[EVEN_STATE]);
-        free_sum_bitarrays();
-        free_part_sum_bitarrays();
+        hardnested_set_target_key(ctx, trgkey);
+        hardnested_crack(ctx, foundkey);
+        hardnested_ctx_free(ctx);
     }
     return 0;
 }
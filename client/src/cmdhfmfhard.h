@@ -21,8 +21,26 @@
 
 #include "common.h"
 
-int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *trgkey, bool nonce_file_read, bool nonce_file_write, bool slow, int tests, uint64_t *foundkey, char *filename);
-void hardnested_print_progress(uint32_t nonces, const char *activity, float brute_force, uint64_t min_diff_print_time);
+// State of one hardnested attack. Independent attacks can run concurrently, e.g. cracking
+// one sector while nonces for the next one are acquired.
+typedef struct hardnested_ctx_s hardnested_ctx_t;
+
+// nonce file write modes
+#define HARDNESTED_NFW_APPEND   0x01    // add a session to an existing v2 nonce file
+#define HARDNESTED_NFW_LZ4      0x02    // LZ4 compress nonce blocks
+
+hardnested_ctx_t *hardnested_ctx_new(const char *label);
+void hardnested_ctx_free(hardnested_ctx_t *ctx);
+// number of attacks that fit into the free memory, at least 1. Each one needs about 1.2GB
+uint32_t hardnested_max_parallel(void);
+int hardnested_acquire(hardnested_ctx_t *ctx, uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, bool nonce_file_write, bool slow, char *filename);
+int hardnested_read_nonces(hardnested_ctx_t *ctx, char *filename);
+void hardnested_set_nonce_file_mode(hardnested_ctx_t *ctx, uint8_t mode);
+void hardnested_set_target_key(hardnested_ctx_t *ctx, uint8_t *trgkey);
+bool hardnested_crack(hardnested_ctx_t *ctx, uint64_t *foundkey);
+
+int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *trgkey, bool nonce_file_read, bool nonce_file_write, bool slow, int tests, uint64_t *foundkey, char *filename, uint8_t nonce_file_mode);
+void hardnested_print_progress(hardnested_ctx_t *ctx, uint32_t nonces, const char *activity, float brute_force, uint64_t min_diff_print_time);
 
 #endif
 
@@ -33,6 +33,22 @@
 #include "pm3_cmd.h"
 #include "pmflash.h"      // rdv40validation_t
 #include "cmdflashmem.h"  // get_signature..
+#include "cmdmain.h"      // CommandReceived
+#include "fileutils.h"    // searchFile
+#include "util_posix.h"   // msclock
+#include "jansson.h"
+#include "mifare/mfkey.h"
+#include "mifare/mifarehost.h"  // lfsr_recovery32_mt
+#include "crapto1/crapto1.h"
+#include "hardnested_bruteforce.h"  // brute_force_benchmark
+#include "mifare/desfirecrypto.h"
+#include "graph.h"          // graph_lod_t
+#include "proxgui.h"        // GraphRenderBench
+#include "mifare/mad.h"      // MADDFDecodeAndPrint
+#include "mifare/aiddesfire.h"
+#include "aidsearch.h"      // PrintAIDDescriptionBuf
+#include "cmdcrc.h"         // GetModels, RunModel
+#include "reveng.h"         // mcount
 
 static int CmdHelp(const char *Cmd);
 
@@ -422,6 +438,531 @@ static void lookupChipID(uint32_t iChipID, uint32_t mem_used) {
     */
 }
 
+// Client side benchmarks over local data,  no device needed.
+// Every workload is run a fixed number of times with the output muted.
+typedef struct {
+    const char *name;
+    const char *setup;          // run once before timing, may be NULL
+    const char *cmds[4];        // timed, run in order for every iteration
+    uint32_t iterations;
+} bench_workload_t;
+
+// every file must be identified by `lf search -1`
+static const char *bench_lf_files[] = {
+    "lf_AWID-15-259.pm3",
+    "lf_EM4102-1.pm3",
+    "lf_HID-proxCardII-05512-11432784-1.pm3",
+    "lf_Indala-504278295.pm3",
+    "lf_Keri.pm3",
+    "lf_NEXWATCH_Quadrakey-521512301.pm3",
+};
+
+// trace file and `trace list` protocol
+static const char *bench_hf_traces[][2] = {
+    {"hf_visa_apple_normal",         "14a"},
+    {"hf_14a_mfu",                   "14a"},
+    {"hf_14a_reader_7b_rats",        "14a"},
+    {"hf_14b_reader",                "14b"},
+    {"hf_14b_cryptorf_select",       "cryptorf"},
+    {"hf_15_reader",                 "15"},
+    {"hf_iclass_sniff",              "iclass"},
+    {"hf_mfdes_sniff",               "des"},
+    {"lf_HitagS256_dump",            "hitags"},
+};
+
+// output is muted while the workloads run, the reason of a failure is kept for the report
+static char bench_error[FILE_PATH_SIZE + 60];
+
+static json_t *bench_result(const char *name, uint32_t iterations, uint64_t ms) {
+    json_t *r = json_object();
+    json_object_set_new(r, "name", json_string(name));
+    json_object_set_new(r, "iterations", json_integer(iterations));
+    json_object_set_new(r, "total_ms", json_integer(ms));
+    json_object_set_new(r, "avg_ms", json_real((double)ms / iterations));
+    json_object_set_new(r, "per_sec", json_real((ms) ? (iterations * 1000.0) / ms : 0));
+    return r;
+}
+
+static int bench_commands(json_t *results, const bench_workload_t *w, uint32_t scale) {
+
+    if (w->setup && CommandReceived(w->setup) != PM3_SUCCESS) {
+        return PM3_ESOFT;
+    }
+
+    uint32_t iterations = MAX(1, w->iterations * scale / 10);
+    uint64_t t1 = msclock();
+    for (uint32_t i = 0; i < iterations; i++) {
+        for (uint8_t j = 0; j < ARRAYLEN(w->cmds) && w->cmds[j]; j++) {
+            if (CommandReceived(w->cmds[j]) != PM3_SUCCESS) {
+                return PM3_ESOFT;
+            }
+        }
+    }
+    json_array_append_new(results, bench_result(w->name, iterations, msclock() - t1));
+    return PM3_SUCCESS;
+}
+
+// every trace is loaded once and listed a number of times, only the listing is timed
+static int bench_trace_list(json_t *results, uint32_t scale) {
+    char cmd[FILE_PATH_SIZE + 20];
+    uint32_t iterations = MAX(1, 4 * scale);
+    uint64_t ms = 0;
+    for (uint8_t j = 0; j < ARRAYLEN(bench_hf_traces); j++) {
+        char *path = NULL;
+        if (searchFile(&path, TRACES_SUBDIR, bench_hf_traces[j][0], ".trace", false) != PM3_SUCCESS) {
+            snprintf(bench_error, sizeof(bench_error), "can't find %s.trace", bench_hf_traces[j][0]);
+            return PM3_EFILE;
+        }
+        snprintf(cmd, sizeof(cmd), "trace load -f %s", path);
+        free(path);
+        if (CommandReceived(cmd) != PM3_SUCCESS) {
+            snprintf(bench_error, sizeof(bench_error), "can't load %s", bench_hf_traces[j][0]);
+            return PM3_EFILE;
+        }
+
+        snprintf(cmd, sizeof(cmd), "trace list -1 -t %s", bench_hf_traces[j][1]);
+        uint64_t t1 = msclock();
+        for (uint32_t i = 0; i < iterations; i++) {
+            if (CommandReceived(cmd) != PM3_SUCCESS) {
+                snprintf(bench_error, sizeof(bench_error), "`%s` failed on %s", cmd, bench_hf_traces[j][0]);
+                return PM3_ESOFT;
+            }
+        }
+        ms += msclock() - t1;
+    }
+    json_t *r = bench_result("trace_list", iterations * ARRAYLEN(bench_hf_traces), ms);
+    json_object_set_new(r, "traces", json_integer(ARRAYLEN(bench_hf_traces)));
+    json_array_append_new(results, r);
+    return PM3_SUCCESS;
+}
+
+static int bench_lf_search(json_t *results, uint32_t scale) {
+    char cmd[FILE_PATH_SIZE + 20];
+    uint32_t iterations = MAX(1, scale / 2);
+    uint64_t t1 = msclock();
+    for (uint32_t i = 0; i < iterations; i++) {
+        for (uint8_t j = 0; j < ARRAYLEN(bench_lf_files); j++) {
+            snprintf(cmd, sizeof(cmd), "data load -f %s", bench_lf_files[j]);
+            if (CommandReceived(cmd) != PM3_SUCCESS) {
+                snprintf(bench_error, sizeof(bench_error), "can't load %s", bench_lf_files[j]);
+                return PM3_EFILE;
+            }
+            if (CommandReceived("lf search -1") != PM3_SUCCESS) {
+                snprintf(bench_error, sizeof(bench_error), "`lf search -1` found no tag in %s", bench_lf_files[j]);
+                return PM3_ESOFT;
+            }
+        }
+    }
+    json_t *r = bench_result("lf_search", iterations * ARRAYLEN(bench_lf_files), msclock() - t1);
+    json_array_append_new(results, r);
+    return PM3_SUCCESS;
+}
+
+static int bench_mfkey32(json_t *results, uint32_t scale) {
+    // mfkey32v2 test vector,  key a0a1a2a3a4a5
+    nonces_t data = {
+        .cuid = 0x12345678,
+        .nonce = 0x1AD8DF2B, .nr = 0x1D316024, .ar = 0x620EF048,
+        .nonce2 = 0x30D6CB07, .nr2 = 0xC52077E2, .ar2 = 0x837AC61A,
+    };
+    uint32_t iterations = MAX(1, scale / 2);
+    uint64_t key = 0;
+    uint64_t t1 = msclock();
+    for (uint32_t i = 0; i < iterations; i++) {
+        if (mfkey32_moebius(&data, &key) == false || key != 0xa0a1a2a3a4a5) {
+            PrintAndLogEx(FAILED, "mfkey32 failed to recover the test key");
+            return PM3_ESOFT;
+        }
+    }
+    json_array_append_new(results, bench_result("mfkey32", iterations, msclock() - t1));
+    return PM3_SUCCESS;
+}
+
+static int bench_lfsr_recovery32(json_t *results, uint32_t scale) {
+    // keystream of the mfkey32v2 test vector
+    uint32_t ks2 = 0x620EF048 ^ prng_successor(0x1AD8DF2B, 64);
+    uint32_t threads = MAX(2, num_CPUs());
+    uint32_t iterations = MAX(1, scale / 5);
+
+    uint64_t t_seq = 0, t_mt = 0;
+    for (uint32_t i = 0; i < iterations; i++) {
+        uint64_t t1 = msclock();
+        struct Crypto1State *seq = lfsr_recovery32(ks2, 0);
+        t_seq += msclock() - t1;
+        t1 = msclock();
+        struct Crypto1State *mt = lfsr_recovery32_mt(ks2, 0, threads);
+        t_mt += msclock() - t1;
+
+        bool same = (seq != NULL && mt != NULL);
+        for (uint32_t j = 0; same; j++) {
+            same = (seq[j].odd == mt[j].odd && seq[j].even == mt[j].even);
+            if ((seq[j].odd | seq[j].even) == 0) {
+                break;
+            }
+        }
+        free(seq);
+        free(mt);
+        if (same == false) {
+            PrintAndLogEx(FAILED, "parallel lfsr_recovery32 differs from the sequential one");
+            return PM3_ESOFT;
+        }
+    }
+    json_array_append_new(results, bench_result("lfsr_recovery32", iterations, t_seq));
+    json_t *r = bench_result("lfsr_recovery32_mt", iterations, t_mt);
+    json_object_set_new(r, "threads", json_integer(threads));
+    json_array_append_new(results, r);
+    return PM3_SUCCESS;
+}
+
+// DESFire secure channel: CBC over a frame sized buffer plus CMAC,  per key type
+static int bench_desfire_cbc(json_t *results, uint32_t scale) {
+    const DesfireCryptoAlgorithm key_types[] = {T_3DES, T_AES};
+    const char *names[] = {"desfire_cbc_3des", "desfire_cbc_aes"};
+    uint8_t key[DESFIRE_MAX_KEY_SIZE] = {0};
+    uint8_t data[1024] = {0};
+    uint8_t mac[DESFIRE_MAX_CRYPTO_BLOCK_SIZE] = {0};
+    uint32_t iterations = scale * 100;
+
+    for (uint8_t t = 0; t < ARRAYLEN(key_types); t++) {
+        DesfireContext_t dctx;
+        DesfireSetKey(&dctx, 0, key_types[t], key);
+        dctx.secureChannel = DACEV1;
+        memcpy(dctx.sessionKeyEnc, key, sizeof(key));
+        memcpy(dctx.sessionKeyMAC, key, sizeof(key));
+
+        uint64_t t1 = msclock();
+        for (uint32_t i = 0; i < iterations; i++) {
+            DesfireCryptoEncDecEx(&dctx, DCOSessionKeyEnc, data, sizeof(data), data, true, true, NULL);
+            DesfireCryptoEncDecEx(&dctx, DCOSessionKeyEnc, data, sizeof(data), data, false, false, NULL);
+            DesfireCryptoCMAC(&dctx, data, sizeof(data), mac);
+        }
+        json_t *r = bench_result(names[t], iterations, msclock() - t1);
+        if (key_types[t] == T_AES)
+            json_object_set_new(r, "aesni", json_boolean(DesfireHasAESNI()));
+        json_array_append_new(results, r);
+    }
+    return PM3_SUCCESS;
+}
+
+// LRP secure channel frame: encrypt + CMAC. one shot contexts rebuild the LRP tables every call
+static int bench_desfire_lrp(json_t *results, uint32_t scale) {
+    uint8_t key[DESFIRE_MAX_KEY_SIZE] = {0};
+    uint8_t data[64] = {0};
+    uint8_t enc[sizeof(data) + CRYPTO_AES_BLOCK_SIZE] = {0};  // bit padding adds a block
+    uint8_t mdata[7 + sizeof(enc)] = {0};                      // cmd, cmdCntr, TI, data
+    uint8_t mac[8] = {0};
+    uint8_t macref[8] = {0};
+    uint32_t iterations = scale * 10;
+
+    DesfireContext_t dctx = {0};
+    DesfireSetKey(&dctx, 0, T_AES, key);
+    dctx.secureChannel = DACLRP;
+
+    uint64_t t1 = msclock();
+    for (uint32_t i = 0; i < iterations; i++) {
+        size_t enclen = 0;
+        LRPEncDec(dctx.sessionKeyEnc, dctx.IV, true, data, sizeof(data), &mdata[7], &enclen);
+        LRPContext_t lctx = {0};
+        LRPSetKey(&lctx, dctx.sessionKeyMAC, 0, true);
+        LRPCMAC8(&lctx, mdata, 7 + sizeof(data), macref);
+    }
+    json_array_append_new(results, bench_result("desfire_lrp_oneshot", iterations, msclock() - t1));
+
+    t1 = msclock();
+    for (uint32_t i = 0; i < iterations; i++) {
+        DesfireCryptoEncDecEx(&dctx, DCOSessionKeyEnc, data, sizeof(data), enc, true, true, NULL);
+        DesfireLRPCalcCMAC(&dctx, 0x00, enc, sizeof(data), mac);
+    }
+    json_array_append_new(results, bench_result("desfire_lrp_session", iterations, msclock() - t1));
+
+    if (memcmp(mac, macref, sizeof(mac)) != 0) {
+        PrintAndLogEx(FAILED, "LRP session context differs from the one shot calls");
+        return PM3_ESOFT;
+    }
+    return PM3_SUCCESS;
+}
+
+// plot pyramid over a full trace: build, small partial update and the min/max of every pixel column
+// of a zoomed out window,  against scanning the samples. With Qt also the offscreen render time
+static int bench_graph_lod(json_t *results, uint32_t scale) {
+    const uint32_t columns = 1500;
+    int *buf = calloc(MAX_GRAPH_TRACE_LEN, sizeof(int));
+    if (buf == NULL) {
+        return PM3_EMALLOC;
+    }
+    for (uint32_t i = 0; i < MAX_GRAPH_TRACE_LEN; i++) {
+        buf[i] = (int)((i * 2654435761u) >> 24) - 128;
+    }
+
+    graph_lod_t lod = {0};
+    uint32_t iterations = scale * 10;
+    uint64_t t1 = msclock();
+    for (uint32_t i = 0; i < iterations; i++) {
+        GraphLodInvalidate(&lod, 0, MAX_GRAPH_TRACE_LEN);
+        if (GraphLodUpdate(&lod, buf, MAX_GRAPH_TRACE_LEN) == false) {
+            free(buf);
+            return PM3_EMALLOC;
+        }
+    }
+    json_array_append_new(results, bench_result("graph_lod_build", iterations, msclock() - t1));
+
+    // a few hundred samples changed,  like a marker region being edited
+    iterations = scale * 1000;
+    t1 = msclock();
+    for (uint32_t i = 0; i < iterations; i++) {
+        size_t start = (i * 7919) % (MAX_GRAPH_TRACE_LEN - 500);
+        buf[start] ^= 1;
+        GraphLodInvalidate(&lod, start, start + 500);
+        GraphLodUpdate(&lod, buf, MAX_GRAPH_TRACE_LEN);
+    }
+    json_array_append_new(results, bench_result("graph_lod_update", iterations, msclock() - t1));
+
+    // one sweep over all pixel columns per iteration,  the last sweep of both is compared
+    int64_t sums[2] = {0};
+    int extremes[2] = {0};
+    uint64_t t_cols[2] = {0};
+    iterations = scale * 2;
+    for (uint8_t pass = 0; pass < 2; pass++) {
+        t1 = msclock();
+        for (uint32_t i = 0; i < iterations; i++) {
+            sums[pass] = 0;
+            extremes[pass] = 0;
+            for (uint32_t c = 0; c < columns; c++) {
+                int vmin, vmax;
+                int64_t vsum;
+                GraphLodQuery((pass) ? NULL : &lod, buf, (size_t)c * MAX_GRAPH_TRACE_LEN / columns, (size_t)(c + 1) * MAX_GRAPH_TRACE_LEN / columns, &vmin, &vmax, &vsum);
+                sums[pass] += vsum;
+                extremes[pass] += vmax - vmin;
+            }
+        }
+        t_cols[pass] = msclock() - t1;
+    }
+    GraphLodFree(&lod);
+    free(buf);
+    if (sums[0] != sums[1] || extremes[0] != extremes[1]) {
+        PrintAndLogEx(FAILED, "graph pyramid differs from the samples");
+        return PM3_ESOFT;
+    }
+    json_array_append_new(results, bench_result("graph_lod_columns", iterations, t_cols[0]));
+    json_array_append_new(results, bench_result("graph_scan_columns", iterations, t_cols[1]));
+
+    uint64_t ms_samples = 0, ms_lod = 0;
+    iterations = MAX(1, scale / 2);
+    if (GraphRenderBench(iterations, &ms_samples, &ms_lod)) {
+        json_array_append_new(results, bench_result("graph_render_samples", iterations, ms_samples));
+        json_array_append_new(results, bench_result("graph_render_lod", iterations, ms_lod));
+    }
+    return PM3_SUCCESS;
+}
+
+// resource json lookups as done while listing card applications. The first run parses the
+// files like every lookup used to,  the second goes through the cached indexes
+static int bench_resources(json_t *results, uint32_t scale) {
+    static const char *names[] = {"mad", "aid_desfire", "aidlist"};
+    uint32_t iterations = scale * 2;
+    uint64_t t1 = msclock();
+    for (uint32_t i = 0; i < iterations; i++) {
+        for (uint8_t j = 0; j < ARRAYLEN(names); j++) {
+            char *path;
+            if (searchFile(&path, RESOURCES_SUBDIR, names[j], ".json", false) != PM3_SUCCESS) {
+                return PM3_EFILE;
+            }
+            json_error_t error;
+            json_t *root = json_load_file(path, 0, &error);
+            free(path);
+            if (root == NULL) {
+                return PM3_ESOFT;
+            }
+            json_decref(root);
+        }
+    }
+    json_array_append_new(results, bench_result("resource_parse", iterations, msclock() - t1));
+
+    uint8_t dfaid[3] = {0x00, 0x00, 0xF0};
+    uint8_t aid[] = {0xA0, 0x00, 0x00, 0x00, 0x03, 0x10, 0x10};
+    iterations = scale * 1000;
+    t1 = msclock();
+    for (uint32_t i = 0; i < iterations; i++) {
+        MADDFDecodeAndPrint(0x0001 + (i % 0x100));
+        dfaid[0] = i & 0xFF;
+        AIDDFDecodeAndPrint(dfaid);
+        PrintAIDDescriptionBuf(NULL, aid, sizeof(aid), false);
+    }
+    json_array_append_new(results, bench_result("resource_lookup", iterations, msclock() - t1));
+    return PM3_SUCCESS;
+}
+
+// brute force CRC search for every 8 and 16 bit catalogue model, three frames of each
+// are handed to `reveng -F -s` which skips the preset list
+static int bench_reveng(json_t *results, uint32_t scale) {
+    static const char *frames[] = {"0102030405", "a1b2c3d4e5", "0011223344"};
+    // GetModels fills one slot per catalogue model, size both arrays from the catalogue
+    int total = mcount();
+    char **models = calloc(MAX(1, total), sizeof(char *));
+    uint8_t *width = calloc(MAX(1, total), sizeof(uint8_t));
+    if (models == NULL || width == NULL) {
+        free(models);
+        free(width);
+        return PM3_EMALLOC;
+    }
+    int count = 0;
+    if (GetModels(models, &count, width) == 0) {
+        for (int j = 0; j < count; j++) {
+            free(models[j]);
+        }
+        free(models);
+        free(width);
+        return PM3_ESOFT;
+    }
+
+    uint32_t iterations = MAX(1, scale / 10), searched = 0;
+    uint64_t t1 = msclock();
+    for (uint32_t i = 0; i < iterations; i++) {
+        for (int j = 0; j < count; j++) {
+            if (width[j] != 8 && width[j] != 16)
+                continue;
+
+            char cmd[200];
+            int n = snprintf(cmd, sizeof(cmd), "reveng -F -w %u -s", width[j]);
+            for (uint8_t k = 0; k < ARRAYLEN(frames); k++) {
+                char crc[30] = {0};
+                if (RunModel(models[j], (char *)frames[k], false, 0, crc) == 0)
+                    break;
+                n += snprintf(cmd + n, sizeof(cmd) - n, " %s%s", frames[k], crc);
+            }
+            CommandReceived(cmd);
+            searched++;
+        }
+    }
+    for (int j = 0; j < count; j++) {
+        free(models[j]);
+    }
+    free(models);
+    free(width);
+    json_array_append_new(results, bench_result("reveng_search", searched, msclock() - t1));
+    return PM3_SUCCESS;
+}
+
+static int bench_hardnested(json_t *results) {
+    uint64_t t1 = msclock();
+    float rate = brute_force_benchmark();
+    json_t *r = bench_result("hardnested_bruteforce", 1, msclock() - t1);
+    json_object_set_new(r, "states_per_sec", json_real(rate));
+    json_array_append_new(results, r);
+    return PM3_SUCCESS;
+}
+
+static int CmdBench(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hw bench",
+                  "Run reproducible client side workloads over local traces and test vectors\n"
+                  "and report the timings as JSON.  No device needed.",
+                  "hw bench\n"
+                  "hw bench -n 1               -> quick run\n"
+                  "hw bench -f bench_results   -> also save results to json file\n"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_u64_0("n", NULL, "<dec>", "iteration scale, 1..100 (def 10)"),
+        arg_str0("f", "file", "<fn>", "save results to json file"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    uint32_t scale = arg_get_u32_def(ctx, 1, 10);
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 2), (uint8_t *)filename, sizeof(filename), &fnlen);
+    CLIParserFree(ctx);
+
+    if (scale < 1 || scale > 100) {
+        PrintAndLogEx(WARNING, "iteration scale must be 1..100");
+        return PM3_EINVARG;
+    }
+
+    const bench_workload_t workloads[] = {
+        {"data_autocorr", "data load -f lf_EM4102-1.pm3", {"data autocorr -w 4000"}, 10},
+        {"iclass_lookup", NULL, {"hf iclass lookup --csn 9655a400f8ff12e0 --epurse f0ffffffffffffff --macs 0000000089cb984b -f iclass_default_keys"}, 200},
+    };
+
+    json_t *results = json_array();
+    bench_error[0] = '\0';
+
+    uint8_t old_printAndLog = g_printAndLog;
+    g_printAndLog = 0;
+
+    int res = PM3_SUCCESS;
+    for (uint8_t i = 0; i < ARRAYLEN(workloads) && res == PM3_SUCCESS; i++) {
+        res = bench_commands(results, &workloads[i], scale);
+    }
+
+    if (res == PM3_SUCCESS)
+        res = bench_trace_list(results, scale);
+
+    if (res == PM3_SUCCESS)
+        res = bench_lf_search(results, scale);
+
+    if (res == PM3_SUCCESS)
+        res = bench_mfkey32(results, scale);
+
+    if (res == PM3_SUCCESS)
+        res = bench_lfsr_recovery32(results, scale);
+
+    if (res == PM3_SUCCESS)
+        res = bench_desfire_cbc(results, scale);
+
+    if (res == PM3_SUCCESS)
+        res = bench_desfire_lrp(results, scale);
+
+    if (res == PM3_SUCCESS)
+        res = bench_graph_lod(results, scale);
+
+    if (res == PM3_SUCCESS)
+        res = bench_resources(results, scale);
+
+    if (res == PM3_SUCCESS)
+        res = bench_reveng(results, scale);
+
+    if (res == PM3_SUCCESS)
+        res = bench_hardnested(results);
+
+    g_printAndLog = old_printAndLog;
+
+    if (res != PM3_SUCCESS) {
+        PrintAndLogEx(FAILED, "benchmark failed ( %d ) %s", res, bench_error);
+        json_decref(results);
+        return res;
+    }
+
+    json_t *root = json_object();
+    json_object_set_new(root, "Created", json_string("proxmark3"));
+    json_object_set_new(root, "FileType", json_string("benchmark"));
+    json_object_set_new(root, "version", json_string(g_version_information.gitversion));
+    json_object_set_new(root, "scale", json_integer(scale));
+    json_object_set_new(root, "results", results);
+
+    // print one line at the time,  the whole document might not fit the print buffer
+    char *out = json_dumps(root, JSON_INDENT(2) | JSON_REAL_PRECISION(6));
+    if (out) {
+        char *line = out;
+        while (line && *line) {
+            char *nl = strchr(line, '\n');
+            if (nl)
+                *nl = '\0';
+            PrintAndLogEx(NORMAL, "%s", line);
+            line = (nl) ? nl + 1 : NULL;
+        }
+        free(out);
+    }
+
+    if (fnlen) {
+        res = saveFileJSONrootEx(filename, root, JSON_INDENT(2) | JSON_REAL_PRECISION(6), true, true);
+    }
+
+    json_decref(root);
+    return res;
+}
+
 static int CmdDbg(const char *Cmd) {
 
     CLIParserContext *ctx;
@@ -992,6 +1533,7 @@ static int CmdBreak(const char *Cmd) {
 static command_t CommandTable[] = {
     {"-------------", CmdHelp,         AlwaysAvailable, "----------------------- " _CYAN_("Hardware") " -----------------------"},
     {"help",          CmdHelp,         AlwaysAvailable, "This help"},
+    {"bench",         CmdBench,        AlwaysAvailable, "Benchmark client side processing of local data"},
     {"break",         CmdBreak,        IfPm3Present,    "Send break loop usb command"},
     {"connect",       CmdConnect,      AlwaysAvailable, "Connect Proxmark3 to serial port"},
     {"dbg",           CmdDbg,          IfPm3Present,    "Set Proxmark3 debug level"},
@@ -1032,6 +1032,244 @@ static int CmdT55xxDetect(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// Shared signal statistics for t55xxTryDetectModulationEx.
+// The graph buffer is converted once and the clocks are detected once,  every
+// modulation hypothesis then demodulates its own scratch copy of the samples
+// instead of re-reading the graph buffer and re-running the clock detection.
+// The lfdemod functions may read past the samples,  so like the cmddata demods
+// all buffers are MAX_GRAPH_TRACE_LEN long and zero padded.
+#define T55XX_DETECT_MAX_HITS    15
+#define T55XX_DETECT_ASKCLK_MAX  4
+
+typedef struct {
+    uint8_t *samples;
+    size_t len;
+    uint8_t *work;
+    size_t work_len;
+    // ASK/Manchester demod input, samples with the sequence terminator removed
+    uint8_t *st_samples;
+    const uint8_t *ask_src;
+    size_t st_len;
+    int st_clk;
+    bool st;
+    // DetectASKClock results, keyed by their input
+    struct {
+        const uint8_t *src;
+        size_t size;
+        int clk_in;
+        int clk;
+        int start;
+    } askclk[T55XX_DETECT_ASKCLK_MAX];
+    uint8_t askclk_cnt;
+} t55xx_detect_t;
+
+// a demodulated hypothesis
+typedef struct {
+    uint8_t *bits;
+    size_t len;
+    int clk;
+    int start_idx;
+} t55xx_demod_t;
+
+static void t55xx_detect_free(t55xx_detect_t *d) {
+    free(d->samples);
+    free(d->work);
+    free(d->st_samples);
+    memset(d, 0, sizeof(t55xx_detect_t));
+}
+
+static bool t55xx_detect_init(t55xx_detect_t *d) {
+    memset(d, 0, sizeof(t55xx_detect_t));
+
+    // every demod below bails out on noise
+    if (g_GraphTraceLen == 0 || getSignalProperties()->isnoise)
+        return false;
+
+    d->samples = calloc(MAX_GRAPH_TRACE_LEN, sizeof(uint8_t));
+    d->work = calloc(MAX_GRAPH_TRACE_LEN, sizeof(uint8_t));
+    d->st_samples = calloc(MAX_GRAPH_TRACE_LEN, sizeof(uint8_t));
+    if (d->samples == NULL || d->work == NULL || d->st_samples == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        t55xx_detect_free(d);
+        return false;
+    }
+
+    d->len = getFromGraphBuf(d->samples);
+    return (d->len > 0);
+}
+
+// DetectASKClock only depends on its input buffer, size and preset clock,  and on whether maxErr is zero.
+// The ASK (maxErr 1) and biphase (maxErr 2) demods both pass a non zero value,  so 1 is used for both
+static int t55xx_detect_askclock(t55xx_detect_t *d, const uint8_t *src, size_t size, int *clk) {
+    for (uint8_t i = 0; i < d->askclk_cnt; i++) {
+        if (d->askclk[i].src == src && d->askclk[i].size == size && d->askclk[i].clk_in == *clk) {
+            *clk = d->askclk[i].clk;
+            return d->askclk[i].start;
+        }
+    }
+
+    int clk_in = *clk;
+    int start = DetectASKClock((uint8_t *)src, size, clk, 1);
+
+    if (d->askclk_cnt < T55XX_DETECT_ASKCLK_MAX) {
+        d->askclk[d->askclk_cnt].src = src;
+        d->askclk[d->askclk_cnt].size = size;
+        d->askclk[d->askclk_cnt].clk_in = clk_in;
+        d->askclk[d->askclk_cnt].clk = *clk;
+        d->askclk[d->askclk_cnt].start = start;
+        d->askclk_cnt++;
+    }
+    return start;
+}
+
+// copy samples to the scratch buffer,  the demods never write past the samples they are given
+static void t55xx_detect_load(t55xx_detect_t *d, const uint8_t *src, size_t len) {
+    memcpy(d->work, src, len);
+    if (d->work_len > len) {
+        memset(d->work + len, 0, d->work_len - len);
+    }
+    d->work_len = len;
+}
+
+static void t55xx_demod_set(t55xx_demod_t *dm, uint8_t *bits, size_t len, int clk, int start_idx) {
+    // same limit as setDemodBuff
+    if (len > MAX_DEMOD_BUF_LEN)
+        len = MAX_DEMOD_BUF_LEN;
+
+    dm->bits = bits;
+    dm->len = len;
+    dm->clk = clk;
+    dm->start_idx = start_idx;
+}
+
+// see FSKrawDemod
+static bool t55xx_demod_fsk(t55xx_detect_t *d, uint8_t rflen, uint8_t invert, uint8_t fchigh, uint8_t fclow, t55xx_demod_t *dm) {
+    t55xx_detect_load(d, d->samples, d->len);
+    int start_idx = 0;
+    size_t size = fskdemod(d->work, d->len, rflen, invert, fchigh, fclow, &start_idx);
+    if (size == 0)
+        return false;
+
+    t55xx_demod_set(dm, d->work, size, rflen, start_idx);
+    return true;
+}
+
+// see ASKDemod_ext,  ASK/Manchester,  maxErr 1,  no amplify
+static bool t55xx_demod_ask(t55xx_detect_t *d, int invert, t55xx_demod_t *dm) {
+    if (d->len < 255)
+        return false;
+
+    int clk = (d->st_clk == 32 || d->st_clk == 64) ? d->st_clk : 0;
+    int start = t55xx_detect_askclock(d, d->ask_src, d->st_len, &clk);
+    if (clk == 0 || start < 0)
+        return false;
+
+    t55xx_detect_load(d, d->ask_src, d->len);
+    size_t bitlen = d->st_len;
+    int start_idx = 0;
+    int errcnt = askdemod_clk(d->work, &bitlen, clk, start, &invert, 0, 1, &start_idx);
+    if (start_idx >= clk / 2) {
+        start_idx -= clk / 2;
+    }
+    if (errcnt < 0 || errcnt > 1 || bitlen < 16)
+        return false;
+
+    t55xx_demod_set(dm, d->work, bitlen, clk, start_idx);
+    return true;
+}
+
+// see ASKbiphaseDemod,  offset 0,  maxErr 2
+static bool t55xx_demod_biphase(t55xx_detect_t *d, int invert, t55xx_demod_t *dm) {
+    int clk = 0;
+    int start = t55xx_detect_askclock(d, d->samples, d->len, &clk);
+    if (clk == 0 || start < 0)
+        return false;
+
+    t55xx_detect_load(d, d->samples, d->len);
+    size_t size = d->len;
+    int start_idx = 0;
+    int errcnt = askdemod_clk(d->work, &size, clk, start, &invert, 0, 0, &start_idx);
+    if (errcnt < 0 || errcnt > 2)
+        return false;
+
+    int offset = 0;
+    errcnt = BiphaseRawDecode(d->work, &size, &offset, invert);
+    if (errcnt < 0 || errcnt > 2)
+        return false;
+
+    if (offset >= 1) {
+        offset -= 1;
+    }
+    t55xx_demod_set(dm, d->work, size, clk, start_idx + clk * offset / 2);
+    return true;
+}
+
+// see NRZrawDemod,  maxErr 1
+static bool t55xx_demod_nrz(t55xx_detect_t *d, int clk, t55xx_demod_t *dm) {
+    t55xx_detect_load(d, d->samples, d->len);
+    size_t bitlen = d->len;
+    int invert = 0, start_idx = 0;
+    int errcnt = nrzRawDemod(d->work, &bitlen, &clk, &invert, &start_idx);
+    if (errcnt < 0 || errcnt > 1 || bitlen < 16)
+        return false;
+
+    t55xx_demod_set(dm, d->work, bitlen, clk, start_idx);
+    return true;
+}
+
+// see PSKDemod,  maxErr 6.   Samples are already trimmed by the caller
+static bool t55xx_demod_psk(t55xx_detect_t *d, const uint8_t *src, size_t len, int invert, t55xx_demod_t *dm) {
+    t55xx_detect_load(d, src, len);
+    size_t bitlen = len;
+    int clk = 0, start_idx = 0;
+    int errcnt = pskRawDemod_ext(d->work, &bitlen, &clk, &invert, &start_idx);
+    if (errcnt > 6 || errcnt < 0 || bitlen < 16)
+        return false;
+
+    t55xx_demod_set(dm, d->work, bitlen, clk, start_idx);
+    return true;
+}
+
+static bool t55xxTestBits(const uint8_t *bits, size_t len, uint8_t mode, uint8_t *offset, int *fndBitRate, uint8_t clk, bool *Q5);
+
+// tests a demodulated hypothesis and,  if it holds a valid configuration block,  adds it to the hits
+static void t55xx_detect_add(t55xx_conf_block_t *tests, t55xx_demod_t *found, uint8_t *hits, const t55xx_demod_t *dm,
+                             uint8_t mode, uint8_t clk, t55xx_modulation modulation, bool inverted, bool st, uint8_t downlink_mode) {
+
+    if (*hits >= T55XX_DETECT_MAX_HITS)
+        return;
+
+    t55xx_conf_block_t *t = &tests[*hits];
+    int bitRate = 0;
+    if (t55xxTestBits(dm->bits, dm->len, mode, &t->offset, &bitRate, clk, &t->Q5) == false)
+        return;
+
+    t->modulation = modulation;
+    t->bitrate = bitRate;
+    t->inverted = inverted;
+    t->block0 = PackBits(t->offset, 32, dm->bits);
+    t->ST = st;
+    t->downlink_mode = downlink_mode;
+
+    // keep the bits,  the selected hypothesis ends up in g_DemodBuffer
+    found[*hits] = *dm;
+    found[*hits].bits = calloc(dm->len, sizeof(uint8_t));
+    if (found[*hits].bits == NULL) {
+        found[*hits].len = 0;
+    } else {
+        memcpy(found[*hits].bits, dm->bits, dm->len);
+    }
+    (*hits)++;
+}
+
+static void t55xx_detect_select(const t55xx_demod_t *dm) {
+    if (dm->bits == NULL || dm->len == 0)
+        return;
+
+    setDemodBuff(dm->bits, dm->len, 0);
+    setClockGrid(dm->clk, dm->start_idx);
+}
+
 // detect configuration?
 bool t55xxTryDetectModulation(uint8_t downlink_mode, bool print_config) {
     return t55xxTryDetectModulationEx(downlink_mode, print_config, 0, -1);
@@ -1039,168 +1277,135 @@ bool t55xxTryDetectModulation(uint8_t downlink_mode, bool print_config) {
 
 bool t55xxTryDetectModulationEx(uint8_t downlink_mode, bool print_config, uint32_t wanted_conf, uint64_t pwd) {
 
-    t55xx_conf_block_t tests[15];
-    int bitRate = 0, clk = 0, firstClockEdge = 0;
-    uint8_t hits = 0, fc1 = 0, fc2 = 0, ans = 0;
+    t55xx_conf_block_t tests[T55XX_DETECT_MAX_HITS];
+    memset(tests, 0, sizeof(tests));
+    t55xx_demod_t found[T55XX_DETECT_MAX_HITS];
+    memset(found, 0, sizeof(found));
+    uint8_t hits = 0;
 
-    ans = fskClocks(&fc1, &fc2, (uint8_t *)&clk, &firstClockEdge);
+    t55xx_detect_t d;
+    if (t55xx_detect_init(&d) == false)
+        return false;
 
-    if (ans && ((fc1 == 10 && fc2 == 8) || (fc1 == 8 && fc2 == 5))) {
-        if ((FSKrawDemod(0, 0, 0, 0, false) == PM3_SUCCESS) && test(DEMOD_FSK, &tests[hits].offset, &bitRate, clk, &tests[hits].Q5)) {
-            tests[hits].modulation = DEMOD_FSK;
-            if (fc1 == 8 && fc2 == 5)
-                tests[hits].modulation = DEMOD_FSK1a;
-            else if (fc1 == 10 && fc2 == 8)
-                tests[hits].modulation = DEMOD_FSK2;
-            tests[hits].bitrate = bitRate;
-            tests[hits].inverted = false;
-            tests[hits].block0 = PackBits(tests[hits].offset, 32, g_DemodBuffer);
-            tests[hits].ST = false;
-            tests[hits].downlink_mode = downlink_mode;
-            ++hits;
+    t55xx_demod_t dm;
+    int clk = 0, firstClockEdge = 0;
+    uint8_t fc1 = 0, fc2 = 0;
+
+    // see fskClocks
+    uint16_t fcs = countFC(d.samples, d.len, true);
+    if (fcs) {
+        fc1 = (fcs >> 8) & 0xFF;
+        fc2 = fcs & 0xFF;
+        clk = detectFSKClk(d.samples, d.len, fc1, fc2, &firstClockEdge);
+    }
+
+    if (clk && ((fc1 == 10 && fc2 == 8) || (fc1 == 8 && fc2 == 5))) {
+        if (t55xx_demod_fsk(&d, clk, 0, fc1, fc2, &dm)) {
+            t55xx_detect_add(tests, found, &hits, &dm, DEMOD_FSK, clk, (fc1 == 8) ? DEMOD_FSK1a : DEMOD_FSK2, false, false, downlink_mode);
         }
-        if ((FSKrawDemod(0, 1, 0, 0, false) == PM3_SUCCESS) && test(DEMOD_FSK, &tests[hits].offset, &bitRate, clk, &tests[hits].Q5)) {
-            tests[hits].modulation = DEMOD_FSK;
-            if (fc1 == 8 && fc2 == 5)
-                tests[hits].modulation = DEMOD_FSK1;
-            else if (fc1 == 10 && fc2 == 8)
-                tests[hits].modulation = DEMOD_FSK2a;
-            tests[hits].bitrate = bitRate;
-            tests[hits].inverted = true;
-            tests[hits].block0 = PackBits(tests[hits].offset, 32, g_DemodBuffer);
-            tests[hits].ST = false;
-            tests[hits].downlink_mode = downlink_mode;
-            ++hits;
+        if (t55xx_demod_fsk(&d, clk, 1, fc1, fc2, &dm)) {
+            t55xx_detect_add(tests, found, &hits, &dm, DEMOD_FSK, clk, (fc1 == 8) ? DEMOD_FSK1 : DEMOD_FSK2a, true, false, downlink_mode);
         }
     } else {
-        clk = GetAskClock("", false);
+
+        // ASK/Manchester only looks at the first bigbuf_size samples,  after the sequence terminator is removed
+        d.st_len = d.len;
+        if (g_pm3_capabilities.bigbuf_size && g_pm3_capabilities.bigbuf_size < d.st_len)
+            d.st_len = g_pm3_capabilities.bigbuf_size;
+
+        bool truncated = (d.st_len < d.len);
+
+        memcpy(d.st_samples, d.samples, d.len);
+        size_t ststart = 0, stend = 0;
+        d.st = DetectST(d.st_samples, &d.st_len, &d.st_clk, &ststart, &stend);
+        if (d.st) {
+            g_CursorCPos = ststart;
+            g_CursorDPos = stend;
+        }
+
+        // DetectST leaves the samples untouched when there is no sequence terminator,
+        // then the ASK and biphase demods share their clock detection
+        d.ask_src = (d.st || truncated) ? d.st_samples : d.samples;
+
+        // see GetAskClock,  it runs the same ST detection over the whole trace
+        if (truncated) {
+            clk = GetAskClock("", false);
+        } else {
+            clk = d.st_clk;
+            if (d.st == false)
+                t55xx_detect_askclock(&d, d.ask_src, d.st_len, &clk);
+        }
+
         if (clk > 0) {
-            tests[hits].ST = true;
-            // "0 0 1 " == clock auto, invert false, maxError 1.
-            // false = no verbose
-            // false = no emSearch
-            // 1 = Ask/Man
-            // st = true
-            if ((ASKDemod_ext(0, 0, 1, 0, false, false, false, 1, &tests[hits].ST) == PM3_SUCCESS) && test(DEMOD_ASK, &tests[hits].offset, &bitRate, clk, &tests[hits].Q5)) {
-                tests[hits].modulation = DEMOD_ASK;
-                tests[hits].bitrate = bitRate;
-                tests[hits].inverted = false;
-                tests[hits].block0 = PackBits(tests[hits].offset, 32, g_DemodBuffer);
-                tests[hits].downlink_mode = downlink_mode;
-                ++hits;
+            // ASKDemod_ext only ever sets the sequence terminator flag,  it never clears it
+            if (t55xx_demod_ask(&d, 0, &dm)) {
+                t55xx_detect_add(tests, found, &hits, &dm, DEMOD_ASK, clk, DEMOD_ASK, false, true, downlink_mode);
             }
-            tests[hits].ST = true;
-            // "0 0 1 " == clock auto, invert true, maxError 1.
-            // false = no verbose
-            // false = no emSearch
-            // 1 = Ask/Man
-            // st = true
-            if ((ASKDemod_ext(0, 1, 1, 0, false, false, false, 1, &tests[hits].ST) == PM3_SUCCESS) && test(DEMOD_ASK, &tests[hits].offset, &bitRate, clk, &tests[hits].Q5)) {
-                tests[hits].modulation = DEMOD_ASK;
-                tests[hits].bitrate = bitRate;
-                tests[hits].inverted = true;
-                tests[hits].block0 = PackBits(tests[hits].offset, 32, g_DemodBuffer);
-                tests[hits].downlink_mode = downlink_mode;
-                ++hits;
+            if (t55xx_demod_ask(&d, 1, &dm)) {
+                t55xx_detect_add(tests, found, &hits, &dm, DEMOD_ASK, clk, DEMOD_ASK, true, true, downlink_mode);
             }
-            if ((ASKbiphaseDemod(0, 0, 0, 2, false) == PM3_SUCCESS) && test(DEMOD_BI, &tests[hits].offset, &bitRate, clk, &tests[hits].Q5)) {
-                tests[hits].modulation = DEMOD_BI;
-                tests[hits].bitrate = bitRate;
-                tests[hits].inverted = false;
-                tests[hits].block0 = PackBits(tests[hits].offset, 32, g_DemodBuffer);
-                tests[hits].ST = false;
-                tests[hits].downlink_mode = downlink_mode;
-                ++hits;
+            if (t55xx_demod_biphase(&d, 0, &dm)) {
+                t55xx_detect_add(tests, found, &hits, &dm, DEMOD_BI, clk, DEMOD_BI, false, false, downlink_mode);
             }
-            if ((ASKbiphaseDemod(0, 0, 1, 2, false) == PM3_SUCCESS) && test(DEMOD_BIa, &tests[hits].offset, &bitRate, clk, &tests[hits].Q5)) {
-                tests[hits].modulation = DEMOD_BIa;
-                tests[hits].bitrate = bitRate;
-                tests[hits].inverted = true;
-                tests[hits].block0 = PackBits(tests[hits].offset, 32, g_DemodBuffer);
-                tests[hits].ST = false;
-                tests[hits].downlink_mode = downlink_mode;
-                ++hits;
+            if (t55xx_demod_biphase(&d, 1, &dm)) {
+                t55xx_detect_add(tests, found, &hits, &dm, DEMOD_BIa, clk, DEMOD_BIa, true, false, downlink_mode);
             }
         }
-        clk = GetNrzClock("", false);
+
+        // see GetNrzClock
+        size_t clkStartIdx = 0;
+        clk = DetectNRZClock(d.samples, d.len, 0, &clkStartIdx);
         if (clk > 8) { //clock of rf/8 is likely a false positive, so don't use it.
-            if ((NRZrawDemod(0, 0, 1, false) == PM3_SUCCESS) && test(DEMOD_NRZ, &tests[hits].offset, &bitRate, clk, &tests[hits].Q5)) {
-                tests[hits].modulation = DEMOD_NRZ;
-                tests[hits].bitrate = bitRate;
-                tests[hits].inverted = false;
-                tests[hits].block0 = PackBits(tests[hits].offset, 32, g_DemodBuffer);
-                tests[hits].ST = false;
-                tests[hits].downlink_mode = downlink_mode;
-                ++hits;
-            }
+            if (t55xx_demod_nrz(&d, clk, &dm)) {
+                t55xx_detect_add(tests, found, &hits, &dm, DEMOD_NRZ, clk, DEMOD_NRZ, false, false, downlink_mode);
+
+                // an inverted NRZ demod only flips the output bits
+                for (size_t i = 0; i < dm.len; i++)
+                    dm.bits[i] ^= 1;
 
-            if ((NRZrawDemod(0, 1, 1, false) == PM3_SUCCESS) && test(DEMOD_NRZ, &tests[hits].offset, &bitRate, clk, &tests[hits].Q5)) {
-                tests[hits].modulation = DEMOD_NRZ;
-                tests[hits].bitrate = bitRate;
-                tests[hits].inverted = true;
-                tests[hits].block0 = PackBits(tests[hits].offset, 32, g_DemodBuffer);
-                tests[hits].ST = false;
-                tests[hits].downlink_mode = downlink_mode;
-                ++hits;
+                t55xx_detect_add(tests, found, &hits, &dm, DEMOD_NRZ, clk, DEMOD_NRZ, true, false, downlink_mode);
             }
         }
 
-        clk = GetPskClock("", false);
+        // see GetPskClock
+        size_t firstPhaseShiftLoc = 0;
+        uint8_t curPhase = 0, fc = 0;
+        clk = DetectPSKClock(d.samples, d.len, 0, &firstPhaseShiftLoc, &curPhase, &fc);
         if (clk > 0) {
-            // allow undo
-            save_restoreGB(GRAPH_SAVE);
             // skip first 160 samples to allow antenna to settle in (psk gets inverted occasionally otherwise)
-            CmdLtrim("-i 160");
-            if ((PSKDemod(0, 0, 6, false) == PM3_SUCCESS) && test(DEMOD_PSK1, &tests[hits].offset, &bitRate, clk, &tests[hits].Q5)) {
-                tests[hits].modulation = DEMOD_PSK1;
-                tests[hits].bitrate = bitRate;
-                tests[hits].inverted = false;
-                tests[hits].block0 = PackBits(tests[hits].offset, 32, g_DemodBuffer);
-                tests[hits].ST = false;
-                tests[hits].downlink_mode = downlink_mode;
-                ++hits;
-            }
-            if ((PSKDemod(0, 1, 6, false) == PM3_SUCCESS) && test(DEMOD_PSK1, &tests[hits].offset, &bitRate, clk, &tests[hits].Q5)) {
-                tests[hits].modulation = DEMOD_PSK1;
-                tests[hits].bitrate = bitRate;
-                tests[hits].inverted = true;
-                tests[hits].block0 = PackBits(tests[hits].offset, 32, g_DemodBuffer);
-                tests[hits].ST = false;
-                tests[hits].downlink_mode = downlink_mode;
-                ++hits;
-            }
-            //ICEMAN: are these PSKDemod calls needed?
-            // PSK2 - needs a call to psk1TOpsk2.
-            if (PSKDemod(0, 0, 6, false) == PM3_SUCCESS) {
-                psk1TOpsk2(g_DemodBuffer, g_DemodBufferLen);
-                if (test(DEMOD_PSK2, &tests[hits].offset, &bitRate, clk, &tests[hits].Q5)) {
-                    tests[hits].modulation = DEMOD_PSK2;
-                    tests[hits].bitrate = bitRate;
-                    tests[hits].inverted = false;
-                    tests[hits].block0 = PackBits(tests[hits].offset, 32, g_DemodBuffer);
-                    tests[hits].ST = false;
-                    tests[hits].downlink_mode = downlink_mode;
-                    ++hits;
-                }
-            } // inverse waves does not affect this demod
-            // PSK3 - needs a call to psk1TOpsk2.
-            if (PSKDemod(0, 0, 6, false) == PM3_SUCCESS) {
-                psk1TOpsk2(g_DemodBuffer, g_DemodBufferLen);
-                if (test(DEMOD_PSK3, &tests[hits].offset, &bitRate, clk, &tests[hits].Q5)) {
-                    tests[hits].modulation = DEMOD_PSK3;
-                    tests[hits].bitrate = bitRate;
-                    tests[hits].inverted = false;
-                    tests[hits].block0 = PackBits(tests[hits].offset, 32, g_DemodBuffer);
-                    tests[hits].ST = false;
-                    tests[hits].downlink_mode = downlink_mode;
-                    ++hits;
+            size_t trim = (d.len > 160) ? 160 : 0;
+            const uint8_t *src = d.samples + trim;
+            size_t len = d.len - trim;
+
+            if (t55xx_demod_psk(&d, src, len, 0, &dm)) {
+                dm.start_idx += trim;
+                t55xx_detect_add(tests, found, &hits, &dm, DEMOD_PSK1, clk, DEMOD_PSK1, false, false, downlink_mode);
+
+                // PSK2 and PSK3 are both tested on the psk1TOpsk2 conversion of the non inverted PSK1 demod,
+                // inverse waves does not affect these.   The ASK demods are done,  reuse their buffer
+                t55xx_demod_t psk2 = dm;
+                psk2.bits = d.st_samples;
+                memcpy(psk2.bits, dm.bits, dm.len);
+                psk1TOpsk2(psk2.bits, psk2.len);
+
+                if (t55xx_demod_psk(&d, src, len, 1, &dm)) {
+                    dm.start_idx += trim;
+                    t55xx_detect_add(tests, found, &hits, &dm, DEMOD_PSK1, clk, DEMOD_PSK1, true, false, downlink_mode);
                 }
-            } // inverse waves does not affect this demod
-            //undo trim samples
-            save_restoreGB(GRAPH_RESTORE);
+                t55xx_detect_add(tests, found, &hits, &psk2, DEMOD_PSK2, clk, DEMOD_PSK2, false, false, downlink_mode);
+                t55xx_detect_add(tests, found, &hits, &psk2, DEMOD_PSK3, clk, DEMOD_PSK3, false, false, downlink_mode);
+            } else if (t55xx_demod_psk(&d, src, len, 1, &dm)) {
+                dm.start_idx += trim;
+                t55xx_detect_add(tests, found, &hits, &dm, DEMOD_PSK1, clk, DEMOD_PSK1, true, false, downlink_mode);
+            }
         }
     }
+    t55xx_detect_free(&d);
+
     if (hits == 1) {
+        t55xx_detect_select(&found[0]);
+        free(found[0].bits);
+
         config.modulation = tests[0].modulation;
         config.bitrate = tests[0].bitrate;
         config.inverted = tests[0].inverted;
@@ -1223,6 +1428,7 @@ bool t55xxTryDetectModulationEx(uint8_t downlink_mode, bool print_config, uint32
 
     bool retval = false;
     if (hits > 1) {
+        int selected = -1;
         PrintAndLogEx(SUCCESS, "Found [%d] possible matches for modulation.", hits);
         for (int i = 0; i < hits; ++i) {
 
@@ -1233,6 +1439,7 @@ bool t55xxTryDetectModulationEx(uint8_t downlink_mode, bool print_config, uint32
             retval = testKnownConfigBlock(tests[i].block0);
             if (retval || wanted) {
                 PrintAndLogEx(NORMAL, "--[%d]--------------- << selected this", i + 1);
+                selected = i;
                 config.modulation = tests[i].modulation;
                 config.bitrate = tests[i].bitrate;
                 config.inverted = tests[i].inverted;
@@ -1254,7 +1461,14 @@ bool t55xxTryDetectModulationEx(uint8_t downlink_mode, bool print_config, uint32
             if (print_config)
                 printConfiguration(tests[i]);
         }
+
+        if (selected >= 0)
+            t55xx_detect_select(&found[selected]);
     }
+
+    for (int i = 0; i < hits; ++i)
+        free(found[i].bits);
+
     return retval;
 }
 
@@ -1388,38 +1602,38 @@ static int convertQ5bitRate(uint8_t bitRateRead) {
     return -1;
 }
 
-static bool testQ5(uint8_t mode, uint8_t *offset, int *fndBitRate, uint8_t clk) {
+static bool testQ5(const uint8_t *bits, size_t len, uint8_t mode, uint8_t *offset, int *fndBitRate, uint8_t clk) {
 
-    if (g_DemodBufferLen < 64) return false;
+    if (len < 64) return false;
 
     for (uint8_t idx = 28; idx < 64; idx++) {
         uint8_t si = idx;
-        if (PackBits(si, 28, g_DemodBuffer) == 0x00) continue;
+        if (PackBits(si, 28, bits) == 0x00) continue;
 
-        uint8_t safer     = PackBits(si, 4, g_DemodBuffer);
+        uint8_t safer     = PackBits(si, 4, bits);
         si += 4;     //master key
-        uint8_t resv      = PackBits(si, 8, g_DemodBuffer);
+        uint8_t resv      = PackBits(si, 8, bits);
         si += 8;
         // 2nibble must be zeroed.
         if (safer != 0x6 && safer != 0x9) continue;
         if (resv > 0x00) continue;
-        //uint8_t pageSel   = PackBits(si, 1, g_DemodBuffer); si += 1;
-        //uint8_t fastWrite = PackBits(si, 1, g_DemodBuffer); si += 1;
+        //uint8_t pageSel   = PackBits(si, 1, bits); si += 1;
+        //uint8_t fastWrite = PackBits(si, 1, bits); si += 1;
         si += 1 + 1;
-        int bitRate       = PackBits(si, 6, g_DemodBuffer) * 2 + 2;
+        int bitRate       = PackBits(si, 6, bits) * 2 + 2;
         si += 6;     //bit rate
         if (bitRate > 128 || bitRate < 8) continue;
 
-        //uint8_t AOR       = PackBits(si, 1, g_DemodBuffer); si += 1;
-        //uint8_t PWD       = PackBits(si, 1, g_DemodBuffer); si += 1;
-        //uint8_t pskcr     = PackBits(si, 2, g_DemodBuffer); si += 2;  //could check psk cr
-        //uint8_t inverse   = PackBits(si, 1, g_DemodBuffer); si += 1;
+        //uint8_t AOR       = PackBits(si, 1, bits); si += 1;
+        //uint8_t PWD       = PackBits(si, 1, bits); si += 1;
+        //uint8_t pskcr     = PackBits(si, 2, bits); si += 2;  //could check psk cr
+        //uint8_t inverse   = PackBits(si, 1, bits); si += 1;
         si += 1 + 1 + 2 + 1;
-        uint8_t modread   = PackBits(si, 3, g_DemodBuffer);
+        uint8_t modread   = PackBits(si, 3, bits);
         si += 3;
-        uint8_t maxBlk    = PackBits(si, 3, g_DemodBuffer);
+        uint8_t maxBlk    = PackBits(si, 3, bits);
         si += 3;
-        //uint8_t ST        = PackBits(si, 1, g_DemodBuffer); si += 1;
+        //uint8_t ST        = PackBits(si, 1, bits); si += 1;
         if (maxBlk == 0) continue;
 
         //test modulation
@@ -1445,29 +1659,34 @@ static bool testBitRate(uint8_t readRate, uint8_t clk) {
 }
 
 bool test(uint8_t mode, uint8_t *offset, int *fndBitRate, uint8_t clk, bool *Q5) {
+    return t55xxTestBits(g_DemodBuffer, g_DemodBufferLen, mode, offset, fndBitRate, clk, Q5);
+}
 
-    if (g_DemodBufferLen < 64) return false;
+// looks for a valid T55x7 / Q5 configuration block in demodulated bits
+static bool t55xxTestBits(const uint8_t *bits, size_t len, uint8_t mode, uint8_t *offset, int *fndBitRate, uint8_t clk, bool *Q5) {
+
+    if (len < 64) return false;
     for (uint8_t idx = 28; idx < 64; idx++) {
         uint8_t si = idx;
-        if (PackBits(si, 28, g_DemodBuffer) == 0x00) continue;
+        if (PackBits(si, 28, bits) == 0x00) continue;
 
-        uint8_t safer    = PackBits(si, 4, g_DemodBuffer);
+        uint8_t safer    = PackBits(si, 4, bits);
         si += 4;     //master key
-        uint8_t resv     = PackBits(si, 4, g_DemodBuffer);
+        uint8_t resv     = PackBits(si, 4, bits);
         si += 4;     //was 7 & +=7+3 //should be only 4 bits if extended mode
         // 2nibble must be zeroed.
         // moved test to here, since this gets most faults first.
         if (resv > 0x00) continue;
 
-        int bitRate      = PackBits(si, 6, g_DemodBuffer);
+        int bitRate      = PackBits(si, 6, bits);
         si += 6;     //bit rate (includes extended mode part of rate)
-        uint8_t extend   = PackBits(si, 1, g_DemodBuffer);
+        uint8_t extend   = PackBits(si, 1, bits);
         si += 1;     //bit 15 extended mode
-        uint8_t modread  = PackBits(si, 5, g_DemodBuffer);
+        uint8_t modread  = PackBits(si, 5, bits);
         si += 5 + 2 + 1;
-        //uint8_t pskcr   = PackBits(si, 2, g_DemodBuffer); si += 2+1;  //could check psk cr
-        //uint8_t nml01    = PackBits(si, 1, g_DemodBuffer); si += 1+5;   //bit 24, 30, 31 could be tested for 0 if not extended mode
-        //uint8_t nml02    = PackBits(si, 2, g_DemodBuffer); si += 2;
+        //uint8_t pskcr   = PackBits(si, 2, bits); si += 2+1;  //could check psk cr
+        //uint8_t nml01    = PackBits(si, 1, bits); si += 1+5;   //bit 24, 30, 31 could be tested for 0 if not extended mode
+        //uint8_t nml02    = PackBits(si, 2, bits); si += 2;
 
         //if extended mode
         bool extMode = ((safer == 0x6 || safer == 0x9) && extend) ? true : false;
@@ -1486,7 +1705,7 @@ bool test(uint8_t mode, uint8_t *offset, int *fndBitRate, uint8_t clk, bool *Q5)
         *Q5 = false;
         return true;
     }
-    if (testQ5(mode, offset, fndBitRate, clk)) {
+    if (testQ5(bits, len, mode, offset, fndBitRate, clk)) {
         *Q5 = true;
         return true;
     }
@@ -3024,6 +3243,105 @@ static bool IsCancelled(void) {
     return false;
 }
 
+// Batched password check.  The device tries as many passwords per command as its memory holds
+// and keeps every block 0 read.  The modulation detection runs on each downloaded read, only the
+// passwords whose read demodulates are read again from the tag and verified.
+// found is set like t55xx_try_one_password(),  > 0 if found xx1 xx downlink needed, 1 found
+static int t55xx_sweep_pwds(const uint32_t *pwds, uint32_t count, uint8_t downlink_mode, bool try_all_dl_modes, uint32_t *found_pwd, uint8_t *found) {
+
+    *found = 0;
+
+    // ensure 0-3
+    downlink_mode = (downlink_mode & 3);
+
+    for (uint8_t dl_mode = downlink_mode; dl_mode < 4; dl_mode++) {
+
+        uint32_t c = 0;
+        while (c < count) {
+
+            if (IsCancelled()) {
+                return PM3_EOPABORTED;
+            }
+
+            if (g_session.pm3_present == false) {
+                PrintAndLogEx(WARNING, "device offline\n");
+                return PM3_ENODATA;
+            }
+
+            t55xx_sweep_pwds_t payload = {
+                .flags = dl_mode << 3,
+                .count = MIN(count - c, T55XX_SWEEP_MAX_PWDS),
+            };
+            memcpy(payload.pwds, pwds + c, payload.count * sizeof(uint32_t));
+
+            clearCommandBuffer();
+            SendCommandNG(CMD_LF_T55XX_SWEEP_PWDS, (uint8_t *)&payload, sizeof(payload));
+            PacketResponseNG resp;
+
+            uint8_t timeout = 0;
+            while (WaitForResponseTimeout(CMD_LF_T55XX_SWEEP_PWDS, &resp, 2000) == false) {
+                timeout++;
+                PrintAndLogEx(NORMAL, "." NOLF);
+                if (timeout > 10) {
+                    PrintAndLogEx(WARNING, "\nno response from Proxmark3. Aborting...");
+                    return PM3_ETIMEOUT;
+                }
+            }
+
+            if (resp.status == PM3_EOPABORTED) {
+                PrintAndLogEx(WARNING, "\naborted on device");
+                return PM3_EOPABORTED;
+            }
+
+            const t55xx_sweep_reply_t *reply = (const t55xx_sweep_reply_t *)resp.data.asBytes;
+            uint8_t n = MIN(reply->count, payload.count);
+            if (resp.status != PM3_SUCCESS || n == 0) {
+                PrintAndLogEx(WARNING, "device has no room for the sweep");
+                return PM3_EMALLOC;
+            }
+
+            PrintAndLogEx(INFO, "testing %08"PRIX32" .. %08"PRIX32, pwds[c], pwds[c + n - 1]);
+
+            // the reads are overwritten by the next acquisition, demodulate them all before verifying
+            uint8_t candidates[T55XX_SWEEP_MAX_PWDS];
+            uint8_t cnt = 0;
+            for (uint8_t i = 0; i < n; i++) {
+                uint32_t start = reply->offset + (i * T55XX_SWEEP_SAMPLES);
+                if (getSamplesEx(start, start + T55XX_SWEEP_SAMPLES, false, true) != PM3_SUCCESS) {
+                    return PM3_ETIMEOUT;
+                }
+
+                if (getSignalProperties()->isnoise) {
+                    continue;
+                }
+
+                if (t55xxTryDetectModulationEx(dl_mode, T55XX_DontPrintConfig, 0, pwds[c + i])) {
+                    candidates[cnt++] = i;
+                }
+            }
+
+            for (uint8_t i = 0; i < cnt; i++) {
+                uint32_t curr_password = pwds[c + candidates[i]];
+                PrintAndLogEx(INFO, "verifying candidate %08"PRIX32, curr_password);
+                if (AcquireData(T55x7_PAGE0, T55x7_CONFIGURATION_BLOCK, true, curr_password, dl_mode)) {
+                    if (t55xxTryDetectModulationEx(dl_mode, T55XX_PrintConfig, 0, curr_password)) {
+                        *found_pwd = curr_password;
+                        *found = 1 + (dl_mode << 1);
+                        return PM3_SUCCESS;
+                    }
+                }
+            }
+
+            c += n;
+        }
+
+        if (try_all_dl_modes == false) {
+            break;
+        }
+    }
+    return PM3_SUCCESS;
+}
+
 // load a default pwd file.
 static int CmdT55xxChkPwds(const char *Cmd) {
     CLIParserContext *ctx;
@@ -3034,23 +3352,25 @@ static int CmdT55xxChkPwds(const char *Cmd) {
                   _RED_("WARNING:") _CYAN_(" this may brick non-password protected chips!"),
                   "lf t55xx chk -m                     -> use dictionary from flash memory (RDV4)\n"
                   "lf t55xx chk -f my_dictionary_pwds  -> loads a default keys dictionary file\n"
+                  "lf t55xx chk -f my_dictionary_pwds --batch -> sweep the dictionary on device\n"
                   "lf t55xx chk --em aa11223344        -> try known pwdgen algo from some cloners based on EM4100 ID"
                  );
 
     /*
       Calculate size of argtable accordingly:
-      1 (help) + 3 (three user specified params) + ( 5 or 6  T55XX_DLMODE)
-      start index to call arg_add_t55xx_downloadlink() is 4 (1 + 3) given the above sample
+      1 (help) + 4 (four user specified params) + ( 5 or 6  T55XX_DLMODE)
+      start index to call arg_add_t55xx_downloadlink() is 5 (1 + 4) given the above sample
     */
 
-    // 1 (help) + 3 (three user specified params) + (6 T55XX_DLMODE_ALL)
-    void *argtable[4 + 6] = {
+    // 1 (help) + 4 (four user specified params) + (6 T55XX_DLMODE_ALL)
+    void *argtable[5 + 6] = {
         arg_param_begin,
         arg_lit0("m", "fm", "use dictionary from flash memory (RDV4)"),
         arg_str0("f", "file", "<fn>", "file name"),
         arg_str0(NULL, "em", "<hex>", "EM4100 ID (5 hex bytes)"),
+        arg_lit0(NULL, "batch", "sweep passwords on device, demodulate every read"),
     };
-    uint8_t idx = 4;
+    uint8_t idx = 5;
     arg_add_t55xx_downloadlink(argtable, &idx, T55XX_DLMODE_ALL, T55XX_DLMODE_ALL);
     CLIExecWithReturn(ctx, Cmd, argtable, true);
 
@@ -3080,11 +3400,12 @@ static int CmdT55xxChkPwds(const char *Cmd) {
         return PM3_EINVARG;
     }
 
-    bool r0 = arg_get_lit(ctx, 4);
-    bool r1 = arg_get_lit(ctx, 5);
-    bool r2 = arg_get_lit(ctx, 6);
-    bool r3 = arg_get_lit(ctx, 7);
-    bool ra = arg_get_lit(ctx, 8);
+    bool use_batch = arg_get_lit(ctx, 4);
+    bool r0 = arg_get_lit(ctx, 5);
+    bool r1 = arg_get_lit(ctx, 6);
+    bool r2 = arg_get_lit(ctx, 7);
+    bool r3 = arg_get_lit(ctx, 8);
+    bool ra = arg_get_lit(ctx, 9);
     CLIParserFree(ctx);
 
     if ((r0 + r1 + r2 + r3 + ra) > 1) {
@@ -3092,6 +3413,11 @@ static int CmdT55xxChkPwds(const char *Cmd) {
         return PM3_EINVARG;
     }
 
+    if (use_batch && (from_flash || use_calc_password)) {
+        PrintAndLogEx(FAILED, "--batch sweeps a dictionary file, it can't be used with -m or --em");
+        return PM3_EINVARG;
+    }
+
     uint8_t downlink_mode = refFixedBit; // Password checks should always start with default/fixed bit unluess requested by user for specific mode
     //  if (r0 || ra) // ra should start downlink mode ad fixed bit to loop through all modes correctly
     //      downlink_mode = refFixedBit;
@@ -3207,7 +3533,35 @@ static int CmdT55xxChkPwds(const char *Cmd) {
 
         PrintAndLogEx(INFO, "press " _GREEN_("<Enter>") " to exit");
 
-        for (uint32_t c = 0; c < keycount && found == false; ++c) {
+        if (use_batch) {
+            uint32_t *pwds = calloc(keycount, sizeof(uint32_t));
+            if (pwds == NULL) {
+                PrintAndLogEx(WARNING, "Failed to allocate memory");
+                free(keyblock);
+                return PM3_EMALLOC;
+            }
+
+            for (uint32_t c = 0; c < keycount; ++c) {
+                pwds[c] = bytes_to_num(keyblock + 4 * c, 4);
+            }
+
+            uint32_t curr_password = 0;
+            uint8_t dl_found = 0;
+            res = t55xx_sweep_pwds(pwds, keycount, downlink_mode, ra, &curr_password, &dl_found);
+            free(pwds);
+            if (res != PM3_SUCCESS) {
+                free(keyblock);
+                return res;
+            }
+
+            if (dl_found) {
+                found = true;
+                PrintAndLogEx(SUCCESS, "found valid password: [ " _GREEN_("%08"PRIX32) " ]", curr_password);
+            }
+        }
+
+        // the sweep already tried every password
+        for (uint32_t c = 0; c < keycount && found == false && use_batch == false; ++c) {
 
             if (!g_session.pm3_present) {
                 PrintAndLogEx(WARNING, "device offline\n");
@@ -3259,15 +3613,17 @@ static int CmdT55xxBruteForce(const char *Cmd) {
                   "Try reading Page 0, block 7 before.\n\n"
                   _RED_("WARNING") _CYAN_(" this may brick non-password protected chips!"),
                   "lf t55xx bruteforce --r2 -s aaaaaa77 -e aaaaaa99\n"
+                  "lf t55xx bruteforce --batch -s aaaaaa00 -e aaaaaaff\n"
                  );
 
-    // 1 (help) + 2 (two user specified params) + (6 T55XX_DLMODE_ALL)
-    void *argtable[3 + 6] = {
+    // 1 (help) + 3 (three user specified params) + (6 T55XX_DLMODE_ALL)
+    void *argtable[4 + 6] = {
         arg_param_begin,
         arg_str1("s", "start", "<hex>", "search start password (4 hex bytes)"),
         arg_str1("e", "end", "<hex>", "search end password (4 hex bytes)"),
+        arg_lit0(NULL, "batch", "sweep passwords on device, demodulate every read"),
     };
-    uint8_t idx = 3;
+    uint8_t idx = 4;
     arg_add_t55xx_downloadlink(argtable, &idx, T55XX_DLMODE_ALL, T55XX_DLMODE_ALL);
     CLIExecWithReturn(ctx, Cmd, argtable, true);
 
@@ -3287,11 +3643,12 @@ static int CmdT55xxBruteForce(const char *Cmd) {
         return PM3_EINVARG;
     }
 
-    bool r0 = arg_get_lit(ctx, 3);
-    bool r1 = arg_get_lit(ctx, 4);
-    bool r2 = arg_get_lit(ctx, 5);
-    bool r3 = arg_get_lit(ctx, 6);
-    bool ra = arg_get_lit(ctx, 7);
+    bool use_batch = arg_get_lit(ctx, 3);
+    bool r0 = arg_get_lit(ctx, 4);
+    bool r1 = arg_get_lit(ctx, 5);
+    bool r2 = arg_get_lit(ctx, 6);
+    bool r3 = arg_get_lit(ctx, 7);
+    bool ra = arg_get_lit(ctx, 8);
     CLIParserFree(ctx);
 
     if ((r0 + r1 + r2 + r3 + ra) > 1) {
@@ -3325,6 +3682,37 @@ static int CmdT55xxBruteForce(const char *Cmd) {
     uint64_t t1 = msclock();
     curr = start_password;
 
+    if (use_batch) {
+        uint32_t pwds[T55XX_SWEEP_MAX_PWDS * 4];
+        uint64_t next = start_password;
+
+        while (found == 0 && next <= end_password) {
+
+            uint32_t cnt = 0;
+            while (cnt < ARRAYLEN(pwds) && next <= end_password) {
+                pwds[cnt++] = (uint32_t)next++;
+            }
+
+            res = t55xx_sweep_pwds(pwds, cnt, downlink_mode, ra, &curr, &found);
+            if (res != PM3_SUCCESS) {
+                return res;
+            }
+        }
+
+        if (found) {
+            PrintAndLogEx(SUCCESS, "Found valid password: [ " _GREEN_("%08X") " ]", curr);
+            T55xx_Print_DownlinkMode((found >> 1) & 3);
+            t1 = msclock() - t1;
+            PrintAndLogEx(SUCCESS, "\ntime in bruteforce " _YELLOW_("%.0f") " seconds\n", (float)t1 / 1000.0);
+            return PM3_SUCCESS;
+        }
+
+        PrintAndLogEx(WARNING, "Bruteforce failed, last tried: [ " _YELLOW_("%08X") " ]", end_password);
+        t1 = msclock() - t1;
+        PrintAndLogEx(SUCCESS, "\ntime in bruteforce " _YELLOW_("%.0f") " seconds\n", (float)t1 / 1000.0);
+        return PM3_SUCCESS;
+    }
+
     while (found == 0) {
 
         PrintAndLogEx(NORMAL, "." NOLF);
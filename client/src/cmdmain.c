@@ -47,6 +47,7 @@
 #include "commonutil.h"   // ARRAYLEN
 #include "preferences.h"
 #include "cliparser.h"
+#include "graph.h"       // GraphBufferSync
 
 static int CmdHelp(const char *Cmd);
 
@@ -352,7 +353,9 @@ static int CmdHelp(const char *Cmd) {
 // then presses Enter, which the full command line that they typed.
 //-----------------------------------------------------------------------------
 int CommandReceived(const char *Cmd) {
-    return CmdsParse(CommandTable, Cmd);
+    int res = CmdsParse(CommandTable, Cmd);
+    GraphBufferSync();
+    return res;
 }
 
 command_t *getTopLevelCommandTable(void) {
@@ -38,6 +38,8 @@
 #include "ui.h"
 #include "fileutils.h"
 #include "cliparser.h"    // cliparsing
+#include "cmddata.h"      // g_DemodBuffer
+#include "graph.h"        // g_GraphBuffer
 
 #ifdef HAVE_LUA_SWIG
 extern int luaopen_pm3(lua_State *L);
@@ -106,6 +108,157 @@ done:
     Py_XDECREF(m);
     return ret;
 }
+
+// Built-in "pm3buffer" module, gives Python scripts zero-copy access to the client buffers
+// through memoryviews and a batched command API. Mirrors core.buffer / core.transceive in Lua.
+
+static PyObject *pm3buffer_demod(PyObject *self, PyObject *args) {
+    return PyMemoryView_FromMemory((char *)g_DemodBuffer, g_DemodBufferLen, PyBUF_WRITE);
+}
+
+static PyObject *pm3buffer_graph(PyObject *self, PyObject *args) {
+    PyObject *mv = PyMemoryView_FromMemory((char *)g_GraphBuffer, g_GraphTraceLen * sizeof(int), PyBUF_WRITE);
+    if (mv == NULL)
+        return NULL;
+
+    PyObject *res = PyObject_CallMethod(mv, "cast", "s", "i");
+    Py_DECREF(mv);
+    return res;
+}
+
+// get_bigbuf(start, length, out=None, offset=0), downloads into any writable buffer
+static PyObject *pm3buffer_get_bigbuf(PyObject *self, PyObject *args) {
+    unsigned int start, len;
+    PyObject *out = Py_None;
+    Py_ssize_t offset = 0;
+    if (!PyArg_ParseTuple(args, "II|On", &start, &len, &out, &offset))
+        return NULL;
+
+    if (out == Py_None) {
+        out = PyByteArray_FromStringAndSize(NULL, len);
+        if (out == NULL)
+            return NULL;
+    } else {
+        Py_INCREF(out);
+    }
+
+    Py_buffer view;
+    if (PyObject_GetBuffer(out, &view, PyBUF_WRITABLE) < 0) {
+        Py_DECREF(out);
+        return NULL;
+    }
+    if (offset < 0 || offset > view.len || len > view.len - offset) {
+        PyBuffer_Release(&view);
+        Py_DECREF(out);
+        PyErr_SetString(PyExc_ValueError, "buffer too small");
+        return NULL;
+    }
+
+    bool ok = GetFromDevice(BIG_BUF, (uint8_t *)view.buf + offset, len, start, NULL, 0, NULL, 2500, false);
+    PyBuffer_Release(&view);
+    if (ok == false) {
+        Py_DECREF(out);
+        PyErr_SetString(PyExc_TimeoutError, "command execution time out");
+        return NULL;
+    }
+    return out;
+}
+
+// transceive(requests, timeout=2500), requests is a sequence of (cmd, data) with bytes-like data.
+// Returns (bytearray of all reply payloads, [(cmd, status, offset, length), ...])
+static PyObject *pm3buffer_transceive(PyObject *self, PyObject *args) {
+    PyObject *obj;
+    unsigned int ms_timeout = 2500;
+    if (!PyArg_ParseTuple(args, "O|I", &obj, &ms_timeout))
+        return NULL;
+
+    PyObject *seq = PySequence_Fast(obj, "requests must be a sequence");
+    if (seq == NULL)
+        return NULL;
+
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(seq);
+    script_request_t *requests = calloc(count + 1, sizeof(script_request_t));
+    script_reply_t *replies = calloc(count + 1, sizeof(script_reply_t));
+    Py_buffer *views = calloc(count + 1, sizeof(Py_buffer));
+    PyObject *out = NULL, *list = NULL;
+    Py_ssize_t parsed = 0;
+    if (requests == NULL || replies == NULL || views == NULL) {
+        PyErr_NoMemory();
+        goto done;
+    }
+
+    for (; parsed < count; parsed++) {
+        unsigned short cmd;
+        views[parsed].buf = NULL;
+        if (!PyArg_ParseTuple(PySequence_Fast_GET_ITEM(seq, parsed), "H|y*", &cmd, &views[parsed]))
+            goto done;
+
+        if (views[parsed].len > PM3_CMD_DATA_SIZE) {
+            PyErr_Format(PyExc_ValueError, "request %zd data too long", parsed + 1);
+            PyBuffer_Release(&views[parsed]);
+            goto done;
+        }
+        requests[parsed].cmd = cmd;
+        requests[parsed].data = views[parsed].buf;
+        requests[parsed].len = views[parsed].len;
+    }
+
+    if (g_session.pm3_present == false) {
+        PyErr_SetString(PyExc_ConnectionError, "no device connected");
+        goto done;
+    }
+
+    out = PyByteArray_FromStringAndSize(NULL, count * PM3_CMD_DATA_SIZE);
+    if (out == NULL)
+        goto done;
+
+    size_t got = ScriptTransceiveNG(requests, count, (uint8_t *)PyByteArray_AS_STRING(out), count * PM3_CMD_DATA_SIZE, replies, ms_timeout);
+    if (got != (size_t)count) {
+        PyErr_Format(PyExc_TimeoutError, "no response from the device to request %zu of %zd", got + 1, count);
+        Py_CLEAR(out);
+        goto done;
+    }
+
+    size_t used = count ? replies[count - 1].offset + replies[count - 1].length : 0;
+    list = PyList_New(count);
+    if (list == NULL || PyByteArray_Resize(out, used) < 0) {
+        Py_CLEAR(out);
+        Py_CLEAR(list);
+        goto done;
+    }
+    for (Py_ssize_t i = 0; i < count; i++) {
+        PyList_SET_ITEM(list, i, Py_BuildValue("(HhII)", replies[i].cmd, replies[i].status, replies[i].offset, replies[i].length));
+    }
+
+done:
+    for (Py_ssize_t i = 0; i < parsed; i++) {
+        if (views[i].buf != NULL)
+            PyBuffer_Release(&views[i]);
+    }
+    free(requests);
+    free(replies);
+    free(views);
+    Py_DECREF(seq);
+    if (out == NULL)
+        return NULL;
+    return Py_BuildValue("(NN)", out, list);
+}
+
+static PyMethodDef pm3buffer_methods[] = {
+    {"demod",      pm3buffer_demod,      METH_NOARGS,  "memoryview of the demod buffer"},
+    {"graph",      pm3buffer_graph,      METH_NOARGS,  "memoryview of the graph buffer samples"},
+    {"get_bigbuf", pm3buffer_get_bigbuf, METH_VARARGS, "get_bigbuf(start, length, out=None, offset=0) download BigBuf into a writable buffer"},
+    {"transceive", pm3buffer_transceive, METH_VARARGS, "transceive(requests, timeout=2500) send a batch of (cmd, data) commands"},
+    {NULL, NULL, 0, NULL}
+};
+
+static struct PyModuleDef pm3buffer_module = {
+    PyModuleDef_HEAD_INIT, "pm3buffer", NULL, -1, pm3buffer_methods, NULL, NULL, NULL, NULL
+};
+
+static PyObject *PyInit_pm3buffer(void) {
+    return PyModule_Create(&pm3buffer_module);
+}
 #endif // HAVE_PYTHON
 
 typedef enum {
@@ -412,6 +565,7 @@ static int CmdScriptRun(const char *Cmd) {
         // hook Proxmark3 API
         PyImport_AppendInittab("_pm3", PyInit__pm3);
 #endif
+        PyImport_AppendInittab("pm3buffer", PyInit_pm3buffer);
         Py_Initialize();
 
         //int argc, char ** argv
@@ -858,6 +858,121 @@ static int CmdSmartList(const char *Cmd) {
     return CmdTraceListAlias(Cmd, "smart", "7816");
 }
 
+// ATR as upper case hex without separators, false if there is anything but hex digits, spaces and colons
+static bool smart_atr_normalize(const char *in, char *out, size_t maxlen) {
+    size_t n = 0;
+    for (const char *p = in; *p; p++) {
+        if (isspace((uint8_t)*p) || *p == ':')
+            continue;
+        if (isxdigit((uint8_t)*p) == 0 || n + 1 >= maxlen)
+            return false;
+        out[n++] = toupper((uint8_t)*p);
+    }
+    out[n] = '\0';
+    return (n > 0 && (n & 1) == 0);
+}
+
+static void smart_atr_print(const char *atr) {
+    // descriptions can span several lines,  keep one line per ATR
+    const char *desc = getAtrInfo(atr);
+    char line[strlen(desc) * 2 + 1];
+    size_t n = 0;
+    for (const char *p = desc; *p; p++) {
+        if (*p == '\n') {
+            line[n++] = ';';
+            line[n++] = ' ';
+        } else {
+            line[n++] = *p;
+        }
+    }
+    line[n] = '\0';
+    PrintAndLogEx(SUCCESS, "%s | %s", atr, line);
+}
+
+static int CmdSmartAtr(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "smart atr",
+                  "Identify ATRs against the fingerprint table, no device needed.\n"
+                  "With a file every line holds one ATR, bytes may be separated by spaces or colons.",
+                  "smart atr -d 3B021450          -> identify one ATR\n"
+                  "smart atr -f atrs.txt          -> identify every ATR in file\n"
+                  "smart atr -t                   -> selftest"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str0("d", "data", "<hex>", "ATR bytes"),
+        arg_str0("f", "file", "<fn>", "file with one ATR per line"),
+        arg_lit0("t", "test", "selftest"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+
+    int dlen = 0;
+    char data[2 * 64 + 1] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)data, sizeof(data) - 1, &dlen);
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 2), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+    bool selftest = arg_get_lit(ctx, 3);
+    CLIParserFree(ctx);
+
+    if (selftest) {
+        return AtrSelfTest() ? PM3_SUCCESS : PM3_ESOFT;
+    }
+
+    char atr[2 * 64 + 1];
+    if (dlen) {
+        if (smart_atr_normalize(data, atr, sizeof(atr)) == false) {
+            PrintAndLogEx(ERR, "ATR must be hex bytes");
+            return PM3_EINVARG;
+        }
+        smart_atr_print(atr);
+        return PM3_SUCCESS;
+    }
+
+    if (fnlen == 0) {
+        PrintAndLogEx(ERR, "empty input");
+        return PM3_EINVARG;
+    }
+
+    FILE *f = fopen(filename, "r");
+    if (f == NULL) {
+        PrintAndLogEx(ERR, "file not found or locked `" _YELLOW_("%s") "`", filename);
+        return PM3_EFILE;
+    }
+
+    char line[256];
+    uint32_t lineno = 0, identified = 0, unknown = 0, invalid = 0;
+    const char *nomatch = getAtrInfo("");
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        strcleanrn(line, sizeof(line));
+
+        char *p = line;
+        while (isspace((uint8_t)*p)) p++;
+        if (*p == '\0' || *p == '#')
+            continue;
+
+        if (smart_atr_normalize(p, atr, sizeof(atr)) == false) {
+            PrintAndLogEx(WARNING, "line %u, not an ATR `%s`", lineno, p);
+            invalid++;
+            continue;
+        }
+
+        if (getAtrInfo(atr) == nomatch)
+            unknown++;
+        else
+            identified++;
+        smart_atr_print(atr);
+    }
+    fclose(f);
+
+    PrintAndLogEx(INFO, "identified " _YELLOW_("%u") ", unknown %u, invalid %u", identified, unknown, invalid);
+    return PM3_SUCCESS;
+}
+
 static void smart_brute_prim(void) {
 
     uint8_t *buf = calloc(PM3_CMD_DATA_SIZE, sizeof(uint8_t));
@@ -1128,6 +1243,7 @@ static int CmdSmartBruteforceSFI(const char *Cmd) {
 static command_t CommandTable[] = {
     {"help",     CmdHelp,               AlwaysAvailable, "This help"},
     {"list",     CmdSmartList,          AlwaysAvailable, "List ISO 7816 history"},
+    {"atr",      CmdSmartAtr,           AlwaysAvailable, "Identify ATRs, single or from file"},
     {"info",     CmdSmartInfo,          IfPm3Smartcard,  "Tag information"},
     {"reader",   CmdSmartReader,        IfPm3Smartcard,  "Act like an IS07816 reader"},
     {"raw",      CmdSmartRaw,           IfPm3Smartcard,  "Send raw hex data to tag"},
@@ -30,6 +30,9 @@
 #include "wiegand_formats.h"
 #include "wiegand_formatutils.h"
 #include "util.h"
+#include "commonutil.h"       // ARRAYLEN
+#include "fileutils.h"         // saveFileJSONrootEx
+#include "jansson.h"
 
 static int CmdHelp(const char *Cmd);
 
@@ -111,18 +114,179 @@ int CmdWiegandEncode(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// one line of a batch file. hex lines get their bit length from the preamble like `--raw`
+static bool wiegand_parse_line(char *line, bool binlines, wiegand_message_t *packed) {
+    uint32_t top = 0, mid = 0, bot = 0;
+    int n = 0;
+    for (char *p = line; *p; p++, n++) {
+        if (binlines) {
+            if ((*p != '0' && *p != '1') || n >= 96)
+                return false;
+            top = (top << 1) | (mid >> 31);
+            mid = (mid << 1) | (bot >> 31);
+            bot = (bot << 1) | (*p - '0');
+        } else {
+            if (isxdigit((uint8_t)*p) == 0 || n >= 24)
+                return false;
+            uint8_t nib = isdigit((uint8_t)*p) ? *p - '0' : (tolower((uint8_t)*p) - 'a' + 10);
+            top = (top << 4) | (mid >> 28);
+            mid = (mid << 4) | (bot >> 28);
+            bot = (bot << 4) | nib;
+        }
+    }
+    if (n == 0)
+        return false;
+
+    *packed = initialize_message_object(top, mid, bot, (binlines) ? n : 0);
+    return true;
+}
+
+// decode every line of a file,  one row per matching format as csv or json
+static int wiegand_decode_file(const char *fn, bool binlines, const char *outfn) {
+    FILE *f = fopen(fn, "r");
+    if (f == NULL) {
+        PrintAndLogEx(ERR, "file not found or locked `" _YELLOW_("%s") "`", fn);
+        return PM3_EFILE;
+    }
+
+    bool json = (strlen(outfn) && str_endswith(outfn, ".json"));
+    FILE *out = NULL;
+    json_t *rows = NULL;
+    if (json) {
+        rows = json_array();
+    } else if (strlen(outfn)) {
+        out = fopen(outfn, "w");
+        if (out == NULL) {
+            PrintAndLogEx(ERR, "can't create file `" _YELLOW_("%s") "`", outfn);
+            fclose(f);
+            return PM3_EFILE;
+        }
+    }
+
+    const char *header = "line,raw,bits,format,fc,cn,issue,oem,parity";
+    if (out)
+        fprintf(out, "%s\n", header);
+    else if (json == false)
+        PrintAndLogEx(NORMAL, "%s", header);
+
+    char line[256];
+    uint32_t lineno = 0, decoded = 0, matches = 0, nomatch = 0, invalid = 0;
+    int idx[64];
+    wiegand_card_t cards[ARRAYLEN(idx)];
+
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+
+        char *p = line;
+        while (isspace((uint8_t)*p)) p++;
+        size_t len = strlen(p);
+        while (len && isspace((uint8_t)p[len - 1]))
+            p[--len] = '\0';
+
+        if (len == 0 || p[0] == '#')
+            continue;
+
+        wiegand_message_t packed;
+        if (wiegand_parse_line(p, binlines, &packed) == false) {
+            PrintAndLogEx(WARNING, "line %u, not a %s credential `%s`", lineno, (binlines) ? "binary" : "hex", p);
+            invalid++;
+            continue;
+        }
+        decoded++;
+
+        int found = HIDUnpackFormats(&packed, idx, cards, ARRAYLEN(idx));
+        if (found == 0)
+            nomatch++;
+        matches += found;
+
+        for (int i = 0; i < found; i++) {
+            cardformat_t fmt = HIDGetCardFormat(idx[i]);
+            wiegand_card_t *c = &cards[i];
+
+            if (json) {
+                json_t *r = json_object();
+                json_object_set_new(r, "line", json_integer(lineno));
+                json_object_set_new(r, "raw", json_string(p));
+                json_object_set_new(r, "bits", json_integer(packed.Length));
+                json_object_set_new(r, "format", json_string(fmt.Name));
+                if (fmt.Fields.hasFacilityCode)
+                    json_object_set_new(r, "fc", json_integer(c->FacilityCode));
+                if (fmt.Fields.hasCardNumber)
+                    json_object_set_new(r, "cn", json_integer(c->CardNumber));
+                if (fmt.Fields.hasIssueLevel)
+                    json_object_set_new(r, "issue", json_integer(c->IssueLevel));
+                if (fmt.Fields.hasOEMCode)
+                    json_object_set_new(r, "oem", json_integer(c->OEM));
+                if (fmt.Fields.hasParity)
+                    json_object_set_new(r, "parity", json_boolean(c->ParityValid));
+                json_array_append_new(rows, r);
+                continue;
+            }
+
+            char row[300];
+            int n = snprintf(row, sizeof(row), "%u,%s,%u,%s,", lineno, p, packed.Length, fmt.Name);
+            if (fmt.Fields.hasFacilityCode)
+                n += snprintf(row + n, sizeof(row) - n, "%u", c->FacilityCode);
+            n += snprintf(row + n, sizeof(row) - n, ",");
+            if (fmt.Fields.hasCardNumber)
+                n += snprintf(row + n, sizeof(row) - n, "%" PRIu64, c->CardNumber);
+            n += snprintf(row + n, sizeof(row) - n, ",");
+            if (fmt.Fields.hasIssueLevel)
+                n += snprintf(row + n, sizeof(row) - n, "%u", c->IssueLevel);
+            n += snprintf(row + n, sizeof(row) - n, ",");
+            if (fmt.Fields.hasOEMCode)
+                n += snprintf(row + n, sizeof(row) - n, "%u", c->OEM);
+            n += snprintf(row + n, sizeof(row) - n, ",");
+            if (fmt.Fields.hasParity)
+                snprintf(row + n, sizeof(row) - n, "%s", (c->ParityValid) ? "ok" : "fail");
+
+            if (out)
+                fprintf(out, "%s\n", row);
+            else
+                PrintAndLogEx(NORMAL, "%s", row);
+        }
+    }
+    fclose(f);
+
+    int res = PM3_SUCCESS;
+    if (out) {
+        fclose(out);
+        PrintAndLogEx(SUCCESS, "saved to csv file " _YELLOW_("%s"), outfn);
+    }
+    if (json) {
+        json_t *root = json_object();
+        json_object_set_new(root, "Created", json_string("proxmark3"));
+        json_object_set_new(root, "FileType", json_string("wiegand"));
+        json_object_set_new(root, "results", rows);
+        res = saveFileJSONrootEx(outfn, root, JSON_INDENT(2), true, true);
+        json_decref(root);
+    }
+
+    PrintAndLogEx(INFO, "lines " _YELLOW_("%u") ", matches " _YELLOW_("%u") ", without match %u, invalid %u", decoded, matches, nomatch, invalid);
+    return res;
+}
+
 int CmdWiegandDecode(const char *Cmd) {
 
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "wiegand decode",
-                  "Decode raw hex or binary to wiegand format",
-                  "wiegand decode --raw 2006f623ae"
+                  "Decode raw hex or binary to wiegand format.\n"
+                  "With a file every line is decoded and each matching format is listed as csv,\n"
+                  "or saved as csv / json by output file extension.",
+                  "wiegand decode --raw 2006f623ae\n"
+                  "wiegand decode -f creds.txt               -> hex per line, csv to console\n"
+                  "wiegand decode -f creds.txt --lbin -o out.json -> binary per line, saved as json\n"
+                  "wiegand decode -t                         -> selftest"
                  );
 
     void *argtable[] = {
         arg_param_begin,
         arg_str0("r", "raw", "<hex>", "raw hex to be decoded"),
         arg_str0("b", "bin", "<bin>", "binary string to be decoded"),
+        arg_str0("f", "file", "<fn>", "file with one raw hex credential per line"),
+        arg_lit0(NULL, "lbin", "file lines are binary strings"),
+        arg_str0("o", "out", "<fn>", "save file results, json if the name ends with .json, else csv"),
+        arg_lit0("t", "test", "selftest"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -133,13 +297,31 @@ int CmdWiegandDecode(const char *Cmd) {
     int blen = 0;
     uint8_t binarr[100] = {0x00};
     int res = CLIParamBinToBuf(arg_get_str(ctx, 2), binarr, sizeof(binarr), &blen);
+
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 3), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+    bool binlines = arg_get_lit(ctx, 4);
+
+    int outlen = 0;
+    char outfn[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 5), (uint8_t *)outfn, FILE_PATH_SIZE, &outlen);
+    bool selftest = arg_get_lit(ctx, 6);
     CLIParserFree(ctx);
 
+    if (selftest) {
+        return HIDSelfTest() ? PM3_SUCCESS : PM3_ESOFT;
+    }
+
     if (res) {
         PrintAndLogEx(FAILED, "Error parsing binary string");
         return PM3_EINVARG;
     }
 
+    if (fnlen) {
+        return wiegand_decode_file(filename, binlines, outfn);
+    }
+
     uint32_t top = 0, mid = 0, bot = 0;
 
     if (hlen) {
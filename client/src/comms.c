@@ -26,6 +26,7 @@
 #include "uart/uart.h"
 #include "ui.h"
 #include "crc16.h"
+#include "lz4/lz4.h"
 #include "util.h" // g_pendingPrompt
 #include "util_posix.h" // msclock
 #include "util_darwin.h" // en/dis-ableNapp();
@@ -69,7 +70,7 @@ static uint64_t timeout_start_time;
 
 static uint64_t last_packet_time;
 
-static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, size_t ms_timeout, bool show_warning, uint32_t rec_cmd);
+static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, size_t ms_timeout, bool show_warning, uint32_t rec_cmd, bool lz4);
 
 // Simple alias to track usages linked to the Bootloader, these commands must not be migrated.
 // - commands sent to enter bootloader mode as we might have to talk to old firmwares
@@ -813,20 +814,22 @@ bool GetFromDevice(DeviceMemType_t memtype, uint8_t *dest, uint32_t bytes, uint3
 
     switch (memtype) {
         case BIG_BUF: {
-            SendCommandMIX(CMD_DOWNLOAD_BIGBUF, start_index, bytes, 0, NULL, 0);
-            return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_DOWNLOADED_BIGBUF);
+            // compressed download if the firmware supports it and it isn't turned off in the preferences
+            bool lz4 = g_pm3_capabilities.compiled_with_bigbuf_lz4 && g_session.bigbuf_lz4;
+            SendCommandMIX(CMD_DOWNLOAD_BIGBUF, start_index, bytes, lz4 ? BIGBUF_DL_LZ4 : 0, NULL, 0);
+            return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_DOWNLOADED_BIGBUF, lz4);
         }
         case BIG_BUF_EML: {
             SendCommandMIX(CMD_DOWNLOAD_EML_BIGBUF, start_index, bytes, 0, NULL, 0);
-            return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_DOWNLOADED_EML_BIGBUF);
+            return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_DOWNLOADED_EML_BIGBUF, false);
         }
         case SPIFFS: {
             SendCommandMIX(CMD_SPIFFS_DOWNLOAD, start_index, bytes, 0, data, datalen);
-            return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_SPIFFS_DOWNLOADED);
+            return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_SPIFFS_DOWNLOADED, false);
         }
         case FLASH_MEM: {
             SendCommandMIX(CMD_FLASHMEM_DOWNLOAD, start_index, bytes, 0, NULL, 0);
-            return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_FLASHMEM_DOWNLOADED);
+            return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_FLASHMEM_DOWNLOADED, false);
         }
         case SIM_MEM: {
             //SendCommandMIX(CMD_DOWNLOAD_SIM_MEM, start_index, bytes, 0, NULL, 0);
@@ -835,13 +838,44 @@ bool GetFromDevice(DeviceMemType_t memtype, uint8_t *dest, uint32_t bytes, uint3
         }
         case FPGA_MEM: {
             SendCommandMIX(CMD_FPGAMEM_DOWNLOAD, start_index, bytes, 0, NULL, 0);
-            return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_FPGAMEM_DOWNLOADED);
+            return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_FPGAMEM_DOWNLOADED, false);
         }
     }
     return false;
 }
 
-static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, size_t ms_timeout, bool show_warning, uint32_t rec_cmd) {
+/**
+* Unpacks one block of a compressed BigBuf download into dest.
+* A block whose packet length equals its uncompressed length was sent as is.
+* @param dest destination buffer of the whole transfer
+* @param bytes size of dest
+* @param offset where the block starts in dest
+* @param packet packet payload
+* @param packet_len length of the packet payload
+* @param block_len uncompressed length of the block
+* @return PM3_SUCCESS, or PM3_EOVFLOW / PM3_ESOFT if the block doesn't fit or doesn't decompress
+*/
+int BigBufUnpackLZ4(uint8_t *dest, uint32_t bytes, uint32_t offset, const uint8_t *packet, uint32_t packet_len, uint32_t block_len) {
+
+    if ((uint64_t)offset + block_len > bytes) {
+        PrintAndLogEx(FAILED, "ERROR: Out of bounds when downloading from device,  offset %u | len %u | total len %u > buf_size %u", offset, block_len,  offset + block_len,  bytes);
+        return PM3_EOVFLOW;
+    }
+
+    if (packet_len == block_len) {
+        memcpy(dest + offset, packet, block_len);
+        return PM3_SUCCESS;
+    }
+
+    int res = LZ4_decompress_safe((const char *)packet, (char *)dest + offset, packet_len, block_len);
+    if (res != (int)block_len) {
+        PrintAndLogEx(FAILED, "ERROR: Failed to decompress block from device,  offset %u | len %u | result %d", offset, block_len, res);
+        return PM3_ESOFT;
+    }
+    return PM3_SUCCESS;
+}
+
+static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, size_t ms_timeout, bool show_warning, uint32_t rec_cmd, bool lz4) {
 
     uint32_t bytes_completed = 0;
     __atomic_store_n(&timeout_start_time,  msclock(), __ATOMIC_SEQ_CST);
@@ -864,7 +898,22 @@ static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, siz
             // arg0 = offset in transfer. Startindex of this chunk
             // arg1 = length bytes to transfer
             // arg2 = bigbuff tracelength (?)
-            if (response->cmd == rec_cmd) {
+            // lz4 block
+            // arg0 = offset in transfer. Startindex of this block
+            // arg1 = length of the packet
+            // arg2 = uncompressed length of the block, equal to arg1 if sent as is
+            if (response->cmd == rec_cmd && lz4) {
+
+                uint32_t offset = response->oldarg[0];
+                uint32_t packet_len = MIN(response->oldarg[1], PM3_CMD_DATA_SIZE);
+                uint32_t block_len = response->oldarg[2];
+
+                if (BigBufUnpackLZ4(dest, bytes, offset, response->data.asBytes, packet_len, block_len) != PM3_SUCCESS) {
+                    break;
+                }
+                bytes_completed += block_len;
+
+            } else if (response->cmd == rec_cmd) {
 
                 uint32_t offset = response->oldarg[0];
                 uint32_t copy_bytes = MIN(bytes - bytes_completed, response->oldarg[1]);
@@ -94,6 +94,7 @@ bool WaitForResponse(uint32_t cmd, PacketResponseNG *response);
 
 //bool GetFromDevice(DeviceMemType_t memtype, uint8_t *dest, uint32_t bytes, uint32_t start_index, PacketResponseNG *response, size_t ms_timeout, bool show_warning);
 bool GetFromDevice(DeviceMemType_t memtype, uint8_t *dest, uint32_t bytes, uint32_t start_index, uint8_t *data, uint32_t datalen, PacketResponseNG *response, size_t ms_timeout, bool show_warning);
+int BigBufUnpackLZ4(uint8_t *dest, uint32_t bytes, uint32_t offset, const uint8_t *packet, uint32_t packet_len, uint32_t block_len);
 
 #ifdef __cplusplus
 }
@@ -243,31 +243,22 @@ static void asn1_tag_dump_integer(const struct tlv *tlv, const struct asn1_tag *
 }
 
 static char *asn1_oid_description(const char *oid, bool with_group_desc) {
-    json_error_t error;
-    json_t *root = NULL;
     static char res[300];
     memset(res, 0x00, sizeof(res));
 
-    char *path;
-    if (searchFile(&path, RESOURCES_SUBDIR, "oids", ".json", false) != PM3_SUCCESS) {
-        return NULL;
-    }
-
-    // load `oids.json`
-    root = json_load_file(path, 0, &error);
-    free(path);
-
+    // `oids.json` is keyed by oid and stays loaded for the session
+    json_t *root = loadResourceJSON("oids", false, false);
     if (!root || !json_is_object(root)) {
-        goto error;
+        return NULL;
     }
 
     json_t *elm = json_object_get(root, oid);
     if (!elm) {
-        goto error;
+        return NULL;
     }
 
     if (JsonLoadStr(elm, "$.d", res))
-        goto error;
+        return NULL;
 
     char strext[300] = {0};
     if (!JsonLoadStr(elm, "$.c", strext)) {
@@ -276,13 +267,7 @@ static char *asn1_oid_description(const char *oid, bool with_group_desc) {
         strcat(res, ")");
     }
 
-    json_decref(root);
     return res;
-
-error:
-    if (root)
-        json_decref(root);
-    return NULL;
 }
 
 static void asn1_tag_dump_object_id(const struct tlv *tlv, const struct asn1_tag *tag, int level) {
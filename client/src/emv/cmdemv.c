@@ -1867,6 +1867,7 @@ static int CmdEMVRoca(const char *Cmd) {
                   "Tries to extract public keys and run the ROCA test against them.\n",
                   "emv roca -w  -> select --CONTACT-- card and run test\n"
                   "emv roca     -> select --CONTACTLESS-- card and run test\n"
+                  "emv roca -f capk.txt -f ~/certs/  -> scan CAPK files, `emv scan` json dumps, PEM/DER files and directories\n"
                  );
 
     void *argtable[] = {
@@ -1874,6 +1875,9 @@ static int CmdEMVRoca(const char *Cmd) {
         arg_lit0("tT",  "selftest", "Self test"),
         arg_lit0("aA",  "apdu",     "Show APDU reqests and responses"),
         arg_lit0("wW",  "wired",    "Send data via contact (iso7816) interface. (def: Contactless interface)"),
+        arg_strn("f",   "file",     "<fn>", 0, ROCA_SCAN_MAX_PATHS, "File or directory to scan offline"),
+        arg_int0("j",   "jobs",     "<dec>", "Number of scan threads (def: number of CPUs)"),
+        arg_lit0("v",   "verbose",  "List every scanned key, not only the vulnerable ones"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
@@ -1883,6 +1887,25 @@ static int CmdEMVRoca(const char *Cmd) {
         return roca_self_test();
     }
 
+    // offline batch scan
+    int pathcnt = arg_get_str(ctx, 4)->count;
+    if (pathcnt > 0) {
+        const char *paths[ROCA_SCAN_MAX_PATHS];
+        for (int i = 0; i < pathcnt; i++) {
+            paths[i] = arg_get_str(ctx, 4)->sval[i];
+        }
+        int jobs = arg_get_int_def(ctx, 5, num_CPUs());
+        bool verbose = arg_get_lit(ctx, 6);
+        if (jobs < 1 || jobs > ROCA_SCAN_MAX_THREADS) {
+            PrintAndLogEx(ERR, "Number of jobs must be between 1 and %u", ROCA_SCAN_MAX_THREADS);
+            CLIParserFree(ctx);
+            return PM3_EINVARG;
+        }
+        res = roca_scan(paths, pathcnt, jobs, verbose);
+        CLIParserFree(ctx);
+        return res;
+    }
+
     bool show_apdu = arg_get_lit(ctx, 2);
 
     Iso7816CommandChannel channel = CC_CONTACTLESS;
@@ -1890,6 +1913,12 @@ static int CmdEMVRoca(const char *Cmd) {
         channel = CC_CONTACT;
 
     CLIParserFree(ctx);
+
+    if (IfPm3Iso14443() == false) {
+        PrintAndLogEx(WARNING, "Proxmark3 with ISO14443 support needed, only `-f` offline scan available");
+        return PM3_EDEVNOTSUPP;
+    }
+
     PrintChannel(channel);
 
     if (!IfPm3Smartcard()) {
@@ -2143,7 +2172,7 @@ static command_t CommandTable[] =  {
     {"clone",       CmdEmvClone,                    IfPm3Iso14443,   "clone an EMV tag"},
     */
     {"list",        CmdEMVList,                     AlwaysAvailable, "List ISO7816 history"},
-    {"roca",        CmdEMVRoca,                     IfPm3Iso14443,   "Extract public keys and run ROCA test"},
+    {"roca",        CmdEMVRoca,                     AlwaysAvailable, "Extract public keys and run ROCA test"},
     {NULL, NULL, NULL, NULL}
 };
 
@@ -37,6 +37,10 @@ void PKISetStrictExecution(bool se) {
     strictExecution = se;
 }
 
+bool PKIGetStrictExecution(void) {
+    return strictExecution;
+}
+
 static const unsigned char empty_tlv_value[] = {};
 static const struct tlv empty_tlv = {.tag = 0x0, .len = 0, .value = empty_tlv_value};
 
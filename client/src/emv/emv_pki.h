@@ -25,6 +25,7 @@
 #include "tlv.h"
 
 void PKISetStrictExecution(bool se);
+bool PKIGetStrictExecution(void);
 
 unsigned char *emv_pki_sdatl_fill(const struct tlvdb *db, size_t *sdatl_len);
 struct emv_pk *emv_pki_recover_issuer_cert(const struct emv_pk *pk, struct tlvdb *db);
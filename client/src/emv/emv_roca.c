@@ -21,124 +21,478 @@
 
 #include "emv_roca.h"
 
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <dirent.h>
+
 #include "ui.h"  // Print...
-#include "bignum.h"
-
-static void rocacheck_init(mbedtls_mpi *prints) {
-
-    for (int i = 0; i < ROCA_PRINTS_LENGTH; i++)
-        mbedtls_mpi_init(&prints[i]);
-
-    mbedtls_mpi_read_string(&prints[0], 10, "1026");
-    mbedtls_mpi_read_string(&prints[1], 10, "5658");
-    mbedtls_mpi_read_string(&prints[2], 10, "107286");
-    mbedtls_mpi_read_string(&prints[3], 10, "199410");
-    mbedtls_mpi_read_string(&prints[4], 10, "67109890");
-    mbedtls_mpi_read_string(&prints[5], 10, "5310023542746834");
-    mbedtls_mpi_read_string(&prints[6], 10, "1455791217086302986");
-    mbedtls_mpi_read_string(&prints[7], 10, "20052041432995567486");
-    mbedtls_mpi_read_string(&prints[8], 10, "6041388139249378920330");
-    mbedtls_mpi_read_string(&prints[9], 10, "207530445072488465666");
-    mbedtls_mpi_read_string(&prints[10], 10, "79228162521181866724264247298");
-    mbedtls_mpi_read_string(&prints[11], 10, "1760368345969468176824550810518");
-    mbedtls_mpi_read_string(&prints[12], 10, "50079290986288516948354744811034");
-    mbedtls_mpi_read_string(&prints[13], 10, "473022961816146413042658758988474");
-    mbedtls_mpi_read_string(&prints[14], 10, "144390480366845522447407333004847678774");
-    mbedtls_mpi_read_string(&prints[15], 10, "1800793591454480341970779146165214289059119882");
-    mbedtls_mpi_read_string(&prints[16], 10, "126304807362733370595828809000324029340048915994");
+#include "util.h"
+#include "util_posix.h"
+#include "commonutil.h"
+#include "scandir.h"
+#include "jansson.h"
+#include "emvjson.h"
+#include "emvcore.h"
+#include "emv_pk.h"
+#include "emv_pki.h"
+#include "tlv.h"
+#include "mbedtls/x509_crt.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/rsa.h"
+
+#define ROCA_PRINT_WORDS 3
+
+static const uint8_t roca_primes[ROCA_PRINTS_LENGTH] = {
+    11, 13, 17, 19, 37, 53, 61, 71, 73, 79, 97, 103, 107, 109, 127, 151, 157
+};
+
+// fingerprint masks, bit r set when "modulus mod prime == r" is a ROCA residue
+static const uint64_t roca_prints[ROCA_PRINTS_LENGTH][ROCA_PRINT_WORDS] = {
+    { 0x0000000000000402, 0x0000000000000000, 0x0000000000000000 }, // 11
+    { 0x000000000000161a, 0x0000000000000000, 0x0000000000000000 }, // 13
+    { 0x000000000001a316, 0x0000000000000000, 0x0000000000000000 }, // 17
+    { 0x0000000000030af2, 0x0000000000000000, 0x0000000000000000 }, // 19
+    { 0x0000000004000402, 0x0000000000000000, 0x0000000000000000 }, // 37
+    { 0x0012dd703303aed2, 0x0000000000000000, 0x0000000000000000 }, // 53
+    { 0x1434026619900b0a, 0x0000000000000000, 0x0000000000000000 }, // 61
+    { 0x164729716b1d977e, 0x0000000000000001, 0x0000000000000000 }, // 71
+    { 0x811a48004962078a, 0x0000000000000147, 0x0000000000000000 }, // 73
+    { 0x4010404000640502, 0x000000000000000b, 0x0000000000000000 }, // 79
+    { 0x6000001800000002, 0x0000000100000000, 0x0000000000000000 }, // 97
+    { 0xbd964257768fe396, 0x00000016380e9115, 0x0000000000000000 }, // 103
+    { 0x633397be6a897e1a, 0x0000027816ea9821, 0x0000000000000000 }, // 107
+    { 0xb003685cbe7192ba, 0x00001752639f4e85, 0x0000000000000000 }, // 109
+    { 0xa04c81430a190536, 0x6ca09850c2813205, 0x0000000000000000 }, // 127
+    { 0x1a2412003d18030a, 0xbc00482458dac35b, 0x000000000050c018 }, // 151
+    { 0x071bd5baca0b7e1a, 0xd76af63826461899, 0x00000000161fb414 }, // 157
+};
+
+// modulus mod p, fed 32 bits at a time. r < 2^8 so (r << 32 | word) fits 64 bits.
+static uint32_t roca_residue(const uint8_t *buf, size_t buflen, uint32_t p) {
+    uint64_t r = 0;
+    size_t head = buflen % 4;
+    for (size_t i = 0; i < head; i++) {
+        r = ((r << 8) | buf[i]) % p;
+    }
+    for (size_t i = head; i < buflen; i += 4) {
+        r = ((r << 32) | MemBeToUint4byte(buf + i)) % p;
+    }
+    return (uint32_t)r;
 }
 
-static void rocacheck_cleanup(mbedtls_mpi *prints) {
-    for (int i = 0; i < ROCA_PRINTS_LENGTH; i++)
-        mbedtls_mpi_free(&prints[i]);
+bool emv_rocacheck(const unsigned char *buf, size_t buflen, bool verbose) {
+
+    for (int i = 0; i < ROCA_PRINTS_LENGTH; i++) {
+        uint32_t r = roca_residue(buf, buflen, roca_primes[i]);
+        if (((roca_prints[i][r / 64] >> (r % 64)) & 1) == 0) {
+            if (verbose) {
+                PrintAndLogEx(FAILED, "No fingerprint found.\n");
+            }
+            return false;
+        }
+    }
+
+    if (verbose)
+        PrintAndLogEx(SUCCESS, "Fingerprint found!\n");
+
+    return true;
 }
 
-static int bitand_is_zero(mbedtls_mpi *a, mbedtls_mpi *b) {
+//-----------------------------------------------------------------------------
+// Batch scanner
+//-----------------------------------------------------------------------------
+typedef struct {
+    char label[64];
+    uint16_t bits;
+    bool vulnerable;
+} roca_key_t;
+
+typedef struct {
+    char *path;
+    const char *type;
+    roca_key_t *keys;
+    size_t keycnt;
+    size_t keycap;
+} roca_file_t;
+
+typedef struct {
+    roca_file_t *files;
+    size_t count;
+    size_t cap;
+    size_t next;
+} roca_scan_t;
+
+static void roca_add_key(roca_file_t *f, const char *label, const uint8_t *modulus, size_t mlen) {
+
+    // strip leading zeros, they don't change the residues but do the bit length
+    while (mlen && modulus[0] == 0) {
+        modulus++;
+        mlen--;
+    }
+    if (mlen == 0) {
+        return;
+    }
 
-    for (int i = 0; i < mbedtls_mpi_bitlen(a); i++) {
+    if (f->keycnt == f->keycap) {
+        size_t cap = f->keycap ? f->keycap * 2 : 8;
+        roca_key_t *tmp = realloc(f->keys, cap * sizeof(roca_key_t));
+        if (tmp == NULL) {
+            return;
+        }
+        f->keys = tmp;
+        f->keycap = cap;
+    }
+
+    roca_key_t *k = &f->keys[f->keycnt++];
+    snprintf(k->label, sizeof(k->label), "%s", label);
+    k->bits = mlen * 8 - __builtin_clz(modulus[0]) + 24;
+    k->vulnerable = emv_rocacheck(modulus, mlen, false);
+}
 
-        if (mbedtls_mpi_get_bit(a, i) && mbedtls_mpi_get_bit(b, i))
-            return 0;
+// CAPK text file, one key per line as in resources/capk.txt
+static size_t roca_scan_capk(roca_file_t *f) {
+    FILE *fp = fopen(f->path, "r");
+    if (fp == NULL) {
+        return 0;
+    }
+
+    size_t n = 0;
+    char buf[2048];
+    while (fgets(buf, sizeof(buf), fp)) {
+        struct emv_pk *pk = emv_pk_parse_pk(buf, sizeof(buf));
+        if (pk == NULL) {
+            continue;
+        }
+        char label[64];
+        snprintf(label, sizeof(label), "CA RID %s IDX %02X", sprint_hex_inrow(pk->rid, 5), pk->index);
+        roca_add_key(f, label, pk->modulus, pk->mlen);
+        emv_pk_free(pk);
+        n++;
     }
-    return 1;
+    fclose(fp);
+    if (n) {
+        f->type = "capk";
+    }
+    return n;
 }
 
+// flatten every {tag, value} pair of an `emv scan` dump into the tlv database
+static void roca_json_to_tlv(json_t *elm, struct tlvdb *db) {
+    if (json_is_array(elm)) {
+        size_t i;
+        json_t *v;
+        json_array_foreach(elm, i, v) {
+            roca_json_to_tlv(v, db);
+        }
+        return;
+    }
 
-static mbedtls_mpi_uint mpi_get_uint(const mbedtls_mpi *X) {
+    if (json_is_object(elm) == false) {
+        return;
+    }
 
-    if (X->n == 1 && X->s > 0) {
-        return X->p[0];
+    uint8_t tag[4] = {0};
+    size_t taglen = 0;
+    uint8_t value[512] = {0};
+    size_t valuelen = 0;
+    if (JsonLoadBufAsHex(elm, "$.tag", tag, sizeof(tag), &taglen) == 0 &&
+            JsonLoadBufAsHex(elm, "$.value", value, sizeof(value), &valuelen) == 0 && taglen) {
+        tlvdb_add(db, tlvdb_fixed(bytes_to_num(tag, taglen), valuelen, value));
     }
 
-    PrintAndLogEx(WARNING, "ZERRRRO!!!\n");
-    return 0;
+    const char *key;
+    json_t *v;
+    json_object_foreach(elm, key, v) {
+        if (json_is_array(v) || json_is_object(v)) {
+            roca_json_to_tlv(v, db);
+        }
+    }
 }
 
-/*
-static void print_mpi(const char *msg, int radix, const mbedtls_mpi *X) {
+// EMV json dump from `emv scan`, recovers issuer and ICC keys with the CA keys
+static size_t roca_scan_json(roca_file_t *f) {
+    json_error_t error;
+    json_t *root = json_load_file(f->path, 0, &error);
+    if (root == NULL) {
+        return 0;
+    }
 
-    char Xchar[400] = {0};
-    size_t len = 0;
+    json_t *app = json_path_get(root, "$.Application");
+    if (app == NULL) {
+        json_decref(root);
+        return 0;
+    }
+
+    f->type = "emv json";
+
+    const char *alr = "Root terminal TLV tree";
+    struct tlvdb *db = tlvdb_fixed(1, strlen(alr), (const unsigned char *)alr);
+    roca_json_to_tlv(app, db);
+    json_decref(root);
+
+    size_t n = 0;
+    struct emv_pk *pk = get_ca_pk(db);
+    if (pk) {
+        struct emv_pk *issuer_pk = emv_pki_recover_issuer_cert(pk, db);
+        if (issuer_pk) {
+            roca_add_key(f, "Issuer", issuer_pk->modulus, issuer_pk->mlen);
+            n++;
+
+            struct emv_pk *icc_pk = emv_pki_recover_icc_cert(issuer_pk, db, NULL);
+            if (icc_pk) {
+                roca_add_key(f, "ICC", icc_pk->modulus, icc_pk->mlen);
+                emv_pk_free(icc_pk);
+                n++;
+            }
+
+            struct emv_pk *icc_pe_pk = emv_pki_recover_icc_pe_cert(issuer_pk, db);
+            if (icc_pe_pk) {
+                roca_add_key(f, "ICC PE", icc_pe_pk->modulus, icc_pe_pk->mlen);
+                emv_pk_free(icc_pe_pk);
+                n++;
+            }
+            emv_pk_free(issuer_pk);
+        }
+        emv_pk_free(pk);
+    }
 
-    mbedtls_mpi_write_string(X, radix, Xchar, sizeof(Xchar), &len);
-    PrintAndLogEx(INFO, "%s[%zu] %s\n", msg, len, Xchar);
+    tlvdb_free(db);
+    return n;
 }
-*/
-bool emv_rocacheck(const unsigned char *buf, size_t buflen, bool verbose) {
 
-    mbedtls_mpi t_modulus;
-    mbedtls_mpi_init(&t_modulus);
+static void roca_add_rsa(roca_file_t *f, const char *label, mbedtls_pk_context *pk) {
+    if (mbedtls_pk_get_type(pk) != MBEDTLS_PK_RSA) {
+        return;
+    }
 
-    bool ret = false;
-    mbedtls_mpi prints[ROCA_PRINTS_LENGTH];
-    uint8_t primes[ROCA_PRINTS_LENGTH] = {
-        11, 13, 17, 19, 37, 53, 61, 71, 73, 79, 97, 103, 107, 109, 127, 151, 157
-    };
+    mbedtls_rsa_context *rsa = mbedtls_pk_rsa(*pk);
+    size_t mlen = mbedtls_mpi_size(&rsa->N);
+    uint8_t *modulus = calloc(mlen, sizeof(uint8_t));
+    if (modulus == NULL) {
+        return;
+    }
+    if (mbedtls_mpi_write_binary(&rsa->N, modulus, mlen) == 0) {
+        roca_add_key(f, label, modulus, mlen);
+    }
+    free(modulus);
+}
 
-    rocacheck_init(prints);
+// PEM / DER certificates, certificate chains, public and private keys
+static size_t roca_scan_x509(roca_file_t *f) {
+    size_t n = 0;
+
+    mbedtls_x509_crt crt;
+    mbedtls_x509_crt_init(&crt);
+    if (mbedtls_x509_crt_parse_file(&crt, f->path) >= 0) {
+        for (mbedtls_x509_crt *c = &crt; c != NULL && c->version != 0; c = c->next) {
+            char label[64] = {0};
+            if (mbedtls_x509_dn_gets(label, sizeof(label), &c->subject) < 0) {
+                snprintf(label, sizeof(label), "certificate");
+            }
+            roca_add_rsa(f, label, &c->pk);
+            n++;
+        }
+    }
+    mbedtls_x509_crt_free(&crt);
 
-    MBEDTLS_MPI_CHK(mbedtls_mpi_read_binary(&t_modulus, buf, buflen));
+    if (n) {
+        f->type = "x509";
+        return n;
+    }
 
-    for (int i = 0; i < ROCA_PRINTS_LENGTH; i++) {
+    mbedtls_pk_context pk;
+    mbedtls_pk_init(&pk);
+    if (mbedtls_pk_parse_public_keyfile(&pk, f->path) == 0) {
+        roca_add_rsa(f, "public key", &pk);
+        f->type = "public key";
+        n++;
+    } else {
+        mbedtls_pk_free(&pk);
+        mbedtls_pk_init(&pk);
+        if (mbedtls_pk_parse_keyfile(&pk, f->path, NULL) == 0) {
+            roca_add_rsa(f, "private key", &pk);
+            f->type = "private key";
+            n++;
+        }
+    }
+    mbedtls_pk_free(&pk);
+    return n;
+}
 
-        mbedtls_mpi t_temp;
-        mbedtls_mpi t_prime;
-        mbedtls_mpi g_one;
+static void roca_scan_file(roca_file_t *f) {
+    if (str_endswith(f->path, ".json")) {
+        roca_scan_json(f);
+        return;
+    }
 
-        mbedtls_mpi_init(&t_temp);
-        mbedtls_mpi_init(&t_prime);
-        mbedtls_mpi_init(&g_one);
+    if (roca_scan_x509(f) == 0) {
+        roca_scan_capk(f);
+    }
+}
 
-        MBEDTLS_MPI_CHK(mbedtls_mpi_read_string(&g_one, 10, "1"));
+static void *roca_scan_worker(void *arg) {
+    roca_scan_t *scan = (roca_scan_t *)arg;
+    size_t i;
+    while ((i = __atomic_fetch_add(&scan->next, 1, __ATOMIC_RELAXED)) < scan->count) {
+        roca_scan_file(&scan->files[i]);
+    }
+    return NULL;
+}
 
-        MBEDTLS_MPI_CHK(mbedtls_mpi_add_int(&t_prime, &t_prime, primes[i]));
+static bool roca_is_directory(const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        return false;
+    }
+    return S_ISDIR(st.st_mode);
+}
+
+static int roca_add_path(roca_scan_t *scan, const char *path, uint8_t depth) {
 
-        MBEDTLS_MPI_CHK(mbedtls_mpi_mod_mpi(&t_temp, &t_modulus, &t_prime));
+    if (roca_is_directory(path) == false) {
+        if (scan->count == scan->cap) {
+            size_t cap = scan->cap ? scan->cap * 2 : 64;
+            roca_file_t *tmp = realloc(scan->files, cap * sizeof(roca_file_t));
+            if (tmp == NULL) {
+                return PM3_EMALLOC;
+            }
+            scan->files = tmp;
+            scan->cap = cap;
+        }
+        roca_file_t *f = &scan->files[scan->count++];
+        memset(f, 0, sizeof(roca_file_t));
+        f->path = strdup(path);
+        return (f->path) ? PM3_SUCCESS : PM3_EMALLOC;
+    }
 
-        MBEDTLS_MPI_CHK(mbedtls_mpi_shift_l(&g_one, mpi_get_uint(&t_temp)));
+    if (depth > ROCA_SCAN_MAX_DEPTH) {
+        return PM3_SUCCESS;
+    }
 
-        mbedtls_mpi_free(&t_temp);
-        mbedtls_mpi_free(&t_prime);
+    struct dirent **namelist;
+    int n = scandir(path, &namelist, NULL, alphasort);
+    if (n < 0) {
+        PrintAndLogEx(WARNING, "Can't read directory " _YELLOW_("%s"), path);
+        return PM3_EFILE;
+    }
 
-        if (bitand_is_zero(&g_one, &prints[i])) {
-            if (verbose) {
-                PrintAndLogEx(FAILED, "No fingerprint found.\n");
+    int res = PM3_SUCCESS;
+    for (int i = 0; i < n; i++) {
+        const char *name = namelist[i]->d_name;
+        if (res == PM3_SUCCESS && name[0] != '.') {
+            size_t len = strlen(path) + strlen(name) + 2;
+            char *child = calloc(len, sizeof(char));
+            if (child == NULL) {
+                res = PM3_EMALLOC;
+            } else {
+                snprintf(child, len, "%s%s%s", path, str_endswith(path, PATHSEP) ? "" : PATHSEP, name);
+                res = roca_add_path(scan, child, depth + 1);
+                free(child);
             }
-            mbedtls_mpi_free(&g_one);
-            goto cleanup;
         }
-        mbedtls_mpi_free(&g_one);
+        free(namelist[i]);
     }
+    free(namelist);
+    return res;
+}
 
-    ret = true;
-    if (verbose)
-        PrintAndLogEx(SUCCESS, "Fingerprint found!\n");
+int roca_scan(const char **paths, size_t pathcnt, uint8_t threads, bool verbose) {
 
-cleanup:
-    mbedtls_mpi_free(&t_modulus);
+    roca_scan_t scan;
+    memset(&scan, 0, sizeof(scan));
 
-    rocacheck_cleanup(prints);
-    return ret;
+    bool strict = PKIGetStrictExecution();
+    int res = PM3_SUCCESS;
+    for (size_t i = 0; i < pathcnt && res == PM3_SUCCESS; i++) {
+        res = roca_add_path(&scan, paths[i], 0);
+    }
+
+    if (res == PM3_SUCCESS && scan.count == 0) {
+        PrintAndLogEx(WARNING, "No files to scan");
+        res = PM3_EINVARG;
+    }
+
+    if (res != PM3_SUCCESS) {
+        goto out;
+    }
+
+    if (threads == 0) {
+        threads = 1;
+    }
+    if (threads > ROCA_SCAN_MAX_THREADS) {
+        threads = ROCA_SCAN_MAX_THREADS;
+    }
+    if (threads > scan.count) {
+        threads = scan.count;
+    }
+
+    PrintAndLogEx(INFO, "Scanning " _YELLOW_("%zu") " file%s with " _YELLOW_("%u") " thread%s",
+                  scan.count, (scan.count > 1) ? "s" : "", threads, (threads > 1) ? "s" : "");
+
+    // don't stop EMV certificate recovery on hash mismatch, dumps lack the ODA data
+    PKISetStrictExecution(false);
+
+    uint64_t t1 = msclock();
+
+    pthread_t thread_ids[ROCA_SCAN_MAX_THREADS];
+    uint8_t started = 0;
+    for (uint8_t i = 1; i < threads; i++) {
+        if (pthread_create(&thread_ids[started], NULL, roca_scan_worker, &scan) == 0) {
+            started++;
+        }
+    }
+    roca_scan_worker(&scan);
+    for (uint8_t i = 0; i < started; i++) {
+        pthread_join(thread_ids[i], NULL);
+    }
+
+    t1 = msclock() - t1;
+
+    // report
+    size_t keys = 0, weak = 0, empty = 0;
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "------------------------- " _CYAN_("ROCA scan report") " -------------------------");
+    for (size_t i = 0; i < scan.count; i++) {
+        roca_file_t *f = &scan.files[i];
+        if (f->keycnt == 0) {
+            empty++;
+            if (verbose) {
+                PrintAndLogEx(INFO, "   no RSA keys    %s", f->path);
+            }
+            continue;
+        }
+
+        for (size_t j = 0; j < f->keycnt; j++) {
+            roca_key_t *k = &f->keys[j];
+            keys++;
+            if (k->vulnerable) {
+                weak++;
+                PrintAndLogEx(WARNING, _RED_("VULNERABLE") " %4u bits  %-11s %-32s %s", k->bits, f->type, k->label, f->path);
+            } else if (verbose) {
+                PrintAndLogEx(SUCCESS, _GREEN_("ok        ") " %4u bits  %-11s %-32s %s", k->bits, f->type, k->label, f->path);
+            }
+        }
+    }
+    PrintAndLogEx(INFO, "-----------------------------------------------------------------------");
+    PrintAndLogEx(SUCCESS, "files..... " _YELLOW_("%zu") " ( %zu without RSA keys )", scan.count, empty);
+    PrintAndLogEx(SUCCESS, "keys...... " _YELLOW_("%zu"), keys);
+    PrintAndLogEx(SUCCESS, "vulnerable " "%s", (weak) ? _RED_("yes") : _GREEN_("none"));
+    if (weak) {
+        PrintAndLogEx(SUCCESS, "           " _RED_("%zu") " ROCA fingerprint%s found", weak, (weak > 1) ? "s" : "");
+    }
+    PrintAndLogEx(SUCCESS, "time...... %" PRIu64 " ms", t1);
+
+out:
+    PKISetStrictExecution(strict);
+
+    for (size_t i = 0; i < scan.count; i++) {
+        free(scan.files[i].path);
+        free(scan.files[i].keys);
+    }
+    free(scan.files);
+    return res;
 }
 
 int roca_self_test(void) {
@@ -25,8 +25,12 @@
 #include "common.h"
 
 #define ROCA_PRINTS_LENGTH 17
+#define ROCA_SCAN_MAX_PATHS 32
+#define ROCA_SCAN_MAX_DEPTH 8
+#define ROCA_SCAN_MAX_THREADS 64
 
 bool emv_rocacheck(const unsigned char *buf, size_t buflen, bool verbose);
+int roca_scan(const char **paths, size_t pathcnt, uint8_t threads, bool verbose);
 int roca_self_test(void);
 
 #endif
@@ -32,6 +32,9 @@
 #ifdef _WIN32
 #include "scandir.h"
 #include <direct.h>
+#include <process.h>      // getpid
+#else
+#include <unistd.h>       // getpid
 #endif
 
 #define PATH_MAX_LENGTH 200
@@ -1478,6 +1481,448 @@ out:
     return retval;
 }
 
+// Compiled dictionaries.
+// A text dictionary is compiled once into a sorted, deduplicated binary copy kept in the user
+// directory. Records have a fixed size so the file can be binary searched or mmapped directly.
+// Each record carries a hit counter, keys which opened cards before are tried first.
+#define DICTIONARY_MAGIC        "PM3DICB1"
+#define DICTIONARY_MAX_KEYLEN   24
+
+typedef struct {
+    char magic[8];
+    uint8_t keylen;
+    uint8_t rfu[3];
+    uint32_t count;
+    uint64_t source_size;
+    uint64_t source_hash;               // FNV-1a of the text file
+} PACKED dictionary_header_t;
+
+typedef struct {
+    uint8_t key[DICTIONARY_MAX_KEYLEN]; // zero padded, sort order
+    uint32_t rank;                      // position in the text file
+    uint32_t hits;
+} PACKED dictionary_record_t;
+
+static int dictionary_cmp_key(const void *a, const void *b) {
+    const dictionary_record_t *ra = a;
+    const dictionary_record_t *rb = b;
+    return memcmp(ra->key, rb->key, DICTIONARY_MAX_KEYLEN);
+}
+
+static int dictionary_cmp_key_rank(const void *a, const void *b) {
+    int res = dictionary_cmp_key(a, b);
+    if (res)
+        return res;
+    const dictionary_record_t *ra = a;
+    const dictionary_record_t *rb = b;
+    return (ra->rank > rb->rank) - (ra->rank < rb->rank);
+}
+
+// most hits first, then dictionary order
+static int dictionary_cmp_hits(const void *a, const void *b) {
+    const dictionary_record_t *ra = a;
+    const dictionary_record_t *rb = b;
+    if (ra->hits != rb->hits)
+        return (ra->hits < rb->hits) - (ra->hits > rb->hits);
+    return (ra->rank > rb->rank) - (ra->rank < rb->rank);
+}
+
+// size and content hash of the text file. The hash catches edits which keep the size and
+// land within the timestamp resolution,  hashing is still far cheaper than parsing the keys
+static int dictionary_source_stat(const char *path, dictionary_header_t *hdr) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+        return PM3_EFILE;
+
+    uint64_t hash = 0xCBF29CE484222325;
+    uint64_t size = 0;
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            hash = (hash ^ buf[i]) * 0x100000001B3;
+        }
+        size += n;
+    }
+    fclose(f);
+
+    hdr->source_size = size;
+    hdr->source_hash = hash;
+    return PM3_SUCCESS;
+}
+
+// ~/.proxmark3/dictionary_cache/<name>-<hash of path>-<keylen>.dicb
+static int dictionary_cache_path(const char *path, uint8_t keylen, char **cachepath) {
+    uint32_t hash = 0x811C9DC5;
+    for (const char *p = path; *p; p++) {
+        hash = (hash ^ (uint8_t)*p) * 0x01000193;
+    }
+
+    const char *name = strrchr(path, PATHSEP[0]);
+    name = (name == NULL) ? path : name + 1;
+
+    char fn[FILE_PATH_SIZE];
+    snprintf(fn, sizeof(fn), "%.*s-%08x-%u.dicb", (int)strcspn(name, "."), name, hash, keylen);
+    return searchHomeFilePath(cachepath, DICTIONARY_CACHE_SUBDIR, fn, true);
+}
+
+static int dictionary_parse_text(const char *path, uint8_t keylen, dictionary_record_t **precords, uint32_t *pcount) {
+
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        PrintAndLogEx(WARNING, "file not found or locked. '" _YELLOW_("%s")"'", path);
+        return PM3_EFILE;
+    }
+
+    uint32_t count = 0;
+    uint32_t mem_count = 256;
+    dictionary_record_t *records = calloc(mem_count, sizeof(dictionary_record_t));
+    if (records == NULL) {
+        fclose(f);
+        return PM3_EMALLOC;
+    }
+
+    char line[255];
+    while (fgets(line, sizeof(line), f)) {
+
+        // add null terminator
+        line[keylen << 1] = 0;
+
+        // smaller keys than expected is skipped
+        if (strlen(line) < (keylen << 1))
+            continue;
+
+        // The line start with # is comment, skip
+        if (line[0] == '#')
+            continue;
+
+        if (!CheckStringIsHEXValue(line))
+            continue;
+
+        if (count == mem_count) {
+            mem_count <<= 1;
+            dictionary_record_t *tmp = realloc(records, mem_count * sizeof(dictionary_record_t));
+            if (tmp == NULL) {
+                free(records);
+                fclose(f);
+                return PM3_EMALLOC;
+            }
+            records = tmp;
+        }
+
+        memset(&records[count], 0, sizeof(dictionary_record_t));
+        if (hex_to_bytes(line, records[count].key, keylen) != keylen)
+            continue;
+
+        records[count].rank = count;
+        count++;
+    }
+    fclose(f);
+
+    // sort and drop duplicates, the first occurrence wins
+    qsort(records, count, sizeof(dictionary_record_t), dictionary_cmp_key_rank);
+    uint32_t unique = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (unique && dictionary_cmp_key(&records[unique - 1], &records[i]) == 0)
+            continue;
+        records[unique++] = records[i];
+    }
+
+    *precords = records;
+    *pcount = unique;
+    return PM3_SUCCESS;
+}
+
+static int dictionary_read_compiled(const char *cachepath, dictionary_header_t *hdr, dictionary_record_t **precords) {
+    *precords = NULL;
+
+    FILE *f = fopen(cachepath, "rb");
+    if (f == NULL)
+        return PM3_EFILE;
+
+    if (fread(hdr, sizeof(dictionary_header_t), 1, f) != 1 || memcmp(hdr->magic, DICTIONARY_MAGIC, sizeof(hdr->magic))) {
+        fclose(f);
+        return PM3_EFILE;
+    }
+
+    // the copy lives in the user directory,  don't trust its header
+    long records_len = -1;
+    if (fseek(f, 0, SEEK_END) == 0) {
+        records_len = ftell(f) - (long)sizeof(dictionary_header_t);
+    }
+    if (hdr->keylen == 0 || hdr->keylen > DICTIONARY_MAX_KEYLEN ||
+            records_len < 0 || (uint64_t)records_len != (uint64_t)hdr->count * sizeof(dictionary_record_t) ||
+            fseek(f, sizeof(dictionary_header_t), SEEK_SET) != 0) {
+        fclose(f);
+        return PM3_EFILE;
+    }
+
+    dictionary_record_t *records = calloc(hdr->count + 1, sizeof(dictionary_record_t));
+    if (records == NULL) {
+        fclose(f);
+        return PM3_EMALLOC;
+    }
+
+    if (fread(records, sizeof(dictionary_record_t), hdr->count, f) != hdr->count) {
+        free(records);
+        fclose(f);
+        return PM3_EFILE;
+    }
+    fclose(f);
+
+    *precords = records;
+    return PM3_SUCCESS;
+}
+
+// written to a temporary file and renamed over the old copy,  so a client reading the copy
+// at the same time sees either the old or the new one
+static int dictionary_write_compiled(const char *cachepath, const dictionary_header_t *hdr, const dictionary_record_t *records) {
+    char tmppath[FILE_PATH_SIZE + 16];
+    snprintf(tmppath, sizeof(tmppath), "%s.%u.tmp", cachepath, (uint32_t)getpid());
+
+    FILE *f = fopen(tmppath, "wb");
+    if (f == NULL)
+        return PM3_EFILE;
+
+    int res = PM3_SUCCESS;
+    if (fwrite(hdr, sizeof(dictionary_header_t), 1, f) != 1 ||
+            fwrite(records, sizeof(dictionary_record_t), hdr->count, f) != hdr->count) {
+        res = PM3_EFILE;
+    }
+    if (fclose(f) != 0) {
+        res = PM3_EFILE;
+    }
+
+    if (res == PM3_SUCCESS) {
+#ifdef _WIN32
+        // rename doesn't replace an existing file on Windows
+        remove(cachepath);
+#endif
+        if (rename(tmppath, cachepath) != 0) {
+            res = PM3_EFILE;
+        }
+    }
+    if (res != PM3_SUCCESS) {
+        remove(tmppath);
+    }
+    return res;
+}
+
+// Get the sorted records of a dictionary, compiling it if the cached copy is missing or outdated.
+static int dictionary_load_compiled(const char *path, uint8_t keylen, dictionary_record_t **precords, uint32_t *pcount) {
+
+    dictionary_header_t hdr = {0};
+    memcpy(hdr.magic, DICTIONARY_MAGIC, sizeof(hdr.magic));
+    hdr.keylen = keylen;
+    if (dictionary_source_stat(path, &hdr) != PM3_SUCCESS) {
+        PrintAndLogEx(WARNING, "file not found or locked. '" _YELLOW_("%s")"'", path);
+        return PM3_EFILE;
+    }
+
+    // incognito or no user directory, work from the text file
+    char *cachepath = NULL;
+    if (g_session.incognito || dictionary_cache_path(path, keylen, &cachepath) != PM3_SUCCESS) {
+        free(cachepath);
+        return dictionary_parse_text(path, keylen, precords, pcount);
+    }
+
+    dictionary_header_t old_hdr;
+    dictionary_record_t *old_records = NULL;
+    if (dictionary_read_compiled(cachepath, &old_hdr, &old_records) == PM3_SUCCESS && old_hdr.keylen == keylen) {
+        if (old_hdr.source_size == hdr.source_size && old_hdr.source_hash == hdr.source_hash) {
+            free(cachepath);
+            *precords = old_records;
+            *pcount = old_hdr.count;
+            return PM3_SUCCESS;
+        }
+    } else {
+        old_hdr.count = 0;
+    }
+
+    int res = dictionary_parse_text(path, keylen, precords, pcount);
+    if (res == PM3_SUCCESS) {
+        // the text file changed, keep the statistics of the keys still in it
+        for (uint32_t i = 0; i < *pcount && old_hdr.count; i++) {
+            dictionary_record_t *old = bsearch(&(*precords)[i], old_records, old_hdr.count, sizeof(dictionary_record_t), dictionary_cmp_key);
+            if (old != NULL) {
+                (*precords)[i].hits = old->hits;
+            }
+        }
+
+        hdr.count = *pcount;
+        if (dictionary_write_compiled(cachepath, &hdr, *precords) != PM3_SUCCESS) {
+            PrintAndLogEx(DEBUG, "couldn't write compiled dictionary " _YELLOW_("%s"), cachepath);
+        }
+    }
+    free(old_records);
+    free(cachepath);
+    return res;
+}
+
+
+int loadFileDICTIONARY_merged(const char **preferredNames, uint8_t namecnt, void **pdata, uint8_t keylen, uint32_t *keycnt) {
+
+    *pdata = NULL;
+    *keycnt = 0;
+
+    // t5577 == 4bytes
+    // mifare == 6 bytes
+    // mf plus == 16 bytes
+    // mf desfire == 3des3k 24 bytes
+    // iclass == 8 bytes
+    // default to 6 bytes.
+    if (keylen != 4 && keylen != 6 && keylen != 8 && keylen != 16 && keylen != 24) {
+        keylen = 6;
+    }
+
+    if (namecnt == 0)
+        return PM3_EINVARG;
+
+    dictionary_record_t **lists = calloc(namecnt, sizeof(dictionary_record_t *));
+    uint32_t *counts = calloc(namecnt, sizeof(uint32_t));
+    uint32_t *heads = calloc(namecnt, sizeof(uint32_t));
+    dictionary_record_t *merged = NULL;
+    int retval = PM3_SUCCESS;
+    if (lists == NULL || counts == NULL || heads == NULL) {
+        retval = PM3_EMALLOC;
+        goto out;
+    }
+
+    uint32_t total = 0;
+    for (uint8_t n = 0; n < namecnt; n++) {
+        char *path;
+        if (searchFile(&path, DICTIONARIES_SUBDIR, preferredNames[n], ".dic", false) != PM3_SUCCESS) {
+            retval = PM3_EFILE;
+            goto out;
+        }
+
+        retval = dictionary_load_compiled(path, keylen, &lists[n], &counts[n]);
+        if (retval != PM3_SUCCESS) {
+            free(path);
+            goto out;
+        }
+
+        // later dictionaries come after earlier ones
+        for (uint32_t i = 0; i < counts[n]; i++) {
+            lists[n][i].rank += total;
+        }
+        total += counts[n];
+
+        PrintAndLogEx(SUCCESS, "loaded " _GREEN_("%2u") " keys from dictionary file " _YELLOW_("%s"), counts[n], path);
+        free(path);
+    }
+
+    merged = calloc(total + 1, sizeof(dictionary_record_t));
+    if (merged == NULL) {
+        retval = PM3_EMALLOC;
+        goto out;
+    }
+
+    // k-way merge of the sorted lists, a key found in several dictionaries is kept once
+    uint32_t cnt = 0;
+    while (true) {
+        int lowest = -1;
+        for (uint8_t n = 0; n < namecnt; n++) {
+            if (heads[n] == counts[n])
+                continue;
+            if (lowest < 0 || dictionary_cmp_key(&lists[n][heads[n]], &lists[lowest][heads[lowest]]) < 0)
+                lowest = n;
+        }
+        if (lowest < 0)
+            break;
+
+        dictionary_record_t *rec = &lists[lowest][heads[lowest]++];
+        if (cnt && dictionary_cmp_key(&merged[cnt - 1], rec) == 0) {
+            merged[cnt - 1].hits += rec->hits;
+            merged[cnt - 1].rank = MIN(merged[cnt - 1].rank, rec->rank);
+            continue;
+        }
+        merged[cnt++] = *rec;
+    }
+
+    qsort(merged, cnt, sizeof(dictionary_record_t), dictionary_cmp_hits);
+
+    uint8_t *keys = calloc(cnt + 1, keylen);
+    if (keys == NULL) {
+        retval = PM3_EMALLOC;
+        goto out;
+    }
+    for (uint32_t i = 0; i < cnt; i++) {
+        memcpy(keys + (i * keylen), merged[i].key, keylen);
+    }
+
+    if (namecnt > 1) {
+        PrintAndLogEx(SUCCESS, "merged " _GREEN_("%u") " unique keys", cnt);
+    }
+
+    *pdata = keys;
+    *keycnt = cnt;
+
+out:
+    if (lists != NULL) {
+        for (uint8_t n = 0; n < namecnt; n++) {
+            free(lists[n]);
+        }
+    }
+    free(lists);
+    free(counts);
+    free(heads);
+    free(merged);
+    return retval;
+}
+
+int updateFileDICTIONARYhits(const char *preferredName, uint8_t keylen, const uint8_t *keys, uint32_t keycnt) {
+
+    if (keys == NULL || keycnt == 0 || keylen > DICTIONARY_MAX_KEYLEN)
+        return PM3_EINVARG;
+
+    if (g_session.incognito)
+        return PM3_SUCCESS;
+
+    char *path;
+    if (searchFile(&path, DICTIONARIES_SUBDIR, preferredName, ".dic", true) != PM3_SUCCESS)
+        return PM3_EFILE;
+
+    dictionary_header_t src = {0};
+    char *cachepath = NULL;
+    if (dictionary_source_stat(path, &src) != PM3_SUCCESS || dictionary_cache_path(path, keylen, &cachepath) != PM3_SUCCESS) {
+        free(cachepath);
+        free(path);
+        return PM3_EFILE;
+    }
+    free(path);
+
+    dictionary_header_t hdr;
+    dictionary_record_t *records = NULL;
+    int res = dictionary_read_compiled(cachepath, &hdr, &records);
+
+    // only a compiled copy matching the text file is updated
+    if (res != PM3_SUCCESS || hdr.keylen != keylen || hdr.source_size != src.source_size || hdr.source_hash != src.source_hash) {
+        free(records);
+        free(cachepath);
+        return PM3_EFILE;
+    }
+
+    uint32_t updated = 0;
+    for (uint32_t i = 0; i < keycnt; i++) {
+        dictionary_record_t needle = {0};
+        memcpy(needle.key, keys + (i * keylen), keylen);
+        dictionary_record_t *rec = bsearch(&needle, records, hdr.count, sizeof(dictionary_record_t), dictionary_cmp_key);
+        if (rec != NULL && rec->hits < UINT32_MAX) {
+            rec->hits++;
+            updated++;
+        }
+    }
+
+    if (updated) {
+        res = dictionary_write_compiled(cachepath, &hdr, records);
+    }
+
+    free(records);
+    free(cachepath);
+    return res;
+}
+
 mfu_df_e detect_mfu_dump_format(uint8_t **dump, size_t *dumplen, bool verbose) {
 
     mfu_df_e retval = MFU_DF_UNKNOWN;
@@ -1880,3 +2325,89 @@ int searchFile(char **foundpath, const char *pm3dir, const char *searchname, con
     free(filename);
     return PM3_SUCCESS;
 }
+
+// parsed resource files, keyed by resource name.
+// Every entry is an object { "path": <found path>, "root": <parsed json>, "index": { <key>: <lookup object> } }
+static json_t *resource_cache = NULL;
+
+json_t *loadResourceJSON(const char *name, bool silent, bool verbose) {
+
+    if (name == NULL)
+        return NULL;
+
+    json_t *entry = NULL;
+    if (resource_cache)
+        entry = json_object_get(resource_cache, name);
+
+    if (entry == NULL) {
+        char *path;
+        if (searchFile(&path, RESOURCES_SUBDIR, name, ".json", silent) != PM3_SUCCESS) {
+            return NULL;
+        }
+
+        json_error_t error;
+        json_t *root = json_load_file(path, 0, &error);
+        if (root == NULL) {
+            PrintAndLogEx(ERR, "json (%s) error on line %d: %s", path, error.line, error.text);
+            free(path);
+            return NULL;
+        }
+
+        if (resource_cache == NULL)
+            resource_cache = json_object();
+
+        entry = json_object();
+        json_object_set_new(entry, "path", json_string(path));
+        json_object_set_new(entry, "root", root);
+        json_object_set_new(entry, "index", json_object());
+        json_object_set_new(resource_cache, name, entry);
+        PrintAndLogEx(DEBUG, "Loaded file " _YELLOW_("%s") " ( " _GREEN_("ok") " )", path);
+        free(path);
+    }
+
+    json_t *root = json_object_get(entry, "root");
+    if (verbose) {
+        size_t records = json_is_array(root) ? json_array_size(root) : json_object_size(root);
+        PrintAndLogEx(SUCCESS, "Loaded file " _YELLOW_("`%s`") " (%s) %zu records.", json_string_value(json_object_get(entry, "path")),  _GREEN_("ok"), records);
+    }
+    return root;
+}
+
+json_t *getResourceJSONIndex(const char *name, const char *key, bool nocase) {
+
+    json_t *root = loadResourceJSON(name, true, false);
+    if (root == NULL || json_is_array(root) == false)
+        return NULL;
+
+    char iname[64] = {0};
+    snprintf(iname, sizeof(iname), "%s%s", key, (nocase) ? "/nocase" : "");
+
+    json_t *indexes = json_object_get(json_object_get(resource_cache, name), "index");
+    json_t *index = json_object_get(indexes, iname);
+    if (index)
+        return index;
+
+    index = json_object();
+    for (size_t i = 0; i < json_array_size(root); i++) {
+        json_t *data = json_array_get(root, i);
+        const char *value = json_string_value(json_object_get(data, key));
+        if (value == NULL || strlen(value) == 0)
+            continue;
+
+        char lvalue[strlen(value) + 1];
+        strcpy(lvalue, value);
+        if (nocase)
+            str_lower(lvalue);
+
+        // first record wins, same as a linear scan would
+        if (json_object_get(index, lvalue) == NULL)
+            json_object_set(index, lvalue, data);
+    }
+    json_object_set_new(indexes, iname, index);
+    return index;
+}
+
+void freeResourceJSON(void) {
+    json_decref(resource_cache);
+    resource_cache = NULL;
+}
@@ -224,6 +224,7 @@ int loadFileDICTIONARYEx(const char *preferredName, void *data, size_t maxdatale
 /**
  * @brief  Utility function to load data safely from a DICTIONARY textfile. This method takes a preferred name.
  * E.g. mfc_default_keys.dic
+ * Keys come in file order, duplicates included. See loadFileDICTIONARY_merged for deduplicated, hit ordered keys.
  *
  * @param preferredName
  * @param pdata A pointer to a pointer  (for reverencing the loaded dictionary)
@@ -232,6 +233,33 @@ int loadFileDICTIONARYEx(const char *preferredName, void *data, size_t maxdatale
 */
 int loadFileDICTIONARY_safe(const char *preferredName, void **pdata, uint8_t keylen, uint32_t *keycnt);
 
+/**
+ * @brief  Utility function to load and merge several DICTIONARY textfiles.
+ * Every dictionary is compiled into a sorted, deduplicated binary copy in the user directory,
+ * rebuilt whenever the text file changes. Keys found in several dictionaries are returned once.
+ * Keys with the most hits (see updateFileDICTIONARYhits) come first, then file order.
+ * Only for commands which maintain the hit counters (hf mf chk / fchk).
+ *
+ * @param preferredNames
+ * @param namecnt number of dictionaries
+ * @param pdata A pointer to a pointer (for reverencing the loaded keys)
+ * @param keylen  the number of bytes a key per row is
+ * @param keycnt number of keys loaded
+ * @return 0 for ok, 1 for failz
+*/
+int loadFileDICTIONARY_merged(const char **preferredNames, uint8_t namecnt, void **pdata, uint8_t keylen, uint32_t *keycnt);
+
+/**
+ * @brief  Count a successful use of keys from a dictionary. Keys not in the dictionary are ignored.
+ *
+ * @param preferredName
+ * @param keylen  the number of bytes a key is
+ * @param keys found keys
+ * @param keycnt number of keys
+ * @return 0 for ok
+*/
+int updateFileDICTIONARYhits(const char *preferredName, uint8_t keylen, const uint8_t *keys, uint32_t keycnt);
+
 
 typedef enum {
     MFU_DF_UNKNOWN,
@@ -253,6 +281,32 @@ mfu_df_e detect_mfu_dump_format(uint8_t **dump, size_t *dumplen, bool verbose);
 int searchAndList(const char *pm3dir, const char *ext);
 int searchFile(char **foundpath, const char *pm3dir, const char *searchname, const char *suffix, bool silent);
 
+/**
+ * @brief Returns a parsed json file from the resources directory.
+ * The file is searched for and parsed on first use, and the result is kept for the rest of the session.
+ * The returned root is owned by the cache, callers must json_incref it if they want to keep a reference
+ * @param name the resource name, without the .json suffix
+ * @param silent don't print an error if the file can't be found
+ * @param verbose print the loaded file path and number of records
+ * @return root json or NULL if the file can't be found or parsed
+ */
+json_t *loadResourceJSON(const char *name, bool silent, bool verbose);
+
+/**
+ * @brief Returns a lookup object over a cached array resource, mapping the string field `key` of each record to the record.
+ * Built on first use. With nocase the keys are stored lowercase and lookups must use lowercase too
+ * @param name the resource name, without the .json suffix
+ * @param key the record field to index
+ * @param nocase lowercase the indexed values
+ * @return json object or NULL if the resource can't be loaded or isn't an array
+ */
+json_t *getResourceJSONIndex(const char *name, const char *key, bool nocase);
+
+/**
+ * @brief Drops all cached resource files. Called on exit
+ */
+void freeResourceJSON(void);
+
 
 /**
  * @brief detects if file is of a supported filetype based on extension
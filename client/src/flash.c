@@ -30,6 +30,7 @@
 #include "util_posix.h"
 #include "comms.h"
 #include "commonutil.h"
+#include "crc32.h"
 
 #define FLASH_START            0x100000
 
@@ -38,7 +39,7 @@
 
 #define BLOCK_SIZE             0x200
 
-#define FLASHER_VERSION        BL_VERSION_1_0_0
+#define FLASHER_VERSION        BL_VERSION_1_1_0
 
 static const uint8_t elf_ident[] = {
     0x7f, 'E', 'L', 'F',
@@ -465,6 +466,9 @@ static int enter_bootloader(char *serial_port_name) {
     return PM3_EFATAL;
 }
 
+// set when the bootloader can report CRCs of what is already in flash
+static bool gs_bl_page_crc = false;
+
 static int wait_for_ack(PacketResponseNG *ack) {
     WaitForResponse(CMD_UNKNOWN, ack);
 
@@ -515,6 +519,8 @@ int flash_start_flashing(int enable_bl_writes, char *serial_port_name, uint32_t
     if (ret != PM3_SUCCESS)
         return ret;
 
+    gs_bl_page_crc = (state & DEVICE_INFO_FLAG_UNDERSTANDS_PAGE_CRC);
+
     if (state & DEVICE_INFO_FLAG_UNDERSTANDS_CHIP_INFO) {
         SendCommandBL(CMD_CHIP_INFO, 0, 0, 0, NULL, 0);
         PacketResponseNG resp;
@@ -628,8 +634,39 @@ static const char ice[] =
     "...................................................................\n"
     ;
 
+// Ask the bootloader for the CRC of each block of a segment and flag the
+// blocks whose content differs from what we are about to write.
+static int flash_diff_segment(flash_seg_t *seg, uint32_t blocks, bool *changed) {
+
+    uint8_t block_buf[BLOCK_SIZE];
+
+    for (uint32_t first = 0; first < blocks; first += BL_PAGE_CRC_MAX_BLOCKS) {
+        uint32_t count = MIN(blocks - first, BL_PAGE_CRC_MAX_BLOCKS);
+
+        SendCommandBL(CMD_BL_PAGE_CRC, seg->start + first * BLOCK_SIZE, count, 0, NULL, 0);
+        PacketResponseNG resp;
+        if (WaitForResponseTimeout(CMD_BL_PAGE_CRC, &resp, 2000) == false) {
+            return PM3_ETIMEOUT;
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t offset = (first + i) * BLOCK_SIZE;
+            uint32_t len = MIN(seg->length - offset, BLOCK_SIZE);
+
+            // same padding as write_block()
+            memset(block_buf, 0xFF, BLOCK_SIZE);
+            memcpy(block_buf, (uint8_t *)seg->data + offset, len);
+
+            uint8_t crc[4];
+            crc32_ex(block_buf, BLOCK_SIZE, crc);
+            changed[first + i] = (MemLeToUint4byte(crc) != MemLeToUint4byte(resp.data.asBytes + i * 4));
+        }
+    }
+    return PM3_SUCCESS;
+}
+
 // Write a file's segments to Flash
-int flash_write(flash_file_t *ctx) {
+int flash_write(flash_file_t *ctx, bool full_write) {
     int len = 0;
 
     PrintAndLogEx(SUCCESS, "Writing segments for file: %s", ctx->filename);
@@ -645,7 +682,20 @@ int flash_write(flash_file_t *ctx) {
 
         PrintAndLogEx(SUCCESS, " 0x%08x..0x%08x [0x%x / %u blocks]", seg->start, end - 1, length, blocks);
         fflush(stdout);
+
+        // differential mode, only write the blocks that changed
+        bool *changed = NULL;
+        if (full_write == false && gs_bl_page_crc) {
+            changed = calloc(blocks, sizeof(bool));
+            if (changed != NULL && flash_diff_segment(seg, blocks, changed) != PM3_SUCCESS) {
+                PrintAndLogEx(WARNING, "Could not get block CRCs from bootloader, writing all blocks");
+                free(changed);
+                changed = NULL;
+            }
+        }
+
         int block = 0;
+        uint32_t skipped = 0;
         uint8_t *data = seg->data;
         uint32_t baddr = seg->start;
 
@@ -654,8 +704,11 @@ int flash_write(flash_file_t *ctx) {
             if (block_size > BLOCK_SIZE)
                 block_size = BLOCK_SIZE;
 
-            if (write_block(baddr, data, block_size) < 0) {
+            if (changed != NULL && changed[block] == false) {
+                skipped++;
+            } else if (write_block(baddr, data, block_size) < 0) {
                 PrintAndLogEx(ERR, "Error writing block %d of %u", block, blocks);
+                free(changed);
                 return PM3_EFATAL;
             }
 
@@ -674,7 +727,13 @@ int flash_write(flash_file_t *ctx) {
             }
             fflush(stdout);
         }
-        PrintAndLogEx(NORMAL, " " _GREEN_("ok"));
+        free(changed);
+
+        if (skipped) {
+            PrintAndLogEx(NORMAL, " " _GREEN_("ok") " ( %u unchanged blocks skipped )", skipped);
+        } else {
+            PrintAndLogEx(NORMAL, " " _GREEN_("ok"));
+        }
         fflush(stdout);
     }
     return PM3_SUCCESS;
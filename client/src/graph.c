@@ -18,6 +18,8 @@
 #include "graph.h"
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <pthread.h>
 #include "ui.h"
 #include "proxgui.h"
 #include "util.h"    //param_get32ex
@@ -27,6 +29,9 @@
 
 int g_GraphBuffer[MAX_GRAPH_TRACE_LEN];
 size_t g_GraphTraceLen;
+graph_lod_t g_GraphLod;
+// commands mark changes from the main thread,  the plot updates the pyramids from the Qt thread
+static pthread_mutex_t s_GraphLodLock = PTHREAD_MUTEX_INITIALIZER;
 
 /* write a manchester bit to the graph
 TODO,  verfy that this doesn't overflow buffer  (iceman)
@@ -109,6 +114,165 @@ size_t getFromGraphBuf(uint8_t *dest) {
     return i;
 }
 
+static void graph_lod_extend(graph_lod_t *lod, size_t start, size_t end) {
+    if (start >= end)
+        return;
+
+    if (lod->dirty_start >= lod->dirty_end) {
+        lod->dirty_start = start;
+        lod->dirty_end = end;
+        return;
+    }
+    if (start < lod->dirty_start)
+        lod->dirty_start = start;
+    if (end > lod->dirty_end)
+        lod->dirty_end = end;
+}
+
+// mark samples [start, end) of the pyramid as changed
+void GraphLodInvalidate(graph_lod_t *lod, size_t start, size_t end) {
+    pthread_mutex_lock(&s_GraphLodLock);
+    graph_lod_extend(lod, start, end);
+    pthread_mutex_unlock(&s_GraphLodLock);
+}
+
+static void graph_lod_merge(graph_lod_node_t *dst, const graph_lod_node_t *src) {
+    if (src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+    dst->sum += src->sum;
+}
+
+// bring the pyramid in line with buf[0..len). Only the nodes over changed samples are recomputed.
+// returns false if the pyramid can't be allocated,  callers then fall back to the samples.
+bool GraphLodUpdate(graph_lod_t *lod, const int *buf, size_t len) {
+    if (len > MAX_GRAPH_TRACE_LEN)
+        len = MAX_GRAPH_TRACE_LEN;
+
+    if (lod->nodes == NULL) {
+        // fixed layout for a full buffer,  so the levels don't move when the trace length changes
+        size_t total = 0;
+        size_t count = (MAX_GRAPH_TRACE_LEN + GRAPH_LOD_BLOCK - 1) / GRAPH_LOD_BLOCK;
+        lod->levels = 0;
+        while (lod->levels < GRAPH_LOD_MAX_LEVELS) {
+            lod->level_offset[lod->levels] = total;
+            lod->level_count[lod->levels] = count;
+            lod->levels++;
+            total += count;
+            if (count == 1)
+                break;
+            count = (count + 1) / 2;
+        }
+        lod->nodes = calloc(total, sizeof(graph_lod_node_t));
+        if (lod->nodes == NULL)
+            return false;
+        lod->len = 0;
+    }
+
+    // take the changes marked so far,  anything marked while we rebuild stays for the next update
+    pthread_mutex_lock(&s_GraphLodLock);
+    // grown: new tail. shrunk: the block now holding the last sample
+    if (len > lod->len)
+        graph_lod_extend(lod, lod->len, len);
+    else if (len < lod->len && len > 0)
+        graph_lod_extend(lod, len - 1, len);
+    lod->len = len;
+
+    size_t dirty_start = lod->dirty_start;
+    size_t dirty_end = MIN(lod->dirty_end, len);
+    lod->dirty_start = 0;
+    lod->dirty_end = 0;
+    pthread_mutex_unlock(&s_GraphLodLock);
+
+    if (dirty_start >= dirty_end)
+        return true;
+
+    size_t first = dirty_start / GRAPH_LOD_BLOCK;
+    size_t last = (dirty_end - 1) / GRAPH_LOD_BLOCK;
+
+    graph_lod_node_t *level = lod->nodes;
+    for (size_t b = first; b <= last; b++) {
+        size_t i = b * GRAPH_LOD_BLOCK;
+        size_t end = MIN(i + GRAPH_LOD_BLOCK, len);
+        graph_lod_node_t n = { buf[i], buf[i], 0 };
+        for (; i < end; i++) {
+            if (buf[i] < n.min) n.min = buf[i];
+            if (buf[i] > n.max) n.max = buf[i];
+            n.sum += buf[i];
+        }
+        level[b] = n;
+    }
+
+    // a parent node exists only where its first child does,  the second child may be past len
+    size_t child_samples = GRAPH_LOD_BLOCK;
+    for (uint8_t k = 1; k < lod->levels; k++) {
+        graph_lod_node_t *children = level;
+        level = lod->nodes + lod->level_offset[k];
+        first >>= 1;
+        last >>= 1;
+        for (size_t b = first; b <= last; b++) {
+            level[b] = children[b * 2];
+            size_t c = b * 2 + 1;
+            if (c < lod->level_count[k - 1] && c * child_samples < len)
+                graph_lod_merge(&level[b], &children[c]);
+        }
+        child_samples *= 2;
+    }
+    return true;
+}
+
+// min, max and sum of buf[start..end). Uses the largest pyramid nodes that fit,  samples at the edges.
+// with no pyramid (lod NULL or not allocated) it scans the samples
+void GraphLodQuery(const graph_lod_t *lod, const int *buf, size_t start, size_t end, int *vmin, int *vmax, int64_t *vsum) {
+    int lo = INT_MAX, hi = INT_MIN;
+    int64_t sum = 0;
+    bool use_nodes = (lod != NULL && lod->nodes != NULL && end <= lod->len);
+
+    size_t i = start;
+    while (i < end) {
+        size_t k = 0;
+        if (use_nodes && (i % GRAPH_LOD_BLOCK) == 0) {
+            size_t blk = GRAPH_LOD_BLOCK;
+            while (k + 1 < lod->levels && (i % (blk * 2)) == 0 && i + blk * 2 <= end) {
+                blk *= 2;
+                k++;
+            }
+            if (i + blk <= end) {
+                const graph_lod_node_t *n = &lod->nodes[lod->level_offset[k] + i / blk];
+                if (n->min < lo) lo = n->min;
+                if (n->max > hi) hi = n->max;
+                sum += n->sum;
+                i += blk;
+                continue;
+            }
+        }
+        size_t stop = end;
+        if (use_nodes)
+            stop = MIN(end, (i / GRAPH_LOD_BLOCK + 1) * GRAPH_LOD_BLOCK);
+        for (; i < stop; i++) {
+            if (buf[i] < lo) lo = buf[i];
+            if (buf[i] > hi) hi = buf[i];
+            sum += buf[i];
+        }
+    }
+
+    if (vmin) *vmin = lo;
+    if (vmax) *vmax = hi;
+    if (vsum) *vsum = sum;
+}
+
+void GraphLodFree(graph_lod_t *lod) {
+    free(lod->nodes);
+    memset(lod, 0, sizeof(graph_lod_t));
+}
+
+// commands write g_GraphBuffer directly,  so there is no telling which samples they changed.
+// Called on every repaint request and once a command returned,  the next paint rebuilds the
+// whole pyramid (well under a millisecond). Paints of the plot window itself,  such as panning
+// and zooming,  reuse it.
+void GraphBufferSync(void) {
+    GraphLodInvalidate(&g_GraphLod, 0, MAX_GRAPH_TRACE_LEN);
+}
+
 // A simple test to see if there is any data inside Graphbuffer.
 bool HasGraphData(void) {
     if (g_GraphTraceLen == 0) {
@@ -49,6 +49,36 @@ bool fskClocks(uint8_t *fc1, uint8_t *fc2, uint8_t *rf1, int *firstClockEdge);
 extern int g_GraphBuffer[MAX_GRAPH_TRACE_LEN];
 extern size_t g_GraphTraceLen;
 
+// min/max/sum pyramid over a graph buffer, used by the plot to draw zoomed out traces.
+// Level 0 summarizes GRAPH_LOD_BLOCK samples, every level above halves the node count.
+#define GRAPH_LOD_BLOCK       16
+#define GRAPH_LOD_MAX_LEVELS  24
+
+typedef struct {
+    int min;
+    int max;
+    int64_t sum;
+} graph_lod_node_t;
+
+typedef struct {
+    graph_lod_node_t *nodes;                        // all levels back to back, finest first
+    size_t level_offset[GRAPH_LOD_MAX_LEVELS];
+    size_t level_count[GRAPH_LOD_MAX_LEVELS];
+    uint8_t levels;
+    size_t len;                                     // samples the nodes are valid for
+    size_t dirty_start;                             // samples changed since the last update, under a lock in graph.c
+    size_t dirty_end;
+} graph_lod_t;
+
+void GraphLodInvalidate(graph_lod_t *lod, size_t start, size_t end);
+bool GraphLodUpdate(graph_lod_t *lod, const int *buf, size_t len);
+void GraphLodQuery(const graph_lod_t *lod, const int *buf, size_t start, size_t end, int *vmin, int *vmax, int64_t *vsum);
+void GraphLodFree(graph_lod_t *lod);
+
+// pyramid of g_GraphBuffer
+extern graph_lod_t g_GraphLod;
+void GraphBufferSync(void);
+
 #ifdef __cplusplus
 }
 #endif
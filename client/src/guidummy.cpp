@@ -17,6 +17,7 @@
 //-----------------------------------------------------------------------------
 
 #include <stdio.h>
+#include <stdint.h>
 
 extern "C" void ShowGraphWindow(void) {
     static int warned = 0;
@@ -29,6 +30,9 @@ extern "C" void ShowGraphWindow(void) {
 
 extern "C" void HideGraphWindow(void) {}
 extern "C" void RepaintGraphWindow(void) {}
+extern "C" bool GraphRenderBench(uint32_t iterations, uint64_t *ms_samples, uint64_t *ms_lod) {
+    return false;
+}
 
 extern "C" void ShowPictureWindow(char *fn) {
     static int warned = 0;
@@ -217,44 +217,6 @@ const char *nxp_cluster_to_text(uint8_t cluster) {
     return "reserved";
 }
 
-static json_t *df_known_aids = NULL;
-
-static int open_aiddf_file(json_t **root, bool verbose) {
-
-    char *path;
-    int res = searchFile(&path, RESOURCES_SUBDIR, "aid_desfire", ".json", true);
-    if (res != PM3_SUCCESS) {
-        return PM3_EFILE;
-    }
-
-    int retval = PM3_SUCCESS;
-    json_error_t error;
-
-    *root = json_load_file(path, 0, &error);
-    if (!*root) {
-        PrintAndLogEx(ERR, "json (%s) error on line %d: %s", path, error.line, error.text);
-        retval = PM3_ESOFT;
-        goto out;
-    }
-
-    if (!json_is_array(*root)) {
-        PrintAndLogEx(ERR, "Invalid json (%s) format. root must be an array.", path);
-        retval = PM3_ESOFT;
-        goto out;
-    }
-
-    if (verbose)
-        PrintAndLogEx(SUCCESS, "Loaded file " _YELLOW_("`%s`") " (%s) %zu records.", path,  _GREEN_("ok"), json_array_size(*root));
-out:
-    free(path);
-    return retval;
-}
-
-static int close_aiddf_file(json_t *root) {
-    json_decref(root);
-    return PM3_SUCCESS;
-}
-
 static const char *aiddf_json_get_str(json_t *data, const char *name) {
 
     json_t *jstr = json_object_get(data, name);
@@ -273,27 +235,11 @@ static const char *aiddf_json_get_str(json_t *data, const char *name) {
     return cstr;
 }
 
-static int print_aiddf_description(json_t *root, uint8_t aid[3], char *fmt, bool verbose) {
+static int print_aiddf_description(uint8_t aid[3], char *fmt, bool verbose) {
     char laid[7] = {0};
     sprintf(laid, "%02x%02x%02x", aid[2], aid[1], aid[0]); // must be lowercase
 
-    json_t *elm = NULL;
-
-    for (uint32_t idx = 0; idx < json_array_size(root); idx++) {
-        json_t *data = json_array_get(root, idx);
-        if (!json_is_object(data)) {
-            PrintAndLogEx(ERR, "data [%d] is not an object\n", idx);
-            continue;
-        }
-        const char *faid = aiddf_json_get_str(data, "AID");
-        char lfaid[strlen(faid) + 1];
-        strcpy(lfaid, faid);
-        str_lower(lfaid);
-        if (strcmp(laid, lfaid) == 0) {
-            elm = data;
-            break;
-        }
-    }
+    json_t *elm = json_object_get(getResourceJSONIndex("aid_desfire", "AID", true), laid);
 
     if (elm == NULL) {
         PrintAndLogEx(INFO, fmt, " (unknown)");
@@ -329,11 +275,8 @@ static int print_aiddf_description(json_t *root, uint8_t aid[3], char *fmt, bool
 }
 
 int AIDDFDecodeAndPrint(uint8_t aid[3]) {
-    open_aiddf_file(&df_known_aids, false);
-
     char fmt[80];
     sprintf(fmt, "  DF AID Function %02X%02X%02X     :" _YELLOW_("%s"), aid[2], aid[1], aid[0], "%s");
-    print_aiddf_description(df_known_aids, aid, fmt, false);
-    close_aiddf_file(df_known_aids);
+    print_aiddf_description(aid, fmt, false);
     return PM3_SUCCESS;
 }
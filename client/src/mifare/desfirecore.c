@@ -1680,6 +1680,48 @@ void DesfireCheckAuthCommandsPrint(AuthCommandsChk_t *authCmdCheck) {
     PrintAndLogEx(SUCCESS, "   Auth LRP.......... %s", authCmdCheck->authLRP ? _GREEN_("YES") : _RED_("NO"));
 }
 
+// Tries the key lists on every used key number that has no key yet, a found key ends the search for that key number.
+// Keys are tried one full authentication at a time, *pos lets an interrupted search resume where it stopped.
+// When the card refuses the first auth step the key type does not fit the application, the rest of that list is skipped.
+int DesfireCheckKeyLists(DesfireContext_t *dctx, DesfireSecureChannel secureChannel, uint32_t aid,
+                         const DesfireChkOps_t *ops, DesfireChkKeyList_t lists[DESFIRE_CHK_KEY_TYPES], const bool usedKeys[DESFIRE_CHK_KEY_NUMS],
+                         uint8_t foundKeys[DESFIRE_CHK_KEY_TYPES][DESFIRE_CHK_KEY_NUMS][24 + 1], DesfireChkPosition_t *pos, bool *result) {
+
+    for (; pos->type < DESFIRE_CHK_KEY_TYPES; pos->type++, pos->keyNum = 0) {
+        DesfireChkKeyList_t *list = &lists[pos->type];
+        size_t keylen = desfire_get_key_length(list->algo);
+        bool badlen = false;
+
+        for (; list->count > 0 && badlen == false && pos->keyNum < DESFIRE_CHK_KEY_NUMS; pos->keyNum++, pos->keyIndex = 0) {
+            if (usedKeys[pos->keyNum] == false || foundKeys[pos->type][pos->keyNum][0] != 0)
+                continue;
+
+            for (; pos->keyIndex < list->count; pos->keyIndex++) {
+                if ((pos->keyIndex % 8) == 0 && ops->aborted != NULL && ops->aborted())
+                    return PM3_EOPABORTED;
+
+                uint8_t *key = list->keys + pos->keyIndex * list->stride;
+                DesfireSetKeyNoClear(dctx, pos->keyNum, list->algo, key);
+                int res = ops->authenticate(dctx, secureChannel, false);
+                if (res == PM3_SUCCESS) {
+                    PrintAndLogEx(SUCCESS, "AID 0x%06X, Found %s Key %02u%*s: " _GREEN_("%s"), aid, list->name, pos->keyNum, (int)(13 - strlen(list->name)), "", sprint_hex(key, keylen));
+                    foundKeys[pos->type][pos->keyNum][0] = 0x01;
+                    memcpy(&foundKeys[pos->type][pos->keyNum][1], key, keylen);
+                    *result = true;
+                    break;
+                } else if (res < 7) {
+                    badlen = true;
+                    res = ops->reselect(dctx, aid);
+                    if (res != PM3_SUCCESS)
+                        return res;
+                    break;
+                }
+            }
+        }
+    }
+    return PM3_SUCCESS;
+}
+
 int DesfireFillPICCInfo(DesfireContext_t *dctx, PICCInfo_t *PICCInfo, bool deepmode) {
     uint8_t buf[250] = {0};
     size_t buflen = 0;
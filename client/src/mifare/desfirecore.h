@@ -151,6 +151,32 @@ typedef enum {
     RFTMAC,
 } DesfireReadOpFileType;
 
+// hf mfdes chk. key types are checked in this order, it is also the index into the found keys table
+#define DESFIRE_CHK_KEY_TYPES   4
+#define DESFIRE_CHK_KEY_NUMS    0x0E
+
+typedef struct {
+    DesfireCryptoAlgorithm algo;
+    const char *name;
+    uint8_t *keys;      // count keys, stride bytes apart
+    size_t stride;
+    uint32_t count;
+} DesfireChkKeyList_t;
+
+// next attempt of DesfireCheckKeyLists, left at the key that was about to be tried when it stops early
+typedef struct {
+    uint8_t type;
+    uint8_t keyNum;
+    uint32_t keyIndex;
+} DesfireChkPosition_t;
+
+// card side of the key search. the command uses the real card, the self test a virtual one
+typedef struct {
+    int (*authenticate)(DesfireContext_t *dctx, DesfireSecureChannel secureChannel, bool verbose);
+    int (*reselect)(DesfireContext_t *dctx, uint32_t aid);
+    int (*aborted)(void);
+} DesfireChkOps_t;
+
 extern const CLIParserOption DesfireAlgoOpts[];
 extern const CLIParserOption DesfireKDFAlgoOpts[];
 extern const CLIParserOption DesfireCommunicationModeOpts[];
@@ -198,6 +224,10 @@ bool DesfireCheckAuthCmd(DesfireISOSelectWay way, uint32_t appID, uint8_t keyNum
 void DesfireCheckAuthCommands(DesfireISOSelectWay way, uint32_t appID, char *dfname, uint8_t keyNum,  AuthCommandsChk_t *authCmdCheck);
 void DesfireCheckAuthCommandsPrint(AuthCommandsChk_t *authCmdCheck);
 
+int DesfireCheckKeyLists(DesfireContext_t *dctx, DesfireSecureChannel secureChannel, uint32_t aid,
+                         const DesfireChkOps_t *ops, DesfireChkKeyList_t lists[DESFIRE_CHK_KEY_TYPES], const bool usedKeys[DESFIRE_CHK_KEY_NUMS],
+                         uint8_t foundKeys[DESFIRE_CHK_KEY_TYPES][DESFIRE_CHK_KEY_NUMS][24 + 1], DesfireChkPosition_t *pos, bool *result);
+
 int DesfireFormatPICC(DesfireContext_t *dctx);
 int DesfireGetFreeMem(DesfireContext_t *dctx, uint32_t *freemem);
 int DesfireGetUID(DesfireContext_t *dctx, uint8_t *resp, size_t *resplen);
@@ -30,6 +30,15 @@
 #include "crc32.h"
 #include "commonutil.h"
 
+#if ( defined (__i386__) || defined (__x86_64__) ) && defined (__GNUC__) && \
+    ( !defined(__APPLE__) || \
+      (defined(__APPLE__) && (__clang_major__ > 8 || __clang_major__ == 8 && __clang_minor__ >= 1)) )
+#define DESFIRE_HAS_AESNI
+#include <cpuid.h>
+#include <wmmintrin.h>
+#define AESNI_TARGET __attribute__((target("aes,sse2")))
+#endif
+
 void DesfireClearContext(DesfireContext_t *ctx) {
     ctx->keyNum = 0;
     ctx->keyType = T_DES;
@@ -64,6 +73,23 @@ void DesfireClearSession(DesfireContext_t *ctx) {
     ctx->lastRequestZeroLen = false;
     ctx->cmdCntr = 0;
     memset(ctx->TI, 0, sizeof(ctx->TI));
+    DesfireClearKeySchedules(ctx);
+}
+
+void DesfireClearKeySchedules(DesfireContext_t *ctx) {
+    memset(ctx->keySchedule, 0, sizeof(ctx->keySchedule));
+    memset(ctx->lrpContext, 0, sizeof(ctx->lrpContext));
+}
+
+// LRP tables cost 41 AES operations to build, keep them for as long as the key stays the same
+static LRPContext_t *DesfireGetLRPContext(DesfireContext_t *ctx, DesfireCryptoOpKeyType key_type, size_t updatedKeyNum, bool useBitPadding) {
+    uint8_t *key = DesfireGetKey(ctx, key_type);
+    if (key == NULL)
+        return NULL;
+
+    LRPContext_t *lctx = &ctx->lrpContext[key_type];
+    LRPUpdateKey(lctx, key, updatedKeyNum, useBitPadding);
+    return lctx;
 }
 
 void DesfireClearIV(DesfireContext_t *ctx) {
@@ -85,6 +111,7 @@ void DesfireSetKeyNoClear(DesfireContext_t *ctx, uint8_t keyNum, DesfireCryptoAl
 
     ctx->keyNum = keyNum;
     ctx->keyType = keyType;
+    DesfireClearKeySchedules(ctx);
     memcpy(ctx->key, key, desfire_get_key_length(keyType));
     memcpy(ctx->masterKey, key, desfire_get_key_length(keyType));
 }
@@ -185,8 +212,186 @@ uint8_t *DesfireGetKey(DesfireContext_t *ctx, DesfireCryptoOpKeyType key_type) {
 }
 
 
-static void DesfireCryptoEncDecSingleBlock(uint8_t *key, DesfireCryptoAlgorithm keyType, uint8_t *data, uint8_t *dstdata, uint8_t *ivect, bool dir_to_send, bool encode) {
-    size_t block_size = desfire_get_key_block_length(keyType);
+#ifdef DESFIRE_HAS_AESNI
+#define AESNI_KEY_EXP(k, rcon) aesni_key_exp((k), _mm_aeskeygenassist_si128((k), (rcon)))
+
+AESNI_TARGET static inline __m128i aesni_key_exp(__m128i key, __m128i kg) {
+    kg = _mm_shuffle_epi32(kg, 0xff);
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    return _mm_xor_si128(key, kg);
+}
+
+AESNI_TARGET static void aesni_setkey(uint8_t *rk, const uint8_t *key, bool encode) {
+    __m128i k[11];
+    k[0] = _mm_loadu_si128((const __m128i *)key);
+    k[1] = AESNI_KEY_EXP(k[0], 0x01);
+    k[2] = AESNI_KEY_EXP(k[1], 0x02);
+    k[3] = AESNI_KEY_EXP(k[2], 0x04);
+    k[4] = AESNI_KEY_EXP(k[3], 0x08);
+    k[5] = AESNI_KEY_EXP(k[4], 0x10);
+    k[6] = AESNI_KEY_EXP(k[5], 0x20);
+    k[7] = AESNI_KEY_EXP(k[6], 0x40);
+    k[8] = AESNI_KEY_EXP(k[7], 0x80);
+    k[9] = AESNI_KEY_EXP(k[8], 0x1b);
+    k[10] = AESNI_KEY_EXP(k[9], 0x36);
+
+    for (int i = 0; i < 11; i++) {
+        __m128i rki = k[i];
+        if (encode == false) {
+            // equivalent inverse cipher: reversed order, InvMixColumns on the inner round keys
+            rki = (i == 0 || i == 10) ? k[10 - i] : _mm_aesimc_si128(k[10 - i]);
+        }
+        _mm_storeu_si128((__m128i *)(rk + i * 16), rki);
+    }
+}
+
+AESNI_TARGET static inline __m128i aesni_enc_block(const __m128i *k, __m128i b) {
+    b = _mm_xor_si128(b, k[0]);
+    for (int i = 1; i < 10; i++)
+        b = _mm_aesenc_si128(b, k[i]);
+    return _mm_aesenclast_si128(b, k[10]);
+}
+
+AESNI_TARGET static inline __m128i aesni_dec_block(const __m128i *k, __m128i b) {
+    b = _mm_xor_si128(b, k[0]);
+    for (int i = 1; i < 10; i++)
+        b = _mm_aesdec_si128(b, k[i]);
+    return _mm_aesdeclast_si128(b, k[10]);
+}
+
+AESNI_TARGET static void aesni_ecb(const uint8_t *rk, const uint8_t *in, uint8_t *out, bool encode) {
+    __m128i k[11];
+    for (int i = 0; i < 11; i++)
+        k[i] = _mm_loadu_si128((const __m128i *)(rk + i * 16));
+
+    __m128i b = _mm_loadu_si128((const __m128i *)in);
+    b = (encode) ? aesni_enc_block(k, b) : aesni_dec_block(k, b);
+    _mm_storeu_si128((__m128i *)out, b);
+}
+
+AESNI_TARGET static void aesni_cbc_encrypt(const uint8_t *rk, const uint8_t *in, uint8_t *out, size_t len, uint8_t *iv) {
+    __m128i k[11];
+    for (int i = 0; i < 11; i++)
+        k[i] = _mm_loadu_si128((const __m128i *)(rk + i * 16));
+
+    __m128i c = _mm_loadu_si128((const __m128i *)iv);
+    for (size_t i = 0; i < len; i += 16) {
+        c = aesni_enc_block(k, _mm_xor_si128(c, _mm_loadu_si128((const __m128i *)(in + i))));
+        _mm_storeu_si128((__m128i *)(out + i), c);
+    }
+    _mm_storeu_si128((__m128i *)iv, c);
+}
+
+// CBC decryption has no chain dependency, so four blocks go through the pipeline at once
+AESNI_TARGET static void aesni_cbc_decrypt(const uint8_t *rk, const uint8_t *in, uint8_t *out, size_t len, uint8_t *iv) {
+    __m128i k[11];
+    for (int i = 0; i < 11; i++)
+        k[i] = _mm_loadu_si128((const __m128i *)(rk + i * 16));
+
+    __m128i prev = _mm_loadu_si128((const __m128i *)iv);
+    size_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m128i c0 = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i c1 = _mm_loadu_si128((const __m128i *)(in + i + 16));
+        __m128i c2 = _mm_loadu_si128((const __m128i *)(in + i + 32));
+        __m128i c3 = _mm_loadu_si128((const __m128i *)(in + i + 48));
+        __m128i b0 = _mm_xor_si128(c0, k[0]);
+        __m128i b1 = _mm_xor_si128(c1, k[0]);
+        __m128i b2 = _mm_xor_si128(c2, k[0]);
+        __m128i b3 = _mm_xor_si128(c3, k[0]);
+        for (int r = 1; r < 10; r++) {
+            b0 = _mm_aesdec_si128(b0, k[r]);
+            b1 = _mm_aesdec_si128(b1, k[r]);
+            b2 = _mm_aesdec_si128(b2, k[r]);
+            b3 = _mm_aesdec_si128(b3, k[r]);
+        }
+        b0 = _mm_xor_si128(_mm_aesdeclast_si128(b0, k[10]), prev);
+        b1 = _mm_xor_si128(_mm_aesdeclast_si128(b1, k[10]), c0);
+        b2 = _mm_xor_si128(_mm_aesdeclast_si128(b2, k[10]), c1);
+        b3 = _mm_xor_si128(_mm_aesdeclast_si128(b3, k[10]), c2);
+        _mm_storeu_si128((__m128i *)(out + i), b0);
+        _mm_storeu_si128((__m128i *)(out + i + 16), b1);
+        _mm_storeu_si128((__m128i *)(out + i + 32), b2);
+        _mm_storeu_si128((__m128i *)(out + i + 48), b3);
+        prev = c3;
+    }
+    for (; i < len; i += 16) {
+        __m128i c = _mm_loadu_si128((const __m128i *)(in + i));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_xor_si128(aesni_dec_block(k, c), prev));
+        prev = c;
+    }
+    _mm_storeu_si128((__m128i *)iv, prev);
+}
+#endif
+
+bool DesfireHasAESNI(void) {
+#ifdef DESFIRE_HAS_AESNI
+    static int has_aesni = -1;
+    if (has_aesni < 0) {
+        unsigned int eax, ebx, ecx, edx;
+        has_aesni = (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_AES)) ? 1 : 0;
+    }
+    return has_aesni;
+#else
+    return false;
+#endif
+}
+
+// Returns the expanded key for a key slot, rebuilding it only when the key has changed
+static DesfireKeySchedule_t *DesfireGetKeySchedule(DesfireContext_t *ctx, DesfireCryptoOpKeyType key_type, bool encode) {
+    uint8_t *key = DesfireGetKey(ctx, key_type);
+    DesfireKeySchedule_t *ks = &ctx->keySchedule[key_type][encode];
+    size_t keylen = desfire_get_key_length(ctx->keyType);
+
+    // mbedtls keeps a pointer to its own round key buffer, a context copied around is rebuilt
+    if (ks->valid && ks->keyType == ctx->keyType && memcmp(ks->key, key, keylen) == 0 &&
+            (ks->keyType != T_AES || ks->sched.aes.rk == ks->sched.aes.buf)) {
+        return ks;
+    }
+
+    memset(ks, 0, sizeof(DesfireKeySchedule_t));
+    ks->keyType = ctx->keyType;
+    memcpy(ks->key, key, keylen);
+
+    switch (ks->keyType) {
+        case T_DES:
+            if (encode)
+                mbedtls_des_setkey_enc(&ks->sched.des, key);
+            else
+                mbedtls_des_setkey_dec(&ks->sched.des, key);
+            break;
+        case T_3DES:
+            if (encode)
+                mbedtls_des3_set2key_enc(&ks->sched.des3, key);
+            else
+                mbedtls_des3_set2key_dec(&ks->sched.des3, key);
+            break;
+        case T_3K3DES:
+            if (encode)
+                mbedtls_des3_set3key_enc(&ks->sched.des3, key);
+            else
+                mbedtls_des3_set3key_dec(&ks->sched.des3, key);
+            break;
+        case T_AES:
+            mbedtls_aes_init(&ks->sched.aes);
+            if (encode)
+                mbedtls_aes_setkey_enc(&ks->sched.aes, key, 128);
+            else
+                mbedtls_aes_setkey_dec(&ks->sched.aes, key, 128);
+#ifdef DESFIRE_HAS_AESNI
+            if (DesfireHasAESNI())
+                aesni_setkey(ks->aesni_rk, key, encode);
+#endif
+            break;
+    }
+    ks->valid = true;
+    return ks;
+}
+
+static void DesfireCryptoEncDecSingleBlock(DesfireKeySchedule_t *ks, uint8_t *data, uint8_t *dstdata, uint8_t *ivect, bool dir_to_send, bool encode) {
+    size_t block_size = desfire_get_key_block_length(ks->keyType);
     uint8_t sdata[DESFIRE_MAX_CRYPTO_BLOCK_SIZE] = {0};
     memcpy(sdata, data, block_size);
     if (dir_to_send) {
@@ -195,49 +400,22 @@ static void DesfireCryptoEncDecSingleBlock(uint8_t *key, DesfireCryptoAlgorithm
 
     uint8_t edata[DESFIRE_MAX_CRYPTO_BLOCK_SIZE] = {0};
 
-    switch (keyType) {
+    switch (ks->keyType) {
         case T_DES:
-            if (encode)
-                des_encrypt(edata, sdata, key);
-            else
-                des_decrypt(edata, sdata, key);
+            mbedtls_des_crypt_ecb(&ks->sched.des, sdata, edata);
             break;
         case T_3DES:
-            if (encode) {
-                mbedtls_des3_context ctx3;
-                mbedtls_des3_set2key_enc(&ctx3, key);
-                mbedtls_des3_crypt_ecb(&ctx3, sdata, edata);
-            } else {
-                mbedtls_des3_context ctx3;
-                mbedtls_des3_set2key_dec(&ctx3, key);
-                mbedtls_des3_crypt_ecb(&ctx3, sdata, edata);
-            }
-            break;
         case T_3K3DES:
-            if (encode) {
-                mbedtls_des3_context ctx3;
-                mbedtls_des3_set3key_enc(&ctx3, key);
-                mbedtls_des3_crypt_ecb(&ctx3, sdata, edata);
-            } else {
-                mbedtls_des3_context ctx3;
-                mbedtls_des3_set3key_dec(&ctx3, key);
-                mbedtls_des3_crypt_ecb(&ctx3, sdata, edata);
-            }
+            mbedtls_des3_crypt_ecb(&ks->sched.des3, sdata, edata);
             break;
         case T_AES:
-            if (encode) {
-                mbedtls_aes_context actx;
-                mbedtls_aes_init(&actx);
-                mbedtls_aes_setkey_enc(&actx, key, 128);
-                mbedtls_aes_crypt_ecb(&actx, MBEDTLS_AES_ENCRYPT, sdata, edata);
-                mbedtls_aes_free(&actx);
-            } else {
-                mbedtls_aes_context actx;
-                mbedtls_aes_init(&actx);
-                mbedtls_aes_setkey_dec(&actx, key, 128);
-                mbedtls_aes_crypt_ecb(&actx, MBEDTLS_AES_DECRYPT, sdata, edata);
-                mbedtls_aes_free(&actx);
+#ifdef DESFIRE_HAS_AESNI
+            if (DesfireHasAESNI()) {
+                aesni_ecb(ks->aesni_rk, sdata, edata, encode);
+                break;
             }
+#endif
+            mbedtls_aes_crypt_ecb(&ks->sched.aes, (encode) ? MBEDTLS_AES_ENCRYPT : MBEDTLS_AES_DECRYPT, sdata, edata);
             break;
     }
 
@@ -251,6 +429,30 @@ static void DesfireCryptoEncDecSingleBlock(uint8_t *key, DesfireCryptoAlgorithm
     memcpy(dstdata, edata, block_size);
 }
 
+// Plain CBC over whole blocks in one go. d40 also uses the "send" chaining with decryption,
+// and receives with encryption. Those stay on the block by block path.
+static bool DesfireCryptoCBC(DesfireKeySchedule_t *ks, uint8_t *srcdata, size_t srcdatalen, uint8_t *dstdata, uint8_t *iv, bool encode) {
+    switch (ks->keyType) {
+        case T_DES:
+            return mbedtls_des_crypt_cbc(&ks->sched.des, (encode) ? MBEDTLS_DES_ENCRYPT : MBEDTLS_DES_DECRYPT, srcdatalen, iv, srcdata, dstdata) == 0;
+        case T_3DES:
+        case T_3K3DES:
+            return mbedtls_des3_crypt_cbc(&ks->sched.des3, (encode) ? MBEDTLS_DES_ENCRYPT : MBEDTLS_DES_DECRYPT, srcdatalen, iv, srcdata, dstdata) == 0;
+        case T_AES:
+#ifdef DESFIRE_HAS_AESNI
+            if (DesfireHasAESNI()) {
+                if (encode)
+                    aesni_cbc_encrypt(ks->aesni_rk, srcdata, dstdata, srcdatalen, iv);
+                else
+                    aesni_cbc_decrypt(ks->aesni_rk, srcdata, dstdata, srcdatalen, iv);
+                return true;
+            }
+#endif
+            return mbedtls_aes_crypt_cbc(&ks->sched.aes, (encode) ? MBEDTLS_AES_ENCRYPT : MBEDTLS_AES_DECRYPT, srcdatalen, iv, srcdata, dstdata) == 0;
+    }
+    return false;
+}
+
 void DesfireCryptoEncDecEx(DesfireContext_t *ctx, DesfireCryptoOpKeyType key_type, uint8_t *srcdata, size_t srcdatalen, uint8_t *dstdata, bool dir_to_send, bool encode, uint8_t *iv) {
     uint8_t data[1024] = {0};
     uint8_t xiv[DESFIRE_MAX_CRYPTO_BLOCK_SIZE] = {0};
@@ -272,11 +474,22 @@ void DesfireCryptoEncDecEx(DesfireContext_t *ctx, DesfireCryptoOpKeyType key_typ
 
     if (ctx->secureChannel == DACLRP) {
         size_t dstlen = 0;
-        LRPEncDec(key, xiv, encode, srcdata, srcdatalen, data, &dstlen);
+        LRPContext_t *lctx = DesfireGetLRPContext(ctx, key_type, 1, true);
+        LRPSetCounter(lctx, xiv, 4 * 2);
+        if (encode)
+            LRPEncode(lctx, srcdata, srcdatalen, data, &dstlen);
+        else
+            LRPDecode(lctx, srcdata, srcdatalen, data, &dstlen);
     } else {
+        DesfireKeySchedule_t *ks = DesfireGetKeySchedule(ctx, key_type, encode);
+        bool done = false;
+        if (dir_to_send == encode && srcdatalen % block_size == 0 && srcdatalen <= sizeof(data)) {
+            done = DesfireCryptoCBC(ks, srcdata, srcdatalen, data, xiv, encode);
+        }
+
         size_t offset = 0;
-        while (offset < srcdatalen) {
-            DesfireCryptoEncDecSingleBlock(key, ctx->keyType, srcdata + offset, data + offset, xiv, dir_to_send, encode);
+        while (done == false && offset < srcdatalen) {
+            DesfireCryptoEncDecSingleBlock(ks, srcdata + offset, data + offset, xiv, dir_to_send, encode);
 
             offset += block_size;
         }
@@ -727,9 +940,7 @@ int DesfireLRPCalcCMAC(DesfireContext_t *ctx, uint8_t cmd, uint8_t *data, size_t
         memcpy(&mdata[7], data, datalen);
     mdatalen = 1 + 2 + 4 + datalen;
 
-    LRPContext_t lctx = {0};
-    LRPSetKey(&lctx, ctx->sessionKeyMAC, 0, true);
-    LRPCMAC8(&lctx, mdata, mdatalen, mac);
+    LRPCMAC8(DesfireGetLRPContext(ctx, DCOSessionKeyMac, 0, true), mdata, mdatalen, mac);
 
     return 0;
 }
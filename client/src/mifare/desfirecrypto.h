@@ -23,6 +23,8 @@
 #include "desfire.h"
 #include "crypto/libpcrypto.h"
 #include "mifare/lrpcrypto.h"
+#include <mbedtls/des.h>
+#include <mbedtls/aes.h>
 
 #define DESFIRE_GET_ISO_STATUS(x) ( ((uint16_t)(0x91<<8)) + (uint16_t)x )
 
@@ -56,6 +58,20 @@ typedef enum {
     DCOSessionKeyEnc
 } DesfireCryptoOpKeyType;
 
+// expanded key of one key slot and direction. Checked against the key bytes on every use,
+// so session keys written directly into the context are picked up as well.
+typedef struct {
+    bool valid;
+    DesfireCryptoAlgorithm keyType;
+    uint8_t key[DESFIRE_MAX_KEY_SIZE];
+    union {
+        mbedtls_des_context des;
+        mbedtls_des3_context des3;
+        mbedtls_aes_context aes;
+    } sched;
+    uint8_t aesni_rk[11 * 16];  // AES-NI round keys, used when the CPU has them
+} DesfireKeySchedule_t;
+
 typedef struct {
     uint8_t keyNum;
     DesfireCryptoAlgorithm keyType;   // des/2tdea/3tdea/aes
@@ -86,11 +102,16 @@ typedef struct {
     bool lastRequestZeroLen;
     uint16_t cmdCntr;   // for AES
     uint8_t TI[4];      // for AES
+
+    DesfireKeySchedule_t keySchedule[DCOSessionKeyEnc + 1][2];  // [key type][encode]
+    LRPContext_t lrpContext[DCOSessionKeyEnc + 1];               // plaintext/updated key tables per key type
 } DesfireContext_t;
 
 void DesfireClearContext(DesfireContext_t *ctx);
 void DesfireClearSession(DesfireContext_t *ctx);
 void DesfireClearIV(DesfireContext_t *ctx);
+void DesfireClearKeySchedules(DesfireContext_t *ctx);
+bool DesfireHasAESNI(void);
 void DesfireSetKey(DesfireContext_t *ctx, uint8_t keyNum, DesfireCryptoAlgorithm keyType, uint8_t *key);
 void DesfireSetKeyNoClear(DesfireContext_t *ctx, uint8_t keyNum, DesfireCryptoAlgorithm keyType, uint8_t *key);
 void DesfireSetCommandSet(DesfireContext_t *ctx, DesfireCommandSet cmdSet);
@@ -22,10 +22,14 @@
 #include <unistd.h>
 #include <string.h>      // memcpy memset
 #include "fileutils.h"
+#include "commonutil.h"  // ARRAYLEN
 
 #include "crypto/libpcrypto.h"
 #include "mifare/desfirecrypto.h"
+#include "mifare/desfirecore.h"
 #include "mifare/lrpcrypto.h"
+#include <mbedtls/des.h>
+#include <mbedtls/aes.h>
 
 static uint8_t CMACData[] = {0x6B, 0xC1, 0xBE, 0xE2, 0x2E, 0x40, 0x9F, 0x96,
                              0xE9, 0x3D, 0x7E, 0x11, 0x73, 0x93, 0x17, 0x2A,
@@ -863,6 +867,90 @@ static bool TestLRPCMAC(void) {
     return res;
 }
 
+// AN12304 vectors again, this time through a reused context and the streaming calls
+static bool TestLRPStreaming(void) {
+    bool res = true;
+
+    LRPContext_t ctx = {0};
+    uint8_t resp[64] = {0};
+    uint8_t cmac[CRYPTO_AES128_KEY_SIZE] = {0};
+
+    // 3.3 LRP encryption, vector 1. bit padding added by hand, two calls of one block each
+    uint8_t key1[] = {0xE0, 0xC4, 0x93, 0x5F, 0xF0, 0xC2, 0x54, 0xCD, 0x2C, 0xEF, 0x8F, 0xDD, 0xC3, 0x24, 0x60, 0xCF};
+    uint8_t iv1[] = {0xC3, 0x31, 0x5D, 0xBF};
+    uint8_t data1[] = {0x01, 0x2D, 0x7F, 0x16, 0x53, 0xCA, 0xF6, 0x50, 0x3C, 0x6A, 0xB0, 0xC1, 0x01, 0x0E, 0x8C, 0xB0,
+                       0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+                      };
+    uint8_t res1[] = {0xFC, 0xBB, 0xAC, 0xAA, 0x4F, 0x29, 0x18, 0x24, 0x64, 0xF9, 0x9D, 0xE4, 0x10, 0x85, 0x26, 0x6F,
+                      0x48, 0x0E, 0x86, 0x3E, 0x48, 0x7B, 0xAA, 0xF6, 0x87, 0xB4, 0x3E, 0xD1, 0xEC, 0xE0, 0xD6, 0x23
+                     };
+    res = res && LRPUpdateKey(&ctx, key1, 0, true);
+    LRPSetCounter(&ctx, iv1, sizeof(iv1) * 2);
+    LRPEncodeBlocks(&ctx, data1, 16, resp);
+    LRPEncodeBlocks(&ctx, &data1[16], 16, &resp[16]);
+    res = res && (memcmp(resp, res1, sizeof(res1)) == 0);
+
+    res = res && (LRPUpdateKey(&ctx, key1, 0, true) == false);
+    LRPSetCounter(&ctx, iv1, sizeof(iv1) * 2);
+    LRPDecodeBlocks(&ctx, res1, 16, resp);
+    LRPDecodeBlocks(&ctx, &res1[16], 16, &resp[16]);
+    res = res && (memcmp(resp, data1, sizeof(data1)) == 0);
+
+    // 3.4 LRP CMAC, vectors 4 and 6. fed in uneven pieces, switching keys on the same context
+    uint8_t key4[] = {0x2A, 0x47, 0x3E, 0x38, 0xBB, 0xF4, 0x53, 0x7C, 0x53, 0x97, 0xF4, 0x5A, 0xE4, 0x98, 0xCD, 0x4D};
+    uint8_t data4[] = {0xC2, 0xAC, 0x3D, 0x72, 0x50, 0xEE, 0xF0, 0x23, 0x18, 0xBC, 0x08, 0x4F, 0x29, 0x4B, 0x1A, 0xC7,
+                       0x22, 0x91, 0xEE, 0x1D, 0xC0, 0x2A, 0xF4, 0x24, 0x94, 0x1C, 0xAA, 0xC6, 0x85, 0xFC, 0xA5, 0x9D,
+                       0x90, 0x08, 0x67, 0x9B, 0x00, 0xC5, 0x6A, 0x05, 0x62, 0x58, 0x3B, 0xDA, 0xEC, 0x0B, 0xBA
+                      };
+    uint8_t cmacres4[] = {0x66, 0xDC, 0x2B, 0xCE, 0x26, 0x9B, 0x79, 0x3B, 0x4A, 0xCA, 0x1A, 0x4D, 0x04, 0xDD, 0xD6, 0x68};
+    uint8_t key6[] = {0x95, 0x2F, 0xDE, 0x83, 0x93, 0xC4, 0x5D, 0x23, 0x0A, 0x5B, 0xE9, 0xB3, 0x86, 0x36, 0xD1, 0x54};
+    uint8_t data6[] = {0xD7, 0x80, 0x0E, 0x25, 0x70, 0x01, 0xA7, 0x74, 0xAE, 0x7B, 0xCF, 0xB2, 0xCE, 0x13, 0x07, 0xB5,
+                       0xB0, 0x44
+                      };
+    uint8_t cmacres6[] = {0x05, 0xF1, 0xCE, 0x30, 0x45, 0x1A, 0x03, 0xA6, 0xE4, 0x68, 0xB3, 0xA5, 0x90, 0x33, 0xA5, 0x54};
+
+    size_t pieces[] = {1, 5, 16, 17, 47};
+    for (size_t p = 0; p < ARRAYLEN(pieces); p++) {
+        res = res && LRPUpdateKey(&ctx, key4, 0, true);
+        LRPCMACInit(&ctx);
+        for (size_t i = 0; i < sizeof(data4); i += pieces[p])
+            LRPCMACUpdate(&ctx, &data4[i], MIN(pieces[p], sizeof(data4) - i));
+        LRPCMACFinal(&ctx, cmac);
+        res = res && (memcmp(cmac, cmacres4, sizeof(cmacres4)) == 0);
+
+        res = res && LRPUpdateKey(&ctx, key6, 0, true);
+        LRPCMACInit(&ctx);
+        for (size_t i = 0; i < sizeof(data6); i += pieces[p])
+            LRPCMACUpdate(&ctx, &data6[i], MIN(pieces[p], sizeof(data6) - i));
+        LRPCMACFinal(&ctx, cmac);
+        res = res && (memcmp(cmac, cmacres6, sizeof(cmacres6)) == 0);
+    }
+
+    // secure channel MAC with the cached context, session key changed directly in between
+    DesfireContext_t dctx = {0};
+    DesfireSetKey(&dctx, 0, T_AES, key4);
+    dctx.secureChannel = DACLRP;
+    for (int i = 0; i < 3; i++) {
+        memcpy(dctx.sessionKeyMAC, (i % 2) ? key6 : key4, CRYPTO_AES128_KEY_SIZE);
+        DesfireLRPCalcCMAC(&dctx, 0x8d, data4, sizeof(data4), cmac);
+
+        uint8_t mdata[7 + sizeof(data4)] = {0x8d};
+        memcpy(&mdata[7], data4, sizeof(data4));
+        uint8_t cmacref[8] = {0};
+        LRPContext_t rctx = {0};
+        LRPSetKey(&rctx, dctx.sessionKeyMAC, 0, true);
+        LRPCMAC8(&rctx, mdata, sizeof(mdata), cmacref);
+        res = res && (memcmp(cmac, cmacref, sizeof(cmacref)) == 0);
+    }
+
+    if (res)
+        PrintAndLogEx(INFO, "LRP streaming..... " _GREEN_("ok"));
+    else
+        PrintAndLogEx(ERR,  "LRP streaming..... " _RED_("fail"));
+
+    return res;
+}
+
 // https://www.nxp.com/docs/en/application-note/AN12343.pdf
 // page 49
 static bool TestLRPSessionKeys(void) {
@@ -885,6 +973,287 @@ static bool TestLRPSessionKeys(void) {
     return res;
 }
 
+// NIST SP 800-38A, F.2.1 CBC-AES128.Encrypt / F.2.2 CBC-AES128.Decrypt
+static bool TestCBCAES(void) {
+    bool res = true;
+
+    uint8_t key[DESFIRE_MAX_KEY_SIZE] = {0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C};
+    uint8_t iv[] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F};
+    uint8_t pt[] = {0x6B, 0xC1, 0xBE, 0xE2, 0x2E, 0x40, 0x9F, 0x96, 0xE9, 0x3D, 0x7E, 0x11, 0x73, 0x93, 0x17, 0x2A,
+                    0xAE, 0x2D, 0x8A, 0x57, 0x1E, 0x03, 0xAC, 0x9C, 0x9E, 0xB7, 0x6F, 0xAC, 0x45, 0xAF, 0x8E, 0x51,
+                    0x30, 0xC8, 0x1C, 0x46, 0xA3, 0x5C, 0xE4, 0x11, 0xE5, 0xFB, 0xC1, 0x19, 0x1A, 0x0A, 0x52, 0xEF,
+                    0xF6, 0x9F, 0x24, 0x45, 0xDF, 0x4F, 0x9B, 0x17, 0xAD, 0x2B, 0x41, 0x7B, 0xE6, 0x6C, 0x37, 0x10
+                   };
+    uint8_t ct[] = {0x76, 0x49, 0xAB, 0xAC, 0x81, 0x19, 0xB2, 0x46, 0xCE, 0xE9, 0x8E, 0x9B, 0x12, 0xE9, 0x19, 0x7D,
+                    0x50, 0x86, 0xCB, 0x9B, 0x50, 0x72, 0x19, 0xEE, 0x95, 0xDB, 0x11, 0x3A, 0x91, 0x76, 0x78, 0xB2,
+                    0x73, 0xBE, 0xD6, 0xB8, 0xE3, 0xC1, 0x74, 0x3B, 0x71, 0x16, 0xE6, 0x9E, 0x22, 0x22, 0x95, 0x16,
+                    0x3F, 0xF1, 0xCA, 0xA1, 0x68, 0x1F, 0xAC, 0x09, 0x12, 0x0E, 0xCA, 0x30, 0x75, 0x86, 0xE1, 0xA7
+                   };
+
+    DesfireContext_t dctx;
+    DesfireSetKey(&dctx, 0, T_AES, key);
+    dctx.secureChannel = DACEV1;
+    uint8_t data[sizeof(pt)] = {0};
+
+    memcpy(dctx.IV, iv, sizeof(iv));
+    DesfireCryptoEncDecEx(&dctx, DCOMainKey, pt, sizeof(pt), data, true, true, NULL);
+    res = res && (memcmp(data, ct, sizeof(ct)) == 0);
+    res = res && (memcmp(dctx.IV, &ct[48], 16) == 0);
+
+    memcpy(dctx.IV, iv, sizeof(iv));
+    DesfireCryptoEncDecEx(&dctx, DCOMainKey, ct, sizeof(ct), data, false, false, NULL);
+    res = res && (memcmp(data, pt, sizeof(pt)) == 0);
+    res = res && (memcmp(dctx.IV, &ct[48], 16) == 0);
+
+    // block by block must chain the same way as the whole buffer
+    memcpy(dctx.IV, iv, sizeof(iv));
+    for (int i = 0; i < 4; i++)
+        DesfireCryptoEncDecEx(&dctx, DCOMainKey, &pt[i * 16], 16, &data[i * 16], true, true, NULL);
+    res = res && (memcmp(data, ct, sizeof(ct)) == 0);
+
+    if (res)
+        PrintAndLogEx(INFO, "CBC AES........... " _GREEN_("ok"));
+    else
+        PrintAndLogEx(ERR,  "CBC AES........... " _RED_("fail"));
+
+    return res;
+}
+
+// reference: every block with a freshly expanded key, the way the secure channel did it before key schedules were cached
+static void CBCRefEncDec(DesfireCryptoAlgorithm keyType, uint8_t *key, uint8_t *src, size_t len, uint8_t *dst, uint8_t *iv, bool dir_to_send, bool encode) {
+    size_t block_size = desfire_get_key_block_length(keyType);
+    for (size_t offset = 0; offset < len; offset += block_size) {
+        uint8_t sdata[DESFIRE_MAX_CRYPTO_BLOCK_SIZE] = {0};
+        uint8_t edata[DESFIRE_MAX_CRYPTO_BLOCK_SIZE] = {0};
+        memcpy(sdata, src + offset, block_size);
+        if (dir_to_send)
+            bin_xor(sdata, iv, block_size);
+
+        if (keyType == T_DES) {
+            mbedtls_des_context ctx;
+            if (encode)
+                mbedtls_des_setkey_enc(&ctx, key);
+            else
+                mbedtls_des_setkey_dec(&ctx, key);
+            mbedtls_des_crypt_ecb(&ctx, sdata, edata);
+        } else if (keyType == T_3DES || keyType == T_3K3DES) {
+            mbedtls_des3_context ctx3;
+            if (keyType == T_3DES) {
+                if (encode)
+                    mbedtls_des3_set2key_enc(&ctx3, key);
+                else
+                    mbedtls_des3_set2key_dec(&ctx3, key);
+            } else {
+                if (encode)
+                    mbedtls_des3_set3key_enc(&ctx3, key);
+                else
+                    mbedtls_des3_set3key_dec(&ctx3, key);
+            }
+            mbedtls_des3_crypt_ecb(&ctx3, sdata, edata);
+        } else {
+            mbedtls_aes_context actx;
+            mbedtls_aes_init(&actx);
+            if (encode)
+                mbedtls_aes_setkey_enc(&actx, key, 128);
+            else
+                mbedtls_aes_setkey_dec(&actx, key, 128);
+            mbedtls_aes_crypt_ecb(&actx, (encode) ? MBEDTLS_AES_ENCRYPT : MBEDTLS_AES_DECRYPT, sdata, edata);
+            mbedtls_aes_free(&actx);
+        }
+
+        if (dir_to_send) {
+            memcpy(iv, edata, block_size);
+        } else {
+            bin_xor(edata, iv, block_size);
+            memcpy(iv, src + offset, block_size);
+        }
+        memcpy(dst + offset, edata, block_size);
+    }
+}
+
+static bool TestCBCKeySchedules(void) {
+    bool res = true;
+
+    DesfireCryptoAlgorithm keyTypes[] = {T_DES, T_3DES, T_3K3DES, T_AES};
+    size_t lengths[] = {8, 16, 48, 64, 80, 256};
+
+    uint8_t src[256] = {0};
+    for (size_t i = 0; i < sizeof(src); i++)
+        src[i] = (i * 7 + 3) & 0xff;
+
+    for (size_t kt = 0; kt < ARRAYLEN(keyTypes); kt++) {
+        uint8_t key[DESFIRE_MAX_KEY_SIZE] = {0};
+        for (size_t i = 0; i < sizeof(key); i++)
+            key[i] = (i * 0x11 + kt) & 0xff;
+
+        DesfireContext_t dctx;
+        DesfireSetKey(&dctx, 0, keyTypes[kt], key);
+        dctx.secureChannel = DACEV1;
+        size_t block_size = desfire_get_key_block_length(keyTypes[kt]);
+
+        for (int mode = 0; mode < 4; mode++) {
+            bool dir_to_send = (mode & 1);
+            bool encode = (mode & 2);
+            for (size_t l = 0; l < ARRAYLEN(lengths); l++) {
+                if (lengths[l] % block_size)
+                    continue;
+
+                // the session key changes behind the context's back, the cached schedule has to notice
+                key[l % block_size] ^= 0x5A;
+                memcpy(dctx.sessionKeyEnc, key, DESFIRE_MAX_KEY_SIZE);
+
+                uint8_t iv[DESFIRE_MAX_CRYPTO_BLOCK_SIZE] = {0};
+                uint8_t refiv[DESFIRE_MAX_CRYPTO_BLOCK_SIZE] = {0};
+                iv[0] = refiv[0] = mode + l;
+
+                uint8_t dst[256] = {0};
+                uint8_t ref[256] = {0};
+                DesfireCryptoEncDecEx(&dctx, DCOSessionKeyEnc, src, lengths[l], dst, dir_to_send, encode, iv);
+                CBCRefEncDec(keyTypes[kt], key, src, lengths[l], ref, refiv, dir_to_send, encode);
+
+                res = res && (memcmp(dst, ref, lengths[l]) == 0);
+                res = res && (memcmp(iv, refiv, block_size) == 0);
+            }
+        }
+    }
+
+    if (res)
+        PrintAndLogEx(INFO, "CBC key schedules. " _GREEN_("ok"));
+    else
+        PrintAndLogEx(ERR,  "CBC key schedules. " _RED_("fail"));
+
+    return res;
+}
+
+// virtual card for the hf mfdes chk search. one application, keys of a single type
+static struct {
+    DesfireCryptoAlgorithm algo;
+    uint8_t keys[DESFIRE_CHK_KEY_NUMS][24];
+    bool present[DESFIRE_CHK_KEY_NUMS];
+    uint32_t auths;
+    uint32_t reselects;
+    uint32_t abortAt;
+} VCard;
+
+static int VCardAuthenticate(DesfireContext_t *dctx, DesfireSecureChannel secureChannel, bool verbose) {
+    VCard.auths++;
+    bool aesapp = (VCard.algo == T_AES);
+    // the card refuses the first step for a key it does not have or an auth command of the other key family
+    if (VCard.present[dctx->keyNum] == false || aesapp != (dctx->keyType == T_AES))
+        return 3;
+    // wrong key, the reader's answer does not decrypt
+    if (dctx->keyType != VCard.algo || memcmp(dctx->key, VCard.keys[dctx->keyNum], desfire_get_key_length(dctx->keyType)) != 0)
+        return 7;
+    return PM3_SUCCESS;
+}
+
+static int VCardReselect(DesfireContext_t *dctx, uint32_t aid) {
+    VCard.reselects++;
+    return PM3_SUCCESS;
+}
+
+static int VCardAborted(void) {
+    return (VCard.abortAt != 0 && VCard.auths >= VCard.abortAt);
+}
+
+static bool TestChkSearch(void) {
+    bool res = true;
+
+    static uint8_t deskeys[1024][8];
+    static uint8_t aeskeys[1024][16];
+    for (int i = 0; i < 1024; i++) {
+        memset(deskeys[i], i & 0xff, 8);
+        deskeys[i][0] = i >> 8;
+        memset(aeskeys[i], i & 0xff, 16);
+        aeskeys[i][0] = i >> 8;
+    }
+
+    DesfireChkKeyList_t lists[DESFIRE_CHK_KEY_TYPES] = {
+        {T_DES,    "DES",   (uint8_t *)deskeys, 8,  0},
+        {T_3DES,   "2TDEA", (uint8_t *)aeskeys, 16, 0},
+        {T_AES,    "AES",   (uint8_t *)aeskeys, 16, 1024},
+        {T_3K3DES, "3TDEA", NULL,               24, 0},
+    };
+    bool used[DESFIRE_CHK_KEY_NUMS] = {true, true, true, true};
+    DesfireChkOps_t ops = {VCardAuthenticate, VCardReselect, VCardAborted};
+
+    // AES application. key 0 and 1 are in the list, key 2 is not, key 3 does not exist
+    memset(&VCard, 0, sizeof(VCard));
+    VCard.algo = T_AES;
+    memcpy(VCard.keys[0], aeskeys[5], 16);
+    memcpy(VCard.keys[1], aeskeys[300], 16);
+    memset(VCard.keys[2], 0xee, 16);
+    VCard.present[0] = VCard.present[1] = VCard.present[2] = true;
+
+    uint8_t found[DESFIRE_CHK_KEY_TYPES][DESFIRE_CHK_KEY_NUMS][24 + 1];
+    memset(found, 0, sizeof(found));
+    DesfireContext_t dctx = {0};
+    DesfireChkPosition_t pos = {0};
+    bool result = false;
+
+    uint8_t old_printAndLog = g_printAndLog;
+    g_printAndLog = 0;
+
+    int r = DesfireCheckKeyLists(&dctx, DACEV1, 0x123456, &ops, lists, used, found, &pos, &result);
+    res = res && (r == PM3_SUCCESS) && result;
+    res = res && (found[2][0][0] == 1) && (memcmp(&found[2][0][1], aeskeys[5], 16) == 0);
+    res = res && (found[2][1][0] == 1) && (memcmp(&found[2][1][1], aeskeys[300], 16) == 0);
+    res = res && (found[2][2][0] == 0) && (found[2][3][0] == 0);
+    // 6 + 301 + whole list + the refused first try on key 3, which ends the AES list
+    uint32_t fullauths = 6 + 301 + 1024 + 1;
+    res = res && (VCard.auths == fullauths) && (VCard.reselects == 1);
+
+    // interrupted and resumed from the saved position, no key tried twice or skipped
+    uint8_t found2[DESFIRE_CHK_KEY_TYPES][DESFIRE_CHK_KEY_NUMS][24 + 1];
+    memset(found2, 0, sizeof(found2));
+    memset(&pos, 0, sizeof(pos));
+    VCard.auths = 0;
+    VCard.reselects = 0;
+    uint32_t stops = 0;
+    for (VCard.abortAt = 100; ; VCard.abortAt += 250) {
+        r = DesfireCheckKeyLists(&dctx, DACEV1, 0x123456, &ops, lists, used, found2, &pos, &result);
+        if (r != PM3_EOPABORTED)
+            break;
+        stops++;
+    }
+    res = res && (r == PM3_SUCCESS) && (stops > 2);
+    res = res && (VCard.auths == fullauths) && (VCard.reselects == 1);
+    res = res && (memcmp(found, found2, sizeof(found)) == 0);
+
+    // keys found already are not checked again
+    memset(&pos, 0, sizeof(pos));
+    VCard.auths = 0;
+    VCard.abortAt = 0;
+    used[3] = false;
+    r = DesfireCheckKeyLists(&dctx, DACEV1, 0x123456, &ops, lists, used, found, &pos, &result);
+    res = res && (r == PM3_SUCCESS) && (VCard.auths == 1024);
+
+    // DES application. DES keys are tried before 2TDEA, a found 2TDEA key does not stop the DES search
+    memset(&VCard, 0, sizeof(VCard));
+    VCard.algo = T_3DES;
+    memcpy(VCard.keys[0], aeskeys[7], 16);
+    VCard.present[0] = true;
+    memset(found, 0, sizeof(found));
+    memset(&pos, 0, sizeof(pos));
+    lists[0].count = 1024;
+    lists[1].count = 1024;
+    lists[2].count = 0;
+    bool used0[DESFIRE_CHK_KEY_NUMS] = {true};
+    r = DesfireCheckKeyLists(&dctx, DACEV1, 0x123456, &ops, lists, used0, found, &pos, &result);
+    res = res && (r == PM3_SUCCESS) && (found[0][0][0] == 0) && (found[1][0][0] == 1);
+    res = res && (memcmp(&found[1][0][1], aeskeys[7], 16) == 0);
+    res = res && (VCard.auths == 1024 + 8);
+
+    g_printAndLog = old_printAndLog;
+
+    if (res)
+        PrintAndLogEx(INFO, "chk key search.... " _GREEN_("ok"));
+    else
+        PrintAndLogEx(ERR,  "chk key search.... " _RED_("fail"));
+
+    return res;
+}
+
 bool DesfireTest(bool verbose) {
     bool res = true;
 
@@ -911,7 +1280,11 @@ bool DesfireTest(bool verbose) {
     res = res && TestLRPDecode();
     res = res && TestLRPSubkeys();
     res = res && TestLRPCMAC();
+    res = res && TestLRPStreaming();
     res = res && TestLRPSessionKeys();
+    res = res && TestCBCAES();
+    res = res && TestCBCKeySchedules();
+    res = res && TestChkSearch();
 
     PrintAndLogEx(INFO, "---------------------------");
     if (res)
@@ -24,11 +24,29 @@
 #include "ui.h"
 #include "aes.h"
 #include "commonutil.h"
+#include <mbedtls/aes.h>
 
 static uint8_t constAA[] = {0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa};
 static uint8_t const55[] = {0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55, 0x55};
 static uint8_t const00[] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
 
+// LRP changes the AES key on almost every block, single block ECB without the CBC wrapper of aes_encode
+static void lrp_aes_encode(const uint8_t *key, const uint8_t *input, uint8_t *output) {
+    mbedtls_aes_context aes;
+    mbedtls_aes_init(&aes);
+    mbedtls_aes_setkey_enc(&aes, key, 128);
+    mbedtls_aes_crypt_ecb(&aes, MBEDTLS_AES_ENCRYPT, input, output);
+    mbedtls_aes_free(&aes);
+}
+
+static void lrp_aes_decode(const uint8_t *key, const uint8_t *input, uint8_t *output) {
+    mbedtls_aes_context aes;
+    mbedtls_aes_init(&aes);
+    mbedtls_aes_setkey_dec(&aes, key, 128);
+    mbedtls_aes_crypt_ecb(&aes, MBEDTLS_AES_DECRYPT, input, output);
+    mbedtls_aes_free(&aes);
+}
+
 void LRPClearContext(LRPContext_t *ctx) {
     memset(ctx->key, 0, CRYPTO_AES128_KEY_SIZE);
 
@@ -38,6 +56,13 @@ void LRPClearContext(LRPContext_t *ctx) {
     ctx->updatedKeysCount = 0;
     memset(ctx->updatedKeys, 0, LRP_MAX_UPDATED_KEYS_SIZE * CRYPTO_AES128_KEY_SIZE);
     ctx->useUpdatedKeyNum = 0;
+
+    ctx->subkeysValid = false;
+    memset(ctx->sk1, 0, CRYPTO_AES128_KEY_SIZE);
+    memset(ctx->sk2, 0, CRYPTO_AES128_KEY_SIZE);
+    memset(ctx->cmacY, 0, CRYPTO_AES128_KEY_SIZE);
+    memset(ctx->cmacBlock, 0, CRYPTO_AES128_KEY_SIZE);
+    ctx->cmacBlockLen = 0;
 }
 
 void LRPSetKey(LRPContext_t *ctx, uint8_t *key, size_t updatedKeyNum, bool useBitPadding) {
@@ -55,6 +80,26 @@ void LRPSetKey(LRPContext_t *ctx, uint8_t *key, size_t updatedKeyNum, bool useBi
     ctx->counterLenNibbles = CRYPTO_AES128_KEY_SIZE;
 }
 
+// Keeps the plaintext and updated key tables when the key is the same, returns true if they had to be rebuilt.
+// The counter is reset the same way LRPSetKey does it.
+bool LRPUpdateKey(LRPContext_t *ctx, uint8_t *key, size_t updatedKeyNum, bool useBitPadding) {
+    bool rebuild = (ctx->plaintextsCount != LRP_MAX_PLAINTEXTS_SIZE ||
+                    ctx->updatedKeysCount != LRP_MAX_UPDATED_KEYS_SIZE ||
+                    memcmp(ctx->key, key, CRYPTO_AES128_KEY_SIZE) != 0);
+
+    if (rebuild) {
+        LRPSetKey(ctx, key, updatedKeyNum, useBitPadding);
+        return true;
+    }
+
+    ctx->useUpdatedKeyNum = updatedKeyNum;
+    ctx->useBitPadding = useBitPadding;
+
+    memcpy(ctx->counter, const00, CRYPTO_AES128_KEY_SIZE);
+    ctx->counterLenNibbles = CRYPTO_AES128_KEY_SIZE;
+    return false;
+}
+
 void LRPSetCounter(LRPContext_t *ctx, uint8_t *counter, size_t counterLenNibbles) {
     memcpy(ctx->counter, counter, counterLenNibbles / 2);
     ctx->counterLenNibbles = counterLenNibbles;
@@ -76,8 +121,8 @@ void LRPGeneratePlaintexts(LRPContext_t *ctx, size_t plaintextsCount) {
     memcpy(h, ctx->key, CRYPTO_AES128_KEY_SIZE);
 
     for (int i = 0; i < plaintextsCount; i++) {
-        aes_encode(NULL, h, const55, h, CRYPTO_AES128_KEY_SIZE);
-        aes_encode(NULL, h, constAA, ctx->plaintexts[i], CRYPTO_AES128_KEY_SIZE);
+        lrp_aes_encode(h, const55, h);
+        lrp_aes_encode(h, constAA, ctx->plaintexts[i]);
     }
 
     ctx->plaintextsCount = plaintextsCount;
@@ -90,11 +135,11 @@ void LRPGenerateUpdatedKeys(LRPContext_t *ctx, size_t updatedKeysCount) {
         return;
 
     uint8_t h[CRYPTO_AES128_KEY_SIZE] = {0};
-    aes_encode(NULL, ctx->key, constAA, h, CRYPTO_AES128_KEY_SIZE);
+    lrp_aes_encode(ctx->key, constAA, h);
 
     for (int i = 0; i < updatedKeysCount; i++) {
-        aes_encode(NULL, h, constAA, ctx->updatedKeys[i], CRYPTO_AES128_KEY_SIZE);
-        aes_encode(NULL, h, const55, h, CRYPTO_AES128_KEY_SIZE);
+        lrp_aes_encode(h, constAA, ctx->updatedKeys[i]);
+        lrp_aes_encode(h, const55, h);
     }
 
     ctx->updatedKeysCount = updatedKeysCount;
@@ -102,20 +147,24 @@ void LRPGenerateUpdatedKeys(LRPContext_t *ctx, size_t updatedKeysCount) {
 
 // https://www.nxp.com/docs/en/application-note/AN12304.pdf
 // Algorithm 3
-void LRPEvalLRP(LRPContext_t *ctx, const uint8_t *iv, size_t ivlen, bool final, uint8_t *y) {
+static void LRPEvalLRPEx(LRPContext_t *ctx, size_t updatedKeyNum, const uint8_t *iv, size_t ivlen, bool final, uint8_t *y) {
     uint8_t ry[CRYPTO_AES128_KEY_SIZE] = {0};
-    memcpy(ry, ctx->updatedKeys[ctx->useUpdatedKeyNum], CRYPTO_AES128_KEY_SIZE);
+    memcpy(ry, ctx->updatedKeys[updatedKeyNum], CRYPTO_AES128_KEY_SIZE);
 
     for (int i = 0; i < ivlen; i++) {
         uint8_t nk = (i % 2) ? iv[i / 2] & 0x0f : (iv[i / 2] >> 4) & 0x0f;
-        aes_encode(NULL, ry, ctx->plaintexts[nk], ry, CRYPTO_AES128_KEY_SIZE);
+        lrp_aes_encode(ry, ctx->plaintexts[nk], ry);
     }
 
     if (final)
-        aes_encode(NULL, ry, const00, ry, CRYPTO_AES128_KEY_SIZE);
+        lrp_aes_encode(ry, const00, ry);
     memcpy(y, ry, CRYPTO_AES128_KEY_SIZE);
 }
 
+void LRPEvalLRP(LRPContext_t *ctx, const uint8_t *iv, size_t ivlen, bool final, uint8_t *y) {
+    LRPEvalLRPEx(ctx, ctx->useUpdatedKeyNum, iv, ivlen, final, y);
+}
+
 void LRPIncCounter(uint8_t *ctr, size_t ctrlen) {
     bool carry = true;
     for (int i = ctrlen - 1; i >= 0; i--) {
@@ -156,11 +205,25 @@ void LRPEncode(LRPContext_t *ctx, uint8_t *data, size_t datalen, uint8_t *resp,
     if (datalen == 0)
         return;
 
+    LRPEncodeBlocks(ctx, xdata, datalen, resp);
+    *resplen = datalen;
+}
+
+// whole blocks only, no padding. the counter carries on from the previous call
+void LRPEncodeBlocks(LRPContext_t *ctx, const uint8_t *data, size_t datalen, uint8_t *resp) {
     uint8_t y[CRYPTO_AES128_KEY_SIZE] = {0};
     for (int i = 0; i < datalen / CRYPTO_AES128_KEY_SIZE; i++) {
         LRPEvalLRP(ctx, ctx->counter, ctx->counterLenNibbles, true, y);
-        aes_encode(NULL, y, &xdata[i * CRYPTO_AES128_KEY_SIZE], &resp[i * CRYPTO_AES128_KEY_SIZE], CRYPTO_AES128_KEY_SIZE);
-        *resplen += CRYPTO_AES128_KEY_SIZE;
+        lrp_aes_encode(y, &data[i * CRYPTO_AES128_KEY_SIZE], &resp[i * CRYPTO_AES128_KEY_SIZE]);
+        LRPIncCounter(ctx->counter, ctx->counterLenNibbles);
+    }
+}
+
+void LRPDecodeBlocks(LRPContext_t *ctx, const uint8_t *data, size_t datalen, uint8_t *resp) {
+    uint8_t y[CRYPTO_AES128_KEY_SIZE] = {0};
+    for (int i = 0; i < datalen / CRYPTO_AES128_KEY_SIZE; i++) {
+        LRPEvalLRP(ctx, ctx->counter, ctx->counterLenNibbles, true, y);
+        lrp_aes_decode(y, &data[i * CRYPTO_AES128_KEY_SIZE], &resp[i * CRYPTO_AES128_KEY_SIZE]);
         LRPIncCounter(ctx->counter, ctx->counterLenNibbles);
     }
 }
@@ -172,13 +235,8 @@ void LRPDecode(LRPContext_t *ctx, uint8_t *data, size_t datalen, uint8_t *resp,
     if (datalen % CRYPTO_AES128_KEY_SIZE)
         return;
 
-    uint8_t y[CRYPTO_AES128_KEY_SIZE] = {0};
-    for (int i = 0; i < datalen / CRYPTO_AES128_KEY_SIZE; i++) {
-        LRPEvalLRP(ctx, ctx->counter, ctx->counterLenNibbles, true, y);
-        aes_decode(NULL, y, &data[i * CRYPTO_AES128_KEY_SIZE], &resp[i * CRYPTO_AES128_KEY_SIZE], CRYPTO_AES128_KEY_SIZE);
-        *resplen += CRYPTO_AES128_KEY_SIZE;
-        LRPIncCounter(ctx->counter, ctx->counterLenNibbles);
-    }
+    LRPDecodeBlocks(ctx, data, datalen, resp);
+    *resplen = datalen;
 
     // search padding
     if (ctx->useBitPadding) {
@@ -223,59 +281,87 @@ static void mulPolyX(uint8_t *data) {
         data[15] = data[15] ^ 0x87;
 }
 
-void LRPGenSubkeys(uint8_t *key, uint8_t *sk1, uint8_t *sk2) {
-    LRPContext_t ctx = {0};
-    LRPSetKey(&ctx, key, 0, true);
+// subkeys always come from updated key 0 (AN12304, Algorithm 6)
+static void LRPGetSubkeys(LRPContext_t *ctx) {
+    if (ctx->subkeysValid)
+        return;
 
     uint8_t y[CRYPTO_AES128_KEY_SIZE] = {0};
-    LRPEvalLRP(&ctx, const00, CRYPTO_AES128_KEY_SIZE * 2, true, y);
+    LRPEvalLRPEx(ctx, 0, const00, CRYPTO_AES128_KEY_SIZE * 2, true, y);
 
     mulPolyX(y);
-    memcpy(sk1, y, CRYPTO_AES128_KEY_SIZE);
+    memcpy(ctx->sk1, y, CRYPTO_AES128_KEY_SIZE);
 
     mulPolyX(y);
-    memcpy(sk2, y, CRYPTO_AES128_KEY_SIZE);
+    memcpy(ctx->sk2, y, CRYPTO_AES128_KEY_SIZE);
+
+    ctx->subkeysValid = true;
 }
 
-// https://www.nxp.com/docs/en/application-note/AN12304.pdf
-// Algorithm 6
-void LRPCMAC(LRPContext_t *ctx, uint8_t *data, size_t datalen, uint8_t *cmac) {
-    uint8_t sk1[CRYPTO_AES128_KEY_SIZE] = {0};
-    uint8_t sk2[CRYPTO_AES128_KEY_SIZE] = {0};
-    LRPGenSubkeys(ctx->key, sk1, sk2);
+void LRPGenSubkeys(uint8_t *key, uint8_t *sk1, uint8_t *sk2) {
+    LRPContext_t ctx = {0};
+    LRPSetKey(&ctx, key, 0, true);
+    LRPGetSubkeys(&ctx);
 
-    uint8_t y[CRYPTO_AES128_KEY_SIZE] = {0};
-    size_t clen = 0;
-    for (int i = 0; i < datalen / CRYPTO_AES128_KEY_SIZE; i++) {
-        if (datalen - clen <= CRYPTO_AES128_KEY_SIZE)
-            break;
+    memcpy(sk1, ctx.sk1, CRYPTO_AES128_KEY_SIZE);
+    memcpy(sk2, ctx.sk2, CRYPTO_AES128_KEY_SIZE);
+}
+
+void LRPCMACInit(LRPContext_t *ctx) {
+    LRPGetSubkeys(ctx);
+    memset(ctx->cmacY, 0, CRYPTO_AES128_KEY_SIZE);
+    memset(ctx->cmacBlock, 0, CRYPTO_AES128_KEY_SIZE);
+    ctx->cmacBlockLen = 0;
+}
+
+void LRPCMACUpdate(LRPContext_t *ctx, const uint8_t *data, size_t datalen) {
+    while (datalen > 0) {
+        // a full block is only chained in once we know it is not the last one
+        if (ctx->cmacBlockLen == CRYPTO_AES128_KEY_SIZE) {
+            bin_xor(ctx->cmacY, ctx->cmacBlock, CRYPTO_AES128_KEY_SIZE);
+            LRPEvalLRP(ctx, ctx->cmacY, CRYPTO_AES128_KEY_SIZE * 2, true, ctx->cmacY);
+            ctx->cmacBlockLen = 0;
+        }
 
-        bin_xor(y, &data[i * CRYPTO_AES128_KEY_SIZE], CRYPTO_AES128_KEY_SIZE);
-        LRPEvalLRP(ctx, y, CRYPTO_AES128_KEY_SIZE * 2, true, y);
-        clen += CRYPTO_AES128_KEY_SIZE;
+        size_t len = MIN(datalen, CRYPTO_AES128_KEY_SIZE - ctx->cmacBlockLen);
+        memcpy(&ctx->cmacBlock[ctx->cmacBlockLen], data, len);
+        ctx->cmacBlockLen += len;
+        data += len;
+        datalen -= len;
     }
+}
+
+// https://www.nxp.com/docs/en/application-note/AN12304.pdf
+// Algorithm 6
+void LRPCMACFinal(LRPContext_t *ctx, uint8_t *cmac) {
+    uint8_t y[CRYPTO_AES128_KEY_SIZE] = {0};
+    memcpy(y, ctx->cmacY, CRYPTO_AES128_KEY_SIZE);
 
-    size_t bllen = datalen - clen;
-    bllen = MIN(bllen, CRYPTO_AES128_KEY_SIZE); // coverity
     uint8_t bl[CRYPTO_AES128_KEY_SIZE] = {0};
-    memcpy(bl, &data[clen], bllen);
+    memcpy(bl, ctx->cmacBlock, ctx->cmacBlockLen);
 
     // last block
-    if (bllen == 16) {
+    if (ctx->cmacBlockLen == CRYPTO_AES128_KEY_SIZE) {
         bin_xor(y, bl, CRYPTO_AES128_KEY_SIZE);
 
-        bin_xor(y, sk1, CRYPTO_AES128_KEY_SIZE);
+        bin_xor(y, ctx->sk1, CRYPTO_AES128_KEY_SIZE);
     } else {
         // padding
-        bl[bllen] = 0x80;
+        bl[ctx->cmacBlockLen] = 0x80;
         bin_xor(y, bl, CRYPTO_AES128_KEY_SIZE);
 
-        bin_xor(y, sk2, CRYPTO_AES128_KEY_SIZE);
+        bin_xor(y, ctx->sk2, CRYPTO_AES128_KEY_SIZE);
     }
 
     LRPEvalLRP(ctx, y, CRYPTO_AES128_KEY_SIZE * 2, true, cmac);
 }
 
+void LRPCMAC(LRPContext_t *ctx, uint8_t *data, size_t datalen, uint8_t *cmac) {
+    LRPCMACInit(ctx);
+    LRPCMACUpdate(ctx, data, datalen);
+    LRPCMACFinal(ctx, cmac);
+}
+
 void LRPCMAC8(LRPContext_t *ctx, uint8_t *data, size_t datalen, uint8_t *cmac) {
     uint8_t cmac_tmp[16] = {0};
     memset(cmac, 0x00, 8);
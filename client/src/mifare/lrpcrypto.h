@@ -38,11 +38,22 @@ typedef struct {
 
     uint8_t counter[LRP_MAX_COUNTER_SIZE];
     size_t counterLenNibbles; // len in bytes * 2 (or * 2 - 1)
+
+    // CMAC subkeys, derived once per key
+    bool subkeysValid;
+    uint8_t sk1[CRYPTO_AES128_KEY_SIZE];
+    uint8_t sk2[CRYPTO_AES128_KEY_SIZE];
+
+    // streaming CMAC state. the last block is held back until final
+    uint8_t cmacY[CRYPTO_AES128_KEY_SIZE];
+    uint8_t cmacBlock[CRYPTO_AES128_KEY_SIZE];
+    size_t cmacBlockLen;
 } LRPContext_t;
 
 void LRPClearContext(LRPContext_t *ctx);
 void LRPSetKey(LRPContext_t *ctx, uint8_t *key, size_t updatedKeyNum, bool useBitPadding);
 void LRPSetKeyEx(LRPContext_t *ctx, uint8_t *key, uint8_t *counter, size_t counterLenNibbles, size_t updatedKeyNum, bool useBitPadding);
+bool LRPUpdateKey(LRPContext_t *ctx, uint8_t *key, size_t updatedKeyNum, bool useBitPadding);
 void LRPSetCounter(LRPContext_t *ctx, uint8_t *counter, size_t counterLenNibbles);
 void LRPGeneratePlaintexts(LRPContext_t *ctx, size_t plaintextsCount);
 void LRPGenerateUpdatedKeys(LRPContext_t *ctx, size_t updatedKeysCount);
@@ -50,8 +61,13 @@ void LRPEvalLRP(LRPContext_t *ctx, const uint8_t *iv, size_t ivlen, bool final,
 void LRPIncCounter(uint8_t *ctr, size_t ctrlen);
 void LRPEncode(LRPContext_t *ctx, uint8_t *data, size_t datalen, uint8_t *resp, size_t *resplen);
 void LRPDecode(LRPContext_t *ctx, uint8_t *data, size_t datalen, uint8_t *resp, size_t *resplen);
+void LRPEncodeBlocks(LRPContext_t *ctx, const uint8_t *data, size_t datalen, uint8_t *resp);
+void LRPDecodeBlocks(LRPContext_t *ctx, const uint8_t *data, size_t datalen, uint8_t *resp);
 void LRPEncDec(uint8_t *key, uint8_t *iv, bool encode, uint8_t *data, size_t datalen, uint8_t *resp, size_t *resplen);
 void LRPGenSubkeys(uint8_t *key, uint8_t *sk1, uint8_t *sk2);
+void LRPCMACInit(LRPContext_t *ctx);
+void LRPCMACUpdate(LRPContext_t *ctx, const uint8_t *data, size_t datalen);
+void LRPCMACFinal(LRPContext_t *ctx, uint8_t *cmac);
 void LRPCMAC(LRPContext_t *ctx, uint8_t *data, size_t datalen, uint8_t *cmac);
 void LRPCMAC8(LRPContext_t *ctx, uint8_t *data, size_t datalen, uint8_t *cmac);
 
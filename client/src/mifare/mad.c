@@ -26,7 +26,6 @@
 #include "jansson.h"
 
 // https://www.nxp.com/docs/en/application-note/AN10787.pdf
-static json_t *mad_known_aids = NULL;
 
 static const char *holder_info_type[] = {
     "Surname",
@@ -44,40 +43,13 @@ static const char *aid_admin[] = {
     "not applicable"
 };
 
-static int open_mad_file(json_t **root, bool verbose) {
-
-    char *path;
-    int res = searchFile(&path, RESOURCES_SUBDIR, "mad", ".json", true);
-    if (res != PM3_SUCCESS) {
-        return PM3_EFILE;
-    }
-
-    int retval = PM3_SUCCESS;
-    json_error_t error;
-
-    *root = json_load_file(path, 0, &error);
-    if (!*root) {
-        PrintAndLogEx(ERR, "json (%s) error on line %d: %s", path, error.line, error.text);
-        retval = PM3_ESOFT;
-        goto out;
-    }
-
-    if (!json_is_array(*root)) {
-        PrintAndLogEx(ERR, "Invalid json (%s) format. root must be an array.", path);
-        retval = PM3_ESOFT;
-        goto out;
+static json_t *open_mad_file(bool verbose) {
+    json_t *root = loadResourceJSON("mad", true, verbose);
+    if (root && json_is_array(root) == false) {
+        PrintAndLogEx(ERR, "Invalid json (mad) format. root must be an array.");
+        return NULL;
     }
-
-    if (verbose)
-        PrintAndLogEx(SUCCESS, "Loaded file " _YELLOW_("`%s`") " (%s) %zu records.", path,  _GREEN_("ok"), json_array_size(*root));
-out:
-    free(path);
-    return retval;
-}
-
-static int close_mad_file(json_t *root) {
-    json_decref(root);
-    return PM3_SUCCESS;
+    return root;
 }
 
 static const char *mad_json_get_str(json_t *data, const char *name) {
@@ -98,27 +70,11 @@ static const char *mad_json_get_str(json_t *data, const char *name) {
     return cstr;
 }
 
-static int print_aid_description(json_t *root, uint16_t aid, char *fmt, bool verbose) {
+static int print_aid_description(uint16_t aid, char *fmt, bool verbose) {
     char lmad[7] = {0};
     sprintf(lmad, "0x%04x", aid); // must be lowercase
 
-    json_t *elm = NULL;
-
-    for (uint32_t idx = 0; idx < json_array_size(root); idx++) {
-        json_t *data = json_array_get(root, idx);
-        if (!json_is_object(data)) {
-            PrintAndLogEx(ERR, "data [%d] is not an object\n", idx);
-            continue;
-        }
-        const char *fmad = mad_json_get_str(data, "mad");
-        char lfmad[strlen(fmad) + 1];
-        strcpy(lfmad, fmad);
-        str_lower(lfmad);
-        if (strcmp(lmad, lfmad) == 0) {
-            elm = data;
-            break;
-        }
-    }
+    json_t *elm = json_object_get(getResourceJSONIndex("mad", "mad", true), lmad);
 
     if (elm == NULL) {
         PrintAndLogEx(INFO, fmt, " (unknown)");
@@ -298,7 +254,7 @@ static int MADInfoByteDecode(const uint8_t *sector, bool swapmad, int mad_ver, b
 }
 
 int MAD1DecodeAndPrint(uint8_t *sector, bool swapmad, bool verbose, bool *haveMAD2) {
-    open_mad_file(&mad_known_aids, verbose);
+    open_mad_file(verbose);
 
     PrintAndLogEx(NORMAL, "");
     PrintAndLogEx(INFO, "------------ " _CYAN_("MAD v1 details") " -------------");
@@ -328,16 +284,15 @@ int MAD1DecodeAndPrint(uint8_t *sector, bool swapmad, bool verbose, bool *haveMA
         } else {
             char fmt[30];
             sprintf(fmt, (ibs == i) ? _MAGENTA_(" %02d [%04X]%s") : " %02d [%04X]%s", i, aid, "%s");
-            print_aid_description(mad_known_aids, aid, fmt, verbose);
+            print_aid_description(aid, fmt, verbose);
             prev_aid = aid;
         }
     }
-    close_mad_file(mad_known_aids);
     return PM3_SUCCESS;
 }
 
 int MAD2DecodeAndPrint(uint8_t *sector, bool swapmad, bool verbose) {
-    open_mad_file(&mad_known_aids, verbose);
+    open_mad_file(verbose);
 
     PrintAndLogEx(NORMAL, "");
     PrintAndLogEx(INFO, "------------ " _CYAN_("MAD v2 details") " -------------");
@@ -372,21 +327,17 @@ int MAD2DecodeAndPrint(uint8_t *sector, bool swapmad, bool verbose) {
         } else {
             char fmt[30];
             sprintf(fmt, (ibs == i) ? _MAGENTA_(" %02d [%04X]%s") : " %02d [%04X]%s", i + 16, aid, "%s");
-            print_aid_description(mad_known_aids, aid, fmt, verbose);
+            print_aid_description(aid, fmt, verbose);
             prev_aid = aid;
         }
     }
-    close_mad_file(mad_known_aids);
 
     return PM3_SUCCESS;
 }
 
 int MADDFDecodeAndPrint(uint32_t short_aid) {
-    open_mad_file(&mad_known_aids, false);
-
     char fmt[50];
     sprintf(fmt, "  MAD AID Function 0x%04X    :" _YELLOW_("%s"), short_aid, "%s");
-    print_aid_description(mad_known_aids, short_aid, fmt, false);
-    close_mad_file(mad_known_aids);
+    print_aid_description(short_aid, fmt, false);
     return PM3_SUCCESS;
 }
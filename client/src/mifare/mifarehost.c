@@ -388,6 +388,79 @@ inline static int Compare16Bits(const void *a, const void *b) {
     return -1;
 }
 
+// every thread holds a ~50MB arena
+#define LFSR_RECOVERY_MAX_THREADS   8
+
+typedef struct {
+    lfsr_recovery32_jobs_t *jobs;
+    uint32_t count;
+    uint32_t next;
+    uint32_t done;
+} lfsr_recovery32_pool_t;
+
+static void
+#ifdef __has_attribute
+#if __has_attribute(force_align_arg_pointer)
+__attribute__((force_align_arg_pointer))
+#endif
+#endif
+*lfsr_recovery32_worker(void *arg) {
+    lfsr_recovery32_pool_t *pool = arg;
+    lfsr_recovery32_arena_t *arena = lfsr_recovery32_arena_new();
+    if (arena == NULL) {
+        return NULL;
+    }
+
+    uint32_t job;
+    while ((job = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED)) < pool->count) {
+        if (lfsr_recovery32_job_run(pool->jobs, job, arena)) {
+            __atomic_add_fetch(&pool->done, 1, __ATOMIC_RELAXED);
+        }
+    }
+    lfsr_recovery32_arena_free(arena);
+    return NULL;
+}
+
+// lfsr_recovery32() spread over several threads, returns the same state list
+struct Crypto1State *lfsr_recovery32_mt(uint32_t ks2, uint32_t in, uint32_t threads) {
+    threads = MIN(threads, LFSR_RECOVERY_MAX_THREADS);
+    if (threads < 2) {
+        return lfsr_recovery32(ks2, in);
+    }
+
+    lfsr_recovery32_pool_t pool = {0};
+    pool.jobs = lfsr_recovery32_jobs_new(ks2, in);
+    if (pool.jobs == NULL) {
+        return lfsr_recovery32(ks2, in);
+    }
+    pool.count = lfsr_recovery32_jobs_count(pool.jobs);
+    threads = MIN(threads, pool.count);
+
+    pthread_t thread_id[LFSR_RECOVERY_MAX_THREADS];
+    uint32_t started = 0;
+    for (uint32_t i = 1; i < threads; i++) {
+        if (pthread_create(thread_id + started, NULL, lfsr_recovery32_worker, &pool) == 0) {
+            started++;
+        }
+    }
+    lfsr_recovery32_worker(&pool);
+    for (uint32_t i = 0; i < started; i++) {
+        pthread_join(thread_id[i], NULL);
+    }
+
+    struct Crypto1State *statelist = NULL;
+    if (pool.done == pool.count) {
+        statelist = lfsr_recovery32_jobs_collect(pool.jobs);
+    }
+    lfsr_recovery32_jobs_free(pool.jobs);
+
+    // out of memory for the arenas, do it the old way
+    if (statelist == NULL) {
+        statelist = lfsr_recovery32(ks2, in);
+    }
+    return statelist;
+}
+
 // wrapper function for multi-threaded lfsr_recovery32
 static void
 #ifdef __has_attribute
@@ -398,7 +471,7 @@ __attribute__((force_align_arg_pointer))
 *nested_worker_thread(void *arg) {
     struct Crypto1State *p1;
     StateList_t *statelist = arg;
-    statelist->head.slhead = lfsr_recovery32(statelist->ks1, statelist->nt_enc ^ statelist->uid);
+    statelist->head.slhead = lfsr_recovery32_mt(statelist->ks1, statelist->nt_enc ^ statelist->uid, statelist->threads);
 
     for (p1 = statelist->head.slhead; p1->odd | p1->even; p1++) {};
 
@@ -462,6 +535,8 @@ int mfnested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo,
         statelists[i].blockNo = package->block;
         statelists[i].keyType = package->keytype;
         statelists[i].uid = uid;
+        // both nonces are recovered at the same time
+        statelists[i].threads = MAX(1, num_CPUs() / 2);
     }
 
     memcpy(&statelists[0].nt_enc,  package->nt_a, sizeof(package->nt_a));
@@ -628,6 +703,7 @@ int mfStaticNested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBl
     statelists[0].blockNo = package->block;
     statelists[0].keyType = package->keytype;
     statelists[0].uid = uid;
+    statelists[0].threads = num_CPUs();
 
     memcpy(&statelists[0].nt_enc, package->nt, sizeof(package->nt));
     memcpy(&statelists[0].ks1, package->ks, sizeof(package->ks));
@@ -51,6 +51,7 @@ typedef struct {
     uint32_t keyType;
     uint32_t nt_enc;
     uint32_t ks1;
+    uint32_t threads;   // threads for the lfsr recovery
 } StateList_t;
 
 typedef struct {
@@ -68,6 +69,8 @@ typedef struct {
 #define KEYBLOCK_SIZE   (KEYS_IN_BLOCK * 6)
 #define CANDIDATE_SIZE  (0xFFFF * 6)
 
+struct Crypto1State *lfsr_recovery32_mt(uint32_t ks2, uint32_t in, uint32_t threads);
+
 int mfDarkside(uint8_t blockno, uint8_t key_type, uint64_t *key);
 int mfnested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *resultKey, bool calibrate);
 int mfStaticNested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *resultKey);
@@ -45,6 +45,7 @@ const static vocabulory_t vocabulory[] = {
     { 1, "prefs get clientdebug" }, 
     { 1, "prefs get clientdelay" }, 
     { 1, "prefs get color" }, 
+    { 1, "prefs get dlcompress" }, 
     { 1, "prefs get savepaths" }, 
     { 1, "prefs get emoji" }, 
     { 1, "prefs get hints" }, 
@@ -54,6 +55,7 @@ const static vocabulory_t vocabulory[] = {
     { 1, "prefs set clientdebug" }, 
     { 1, "prefs set clientdelay" }, 
     { 1, "prefs set color" }, 
+    { 1, "prefs set dlcompress" }, 
     { 1, "prefs set emoji" }, 
     { 1, "prefs set hints" }, 
     { 1, "prefs set savepaths" }, 
@@ -699,6 +701,7 @@ const static vocabulory_t vocabulory[] = {
     { 1, "nfc barcode help" }, 
     { 1, "smart help" }, 
     { 1, "smart list" }, 
+    { 1, "smart atr" }, 
     { 0, "smart info" }, 
     { 0, "smart reader" }, 
     { 0, "smart raw" }, 
@@ -63,6 +63,7 @@ int preferences_load(void) {
     g_session.overlay.w = g_session.plot.w;
     g_session.overlay_sliders = true;
     g_session.show_hints = true;
+    g_session.bigbuf_lz4 = true;
 
     g_session.bar_mode = STYLE_VALUE;
     setDefaultPath(spDefault, "");
@@ -185,6 +186,8 @@ void preferences_save_callback(json_t *root) {
 
     JsonSaveBoolean(root, "show.hints", g_session.show_hints);
 
+    JsonSaveBoolean(root, "client.download.compress", g_session.bigbuf_lz4);
+
     JsonSaveBoolean(root, "os.supports.colors", g_session.supports_colors);
 
     JsonSaveStr(root, "file.default.savepath", g_session.defaultPaths[spDefault]);
@@ -319,6 +322,9 @@ void preferences_load_callback(json_t *root) {
     if (json_unpack_ex(root, &up_error, 0, "{s:b}", "show.hints", &b1) == 0)
         g_session.show_hints = (bool)b1;
 
+    if (json_unpack_ex(root, &up_error, 0, "{s:b}", "client.download.compress", &b1) == 0)
+        g_session.bigbuf_lz4 = (bool)b1;
+
     if (json_unpack_ex(root, &up_error, 0, "{s:b}", "os.supports.colors", &b1) == 0)
         g_session.supports_colors = (bool)b1;
 
@@ -493,6 +499,13 @@ static void showHintsState(prefShowOpt_t opt) {
         PrintAndLogEx(INFO, "   %s hints.................. "_WHITE_("off"), prefShowMsg(opt));
 }
 
+static void showDownloadCompressState(prefShowOpt_t opt) {
+    if (g_session.bigbuf_lz4)
+        PrintAndLogEx(INFO, "   %s compressed download.... "_GREEN_("on"), prefShowMsg(opt));
+    else
+        PrintAndLogEx(INFO, "   %s compressed download.... "_WHITE_("off"), prefShowMsg(opt));
+}
+
 static void showPlotSliderState(prefShowOpt_t opt) {
     if (g_session.overlay_sliders)
         PrintAndLogEx(INFO, "   %s show plot sliders...... "_GREEN_("on"), prefShowMsg(opt));
@@ -767,6 +780,50 @@ static int setCmdExeDelay(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+static int setCmdDownloadCompress(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "prefs set dlcompress ",
+                  "Set persistent preference of compressing BigBuf downloads (samples, traces),\n"
+                  "when the device firmware supports it. Turn it off to force the plain download",
+                  "prefs set dlcompress --off"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_lit0(NULL, "off", "plain downloads"),
+        arg_lit0(NULL, "on", "compressed downloads"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    bool use_off = arg_get_lit(ctx, 1);
+    bool use_on = arg_get_lit(ctx, 2);
+    CLIParserFree(ctx);
+
+    if ((use_off + use_on) > 1) {
+        PrintAndLogEx(FAILED, "Can only set one option");
+        return PM3_EINVARG;
+    }
+
+    bool new_value = g_session.bigbuf_lz4;
+    if (use_off) {
+        new_value = false;
+    }
+    if (use_on) {
+        new_value = true;
+    }
+
+    if (g_session.bigbuf_lz4 != new_value) {
+        showDownloadCompressState(prefShowOLD);
+        g_session.bigbuf_lz4 = new_value;
+        showDownloadCompressState(prefShowNEW);
+        preferences_save();
+    } else {
+        showDownloadCompressState(prefShowNone);
+    }
+
+    return PM3_SUCCESS;
+}
+
 static int setCmdHint(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "prefs set hints ",
@@ -996,6 +1053,22 @@ static int getCmdEmoji(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+static int getCmdDownloadCompress(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "prefs get dlcompress",
+                  "Get preference of compressing BigBuf downloads",
+                  "prefs get dlcompress"
+                 );
+    void *argtable[] = {
+        arg_param_begin,
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    CLIParserFree(ctx);
+    showDownloadCompressState(prefShowNone);
+    return PM3_SUCCESS;
+}
+
 static int getCmdHint(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "prefs get hints",
@@ -1115,6 +1188,7 @@ static command_t CommandTableGet[] = {
     {"clientdebug",      getCmdDebug,         AlwaysAvailable, "Get client debug level preference"},
     {"clientdelay",      getCmdExeDelay,      AlwaysAvailable, "Get client execution delay preference"},
     {"color",            getCmdColor,         AlwaysAvailable, "Get color support preference"},
+    {"dlcompress",       getCmdDownloadCompress, AlwaysAvailable, "Get compressed download preference"},
     {"savepaths",        getCmdSavePaths,     AlwaysAvailable, "Get file folder  "},
     //  {"devicedebug",      getCmdDeviceDebug,   AlwaysAvailable, "Get device debug level"},
     {"emoji",            getCmdEmoji,         AlwaysAvailable, "Get emoji display preference"},
@@ -1129,6 +1203,7 @@ static command_t CommandTableSet[] = {
     {"clientdebug",      setCmdDebug,         AlwaysAvailable, "Set client debug level"},
     {"clientdelay",      setCmdExeDelay,      AlwaysAvailable, "Set client execution delay"},
     {"color",            setCmdColor,         AlwaysAvailable, "Set color support"},
+    {"dlcompress",       setCmdDownloadCompress, AlwaysAvailable, "Set compressed download"},
     {"emoji",            setCmdEmoji,         AlwaysAvailable, "Set emoji display"},
     {"hints",            setCmdHint,          AlwaysAvailable, "Set hint display"},
     {"savepaths",        setCmdSavePaths,     AlwaysAvailable, "... to be adjusted next ... "},
@@ -1186,6 +1261,7 @@ static int CmdPrefShow(const char *Cmd) {
     showSavePathState(spTrace, prefShowNone);
     showClientDebugState(prefShowNone);
     showPlotSliderState(prefShowNone);
+    showDownloadCompressState(prefShowNone);
 //    showDeviceDebugState(prefShowNone);
     showBarModeState(prefShowNone);
     showClientExeDelayState();
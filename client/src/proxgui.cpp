@@ -22,6 +22,7 @@
 #include "proxguiqt.h"
 #include "proxmark3.h"
 #include "ui.h"  // for prints
+#include "graph.h"
 
 static ProxGuiQT *gui = NULL;
 static WorkerThread *main_loop_thread = NULL;
@@ -47,6 +48,7 @@ extern "C" void ShowGraphWindow(void) {
         return;
     }
 
+    GraphBufferSync();
     gui->ShowGraphWindow();
 
 }
@@ -62,9 +64,18 @@ extern "C" void RepaintGraphWindow(void) {
     if (!gui)
         return;
 
+    GraphBufferSync();
     gui->RepaintGraphWindow();
 }
 
+// needs the Qt application,  run with QT_QPA_PLATFORM=offscreen when there is no display
+extern "C" bool GraphRenderBench(uint32_t iterations, uint64_t *ms_samples, uint64_t *ms_lod) {
+    if (!gui)
+        return false;
+
+    return PlotRenderBench(iterations, ms_samples, ms_lod);
+}
+
 
 // hook up picture viewer
 extern "C" void ShowPictureWindow(char *fn) {
@@ -30,6 +30,7 @@ extern "C" {
 void ShowGraphWindow(void);
 void HideGraphWindow(void);
 void RepaintGraphWindow(void);
+bool GraphRenderBench(uint32_t iterations, uint64_t *ms_samples, uint64_t *ms_lod);
 
 // hook up picture viewer
 void ShowPictureWindow(char *fn);
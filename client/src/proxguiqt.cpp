@@ -25,12 +25,14 @@
 #include <QBrush>
 #include <QPen>
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QCloseEvent>
 #include <QMouseEvent>
 #include <QKeyEvent>
 #include <math.h>
 #include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <QSlider>
 #include <QHBoxLayout>
 #include <string.h>
@@ -46,6 +48,7 @@
 extern "C" int preferences_save(void);
 
 static int s_Buff[MAX_GRAPH_TRACE_LEN];
+static graph_lod_t s_BuffLod;
 static bool gs_useOverlays = false;
 static int gs_absVMax = 0;
 static uint32_t startMax; // Maximum offset in the graph (right side of graph)
@@ -353,6 +356,7 @@ void ProxWidget::applyOperation() {
     //printf("ApplyOperation()");
     save_restoreGB(GRAPH_SAVE);
     memcpy(g_GraphBuffer, s_Buff, sizeof(int) * g_GraphTraceLen);
+    GraphLodInvalidate(&g_GraphLod, 0, g_GraphTraceLen);
     RepaintGraphWindow();
 }
 void ProxWidget::stickOperation() {
@@ -361,6 +365,7 @@ void ProxWidget::stickOperation() {
 }
 void ProxWidget::vchange_autocorr(int v) {
     int ans = AutoCorrelate(g_GraphBuffer, s_Buff, g_GraphTraceLen, v, true, false);
+    GraphLodInvalidate(&s_BuffLod, 0, g_GraphTraceLen);
     if (g_debugMode) printf("vchange_autocorr(w:%d): %d\n", v, ans);
     gs_useOverlays = true;
     RepaintGraphWindow();
@@ -368,6 +373,7 @@ void ProxWidget::vchange_autocorr(int v) {
 void ProxWidget::vchange_askedge(int v) {
     //extern int AskEdgeDetect(const int *in, int *out, int len, int threshold);
     int ans = AskEdgeDetect(g_GraphBuffer, s_Buff, g_GraphTraceLen, v);
+    GraphLodInvalidate(&s_BuffLod, 0, g_GraphTraceLen);
     if (g_debugMode) printf("vchange_askedge(w:%d)%d\n", v, ans);
     gs_useOverlays = true;
     RepaintGraphWindow();
@@ -375,6 +381,7 @@ void ProxWidget::vchange_askedge(int v) {
 void ProxWidget::vchange_dthr_up(int v) {
     int down = opsController->horizontalSlider_dirthr_down->value();
     directionalThreshold(g_GraphBuffer, s_Buff, g_GraphTraceLen, v, down);
+    GraphLodInvalidate(&s_BuffLod, 0, g_GraphTraceLen);
     //printf("vchange_dthr_up(%d)", v);
     gs_useOverlays = true;
     RepaintGraphWindow();
@@ -383,6 +390,7 @@ void ProxWidget::vchange_dthr_down(int v) {
     //printf("vchange_dthr_down(%d)", v);
     int up = opsController->horizontalSlider_dirthr_up->value();
     directionalThreshold(g_GraphBuffer, s_Buff, g_GraphTraceLen, v, up);
+    GraphLodInvalidate(&s_BuffLod, 0, g_GraphTraceLen);
     gs_useOverlays = true;
     RepaintGraphWindow();
 }
@@ -506,12 +514,68 @@ int Plot::xCoordOf(int i, QRect r) {
     return r.left() + (int)((i - g_GraphStart) * g_GraphPixelsPerPoint);
 }
 
-int Plot::yCoordOf(int v, QRect r, int maxVal) {
+static int graphYCoord(int v, QRect r, int maxVal) {
     int z = (r.bottom() - r.top()) / 2;
     if (maxVal == 0) ++maxVal;
     return -(z * v) / maxVal + z;
 }
 
+int Plot::yCoordOf(int v, QRect r, int maxVal) {
+    return graphYCoord(v, r, maxVal);
+}
+
+// first sample right of the plot area, starting from g_GraphStart
+uint32_t Plot::visibleStop(size_t len, QRect r) {
+    if (g_GraphStart >= len) return g_GraphStart;
+
+    double n = ceil((r.right() - r.left()) / g_GraphPixelsPerPoint);
+    uint32_t stop = (g_GraphStart + n < len) ? g_GraphStart + (uint32_t)n : len;
+    while (stop > g_GraphStart && xCoordOf(stop - 1, r) >= r.right()) stop--;
+    while (stop < len && xCoordOf(stop, r) < r.right()) stop++;
+    return stop;
+}
+
+// Trace path of buffer[start..stop). Up to two samples per pixel every sample is a point,
+// further out every pixel column is one min/max segment taken from the pyramid.
+// Without a pyramid (lod NULL) all samples are added.
+static void graphPath(QPainterPath *path, const int *buffer, const graph_lod_t *lod, uint32_t start, uint32_t stop, double pixelsPerPoint, QRect r, int absVMax) {
+    if (start >= stop) return;
+
+    path->moveTo(r.left(), graphYCoord(buffer[start], r, absVMax));
+
+    if (lod == NULL || pixelsPerPoint >= 0.5) {
+        for (uint32_t i = start; i < stop; i++) {
+            path->lineTo(r.left() + (int)((i - start) * pixelsPerPoint), graphYCoord(buffer[i], r, absVMax));
+        }
+        return;
+    }
+
+    int last = buffer[start];
+    for (int px = 0; ; px++) {
+        uint32_t s0 = start + (uint32_t)ceil(px / pixelsPerPoint);
+        if (s0 >= stop) break;
+        uint32_t s1 = start + (uint32_t)ceil((px + 1) / pixelsPerPoint);
+        if (s1 > stop) s1 = stop;
+
+        int vMin, vMax;
+        GraphLodQuery(lod, buffer, s0, s1, &vMin, &vMax, NULL);
+
+        // walk the column starting from the end nearest to the previous one.
+        // The segment sits on the pixel centre,  on the left edge the raster engine puts it in the
+        // column before. The lower end is pushed half a pixel down so its last pixel is drawn too
+        qreal x = r.left() + px + 0.5;
+        if (last - vMin < vMax - last) {
+            path->lineTo(x, graphYCoord(vMin, r, absVMax) + 0.5);
+            path->lineTo(x, graphYCoord(vMax, r, absVMax));
+            last = vMax;
+        } else {
+            path->lineTo(x, graphYCoord(vMax, r, absVMax));
+            path->lineTo(x, graphYCoord(vMin, r, absVMax) + 0.5);
+            last = vMin;
+        }
+    }
+}
+
 int Plot::valueOf_yCoord(int y, QRect r, int maxVal) {
     int z = (r.bottom() - r.top()) / 2;
     return (y - z) * maxVal / z;
@@ -543,7 +607,7 @@ QColor Plot::getColor(int graphNum) {
     }
 }
 
-void Plot::setMaxAndStart(int *buffer, size_t len, QRect plotRect) {
+void Plot::setMaxAndStart(int *buffer, graph_lod_t *lod, size_t len, QRect plotRect) {
     if (len == 0) return;
     startMax = 0;
     if (plotRect.right() >= plotRect.left() + 40) {
@@ -555,14 +619,9 @@ void Plot::setMaxAndStart(int *buffer, size_t len, QRect plotRect) {
         g_GraphStart = startMax;
     }
     if (g_GraphStart > len) return;
-    int vMin = INT_MAX, vMax = INT_MIN;
-    uint32_t sample_index = g_GraphStart ;
-    for (; sample_index < len && xCoordOf(sample_index, plotRect) < plotRect.right() ; sample_index++) {
-
-        int v = buffer[sample_index];
-        if (v < vMin) vMin = v;
-        if (v > vMax) vMax = v;
-    }
+    if (GraphLodUpdate(lod, buffer, len) == false) lod = NULL;
+    int vMin, vMax;
+    GraphLodQuery(lod, buffer, g_GraphStart, visibleStop(len, plotRect), &vMin, &vMax, NULL);
 
     gs_absVMax = 0;
     if (fabs((double) vMin) > gs_absVMax) gs_absVMax = (int)fabs((double) vMin);
@@ -624,36 +683,31 @@ void Plot::PlotDemod(uint8_t *buffer, size_t len, QRect plotRect, QRect annotati
     painter->drawPath(penPath);
 }
 
-void Plot::PlotGraph(int *buffer, size_t len, QRect plotRect, QRect annotationRect, QPainter *painter, int graphNum) {
+void Plot::PlotGraph(int *buffer, graph_lod_t *lod, size_t len, QRect plotRect, QRect annotationRect, QPainter *painter, int graphNum) {
     if (len == 0) return;
     // clock_t begin = clock();
     QPainterPath penPath;
-    int vMin = INT_MAX, vMax = INT_MIN, v = 0;
+    int vMin, vMax, v = 0;
     int64_t vMean = 0;
-    uint32_t i = 0;
-    int x = xCoordOf(g_GraphStart, plotRect);
-    int y = yCoordOf(buffer[g_GraphStart], plotRect, gs_absVMax);
-    penPath.moveTo(x, y);
-    for (i = g_GraphStart; i < len && xCoordOf(i, plotRect) < plotRect.right(); i++) {
+    if (GraphLodUpdate(lod, buffer, len) == false) lod = NULL;
 
-        x = xCoordOf(i, plotRect);
-        v = buffer[i];
+    uint32_t stop = visibleStop(len, plotRect);
+    graphPath(&penPath, buffer, lod, g_GraphStart, stop, g_GraphPixelsPerPoint, plotRect, gs_absVMax);
 
-        y = yCoordOf(v, plotRect, gs_absVMax);
-
-        penPath.lineTo(x, y);
-
-        if (g_GraphPixelsPerPoint > 10) {
+    if (g_GraphPixelsPerPoint > 10) {
+        for (uint32_t i = g_GraphStart; i < stop; i++) {
+            int x = xCoordOf(i, plotRect);
+            int y = yCoordOf(buffer[i], plotRect, gs_absVMax);
             QRect f(QPoint(x - 3, y - 3), QPoint(x + 3, y + 3));
             painter->fillRect(f, GREEN);
         }
-        // catch stats
-        if (v < vMin) vMin = v;
-        if (v > vMax) vMax = v;
-        vMean += v;
     }
-    g_GraphStop = i;
-    vMean /= (g_GraphStop - g_GraphStart);
+
+    // catch stats
+    GraphLodQuery(lod, buffer, g_GraphStart, stop, &vMin, &vMax, &vMean);
+    g_GraphStop = stop;
+    if (g_GraphStop > g_GraphStart)
+        vMean /= (g_GraphStop - g_GraphStart);
 
     painter->setPen(getColor(graphNum));
 
@@ -760,7 +814,7 @@ void Plot::paintEvent(QPaintEvent *event) {
     painter.fillRect(plotRect, BLACK);
 
     //init graph variables
-    setMaxAndStart(g_GraphBuffer, g_GraphTraceLen, plotRect);
+    setMaxAndStart(g_GraphBuffer, &g_GraphLod, g_GraphTraceLen, plotRect);
 
     // center line
     int zeroHeight = plotRect.top() + (plotRect.bottom() - plotRect.top()) / 2;
@@ -770,14 +824,14 @@ void Plot::paintEvent(QPaintEvent *event) {
     plotGridLines(&painter, plotRect);
 
     //Start painting graph
-    PlotGraph(g_GraphBuffer, g_GraphTraceLen, plotRect, infoRect, &painter, 0);
+    PlotGraph(g_GraphBuffer, &g_GraphLod, g_GraphTraceLen, plotRect, infoRect, &painter, 0);
     if (g_DemodBufferLen > 8) {
         PlotDemod(g_DemodBuffer, g_DemodBufferLen, plotRect, infoRect, &painter, 2, g_DemodStartIdx);
     }
     if (gs_useOverlays) {
         //init graph variables
-        setMaxAndStart(s_Buff, g_GraphTraceLen, plotRect);
-        PlotGraph(s_Buff, g_GraphTraceLen, plotRect, infoRect, &painter, 1);
+        setMaxAndStart(s_Buff, &s_BuffLod, g_GraphTraceLen, plotRect);
+        PlotGraph(s_Buff, &s_BuffLod, g_GraphTraceLen, plotRect, infoRect, &painter, 1);
     }
     // End graph drawing
 
@@ -826,6 +880,49 @@ void Plot::paintEvent(QPaintEvent *event) {
     painter.drawText(20, infoRect.bottom() - 3, str);
 }
 
+// Offscreen render time of a full trace zoomed out to the window width,  drawn from
+// every sample and drawn through the pyramid. The pyramid is built before timing.
+bool PlotRenderBench(uint32_t iterations, uint64_t *ms_samples, uint64_t *ms_lod) {
+    int *buf = (int *)calloc(MAX_GRAPH_TRACE_LEN, sizeof(int));
+    if (buf == NULL) return false;
+
+    // 125 kHz carrier with an ASK envelope and some noise
+    uint32_t lfsr = 0x12345678;
+    for (uint32_t i = 0; i < MAX_GRAPH_TRACE_LEN; i++) {
+        lfsr = lfsr * 1103515245 + 12345;
+        int amp = ((i / 512) & 1) ? 100 : 60;
+        buf[i] = (int)(amp * sin(i * M_PI / 4)) + (int)((lfsr >> 16) % 9) - 4;
+    }
+
+    graph_lod_t lod = {0};
+    if (GraphLodUpdate(&lod, buf, MAX_GRAPH_TRACE_LEN) == false) {
+        free(buf);
+        return false;
+    }
+
+    QImage image(1600, 600, QImage::Format_RGB32);
+    QRect r(WIDTH_AXES, 0, image.width() - WIDTH_AXES, image.height() - HEIGHT_INFO);
+    double pixelsPerPoint = (double)(r.right() - r.left()) / MAX_GRAPH_TRACE_LEN;
+
+    for (uint8_t pass = 0; pass < 2; pass++) {
+        QElapsedTimer timer;
+        timer.start();
+        for (uint32_t i = 0; i < iterations; i++) {
+            QPainter painter(&image);
+            painter.fillRect(r, BLACK);
+            painter.setPen(GREEN);
+            QPainterPath path;
+            graphPath(&path, buf, (pass) ? &lod : NULL, 0, MAX_GRAPH_TRACE_LEN, pixelsPerPoint, r, 160);
+            painter.drawPath(path);
+        }
+        *((pass) ? ms_lod : ms_samples) = timer.elapsed();
+    }
+
+    GraphLodFree(&lod);
+    free(buf);
+    return true;
+}
+
 Plot::Plot(QWidget *parent) : QWidget(parent), g_GraphPixelsPerPoint(1) {
     //Need to set this, otherwise we don't receive keypress events
     setFocusPolicy(Qt::StrongFocus);
@@ -931,6 +1028,7 @@ void Plot::Trim(void) {
         g_GraphBuffer[i - lref] = g_GraphBuffer[i];
     g_GraphTraceLen = rref - lref;
     g_GraphStart = 0;
+    GraphLodInvalidate(&g_GraphLod, 0, g_GraphTraceLen);
 }
 
 void Plot::wheelEvent(QWheelEvent *event) {
@@ -31,6 +31,7 @@
 
 #include "ui/ui_overlays.h"
 #include "ui/ui_image.h"
+#include "graph.h"
 
 class ProxWidget;
 
@@ -43,13 +44,14 @@ class Plot: public QWidget {
     double g_GraphPixelsPerPoint; // How many visual pixels are between each sample point (x axis)
     uint32_t CursorAPos;
     uint32_t CursorBPos;
-    void PlotGraph(int *buffer, size_t len, QRect plotRect, QRect annotationRect, QPainter *painter, int graphNum);
+    void PlotGraph(int *buffer, graph_lod_t *lod, size_t len, QRect plotRect, QRect annotationRect, QPainter *painter, int graphNum);
     void PlotDemod(uint8_t *buffer, size_t len, QRect plotRect, QRect annotationRect, QPainter *painter, int graphNum, uint32_t plotOffset);
     void plotGridLines(QPainter *painter, QRect r);
     int xCoordOf(int i, QRect r);
     int yCoordOf(int v, QRect r, int maxVal);
     int valueOf_yCoord(int y, QRect r, int maxVal);
-    void setMaxAndStart(int *buffer, size_t len, QRect plotRect);
+    void setMaxAndStart(int *buffer, graph_lod_t *lod, size_t len, QRect plotRect);
+    uint32_t visibleStop(size_t len, QRect r);
     QColor getColor(int graphNum);
 
   public:
@@ -68,6 +70,8 @@ class Plot: public QWidget {
 };
 class ProxGuiQT;
 
+bool PlotRenderBench(uint32_t iterations, uint64_t *ms_samples, uint64_t *ms_lod);
+
 // Added class for SliderWidget to allow move/resize event override
 class SliderWidget : public QWidget {
   protected:
@@ -345,6 +345,7 @@ check_script:
                     char prompt_filtered[PROXPROMPT_MAX_SIZE] = {0};
                     memcpy_filter_ansi(prompt_filtered, prompt, sizeof(prompt_filtered), !g_session.supports_colors);
                     g_pendingPrompt = true;
+                    FlushSessionLog();
                     script_cmd = pm3line_read(prompt_filtered);
 #if defined(_WIN32)
                     //Check if color support needs to be enabled again in case the window buffer did change
@@ -549,7 +550,7 @@ static void show_help(bool showFullHelp, char *exec_name) {
 #else // HAVE_PYTHON
     PrintAndLogEx(NORMAL, "        %s [[-p] <port>] [-b] [-w] [-f] [-c <command>]|[-l <lua_script_file>]|[-s <cmd_script_file>] [-i] [-d <0|1|2>]", exec_name);
 #endif // HAVE_PYTHON
-    PrintAndLogEx(NORMAL, "        %s [-p] <port> --flash [--unlock-bootloader] [--image <imagefile>]+ [-w] [-f] [-d <0|1|2>]", exec_name);
+    PrintAndLogEx(NORMAL, "        %s [-p] <port> --flash [--unlock-bootloader] [--full] [--image <imagefile>]+ [-w] [-f] [-d <0|1|2>]", exec_name);
 
     if (showFullHelp) {
 
@@ -578,6 +579,7 @@ static void show_help(bool showFullHelp, char *exec_name) {
         PrintAndLogEx(NORMAL, "      --flash                             flash Proxmark3, requires at least one --image");
         PrintAndLogEx(NORMAL, "      --unlock-bootloader                 Enable flashing of bootloader area *DANGEROUS* (need --flash)");
         PrintAndLogEx(NORMAL, "      --force                             Enable flashing even if firmware seems to not match client version");
+        PrintAndLogEx(NORMAL, "      --full                              Write all blocks, even those the bootloader reports as unchanged");
         PrintAndLogEx(NORMAL, "      --image <imagefile>                 image to flash. Can be specified several times.");
         PrintAndLogEx(NORMAL, "\nExamples:");
         PrintAndLogEx(NORMAL, "\n  to run Proxmark3 client:\n");
@@ -603,7 +605,7 @@ static void show_help(bool showFullHelp, char *exec_name) {
     }
 }
 
-static int flash_pm3(char *serial_port_name, uint8_t num_files, char *filenames[FLASH_MAX_FILES], bool can_write_bl, bool force) {
+static int flash_pm3(char *serial_port_name, uint8_t num_files, char *filenames[FLASH_MAX_FILES], bool can_write_bl, bool force, bool full_write) {
 
     int ret = PM3_EUNDEF;
     flash_file_t files[FLASH_MAX_FILES];
@@ -671,7 +673,7 @@ static int flash_pm3(char *serial_port_name, uint8_t num_files, char *filenames[
     PrintAndLogEx(SUCCESS, _CYAN_("Flashing..."));
 
     for (int i = 0; i < num_files; i++) {
-        ret = flash_write(&files[i]);
+        ret = flash_write(&files[i], full_write);
         if (ret != PM3_SUCCESS) {
             goto finish;
         }
@@ -734,6 +736,7 @@ int main(int argc, char *argv[]) {
     bool flash_mode = false;
     bool flash_can_write_bl = false;
     bool flash_force = false;
+    bool flash_full_write = false;
     bool debug_mode_forced = false;
     int flash_num_files = 0;
     char *flash_filenames[FLASH_MAX_FILES];
@@ -956,6 +959,12 @@ int main(int argc, char *argv[]) {
             continue;
         }
 
+        // write all blocks, skip the unchanged blocks detection
+        if (strcmp(argv[i], "--full") == 0) {
+            flash_full_write = true;
+            continue;
+        }
+
         // flash file
         if (strcmp(argv[i], "--image") == 0) {
             if (flash_num_files == FLASH_MAX_FILES) {
@@ -997,7 +1006,7 @@ int main(int argc, char *argv[]) {
         speed = USART_BAUD_RATE;
 
     if (flash_mode) {
-        flash_pm3(port, flash_num_files, flash_filenames, flash_can_write_bl, flash_force);
+        flash_pm3(port, flash_num_files, flash_filenames, flash_can_write_bl, flash_force, flash_full_write);
         exit(EXIT_SUCCESS);
     }
 
@@ -1094,6 +1103,8 @@ int main(int argc, char *argv[]) {
 
     if (g_session.window_changed) // Plot/Overlay moved or resized
         preferences_save();
+
+    freeResourceJSON();
     return mainret;
 }
 #endif //LIBPM3
@@ -46,6 +46,10 @@
 #include "cmdlfem4x05.h"  // read 4305
 #include "cmdlfem4x50.h"  // read 4350
 #include "em4x50.h"       // 4x50 structs
+#include "cmddata.h"      // g_DemodBuffer
+#include "graph.h"        // g_GraphBuffer
+#include "util.h"         // hex_to_bytes
+#include "util_posix.h"   // msclock
 
 static int returnToLuaWithError(lua_State *L, const char *fmt, ...) {
     char buffer[200];
@@ -59,6 +63,358 @@ static int returnToLuaWithError(lua_State *L, const char *fmt, ...) {
     return 2;
 }
 
+// Byte buffer shared with Lua scripts, so device data doesn't have to travel through Lua strings.
+// It either owns its bytes (stored right behind the header) or is a view into client memory or
+// into another buffer, which is then kept alive through the uservalue. Lua 5.2 only accepts a
+// table or nil as uservalue, so the parent is stored in a one slot table.
+#define SCRIPT_BUFFER_MT "pm3.buffer"
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+} script_buffer_t;
+
+static script_buffer_t *newBuffer(lua_State *L, size_t len) {
+    script_buffer_t *b = lua_newuserdata(L, sizeof(script_buffer_t) + len);
+    b->data = (uint8_t *)(b + 1);
+    b->len = len;
+    memset(b->data, 0, len);
+    luaL_setmetatable(L, SCRIPT_BUFFER_MT);
+    return b;
+}
+
+// parent is the stack index of the object owning the memory, 0 for client globals
+static script_buffer_t *newBufferView(lua_State *L, uint8_t *data, size_t len, int parent) {
+    if (parent < 0)
+        parent = lua_gettop(L) + parent + 1;
+
+    script_buffer_t *b = lua_newuserdata(L, sizeof(script_buffer_t));
+    b->data = data;
+    b->len = len;
+    luaL_setmetatable(L, SCRIPT_BUFFER_MT);
+    if (parent) {
+        lua_createtable(L, 1, 0);
+        lua_pushvalue(L, parent);
+        lua_rawseti(L, -2, 1);
+        lua_setuservalue(L, -2);
+    }
+    return b;
+}
+
+static script_buffer_t *checkBuffer(lua_State *L, int idx) {
+    return luaL_checkudata(L, idx, SCRIPT_BUFFER_MT);
+}
+
+// checks [offset, offset + n) against the buffer, offset at idx and n at idx + 1
+static void checkBufferRange(lua_State *L, script_buffer_t *b, int idx, size_t *offset, size_t *n, size_t defn) {
+    *offset = luaL_optunsigned(L, idx, 0);
+    luaL_argcheck(L, *offset <= b->len, idx, "offset out of range");
+    *n = luaL_optunsigned(L, idx + 1, (defn == (size_t) - 1) ? b->len - *offset : defn);
+    luaL_argcheck(L, *n <= b->len - *offset, idx + 1, "length out of range");
+}
+
+static int l_buffer_len(lua_State *L) {
+    script_buffer_t *b = checkBuffer(L, 1);
+    lua_pushunsigned(L, b->len);
+    return 1;
+}
+
+static int l_buffer_tostring(lua_State *L) {
+    script_buffer_t *b = checkBuffer(L, 1);
+    lua_pushfstring(L, SCRIPT_BUFFER_MT ": %d bytes", (int)b->len);
+    return 1;
+}
+
+// buf:get(offset [, n]) returns n bytes as numbers, like string.byte
+static int l_buffer_get(lua_State *L) {
+    script_buffer_t *b = checkBuffer(L, 1);
+    size_t offset, n;
+    checkBufferRange(L, b, 2, &offset, &n, 1);
+    luaL_checkstack(L, n, "too many bytes requested");
+    for (size_t i = 0; i < n; i++) {
+        lua_pushunsigned(L, b->data[offset + i]);
+    }
+    return n;
+}
+
+// buf:set(offset, byte, ...) writes the given bytes from offset on
+static int l_buffer_set(lua_State *L) {
+    script_buffer_t *b = checkBuffer(L, 1);
+    size_t offset = luaL_checkunsigned(L, 2);
+    size_t n = lua_gettop(L) - 2;
+    luaL_argcheck(L, offset <= b->len && n <= b->len - offset, 2, "offset out of range");
+    for (size_t i = 0; i < n; i++) {
+        b->data[offset + i] = luaL_checkunsigned(L, 3 + i) & 0xFF;
+    }
+    return 0;
+}
+
+// buf:write(offset, string) copies a raw string into the buffer
+static int l_buffer_write(lua_State *L) {
+    script_buffer_t *b = checkBuffer(L, 1);
+    size_t offset = luaL_checkunsigned(L, 2);
+    size_t n;
+    const char *s = luaL_checklstring(L, 3, &n);
+    luaL_argcheck(L, offset <= b->len && n <= b->len - offset, 2, "offset out of range");
+    memcpy(b->data + offset, s, n);
+    return 0;
+}
+
+static int l_buffer_fill(lua_State *L) {
+    script_buffer_t *b = checkBuffer(L, 1);
+    memset(b->data, luaL_optunsigned(L, 2, 0) & 0xFF, b->len);
+    return 0;
+}
+
+// buf:u16(offset [, bigendian]), little endian by default
+static int l_buffer_u16(lua_State *L) {
+    script_buffer_t *b = checkBuffer(L, 1);
+    size_t offset = luaL_checkunsigned(L, 2);
+    luaL_argcheck(L, offset + 2 <= b->len, 2, "offset out of range");
+    if (lua_toboolean(L, 3))
+        lua_pushunsigned(L, MemBeToUint2byte(b->data + offset));
+    else
+        lua_pushunsigned(L, MemLeToUint2byte(b->data + offset));
+    return 1;
+}
+
+// buf:u32(offset [, bigendian]), little endian by default
+static int l_buffer_u32(lua_State *L) {
+    script_buffer_t *b = checkBuffer(L, 1);
+    size_t offset = luaL_checkunsigned(L, 2);
+    luaL_argcheck(L, offset + 4 <= b->len, 2, "offset out of range");
+    if (lua_toboolean(L, 3))
+        lua_pushunsigned(L, MemBeToUint4byte(b->data + offset));
+    else
+        lua_pushunsigned(L, MemLeToUint4byte(b->data + offset));
+    return 1;
+}
+
+// buf:int(index) reads a native int, as stored in the graph buffer
+static int l_buffer_int(lua_State *L) {
+    script_buffer_t *b = checkBuffer(L, 1);
+    size_t index = luaL_checkunsigned(L, 2);
+    luaL_argcheck(L, index < b->len / sizeof(int), 2, "index out of range");
+    int v;
+    memcpy(&v, b->data + index * sizeof(int), sizeof(v));
+    lua_pushinteger(L, v);
+    return 1;
+}
+
+// buf:hex([offset [, n]])
+static int l_buffer_hex(lua_State *L) {
+    static const char hexchars[] = "0123456789ABCDEF";
+    script_buffer_t *b = checkBuffer(L, 1);
+    size_t offset, n;
+    checkBufferRange(L, b, 2, &offset, &n, -1);
+    luaL_Buffer lb;
+    char *p = luaL_buffinitsize(L, &lb, n * 2);
+    for (size_t i = 0; i < n; i++) {
+        p[i * 2] = hexchars[b->data[offset + i] >> 4];
+        p[i * 2 + 1] = hexchars[b->data[offset + i] & 0x0F];
+    }
+    luaL_pushresultsize(&lb, n * 2);
+    return 1;
+}
+
+// buf:string([offset [, n]]) copies out a raw Lua string
+static int l_buffer_string(lua_State *L) {
+    script_buffer_t *b = checkBuffer(L, 1);
+    size_t offset, n;
+    checkBufferRange(L, b, 2, &offset, &n, -1);
+    lua_pushlstring(L, (const char *)b->data + offset, n);
+    return 1;
+}
+
+// buf:sub([offset [, n]]) returns a view sharing the memory of buf
+static int l_buffer_sub(lua_State *L) {
+    script_buffer_t *b = checkBuffer(L, 1);
+    size_t offset, n;
+    checkBufferRange(L, b, 2, &offset, &n, -1);
+    newBufferView(L, b->data + offset, n, 1);
+    return 1;
+}
+
+static void set_buffer_metatable(lua_State *L) {
+    static const luaL_Reg methods[] = {
+        {"len",     l_buffer_len},
+        {"get",     l_buffer_get},
+        {"set",     l_buffer_set},
+        {"write",   l_buffer_write},
+        {"fill",    l_buffer_fill},
+        {"u16",     l_buffer_u16},
+        {"u32",     l_buffer_u32},
+        {"int",     l_buffer_int},
+        {"hex",     l_buffer_hex},
+        {"string",  l_buffer_string},
+        {"sub",     l_buffer_sub},
+        {NULL, NULL}
+    };
+
+    luaL_newmetatable(L, SCRIPT_BUFFER_MT);
+    luaL_newlib(L, methods);
+    lua_setfield(L, -2, "__index");
+    lua_pushcfunction(L, l_buffer_len);
+    lua_setfield(L, -2, "__len");
+    lua_pushcfunction(L, l_buffer_tostring);
+    lua_setfield(L, -2, "__tostring");
+    lua_pop(L, 1);
+}
+
+/**
+ * @brief core.buffer(size) or core.buffer(string) creates a new buffer,
+ * zero filled or holding a copy of the string
+ */
+static int l_buffer(lua_State *L) {
+    if (lua_type(L, 1) == LUA_TSTRING) {
+        size_t len;
+        const char *s = lua_tolstring(L, 1, &len);
+        script_buffer_t *b = newBuffer(L, len);
+        memcpy(b->data, s, len);
+        return 1;
+    }
+    newBuffer(L, luaL_checkunsigned(L, 1));
+    return 1;
+}
+
+/**
+ * @brief core.demodbuffer() returns a view into the client demod buffer
+ */
+static int l_demodbuffer(lua_State *L) {
+    newBufferView(L, g_DemodBuffer, g_DemodBufferLen, 0);
+    return 1;
+}
+
+/**
+ * @brief core.graphbuffer() returns a view into the client graph buffer, read samples with buf:int(i)
+ */
+static int l_graphbuffer(lua_State *L) {
+    newBufferView(L, (uint8_t *)g_GraphBuffer, g_GraphTraceLen * sizeof(int), 0);
+    return 1;
+}
+
+/**
+ * @brief core.msclock() returns a millisecond wall clock, for timing scripts
+ */
+static int l_msclock(lua_State *L) {
+    lua_pushnumber(L, msclock());
+    return 1;
+}
+
+size_t ScriptTransceiveNG(const script_request_t *requests, size_t count, uint8_t *out, size_t outsize, script_reply_t *replies, size_t ms_timeout) {
+
+    if (g_session.pm3_present == false)
+        return 0;
+
+    size_t used = 0;
+    clearCommandBuffer();
+    for (size_t i = 0; i < count; i++) {
+        SendCommandNG(requests[i].cmd, (uint8_t *)requests[i].data, requests[i].len);
+
+        PacketResponseNG resp;
+        if (WaitForResponseTimeout(requests[i].cmd, &resp, ms_timeout) == false)
+            return i;
+
+        uint16_t len = MIN(resp.length, outsize - used);
+        memcpy(out + used, resp.data.asBytes, len);
+        replies[i].cmd = resp.cmd;
+        replies[i].status = resp.status;
+        replies[i].offset = used;
+        replies[i].length = len;
+        used += len;
+    }
+    return count;
+}
+
+/**
+ * @brief core.transceive(requests [, timeout]) sends a batch of NG commands.
+ * requests is a list of { cmd = <number>, data = <buffer or hexstring> }.
+ * Returns a buffer holding all reply payloads back to back
+ * and a list of { cmd, status, offset, length } per reply
+ */
+static int l_transceive(lua_State *L) {
+
+    luaL_checktype(L, 1, LUA_TTABLE);
+    size_t ms_timeout = luaL_optunsigned(L, 2, 2500);
+    size_t count = lua_rawlen(L, 1);
+    if (count == 0)
+        return returnToLuaWithError(L, "You need to supply at least one request");
+
+    if (g_session.pm3_present == false)
+        return returnToLuaWithError(L, "No device connected");
+
+    script_request_t *requests = calloc(count, sizeof(script_request_t));
+    script_reply_t *replies = calloc(count, sizeof(script_reply_t));
+    // hexstring payloads are parsed into here, buffers are sent in place
+    uint8_t *hexdata = calloc(count, PM3_CMD_DATA_SIZE);
+    if (requests == NULL || replies == NULL || hexdata == NULL) {
+        free(requests);
+        free(replies);
+        free(hexdata);
+        return returnToLuaWithError(L, "Allocating memory failed");
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        lua_rawgeti(L, 1, i + 1);
+        if (lua_type(L, -1) != LUA_TTABLE) {
+            lua_pop(L, 1);
+            free(requests);
+            free(replies);
+            free(hexdata);
+            return returnToLuaWithError(L, "Request %zu is not a table", i + 1);
+        }
+        lua_getfield(L, -1, "cmd");
+        requests[i].cmd = lua_tounsigned(L, -1);
+        lua_getfield(L, -2, "data");
+        script_buffer_t *b = luaL_testudata(L, -1, SCRIPT_BUFFER_MT);
+        int len = 0;
+        if (b) {
+            requests[i].data = b->data;
+            len = b->len;
+        } else if (lua_type(L, -1) == LUA_TSTRING) {
+            requests[i].data = hexdata + i * PM3_CMD_DATA_SIZE;
+            len = hex_to_bytes(lua_tostring(L, -1), hexdata + i * PM3_CMD_DATA_SIZE, PM3_CMD_DATA_SIZE);
+        }
+        // the request list at index 1 keeps the buffers alive
+        lua_pop(L, 3);
+        if (len < 0 || len > PM3_CMD_DATA_SIZE) {
+            free(requests);
+            free(replies);
+            free(hexdata);
+            return returnToLuaWithError(L, "Request %zu has invalid data", i + 1);
+        }
+        requests[i].len = len;
+    }
+
+    script_buffer_t *out = newBuffer(L, count * PM3_CMD_DATA_SIZE);
+    size_t got = ScriptTransceiveNG(requests, count, out->data, out->len, replies, ms_timeout);
+    free(requests);
+    free(hexdata);
+    if (got != count) {
+        free(replies);
+        return returnToLuaWithError(L, "No response from the device to request %zu of %zu", got + 1, count);
+    }
+
+    size_t used = replies[count - 1].offset + replies[count - 1].length;
+    newBufferView(L, out->data, used, -1);
+
+    lua_createtable(L, count, 0);
+    for (size_t i = 0; i < count; i++) {
+        lua_createtable(L, 0, 4);
+        lua_pushunsigned(L, replies[i].cmd);
+        lua_setfield(L, -2, "cmd");
+        lua_pushinteger(L, replies[i].status);
+        lua_setfield(L, -2, "status");
+        lua_pushunsigned(L, replies[i].offset);
+        lua_setfield(L, -2, "offset");
+        lua_pushunsigned(L, replies[i].length);
+        lua_setfield(L, -2, "length");
+        lua_rawseti(L, -2, i + 1);
+    }
+    free(replies);
+    return 2;
+}
+
 static int l_clearCommandBuffer(lua_State *L) {
     clearCommandBuffer();
     return 0;
@@ -183,11 +539,29 @@ static int l_SendCommandNG(lua_State *L) {
 }
 
 
+// Downloads straight into the buffer at stack index 3, at the optional offset at index 4.
+// Returns -1 when no buffer was given, else the number of values pushed.
+static int getFromDeviceToBuffer(lua_State *L, DeviceMemType_t memtype, int len, int startindex, size_t ms_timeout) {
+    if (lua_isnoneornil(L, 3))
+        return -1;
+
+    script_buffer_t *b = checkBuffer(L, 3);
+    size_t offset = luaL_optunsigned(L, 4, 0);
+    luaL_argcheck(L, offset <= b->len && len <= b->len - offset, 4, "buffer too small");
+
+    if (!GetFromDevice(memtype, b->data + offset, len, startindex, NULL, 0, NULL, ms_timeout, false)) {
+        return returnToLuaWithError(L, "command execution time out");
+    }
+    lua_pushvalue(L, 3);
+    return 1;
+}
+
 /**
  * @brief The following params expected:
- * uint8_t *dest
- * int bytes
  * int start_index
+ * int bytes
+ * buffer dest, optional. Downloads into it instead of returning a new string
+ * int offset into dest, optional
  * @param L
  * @return
  */
@@ -210,6 +584,11 @@ static int l_GetFromBigBuf(lua_State *L) {
         return returnToLuaWithError(L, "You need to supply number of bytes larger than zero");
     }
 
+    int res = getFromDeviceToBuffer(L, BIG_BUF, len, startindex, 2500);
+    if (res >= 0) {
+        return res;
+    }
+
     uint8_t *data = calloc(len, sizeof(uint8_t));
     if (!data) {
         return returnToLuaWithError(L, "Allocating memory failed");
@@ -228,9 +607,10 @@ static int l_GetFromBigBuf(lua_State *L) {
 
 /**
  * @brief The following params expected:
- * uint8_t *dest
- * int bytes
  * int start_index
+ * int bytes
+ * buffer dest, optional. Downloads into it instead of returning a new string
+ * int offset into dest, optional
  * @param L
  * @return
  */
@@ -251,6 +631,10 @@ static int l_GetFromFlashMem(lua_State *L) {
         if (len == 0)
             return returnToLuaWithError(L, "You need to supply number of bytes larger than zero");
 
+        int res = getFromDeviceToBuffer(L, FLASH_MEM, len, startindex, -1);
+        if (res >= 0)
+            return res;
+
         uint8_t *data = calloc(len, sizeof(uint8_t));
         if (!data)
             return returnToLuaWithError(L, "Allocating memory failed");
@@ -862,7 +1246,7 @@ static int l_hardnested(lua_State *L) {
     }
 
     uint64_t foundkey = 0;
-    int retval = mfnestedhard(blockNo, keyType, key, trgBlockNo, trgKeyType, haveTarget ? trgkey : NULL, nonce_file_read,  nonce_file_write,  slow,  tests, &foundkey, filename);
+    int retval = mfnestedhard(blockNo, keyType, key, trgBlockNo, trgKeyType, haveTarget ? trgkey : NULL, nonce_file_read,  nonce_file_write,  slow,  tests, &foundkey, filename, 0);
     DropField();
 
     //Push the key onto the stack
@@ -1354,6 +1738,11 @@ int set_pm3_libraries(lua_State *L) {
         {"rem",                         l_remark},
         {"em4x05_read",                 l_em4x05_read},
         {"em4x50_read",                 l_em4x50_read},
+        {"buffer",                      l_buffer},
+        {"demodbuffer",                 l_demodbuffer},
+        {"graphbuffer",                 l_graphbuffer},
+        {"transceive",                  l_transceive},
+        {"msclock",                     l_msclock},
         {NULL, NULL}
     };
 
@@ -1370,6 +1759,8 @@ int set_pm3_libraries(lua_State *L) {
     // Name of 'core'
     lua_setfield(L, -2, "core");
 
+    set_buffer_metatable(L);
+
     // remove the global environment table from the stack
     lua_pop(L, 1);
 
@@ -21,9 +21,32 @@
 #include <lua.h>
 //#include <lualib.h>
 //#include <lauxlib.h>
+#include "common.h"
 
 #define LUA_LIBRARIES_WILDCARD  "?.lua"
 
+// one command of a scripted batch, data is sent as is
+typedef struct {
+    uint16_t cmd;
+    const uint8_t *data;
+    uint16_t len;
+} script_request_t;
+
+// reply to a scripted batch command, payload lives at offset in the shared reply buffer
+typedef struct {
+    uint16_t cmd;
+    int16_t status;
+    uint32_t offset;
+    uint16_t length;
+} script_reply_t;
+
+/**
+ * @brief ScriptTransceiveNG sends a batch of NG commands and collects the reply payloads
+ *  back to back into one buffer, for the Lua and Python bindings
+ * @return number of requests which got a reply
+ */
+size_t ScriptTransceiveNG(const script_request_t *requests, size_t count, uint8_t *out, size_t outsize, script_reply_t *replies, size_t ms_timeout);
+
 /**
  * @brief set_libraries loads the core components of pm3 into the 'pm3'
  *  namespace within the given lua_State
@@ -35,6 +35,7 @@
 
 #include <complex.h>
 #include "util.h"
+#include "util_posix.h"  // msleep
 #include "proxmark3.h"  // PROXLOG
 #include "fileutils.h"
 #include "pm3_cmd.h"
@@ -198,8 +199,9 @@ void PrintAndLogEx(logLevel_t level, const char *fmt, ...) {
         return;
 
     char prefix[40] = {0};
-    char buffer[MAX_PRINT_BUFFER] = {0};
-    char buffer2[MAX_PRINT_BUFFER + sizeof(prefix)] = {0};
+    char buffer[MAX_PRINT_BUFFER];
+    char buffer2[MAX_PRINT_BUFFER + sizeof(prefix)];
+    buffer2[0] = '\0';
     char *token = NULL;
     char *tmp_ptr = NULL;
     FILE *stream = stdout;
@@ -293,10 +295,10 @@ void PrintAndLogEx(logLevel_t level, const char *fmt, ...) {
     } else {
         snprintf(buffer2, sizeof(buffer2), "%s%s", prefix, buffer);
         if (level == INPLACE) {
-            char buffer3[sizeof(buffer2)] = {0};
-            char buffer4[sizeof(buffer2)] = {0};
-            memcpy_filter_ansi(buffer3, buffer2, sizeof(buffer2), !g_session.supports_colors);
-            memcpy_filter_emoji(buffer4, buffer3, sizeof(buffer3), g_session.emoji_mode);
+            char buffer3[sizeof(buffer2)];
+            char buffer4[sizeof(buffer2)];
+            memcpy_filter_ansi(buffer3, buffer2, strlen(buffer2) + 1, !g_session.supports_colors);
+            memcpy_filter_emoji(buffer4, buffer3, strlen(buffer3) + 1, g_session.emoji_mode);
             fprintf(stream, "\r%s", buffer4);
             fflush(stream);
         } else {
@@ -305,13 +307,169 @@ void PrintAndLogEx(logLevel_t level, const char *fmt, ...) {
     }
 }
 
+// Session log writer.
+// fPrintAndLog() appends each line as a record to a ring buffer and returns, a writer thread
+// does the emoji / ansi filtering and writes the records to the log file in batches.
+// Producers are serialized by g_print_lock so the ring has a single producer and a single
+// consumer and needs no lock of its own.  The log file is flushed once the writer has been
+// idle for LOG_FLUSH_IDLE_MS,  and before every prompt / at exit by FlushSessionLog().
+#define LOG_RING_SIZE       (256 * 1024)
+#define LOG_RECORD_HDR      3
+#define LOG_FLUSH_IDLE_MS   10
+#define LOG_RECORD_LINEFEED     0x01
+#define LOG_RECORD_ANSI_FIRST   0x02
+
+static FILE *logfile = NULL;
+static uint8_t log_ring[LOG_RING_SIZE];
+static size_t log_head = 0;   // written by producer
+static size_t log_tail = 0;   // written by writer
+static bool log_writer_running = false;
+static bool log_writer_sleeping = false;
+static bool log_writer_stop = false;
+static pthread_t log_writer_thread;
+static pthread_mutex_t log_wait_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_wait_cond = PTHREAD_COND_INITIALIZER;
+
+static void log_ring_read(size_t pos, void *dest, size_t n) {
+    size_t off = pos % LOG_RING_SIZE;
+    size_t first = MIN(n, LOG_RING_SIZE - off);
+    memcpy(dest, log_ring + off, first);
+    memcpy((uint8_t *)dest + first, log_ring, n - first);
+}
+
+static void log_ring_write(size_t pos, const void *src, size_t n) {
+    size_t off = pos % LOG_RING_SIZE;
+    size_t first = MIN(n, LOG_RING_SIZE - off);
+    memcpy(log_ring + off, src, first);
+    memcpy(log_ring, (const uint8_t *)src + first, n - first);
+}
+
+// same filtering order as the terminal output, ansi sequences are removed first when colors are off
+static void log_write_record(const char *text, uint8_t flags) {
+    char buffer[MAX_PRINT_BUFFER];
+    char buffer2[MAX_PRINT_BUFFER];
+    if (flags & LOG_RECORD_ANSI_FIRST) {
+        memcpy_filter_ansi(buffer, text, strlen(text) + 1, true);
+        memcpy_filter_emoji(buffer2, buffer, strlen(buffer) + 1, EMO_ALTTEXT);
+    } else {
+        memcpy_filter_emoji(buffer, text, strlen(text) + 1, EMO_ALTTEXT);
+        memcpy_filter_ansi(buffer2, buffer, strlen(buffer) + 1, true);
+    }
+    fputs(buffer2, logfile);
+    if (flags & LOG_RECORD_LINEFEED)
+        fputc('\n', logfile);
+}
+
+static void *log_writer(void *arg) {
+    (void)arg;
+    char text[MAX_PRINT_BUFFER];
+    uint32_t idle_ms = 0;
+
+    while (true) {
+        size_t tail = log_tail;
+        size_t head = __atomic_load_n(&log_head, __ATOMIC_ACQUIRE);
+
+        if (tail != head) {
+            uint8_t hdr[LOG_RECORD_HDR];
+            log_ring_read(tail, hdr, sizeof(hdr));
+            uint16_t len = (hdr[0] << 8) | hdr[1];
+            log_ring_read(tail + LOG_RECORD_HDR, text, len);
+            text[len] = '\0';
+            log_write_record(text, hdr[2]);
+            __atomic_store_n(&log_tail, tail + LOG_RECORD_HDR + len, __ATOMIC_RELEASE);
+            idle_ms = 0;
+            continue;
+        }
+
+        // keep polling a little while, to batch bursts of output into a single flush
+        if (idle_ms < LOG_FLUSH_IDLE_MS && __atomic_load_n(&log_writer_stop, __ATOMIC_SEQ_CST) == false) {
+            msleep(1);
+            idle_ms++;
+            continue;
+        }
+
+        fflush(logfile);
+
+        pthread_mutex_lock(&log_wait_lock);
+        __atomic_store_n(&log_writer_sleeping, true, __ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&log_head, __ATOMIC_SEQ_CST) == log_tail && __atomic_load_n(&log_writer_stop, __ATOMIC_SEQ_CST) == false) {
+            pthread_cond_wait(&log_wait_cond, &log_wait_lock);
+        }
+        __atomic_store_n(&log_writer_sleeping, false, __ATOMIC_SEQ_CST);
+        bool stop = __atomic_load_n(&log_writer_stop, __ATOMIC_SEQ_CST) && (__atomic_load_n(&log_head, __ATOMIC_SEQ_CST) == log_tail);
+        pthread_mutex_unlock(&log_wait_lock);
+
+        if (stop)
+            break;
+
+        idle_ms = 0;
+    }
+    return NULL;
+}
+
+static void log_writer_wakeup(void) {
+    if (__atomic_load_n(&log_writer_sleeping, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&log_wait_lock);
+        pthread_cond_signal(&log_wait_cond);
+        pthread_mutex_unlock(&log_wait_lock);
+    }
+}
+
+// called with g_print_lock held
+static void log_push(const char *text, uint8_t flags) {
+    size_t len = strlen(text);
+    size_t need = LOG_RECORD_HDR + len;
+    size_t head = log_head;
+
+    // ring full,  wait for the writer to catch up
+    while (LOG_RING_SIZE - (head - __atomic_load_n(&log_tail, __ATOMIC_ACQUIRE)) < need) {
+        log_writer_wakeup();
+        msleep(1);
+    }
+
+    uint8_t hdr[LOG_RECORD_HDR] = { (len >> 8) & 0xFF, len & 0xFF, flags };
+    log_ring_write(head, hdr, sizeof(hdr));
+    log_ring_write(head + LOG_RECORD_HDR, text, len);
+    __atomic_store_n(&log_head, head + need, __ATOMIC_SEQ_CST);
+
+    log_writer_wakeup();
+}
+
+// Wait until the writer has written out everything queued so far and flush the log file
+void FlushSessionLog(void) {
+    if (__atomic_load_n(&log_writer_running, __ATOMIC_SEQ_CST) == false)
+        return;
+
+    size_t head = __atomic_load_n(&log_head, __ATOMIC_SEQ_CST);
+    log_writer_wakeup();
+    while (__atomic_load_n(&log_tail, __ATOMIC_ACQUIRE) != head) {
+        msleep(1);
+    }
+    fflush(logfile);
+}
+
+static void log_writer_shutdown(void) {
+    pthread_mutex_lock(&g_print_lock);
+    if (log_writer_running) {
+        pthread_mutex_lock(&log_wait_lock);
+        __atomic_store_n(&log_writer_stop, true, __ATOMIC_SEQ_CST);
+        pthread_cond_signal(&log_wait_cond);
+        pthread_mutex_unlock(&log_wait_lock);
+        pthread_join(log_writer_thread, NULL);
+        __atomic_store_n(&log_writer_running, false, __ATOMIC_SEQ_CST);
+    }
+    // any late prints are written directly
+    if (logfile)
+        fflush(logfile);
+    pthread_mutex_unlock(&g_print_lock);
+}
+
 static void fPrintAndLog(FILE *stream, const char *fmt, ...) {
     va_list argptr;
-    static FILE *logfile = NULL;
     static int logging = 1;
-    char buffer[MAX_PRINT_BUFFER] = {0};
-    char buffer2[MAX_PRINT_BUFFER] = {0};
-    char buffer3[MAX_PRINT_BUFFER] = {0};
+    char buffer[MAX_PRINT_BUFFER];
+    char buffer2[MAX_PRINT_BUFFER];
+    char buffer3[MAX_PRINT_BUFFER];
     // lock this section to avoid interlacing prints from different threads
     pthread_mutex_lock(&g_print_lock);
     bool linefeed = true;
@@ -343,6 +501,10 @@ static void fPrintAndLog(FILE *stream, const char *fmt, ...) {
                     printf("[=] Session log %s\n", my_logfile_path);
                 }
 
+                if (pthread_create(&log_writer_thread, NULL, log_writer, NULL) == 0) {
+                    __atomic_store_n(&log_writer_running, true, __ATOMIC_SEQ_CST);
+                    atexit(log_writer_shutdown);
+                }
             }
             free(my_logfile_path);
         }
@@ -374,10 +536,9 @@ static void fPrintAndLog(FILE *stream, const char *fmt, ...) {
         linefeed = false;
         buffer[strlen(buffer) - 1] = 0;
     }
-    bool filter_ansi = !g_session.supports_colors;
-    memcpy_filter_ansi(buffer2, buffer, sizeof(buffer), filter_ansi);
     if (g_printAndLog & PRINTANDLOG_PRINT) {
-        memcpy_filter_emoji(buffer3, buffer2, sizeof(buffer2), g_session.emoji_mode);
+        memcpy_filter_ansi(buffer2, buffer, strlen(buffer) + 1, !g_session.supports_colors);
+        memcpy_filter_emoji(buffer3, buffer2, strlen(buffer2) + 1, g_session.emoji_mode);
         fprintf(stream, "%s", buffer3);
         if (linefeed)
             fprintf(stream, "\n");
@@ -395,16 +556,12 @@ static void fPrintAndLog(FILE *stream, const char *fmt, ...) {
 #endif
 
     if ((g_printAndLog & PRINTANDLOG_LOG) && logging && logfile) {
-        memcpy_filter_emoji(buffer3, buffer2, sizeof(buffer2), EMO_ALTTEXT);
-        if (filter_ansi) { // already done
-            fprintf(logfile, "%s", buffer3);
+        uint8_t flags = (linefeed ? LOG_RECORD_LINEFEED : 0) | (g_session.supports_colors ? 0 : LOG_RECORD_ANSI_FIRST);
+        if (log_writer_running) {
+            log_push(buffer, flags);
         } else {
-            memcpy_filter_ansi(buffer, buffer3, sizeof(buffer3), true);
-            fprintf(logfile, "%s", buffer);
+            log_write_record(buffer, flags);
         }
-        if (linefeed)
-            fprintf(logfile, "\n");
-        fflush(logfile);
     }
 
     if (flushAfterWrite)
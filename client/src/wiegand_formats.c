@@ -17,6 +17,7 @@
 //-----------------------------------------------------------------------------
 #include "wiegand_formats.h"
 #include <stdlib.h>
+#include <ctype.h>
 #include "commonutil.h"
 
 
@@ -1412,6 +1413,94 @@ static const cardformat_t FormatTable[] = {
     {NULL, NULL, NULL, NULL, {0, 0, 0, 0, 0}} // Must null terminate array
 };
 
+// Lookup structures built once from FormatTable.
+// Every unpack accepts a single bit length, probed by packing an empty card and then checking that
+// no other length is accepted. Formats that fail the probe are tried for every length.
+#define HID_MAX_BITS        96
+#define HID_NAME_HASH_SIZE  128
+#define HID_FORMAT_COUNT    (ARRAYLEN(FormatTable) - 1)
+
+static bool hid_index_ready = false;
+static uint16_t hid_len_offset[HID_MAX_BITS + 3];                    // bucket HID_MAX_BITS + 1 holds longer messages
+static uint8_t hid_len_list[(HID_MAX_BITS + 2) * HID_FORMAT_COUNT];  // format indexes,  table order within a bucket
+static int8_t hid_name_hash[HID_NAME_HASH_SIZE];
+
+static uint8_t hid_probe_length(int idx) {
+    wiegand_card_t card;
+    wiegand_message_t packed;
+    memset(&card, 0, sizeof(wiegand_card_t));
+    memset(&packed, 0, sizeof(wiegand_message_t));
+
+    if (FormatTable[idx].Pack(&card, &packed, false) == false)
+        return 0;
+
+    uint8_t len = packed.Length;
+    if (len == 0 || len > HID_MAX_BITS || FormatTable[idx].Unpack(&packed, &card) == false)
+        return 0;
+
+    for (int i = 0; i <= HID_MAX_BITS + 1; i++) {
+        packed.Length = i;
+        if (i != len && FormatTable[idx].Unpack(&packed, &card))
+            return 0;
+    }
+    return len;
+}
+
+// FNV-1a over the lower case name. Returns false if the name is too long to be a format name
+static bool hid_name_key(const char *name, char *lower, size_t lowerlen, uint32_t *hash) {
+    uint32_t h = 2166136261u;
+    size_t i = 0;
+    for (; name[i]; i++) {
+        if (i + 1 >= lowerlen)
+            return false;
+        lower[i] = tolower((uint8_t)name[i]);
+        h = (h ^ (uint8_t)lower[i]) * 16777619u;
+    }
+    lower[i] = '\0';
+    *hash = h;
+    return true;
+}
+
+static bool hid_name_equal(const char *lower, const char *name) {
+    for (; *lower && *name; lower++, name++) {
+        if (*lower != tolower((uint8_t)*name))
+            return false;
+    }
+    return (*lower == *name);
+}
+
+static void hid_build_index(void) {
+    if (hid_index_ready)
+        return;
+
+    uint8_t bits[HID_FORMAT_COUNT];
+    for (int i = 0; i < HID_FORMAT_COUNT; i++) {
+        bits[i] = hid_probe_length(i);
+    }
+
+    uint16_t n = 0;
+    for (int len = 0; len <= HID_MAX_BITS + 1; len++) {
+        hid_len_offset[len] = n;
+        for (int i = 0; i < HID_FORMAT_COUNT; i++) {
+            if (bits[i] == 0 || (bits[i] == len && len <= HID_MAX_BITS))
+                hid_len_list[n++] = i;
+        }
+    }
+    hid_len_offset[HID_MAX_BITS + 2] = n;
+
+    memset(hid_name_hash, -1, sizeof(hid_name_hash));
+    for (int i = 0; i < HID_FORMAT_COUNT; i++) {
+        char lower[32];
+        uint32_t h = 0;
+        if (hid_name_key(FormatTable[i].Name, lower, sizeof(lower), &h) == false)
+            continue;
+        while (hid_name_hash[h % HID_NAME_HASH_SIZE] != -1)
+            h++;
+        hid_name_hash[h % HID_NAME_HASH_SIZE] = i;
+    }
+    hid_index_ready = true;
+}
+
 void HIDListFormats(void) {
     if (FormatTable[0].Name == NULL)
         return;
@@ -1441,27 +1530,18 @@ cardformat_t HIDGetCardFormat(int idx) {
 }
 
 int HIDFindCardFormat(const char *format) {
+    hid_build_index();
 
-    char *s = str_dup(format);
-    str_lower(s);
-
-    int i = 0;
-    while (FormatTable[i].Name) {
-
-        char *a = str_dup(FormatTable[i].Name);
-        str_lower(a);
+    char lower[32];
+    uint32_t h = 0;
+    if (hid_name_key(format, lower, sizeof(lower), &h) == false)
+        return -1;
 
-        if (strcmp(a, s) == 0) {
-            free(a);
-            free(s);
+    for (; hid_name_hash[h % HID_NAME_HASH_SIZE] != -1; h++) {
+        int i = hid_name_hash[h % HID_NAME_HASH_SIZE];
+        if (hid_name_equal(lower, FormatTable[i].Name))
             return i;
-        }
-
-        free(a);
-        ++i;
     }
-
-    free(s);
     return -1;
 }
 
@@ -1494,25 +1574,38 @@ void HIDPackTryAll(wiegand_card_t *card, bool preamble) {
     PrintAndLogEx(NORMAL, "");
 }
 
+// formats whose unpack accepts the message,  in table order. Only the formats of the message bit length are tried.
+// returns the number of matches,  at most max
+int HIDUnpackFormats(wiegand_message_t *packed, int *idx, wiegand_card_t *cards, int max) {
+    hid_build_index();
+
+    uint8_t len = (packed->Length <= HID_MAX_BITS) ? packed->Length : HID_MAX_BITS + 1;
+    int found = 0;
+    for (uint16_t n = hid_len_offset[len]; n < hid_len_offset[len + 1] && found < max; n++) {
+        int i = hid_len_list[n];
+        if (FormatTable[i].Unpack(packed, &cards[found])) {
+            idx[found++] = i;
+        }
+    }
+    return found;
+}
+
 bool HIDTryUnpack(wiegand_message_t *packed) {
     if (FormatTable[0].Name == NULL)
         return false;
 
-    int i = 0;
-    wiegand_card_t card;
-    memset(&card, 0, sizeof(wiegand_card_t));
+    int idx[HID_FORMAT_COUNT];
+    wiegand_card_t cards[HID_FORMAT_COUNT];
     uint8_t found_cnt = 0, found_invalid_par = 0;
 
-    while (FormatTable[i].Name) {
-        if (FormatTable[i].Unpack(packed, &card)) {
+    int found = HIDUnpackFormats(packed, idx, cards, HID_FORMAT_COUNT);
+    for (int n = 0; n < found; n++) {
 
-            found_cnt++;
-            hid_print_card(&card, FormatTable[i]);
+        found_cnt++;
+        hid_print_card(&cards[n], FormatTable[idx[n]]);
 
-            if (FormatTable[i].Fields.hasParity || card.ParityValid == false)
-                found_invalid_par++;
-        }
-        ++i;
+        if (FormatTable[idx[n]].Fields.hasParity || cards[n].ParityValid == false)
+            found_invalid_par++;
     }
 
     if (found_cnt) {
@@ -1534,3 +1627,94 @@ void HIDUnpack(int idx, wiegand_message_t *packed) {
         hid_print_card(&card, FormatTable[idx]);
     }
 }
+
+// the plain walk over FormatTable,  reference for the self test
+static int hid_unpack_linear(wiegand_message_t *packed, int *idx, wiegand_card_t *cards) {
+    int found = 0;
+    for (int i = 0; FormatTable[i].Name; i++) {
+        if (FormatTable[i].Unpack(packed, &cards[found])) {
+            idx[found++] = i;
+        }
+    }
+    return found;
+}
+
+static bool hid_compare_unpack(wiegand_message_t *packed) {
+    int idx_a[HID_FORMAT_COUNT], idx_b[HID_FORMAT_COUNT];
+    wiegand_card_t cards_a[HID_FORMAT_COUNT], cards_b[HID_FORMAT_COUNT];
+
+    int a = HIDUnpackFormats(packed, idx_a, cards_a, HID_FORMAT_COUNT);
+    int b = hid_unpack_linear(packed, idx_b, cards_b);
+    if (a != b)
+        return false;
+
+    for (int n = 0; n < a; n++) {
+        if (idx_a[n] != idx_b[n] || memcmp(&cards_a[n], &cards_b[n], sizeof(wiegand_card_t)) != 0)
+            return false;
+    }
+    return true;
+}
+
+// indexed unpack and name lookup against walking the whole table,  for every format and bit length
+bool HIDSelfTest(void) {
+    hid_build_index();
+
+    bool res = true;
+    int indexed = 0;
+    uint32_t lfsr = 0x5EED1234;
+
+    for (int i = 0; i < HID_FORMAT_COUNT && res; i++) {
+        if (hid_probe_length(i))
+            indexed++;
+
+        // name lookup in any case
+        char name[32] = {0};
+        strncpy(name, FormatTable[i].Name, sizeof(name) - 1);
+        res = (HIDFindCardFormat(name) == i);
+        str_lower(name);
+        res = res && (HIDFindCardFormat(name) == i);
+        for (char *c = name; *c; c++)
+            *c = toupper((uint8_t)*c);
+        res = res && (HIDFindCardFormat(name) == i);
+
+        // packed cards of the format,  with and without preamble
+        for (int v = 0; v < 16 && res; v++) {
+            lfsr = lfsr * 1103515245 + 12345;
+            wiegand_card_t card = {
+                .FacilityCode = (v & 1) ? (lfsr >> 8) & 0xFF : v,
+                .CardNumber = (v & 2) ? (lfsr >> 4) & 0xFFFF : v,
+                .IssueLevel = v & 3,
+                .OEM = v & 7,
+            };
+            wiegand_message_t packed;
+            memset(&packed, 0, sizeof(wiegand_message_t));
+            if (FormatTable[i].Pack(&card, &packed, (v & 4)) == false)
+                continue;
+
+            res = hid_compare_unpack(&packed);
+        }
+    }
+    PrintAndLogEx(INFO, "formats %u, indexed by bit length %d", (unsigned)HID_FORMAT_COUNT, indexed);
+    PrintAndLogEx(res ? SUCCESS : FAILED, "packed cards and name lookup ( %s )", res ? _GREEN_("ok") : _RED_("fail"));
+
+    // random messages of every length
+    bool rnd = true;
+    for (int len = 0; len <= HID_MAX_BITS + 1 && rnd; len++) {
+        for (int v = 0; v < 64 && rnd; v++) {
+            uint32_t w[3];
+            for (int j = 0; j < 3; j++) {
+                lfsr = lfsr * 1103515245 + 12345;
+                w[j] = (lfsr >> 16) | (lfsr << 16);
+            }
+            wiegand_message_t packed = initialize_message_object(w[0], w[1], w[2], len);
+            packed.Length = len;
+            rnd = hid_compare_unpack(&packed);
+        }
+    }
+    PrintAndLogEx(rnd ? SUCCESS : FAILED, "random messages, all lengths ( %s )", rnd ? _GREEN_("ok") : _RED_("fail"));
+
+    res = res && rnd && (HIDFindCardFormat("nonexistent") == -1) && (HIDFindCardFormat("") == -1);
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(res ? SUCCESS : FAILED, "Tests [ %s ]", res ? _GREEN_("ok") : _RED_("fail"));
+    return res;
+}
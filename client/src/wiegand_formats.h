@@ -52,8 +52,10 @@ int HIDFindCardFormat(const char *format);
 cardformat_t HIDGetCardFormat(int idx);
 bool HIDPack(int format_idx, wiegand_card_t *card, wiegand_message_t *packed, bool preamble);
 bool HIDTryUnpack(wiegand_message_t *packed);
+int HIDUnpackFormats(wiegand_message_t *packed, int *idx, wiegand_card_t *cards, int max);
 void HIDPackTryAll(wiegand_card_t *card, bool preamble);
 void HIDUnpack(int idx, wiegand_message_t *packed);
 void print_wiegand_code(wiegand_message_t *packed);
 void print_desc_wiegand(cardformat_t *fmt, wiegand_message_t *packed);
+bool HIDSelfTest(void);
 #endif
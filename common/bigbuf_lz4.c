@@ -0,0 +1,35 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Compressed BigBuf download,  packing of one packet
+// Built by the firmware and by the client self test,  so both use the same packer
+//-----------------------------------------------------------------------------
+
+#include "bigbuf_lz4.h"
+#include "lz4/lz4.h"
+
+uint32_t bigbuf_lz4_pack(const uint8_t *src, uint32_t len, uint8_t *dst, uint32_t dst_size, uint32_t *block_len) {
+
+    int srclen = len;
+    int clen = LZ4_compress_destSize((const char *)src, (char *)dst, &srclen, dst_size);
+
+    if (clen <= 0 || clen >= srclen) {
+        *block_len = MIN(len, dst_size);
+        return *block_len;
+    }
+
+    *block_len = srclen;
+    return clen;
+}
@@ -0,0 +1,29 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Compressed BigBuf download,  packing of one packet
+//-----------------------------------------------------------------------------
+
+#ifndef __BIGBUF_LZ4_H
+#define __BIGBUF_LZ4_H
+
+#include "common.h"
+
+// Packs the start of src into one lz4 block of at most dst_size bytes.
+// Returns the packet length and sets *block_len to the number of src bytes it holds.
+// When both are equal the block didn't shrink and the packet is src itself, dst is unused.
+uint32_t bigbuf_lz4_pack(const uint8_t *src, uint32_t len, uint8_t *dst, uint32_t dst_size, uint32_t *block_len);
+
+#endif
@@ -19,6 +19,7 @@
 #include "bucketsort.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include "parity.h"
 
 #if !defined LOWMEM && defined __GNUC__
@@ -124,6 +125,53 @@ recover(uint32_t *o_head, uint32_t *o_tail, uint32_t oks,
 
 
 #if !defined(__arm__) || defined(__linux__) || defined(_WIN32) || defined(__APPLE__) // bare metal ARM Proxmark lacks malloc()/free()
+/** init_recovery_tables
+ * split the keystream into an odd and even part and fill the statelists with all states
+ * which could have generated its last 10 bits
+ */
+static void init_recovery_tables(uint32_t ks2, uint32_t *odd_head, uint32_t **odd_tail, uint32_t *oks,
+                                 uint32_t *even_head, uint32_t **even_tail, uint32_t *eks) {
+    int i;
+    *oks = 0;
+    *eks = 0;
+    for (i = 31; i >= 0; i -= 2)
+        *oks = *oks << 1 | BEBIT(ks2, i);
+    for (i = 30; i >= 0; i -= 2)
+        *eks = *eks << 1 | BEBIT(ks2, i);
+
+    // initialize statelists: add all possible states which would result into the rightmost 2 bits of the keystream
+    for (i = 1 << 20; i >= 0; --i) {
+        if (filter(i) == (*oks & 1))
+            *++*odd_tail = i;
+        if (filter(i) == (*eks & 1))
+            *++*even_tail = i;
+    }
+
+    // extend the statelists. Look at the next 8 Bits of the keystream (4 Bit each odd and even):
+    for (i = 0; i < 4; i++) {
+        extend_table_simple(odd_head, odd_tail, (*oks >>= 1) & 1);
+        extend_table_simple(even_head, even_tail, (*eks >>= 1) & 1);
+    }
+}
+
+static bool alloc_buckets(bucket_array_t bucket) {
+    for (int i = 0; i < 2; i++) {
+        for (uint32_t j = 0; j <= 0xff; j++) {
+            bucket[i][j].head = calloc(1, sizeof(uint32_t) << 14);
+            if (!bucket[i][j].head) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void free_buckets(bucket_array_t bucket) {
+    for (int i = 0; i < 2; i++)
+        for (uint32_t j = 0; j <= 0xff; j++)
+            free(bucket[i][j].head);
+}
+
 /** lfsr_recovery
  * recover the state of the lfsr given 32 bits of the keystream
  * additionally you can use the in parameter to specify the value
@@ -133,13 +181,9 @@ struct Crypto1State *lfsr_recovery32(uint32_t ks2, uint32_t in) {
     struct Crypto1State *statelist;
     uint32_t *odd_head = 0, *odd_tail = 0, oks = 0;
     uint32_t *even_head = 0, *even_tail = 0, eks = 0;
-    int i;
 
-    // split the keystream into an odd and even part
-    for (i = 31; i >= 0; i -= 2)
-        oks = oks << 1 | BEBIT(ks2, i);
-    for (i = 30; i >= 0; i -= 2)
-        eks = eks << 1 | BEBIT(ks2, i);
+    // allocate memory for out of place bucket_sort
+    bucket_array_t bucket = {{{0}}};
 
     odd_head = odd_tail = calloc(1, sizeof(uint32_t) << 21);
     even_head = even_tail = calloc(1, sizeof(uint32_t) << 21);
@@ -152,31 +196,11 @@ struct Crypto1State *lfsr_recovery32(uint32_t ks2, uint32_t in) {
 
     statelist->odd = statelist->even = 0;
 
-    // allocate memory for out of place bucket_sort
-    bucket_array_t bucket;
-
-    for (i = 0; i < 2; i++) {
-        for (uint32_t j = 0; j <= 0xff; j++) {
-            bucket[i][j].head = calloc(1, sizeof(uint32_t) << 14);
-            if (!bucket[i][j].head) {
-                goto out;
-            }
-        }
-    }
-
-    // initialize statelists: add all possible states which would result into the rightmost 2 bits of the keystream
-    for (i = 1 << 20; i >= 0; --i) {
-        if (filter(i) == (oks & 1))
-            *++odd_tail = i;
-        if (filter(i) == (eks & 1))
-            *++even_tail = i;
+    if (alloc_buckets(bucket) == false) {
+        goto out;
     }
 
-    // extend the statelists. Look at the next 8 Bits of the keystream (4 Bit each odd and even):
-    for (i = 0; i < 4; i++) {
-        extend_table_simple(odd_head,  &odd_tail, (oks >>= 1) & 1);
-        extend_table_simple(even_head, &even_tail, (eks >>= 1) & 1);
-    }
+    init_recovery_tables(ks2, odd_head, &odd_tail, &oks, even_head, &even_tail, &eks);
 
     // the statelists now contain all states which could have generated the last 10 Bits of the keystream.
     // 22 bits to go to recover 32 bits in total. From now on, we need to take the "in"
@@ -185,14 +209,168 @@ struct Crypto1State *lfsr_recovery32(uint32_t ks2, uint32_t in) {
     recover(odd_head, odd_tail, oks, even_head, even_tail, eks, 11, statelist, in << 1, bucket);
 
 out:
-    for (i = 0; i < 2; i++)
-        for (uint32_t j = 0; j <= 0xff; j++)
-            free(bucket[i][j].head);
+    free_buckets(bucket);
     free(odd_head);
     free(even_head);
     return statelist;
 }
 
+/** lfsr_recovery32 split into jobs
+ * The first round of recover() is done up front. Every pair of intersecting buckets it leaves
+ * is an independent job, working on a copy of its part of the tables in a private arena.
+ * Collecting the jobs in reverse order gives the same list as lfsr_recovery32().
+ */
+struct lfsr_recovery32_arena {
+    uint32_t *odd;
+    uint32_t *even;
+    struct Crypto1State *sl;
+    bucket_array_t bucket;
+};
+
+struct lfsr_recovery32_jobs {
+    uint32_t *odd_head;
+    uint32_t *even_head;
+    uint32_t oks, eks, in;
+    int rem;
+    bucket_info_t bucket_info;
+    struct Crypto1State *results[0x100];
+    uint32_t result_len[0x100];
+};
+
+lfsr_recovery32_arena_t *lfsr_recovery32_arena_new(void) {
+    lfsr_recovery32_arena_t *arena = calloc(1, sizeof(lfsr_recovery32_arena_t));
+    if (!arena)
+        return 0;
+
+    arena->odd = calloc(1, sizeof(uint32_t) << 21);
+    arena->even = calloc(1, sizeof(uint32_t) << 21);
+    arena->sl = calloc(1, sizeof(struct Crypto1State) << 18);
+    if (!arena->odd || !arena->even || !arena->sl || alloc_buckets(arena->bucket) == false) {
+        lfsr_recovery32_arena_free(arena);
+        return 0;
+    }
+    return arena;
+}
+
+void lfsr_recovery32_arena_free(lfsr_recovery32_arena_t *arena) {
+    if (!arena)
+        return;
+    free_buckets(arena->bucket);
+    free(arena->odd);
+    free(arena->even);
+    free(arena->sl);
+    free(arena);
+}
+
+lfsr_recovery32_jobs_t *lfsr_recovery32_jobs_new(uint32_t ks2, uint32_t in) {
+    lfsr_recovery32_jobs_t *jobs = calloc(1, sizeof(lfsr_recovery32_jobs_t));
+    if (!jobs)
+        return 0;
+
+    uint32_t *odd_tail, *even_tail;
+    jobs->odd_head = odd_tail = calloc(1, sizeof(uint32_t) << 21);
+    jobs->even_head = even_tail = calloc(1, sizeof(uint32_t) << 21);
+    bucket_array_t bucket = {{{0}}};
+    if (!odd_tail-- || !even_tail-- || alloc_buckets(bucket) == false) {
+        free_buckets(bucket);
+        lfsr_recovery32_jobs_free(jobs);
+        return 0;
+    }
+
+    init_recovery_tables(ks2, jobs->odd_head, &odd_tail, &jobs->oks, jobs->even_head, &even_tail, &jobs->eks);
+
+    in = (in >> 16 & 0xff) | (in << 16) | (in & 0xff00); // Byte swapping
+    in <<= 1;
+
+    // first round of recover(), rem = 11
+    int rem = 11;
+    for (uint32_t i = 0; i < 4 && rem--; i++) {
+        jobs->oks >>= 1;
+        jobs->eks >>= 1;
+        in >>= 2;
+        extend_table(jobs->odd_head, &odd_tail, jobs->oks & 1, LF_POLY_EVEN << 1 | 1, LF_POLY_ODD << 1, 0);
+        if (jobs->odd_head > odd_tail)
+            break;
+
+        extend_table(jobs->even_head, &even_tail, jobs->eks & 1, LF_POLY_ODD, LF_POLY_EVEN << 1 | 1, in & 3);
+        if (jobs->even_head > even_tail)
+            break;
+    }
+    jobs->in = in;
+    jobs->rem = rem;
+
+    if (jobs->odd_head <= odd_tail && jobs->even_head <= even_tail)
+        bucket_sort_intersect(jobs->even_head, even_tail, jobs->odd_head, odd_tail, &jobs->bucket_info, bucket);
+
+    free_buckets(bucket);
+    return jobs;
+}
+
+uint32_t lfsr_recovery32_jobs_count(const lfsr_recovery32_jobs_t *jobs) {
+    return jobs->bucket_info.numbuckets;
+}
+
+bool lfsr_recovery32_job_run(lfsr_recovery32_jobs_t *jobs, uint32_t job, lfsr_recovery32_arena_t *arena) {
+    if (job >= jobs->bucket_info.numbuckets)
+        return false;
+
+    uint32_t *o_head = jobs->bucket_info.bucket_info[1][job].head;
+    uint32_t *o_tail = jobs->bucket_info.bucket_info[1][job].tail;
+    uint32_t *e_head = jobs->bucket_info.bucket_info[0][job].head;
+    uint32_t *e_tail = jobs->bucket_info.bucket_info[0][job].tail;
+    size_t olen = o_tail - o_head + 1;
+    size_t elen = e_tail - e_head + 1;
+    memcpy(arena->odd, o_head, olen * sizeof(uint32_t));
+    memcpy(arena->even, e_head, elen * sizeof(uint32_t));
+
+    arena->sl->odd = arena->sl->even = 0;
+    struct Crypto1State *sl = recover(arena->odd, arena->odd + olen - 1, jobs->oks,
+                                      arena->even, arena->even + elen - 1, jobs->eks,
+                                      jobs->rem, arena->sl, jobs->in, arena->bucket);
+
+    uint32_t len = sl - arena->sl;
+    jobs->result_len[job] = len;
+    if (len) {
+        jobs->results[job] = malloc(len * sizeof(struct Crypto1State));
+        if (!jobs->results[job]) {
+            jobs->result_len[job] = 0;
+            return false;
+        }
+        memcpy(jobs->results[job], arena->sl, len * sizeof(struct Crypto1State));
+    }
+    return true;
+}
+
+struct Crypto1State *lfsr_recovery32_jobs_collect(lfsr_recovery32_jobs_t *jobs) {
+    size_t total = 0;
+    for (uint32_t i = 0; i < jobs->bucket_info.numbuckets; i++)
+        total += jobs->result_len[i];
+
+    struct Crypto1State *statelist = calloc(total + 1, sizeof(struct Crypto1State));
+    if (!statelist)
+        return 0;
+
+    struct Crypto1State *sl = statelist;
+    for (int i = jobs->bucket_info.numbuckets - 1; i >= 0; i--) {
+        if (jobs->result_len[i]) {
+            memcpy(sl, jobs->results[i], jobs->result_len[i] * sizeof(struct Crypto1State));
+            sl += jobs->result_len[i];
+        }
+    }
+    sl->odd = sl->even = 0;
+    return statelist;
+}
+
+void lfsr_recovery32_jobs_free(lfsr_recovery32_jobs_t *jobs) {
+    if (!jobs)
+        return;
+    for (uint32_t i = 0; i < 0x100; i++)
+        free(jobs->results[i]);
+    free(jobs->odd_head);
+    free(jobs->even_head);
+    free(jobs);
+}
+
 static const uint32_t S1[] = {     0x62141, 0x310A0, 0x18850, 0x0C428, 0x06214,
                                    0x0310A, 0x85E30, 0xC69AD, 0x634D6, 0xB5CDE, 0xDE8DA, 0x6F46D, 0xB3C83,
                                    0x59E41, 0xA8995, 0xD027F, 0x6813F, 0x3409F, 0x9E6FA
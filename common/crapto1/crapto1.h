@@ -36,6 +36,19 @@ uint32_t prng_successor(uint32_t x, uint32_t n);
 
 #if !defined(__arm__) || defined(__linux__) || defined(_WIN32) || defined(__APPLE__) // bare metal ARM Proxmark lacks malloc()/free()
 struct Crypto1State *lfsr_recovery32(uint32_t ks2, uint32_t in);
+
+// lfsr_recovery32() as independent jobs, for callers which want to spread it over threads.
+// Each thread needs its own arena, the jobs of one recovery can run in any order.
+typedef struct lfsr_recovery32_jobs lfsr_recovery32_jobs_t;
+typedef struct lfsr_recovery32_arena lfsr_recovery32_arena_t;
+lfsr_recovery32_arena_t *lfsr_recovery32_arena_new(void);
+void lfsr_recovery32_arena_free(lfsr_recovery32_arena_t *arena);
+lfsr_recovery32_jobs_t *lfsr_recovery32_jobs_new(uint32_t ks2, uint32_t in);
+uint32_t lfsr_recovery32_jobs_count(const lfsr_recovery32_jobs_t *jobs);
+bool lfsr_recovery32_job_run(lfsr_recovery32_jobs_t *jobs, uint32_t job, lfsr_recovery32_arena_t *arena);
+struct Crypto1State *lfsr_recovery32_jobs_collect(lfsr_recovery32_jobs_t *jobs);
+void lfsr_recovery32_jobs_free(lfsr_recovery32_jobs_t *jobs);
+
 struct Crypto1State *lfsr_recovery64(uint32_t ks2, uint32_t ks3);
 struct Crypto1State *
 lfsr_common_prefix(uint32_t pfx, uint32_t rr, uint8_t ks[8], uint8_t par[8][8], uint32_t no_par);
@@ -1689,13 +1689,20 @@ int askdemod_ext(uint8_t *bits, size_t *size, int *clk, int *invert, int maxErr,
     int start = DetectASKClock(bits, *size, clk, maxErr);
     if (*clk == 0 || start < 0) return -3;
 
+    return askdemod_clk(bits, size, *clk, start, invert, amp, askType, startIdx);
+}
+
+// askdemod_ext without the clock detection,
+// clk and start are the clock and best starting position as returned by DetectASKClock
+int askdemod_clk(uint8_t *bits, size_t *size, int clk, int start, int *invert, uint8_t amp, uint8_t askType, int *startIdx) {
+
     if (*invert != 1) *invert = 0;
 
     // amplify signal data.
     // ICEMAN todo,
     if (amp == 1) askAmp(bits, *size);
 
-    if (g_debugMode == 2) prnt("DEBUG (askdemod_ext) clk %d, beststart %d, amp %d", *clk, start, amp);
+    if (g_debugMode == 2) prnt("DEBUG (askdemod_clk) clk %d, beststart %d, amp %d", clk, start, amp);
 
     // Detect high and lows
     //25% clip in case highs and lows aren't clipped [marshmellow]
@@ -1708,41 +1715,41 @@ int askdemod_ext(uint8_t *bits, size_t *size, int *clk, int *invert, int maxErr,
 
         //start pos from detect ask clock is 1/2 clock offset
         // NOTE: can be negative (demod assumes rest of wave was there)
-        *startIdx = start - (*clk / 2);
-        if (g_debugMode == 2) prnt("DEBUG: (askdemod_ext) Clean wave detected  --- startindex %d", *startIdx);
+        *startIdx = start - (clk / 2);
+        if (g_debugMode == 2) prnt("DEBUG: (askdemod_clk) Clean wave detected  --- startindex %d", *startIdx);
 
-        errCnt = cleanAskRawDemod(bits, size, *clk, *invert, high, low, startIdx);
+        errCnt = cleanAskRawDemod(bits, size, clk, *invert, high, low, startIdx);
 
         if (askType) { //ask/manchester
             uint8_t alignPos = 0;
             errCnt = manrawdecode(bits, size, 0, &alignPos);
-            *startIdx += ((*clk / 2) * alignPos);
+            *startIdx += ((clk / 2) * alignPos);
 
-            if (g_debugMode == 2) prnt("DEBUG: (askdemod_ext) CLEAN: startIdx %i, alignPos %u , bestError %zu", *startIdx, alignPos, errCnt);
+            if (g_debugMode == 2) prnt("DEBUG: (askdemod_clk) CLEAN: startIdx %i, alignPos %u , bestError %zu", *startIdx, alignPos, errCnt);
         }
         return errCnt;
     }
 
-    *startIdx = start - (*clk / 2);
-    if (g_debugMode == 2) prnt("DEBUG: (askdemod_ext) Weak wave detected: startIdx %i", *startIdx);
+    *startIdx = start - (clk / 2);
+    if (g_debugMode == 2) prnt("DEBUG: (askdemod_clk) Weak wave detected: startIdx %i", *startIdx);
 
     int lastBit;              // set first clock check - can go negative
     size_t i, bitnum = 0;     // output counter
     uint8_t midBit = 0;
     uint8_t tol = 0;          // clock tolerance adjust - waves will be accepted as within the clock if they fall + or - this value + clock from last valid wave
-    if (*clk <= 32) tol = 1;  // clock tolerance may not be needed anymore currently set to + or - 1 but could be increased for poor waves or removed entirely
+    if (clk <= 32) tol = 1;  // clock tolerance may not be needed anymore currently set to + or - 1 but could be increased for poor waves or removed entirely
     size_t MaxBits = 3072;    // max bits to collect
-    lastBit = start - *clk;
+    lastBit = start - clk;
 
     for (i = start; i < *size; ++i) {
-        if (i - lastBit >= *clk - tol) {
+        if (i - lastBit >= clk - tol) {
             if (bits[i] >= high) {
                 bits[bitnum++] = *invert;
             } else if (bits[i] <= low) {
                 bits[bitnum++] = *invert ^ 1;
-            } else if (i - lastBit >= *clk + tol) {
+            } else if (i - lastBit >= clk + tol) {
                 if (bitnum > 0) {
-//                    if (g_debugMode == 2) prnt("DEBUG: (askdemod_ext) Modulation Error at: %u", i);
+//                    if (g_debugMode == 2) prnt("DEBUG: (askdemod_clk) Modulation Error at: %u", i);
                     bits[bitnum++] = 7;
                     errCnt++;
                 }
@@ -1750,13 +1757,13 @@ int askdemod_ext(uint8_t *bits, size_t *size, int *clk, int *invert, int maxErr,
                 continue;
             }
             midBit = 0;
-            lastBit += *clk;
-        } else if (i - lastBit >= (*clk / 2 - tol) && !midBit && !askType) {
+            lastBit += clk;
+        } else if (i - lastBit >= (clk / 2 - tol) && !midBit && !askType) {
             if (bits[i] >= high) {
                 bits[bitnum++] = *invert;
             } else if (bits[i] <= low) {
                 bits[bitnum++] = *invert ^ 1;
-            } else if (i - lastBit >= *clk / 2 + tol) {
+            } else if (i - lastBit >= clk / 2 + tol) {
                 if (bitnum > 0) {
                     bits[bitnum] = bits[bitnum - 1];
                     bitnum++;
@@ -50,6 +50,7 @@ size_t pskFindFirstPhaseShift(const uint8_t *samples, size_t size, uint8_t *curP
 size_t addParity(const uint8_t *src, uint8_t *dest, uint8_t sourceLen, uint8_t pLen, uint8_t pType);
 int askdemod(uint8_t *bits, size_t *size, int *clk, int *invert, int maxErr, uint8_t amp, uint8_t askType);
 int askdemod_ext(uint8_t *bits, size_t *size, int *clk, int *invert, int maxErr, uint8_t amp, uint8_t askType, int *startIdx);
+int askdemod_clk(uint8_t *bits, size_t *size, int clk, int start, int *invert, uint8_t amp, uint8_t askType, int *startIdx);
 void askAmp(uint8_t *bits, size_t size);
 int BiphaseRawDecode(uint8_t *bits, size_t *size, int *offset, int invert);
 int bits_to_array(const uint8_t *bits, size_t size, uint8_t *dest);
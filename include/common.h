@@ -34,6 +34,7 @@
 #define PYTHON_SCRIPTS_SUBDIR "pyscripts" PATHSEP
 #define CMD_SCRIPTS_SUBDIR   "cmdscripts" PATHSEP
 #define DICTIONARIES_SUBDIR  "dictionaries" PATHSEP
+#define DICTIONARY_CACHE_SUBDIR "dictionary_cache" PATHSEP
 #define LUA_LIBRARIES_SUBDIR "lualibs" PATHSEP
 #define LUA_SCRIPTS_SUBDIR   "luascripts" PATHSEP
 #define RESOURCES_SUBDIR     "resources" PATHSEP
@@ -205,10 +205,19 @@ typedef struct {
     // rdv4
     bool hw_available_flash            : 1;
     bool hw_available_smartcard        : 1;
+
+    // new fields go last,  earlier ones keep their place
+    bool compiled_with_bigbuf_lz4      : 1;
+    bool compiled_with_mf_dump_sectors : 1;
 } PACKED capabilities_t;
-#define CAPABILITIES_VERSION 6
+#define CAPABILITIES_VERSION 8
 extern capabilities_t g_pm3_capabilities;
 
+// For CMD_DOWNLOAD_BIGBUF, arg2 flags
+// With BIGBUF_DL_LZ4 each CMD_DOWNLOADED_BIGBUF packet holds an independent lz4 block,
+// arg0 = offset,  arg1 = packet length,  arg2 = uncompressed length.  arg1 == arg2 means stored as is.
+#define BIGBUF_DL_LZ4           0x01
+
 // For CMD_LF_T55XX_WRITEBL
 typedef struct {
     uint32_t data;
@@ -223,6 +232,20 @@ typedef struct {
     uint32_t time;
 } PACKED t55xx_test_block_t;
 
+// For CMD_LF_T55XX_SWEEP_PWDS
+#define T55XX_SWEEP_MAX_PWDS    16
+#define T55XX_SWEEP_SAMPLES     6144
+typedef struct {
+    uint8_t flags;      // downlink mode << 3
+    uint8_t count;
+    uint32_t pwds[T55XX_SWEEP_MAX_PWDS];
+} PACKED t55xx_sweep_pwds_t;
+
+typedef struct {
+    uint8_t count;      // passwords tried, their block 0 reads follow each other
+    uint32_t offset;    // BigBuf offset of the first read
+} PACKED t55xx_sweep_reply_t;
+
 // For CMD_LF_HID_SIMULATE (FSK)
 typedef struct {
     uint32_t hi2;
@@ -279,6 +302,28 @@ typedef struct {
     uint8_t key[6];
 } PACKED mf_readblock_t;
 
+// For CMD_HF_MIFARE_DUMP_SECTORS
+#define MF_DUMP_MAX_SECTORS 40
+// attempts per block, same as the client side block by block dump
+#define MF_DUMP_BLOCK_RETRY 10
+typedef struct {
+    uint8_t first_sector;
+    uint8_t sector_count;
+    uint8_t keys[MF_DUMP_MAX_SECTORS][2][6];   // [sector][A/B][key]
+} PACKED mf_dump_sectors_t;
+
+// one sector record, followed by 16 bytes per block of the sector
+typedef struct {
+    uint8_t sector;
+    uint16_t read_mask;                         // bit n set = block n of the sector was read
+} PACKED mf_dump_sector_hdr_t;
+
+typedef struct {
+    uint8_t last;                               // last packet of the dump
+    uint8_t count;                              // number of sector records in data
+    uint8_t data[PM3_CMD_DATA_SIZE - 2];
+} PACKED mf_dump_sectors_resp_t;
+
 typedef struct {
     uint8_t sectorcnt;
     uint8_t keytype;
@@ -354,6 +399,7 @@ typedef struct {
 #define CMD_START_FLASH                                                   0x0005
 #define CMD_CHIP_INFO                                                     0x0006
 #define CMD_BL_VERSION                                                    0x0007
+#define CMD_BL_PAGE_CRC                                                   0x0008
 #define CMD_NACK                                                          0x00fe
 #define CMD_ACK                                                           0x00ff
 
@@ -500,6 +546,7 @@ typedef struct {
 
 #define CMD_LF_T55XX_CHK_PWDS                                             0x0230
 #define CMD_LF_T55XX_DANGERRAW                                            0x0231
+#define CMD_LF_T55XX_SWEEP_PWDS                                           0x0233
 
 
 // ZX8211
@@ -621,6 +668,7 @@ typedef struct {
 #define CMD_HF_MIFARE_SETMOD                                              0x0624
 #define CMD_HF_MIFARE_CHKKEYS_FAST                                        0x0625
 #define CMD_HF_MIFARE_CHKKEYS_FILE                                        0x0626
+#define CMD_HF_MIFARE_DUMP_SECTORS                                        0x0627
 
 #define CMD_HF_MIFARE_SNIFF                                               0x0630
 #define CMD_HF_MIFARE_MFKEY                                               0x0631
@@ -815,6 +863,9 @@ typedef struct {
 /* Set if this device understands the version command */
 #define DEVICE_INFO_FLAG_UNDERSTANDS_VERSION         (1<<6)
 
+/* Set if this device understands the page crc command */
+#define DEVICE_INFO_FLAG_UNDERSTANDS_PAGE_CRC        (1<<7)
+
 #define BL_VERSION_MAJOR(version) ((uint32_t)(version) >> 22)
 #define BL_VERSION_MINOR(version) (((uint32_t)(version) >> 12) & 0x3ff)
 #define BL_VERSION_PATCH(version) ((uint32_t)(version) & 0xfff)
@@ -825,6 +876,13 @@ typedef struct {
 #define BL_VERSION_INVALID  0
 // Different versions here. Each version should increase the numbers
 #define BL_VERSION_1_0_0    BL_MAKE_VERSION(1, 0, 0)
+#define BL_VERSION_1_1_0    BL_MAKE_VERSION(1, 1, 0)
+
+/* CMD_BL_PAGE_CRC takes a flash address and a number of 512 bytes blocks
+   (max PM3_CMD_DATA_SIZE / 4) and answers with one CRC-32 per block,
+   so the flasher can skip blocks which already hold the right content */
+#define BL_PAGE_CRC_BLOCK_SIZE  512
+#define BL_PAGE_CRC_MAX_BLOCKS  (PM3_CMD_DATA_SIZE / 4)
 
 
 /* CMD_START_FLASH may have three arguments: start of area to flash,
@@ -1,66 +1,82 @@
 /*
  * ht2crack2buildtable.c
- * This builds the 1.2TB table and sorts it.
+ * This builds the table and sorts it.
+ *
+ * The full table (-k 37) holds 2^37 entries and ends up around 1TB, needing about 1.5TB of
+ * temporary space in the bucket directory while it is built.  Smaller -k values build a
+ * reduced keyspace table, which only finds keys of tags whose PRNG state is within the
+ * first 2^k * 2048 steps of the sequence, see ht2crack2gentest -k.
  */
 
-#include "ht2crackutils.h"
+#include "ht2crack2table.h"
 #include <stdlib.h>
-
-// DATAMAX is the size of each bucket (bytes).  There are 65536 buckets so choose a value such that
-// DATAMAX * 65536 < RAM available.  For ex, if you want to use 12GB of RAM (for a 16GB machine
-// leaving some RAM free for OS and other stuff), DATAMAX = 12GB / 65536 = 196608.  Round this down
-// to a power of 10; DATAMAX = 196600.
-#define DATAMAX 196600 // around 192K rounded down to a power of 10
-
-// NUM_BUILD_THREADS and NUM_SORT_THREADS are the number of threads to run concurrently.  These should
-// ideally be equal to the number of virtual cores you have available.  A quad-core machine will
-// likely have 8 virtual cores, so set them to 8.
-//
-// If sorting fails with a 'bus error' then that is likely because your disk I/O can't keep up with
-// the read/write demands of the multi-threaded sorting.  In this case, reduce the number of sorting
-// threads.  This will most likely only be a problem with network disks; SATA should be okay;
-// USB2/3 should keep up.
-//
-// These MUST be a power of 2 for the maths to work - you have been warned!
-// Also, sort threads MUST be <= build threads or a horrible buffer overflow will happen!
-#define NUM_BUILD_THREADS 8
-#define NUM_SORT_THREADS 8
-
-// DATASIZE is the number of bytes in an entry.  This is 10; 4 bytes of keystream (2 are in the filepath) +
-// 6 bytes of PRNG state.
-#define DATASIZE 10
+#include <getopt.h>
+#include <errno.h>
+#include <inttypes.h>
 
 int debug = 0;
 
+// runtime settings, see usage()
+static int num_build_threads = 8;
+static int num_sort_threads = 8;
+static uint64_t memsize = 1024ULL * 1024ULL * 1024ULL;
+static uint32_t blockentries = 256;
+static const char *tmpdir = "table";
+static const char *outfile = HT2_TABLE_FILE;
+
+static ht2_table_header_t hdr;
+
+// recsize is the number of bytes in an unsorted entry; 6 bytes of keystream + the sample index
+static size_t recsize;
+
+// buckets split the entries on the top bits of the keystream, so each can be sorted in memory
+static uint32_t numbuckets;
+static int bucketbits;
+static size_t bucketmax;
+
+// jump of HT2_TABLE_SPACING steps
+static ht2_jump_t spacingjump;
+
 // table entry for a bucket
 struct table {
-    char path[32];
+    char path[256];
     pthread_mutex_t mutex;
     unsigned char *data;
     unsigned char *ptr;
 };
 
-
 // actual table
 struct table *t;
 
-// jump table 1
-uint64_t d[48];
-int nsteps;
-
-// jump table 2
-uint64_t d2[48];
-int nsteps2;
+// sorted entry
+typedef struct {
+    uint64_t key;
+    uint64_t index;
+} entry_t;
+
+static void usage(void) {
+    printf("ht2crack2buildtable - builds the table for ht2crack2search\n\n");
+    printf(" -t NUM     build threads (defaults to 8)\n");
+    printf(" -s NUM     sort threads (defaults to 8)\n");
+    printf(" -m MB      memory to use for buffers and sorting (defaults to 1024)\n");
+    printf(" -k BITS    table holds 2^BITS entries, %d (default) covers the whole keyspace\n", HT2_TABLE_FULLBITS);
+    printf(" -b NUM     entries per indexed block (defaults to 256)\n");
+    printf(" -d DIR     directory for the unsorted buckets (defaults to table)\n");
+    printf(" -o FILE    table file (defaults to %s)\n", HT2_TABLE_FILE);
+    printf("\nIf sorting fails with a 'bus error' then your disk I/O likely can't keep up with\n");
+    printf("the multi-threaded sorting; reduce the number of sort threads.\n");
+    exit(1);
+}
 
 // create table entry
-static void create_table(struct table *tt, int d_1, int d_2) {
+static void create_table(struct table *tt, int i) {
     if (!tt) {
         printf("create_table: t is NULL\n");
         exit(1);
     }
 
     // create some space
-    tt->data = (unsigned char *)calloc(1, DATAMAX);
+    tt->data = (unsigned char *)calloc(1, bucketmax);
     if (!(tt->data)) {
         printf("create_table: cannot calloc data\n");
         exit(1);
@@ -75,25 +91,21 @@ static void create_table(struct table *tt, int d_1, int d_2) {
         exit(1);
     }
 
-    // create the path
-//    sprintf(tt->path, "/Volumes/2tb/%02X/%02X.bin", d_1 & 0xff, d_2 & 0xff);
-    sprintf(tt->path, "table/%02x/%02x.bin", d_1 & 0xff, d_2 & 0xff);
+    // create the path, leftovers of an earlier run would end up in the table
+    snprintf(tt->path, sizeof(tt->path), "%s/%04x.bin", tmpdir, i);
+    unlink(tt->path);
 }
 
 
 // create all table entries
 static void create_tables(struct table *tt) {
-    int i, j;
-
     if (!tt) {
         printf("create_tables: t is NULL\n");
         exit(1);
     }
 
-    for (i = 0; i < 0x100; i++) {
-        for (j = 0; j < 0x100; j++) {
-            create_table(tt + ((i * 0x100) + j), i, j);
-        }
+    for (uint32_t i = 0; i < numbuckets; i++) {
+        create_table(tt + i, i);
     }
 }
 
@@ -105,13 +117,29 @@ static void free_tables(struct table *tt) {
         exit(1);
     }
 
-    for (int i = 0; i < 0x10000; i++) {
+    for (uint32_t i = 0; i < numbuckets; i++) {
         struct table *ttmp = tt + i;
         free(ttmp->data);
     }
 }
 
 
+// write all of buf at offset, or to the end of the file if offset is -1
+static void writeall(int fd, const unsigned char *buf, size_t len, off_t offset, const char *name) {
+    while (len) {
+        ssize_t res = (offset < 0) ? write(fd, buf, len) : pwrite(fd, buf, len, offset);
+        if (res <= 0) {
+            printf("cannot write all of the data to %s\n", name);
+            exit(1);
+        }
+        buf += res;
+        len -= res;
+        if (offset >= 0) {
+            offset += res;
+        }
+    }
+}
+
 
 // write (partial) table to file
 static void writetable(struct table *t1) {
@@ -120,340 +148,297 @@ static void writetable(struct table *t1) {
     if (debug) printf("writetable %s\n", t1->path);
 
     fd = open(t1->path, O_WRONLY | O_CREAT | O_APPEND, 0644);
-    if (fd <= 0) {
+    if (fd < 0) {
         printf("writetable cannot open file %s for appending\n", t1->path);
         exit(1);
     }
 
-    if (debug) printf("writetable %s opened\n", t1->path);
-
-    if (write(fd, t1->data, t1->ptr - t1->data) < (t1->ptr - t1->data)) {
-        printf("writetable cannot write all of the data\n");
-        exit(1);
-    }
-
-    if (debug) printf("writetable %s written\n", t1->path);
+    writeall(fd, t1->data, t1->ptr - t1->data, -1, t1->path);
 
     close(fd);
 }
 
 
 // store value in table
-static void store(unsigned char *data) {
-    unsigned char d_1, d_2;
-    int offset;
-    struct table *t1;
-
-    // use the first two bytes as an index
-    d_1 = data[0];
-    d_2 = data[1];
-    offset = (d_1 * 0x100) + d_2;
-
-    if (debug) printf("store, d1=%02X, d2=%02X, offset = %d\n", d_1, d_2, offset);
-
-    // get pointer to table entry
-    t1 = t + offset;
+static void store(uint64_t ks, uint64_t index) {
+    struct table *t1 = t + (ks >> (48 - bucketbits));
 
     // wait for a lock on this entry
     if (pthread_mutex_lock(&(t1->mutex))) {
-        printf("store: cannot lock mutex at offset %d\n", offset);
+        printf("store: cannot lock mutex of %s\n", t1->path);
         exit(1);
     }
 
-    if (debug) printf("store, offset = %d, got lock\n", offset);
-
     // store the entry
-    memcpy(t1->ptr, data + 2, 10);
-
-    if (debug) printf("store, offset = %d, copied data\n", offset);
-
-    // update the ptr
-    t1->ptr += 10;
+    writebuf(t1->ptr, ks, 6);
+    writebuf(t1->ptr + 6, index, hdr.indexbytes);
+    t1->ptr += recsize;
 
     // check if table is full
-    if ((t1->ptr - t1->data) >= DATAMAX) {
+    if ((t1->ptr - t1->data) + recsize > bucketmax) {
         // write the table to disk
         writetable(t1);
         // reset ptr
         t1->ptr = t1->data;
     }
 
-    if (debug) printf("store, offset = %d, after possible write\n", offset);
-
     // release the lock
     if (pthread_mutex_unlock(&(t1->mutex))) {
-        printf("store: cannot unlock mutex at offset %d\n", offset);
+        printf("store: cannot unlock mutex of %s\n", t1->path);
         exit(1);
     }
-
-    if (debug) printf("store, offset = %d, unlocked\n", offset);
-
 }
 
-// writes the ks (keystream) and s (state)
-static void write_ks_s(uint32_t ks1, uint32_t ks2, uint64_t shiftreg) {
-    unsigned char buf[16];
 
-    // create buffer
-    writebuf(buf, ks1, 3);
-    writebuf(buf + 3, ks2, 3);
-    writebuf(buf + 6, shiftreg, 6);
-
-    // store buffer
-    store(buf);
-}
-
-
-// builds the di table for jumping
-static void builddi(int steps, int table) {
-    uint64_t statemask;
-    int i;
-    Hitag_State mystate;
-    uint64_t *thisd = NULL;
+// thread to build a part of the table
+static void *buildtable(void *dd) {
+    int index = (int)(long)dd;
 
-    statemask = 1;
+    // each thread makes a consecutive run of samples
+    uint64_t first = (hdr.entries / num_build_threads) * index;
+    uint64_t last = (index == num_build_threads - 1) ? hdr.entries : first + (hdr.entries / num_build_threads);
 
-    // select jump table
-    if (table == 1) {
-        nsteps = steps;
-        thisd = d;
-    } else if (table == 2) {
-        nsteps2 = steps;
-        thisd = d2;
-    } else {
-        printf("builddi: invalid table num\n");
-        exit(1);
+    // jump to the first sample of the run, then from sample to sample
+    uint64_t state = ht2_table_state(&hdr, first);
+    for (uint64_t i = first; i < last; i++) {
+        store(ht2_keystream(state), i);
+        state = ht2_jump(state, &spacingjump);
     }
 
-    // build di states
-    for (i = 0; i < 48; i++) {
-        mystate.shiftreg = statemask;
-        buildlfsr(&mystate);
-        hitag2_nstep(&mystate, steps);
-        thisd[i] = mystate.shiftreg;
-
-        statemask = statemask << 1;
-    }
+    return NULL;
 }
 
-// jump function - quickly jumps a load of steps
-static void jumpnsteps(Hitag_State *hstate, int table) {
-    uint64_t output = 0;
-    uint64_t bitmask;
-    int i;
-    uint64_t *thisd = NULL;
 
-
-    // select jump table
-    if (table == 1) {
-        thisd = d;
-    } else if (table == 2) {
-        thisd = d2;
-    } else {
-        printf("jumpnsteps: invalid table num\n");
+// make 'table/' (unsorted) dir
+static void makedirs(void) {
+    if (mkdir(tmpdir, 0755) && (errno != EEXIST)) {
+        printf("cannot make dir %s\n", tmpdir);
         exit(1);
     }
+}
 
-    // xor all di.si where di is a d state and si is a bit
-    // we do this by multiplying di by si:
-    // if si is 1, di.si = di; if si is 0, di.si = 0
+static int entrycmp(const void *p1, const void *p2) {
+    const entry_t *e1 = (const entry_t *)p1;
+    const entry_t *e2 = (const entry_t *)p2;
 
-    bitmask = 1;
-    for (i = 0; i < 48; i++) {
-        if (hstate->shiftreg & bitmask) {
-            output = output ^ thisd[i];
-        }
-
-        bitmask = bitmask << 1;
+    if (e1->key != e2->key) {
+        return (e1->key < e2->key) ? -1 : 1;
     }
-
-    hstate->shiftreg = output;
-    buildlfsr(hstate);
+    if (e1->index != e2->index) {
+        return (e1->index < e2->index) ? -1 : 1;
+    }
+    return 0;
 }
 
+// a bucket loaded and sorted by a sort thread
+struct sortjob {
+    uint32_t bucket;
+    entry_t *entries;
+    uint64_t numentries;
+};
 
-// thread to build a part of the table
-static void *buildtable(void *dd) {
-    Hitag_State hstate;
-    Hitag_State hstate2;
-    unsigned long maxentries = 1;
-    int index = (int)(long)dd;
-    int tnum = NUM_BUILD_THREADS;
+static void *sorttable(void *dd) {
+    struct sortjob *job = (struct sortjob *)dd;
+    char *infile = t[job->bucket].path;
+    unsigned char *data = NULL;
+    struct stat filestat;
+    int fdin;
 
-    /* set random state */
-    hstate.shiftreg = 0x123456789abc;
-    buildlfsr(&hstate);
+    job->entries = NULL;
+    job->numentries = 0;
 
-    /* jump to offset using jump table 2 (2048) */
-    for (unsigned long i = 0; i < index; i++) {
-        jumpnsteps(&hstate, 2);
+    // open file, stat it and mmap it, buckets without entries have no file
+    fdin = open(infile, O_RDONLY);
+    if (fdin < 0) {
+        return NULL;
     }
 
-    /* set max entries - this is a fraction of 2^37 depending on how many threads we are running.
-       1 thread  = 2^37
-       2 threads = 2^36
-       4 threads = 2^35
-       8 threads = 2^34
-       etc
-    */
-    maxentries = maxentries << 37;
-    while (!(tnum & 0x1)) {
-        maxentries = maxentries >> 1;
-        tnum = tnum >> 1;
+    if (fstat(fdin, &filestat)) {
+        printf("cannot stat file %s\n", infile);
+        exit(1);
     }
 
-    /* make the entries */
-    for (unsigned long i = 0; i < maxentries; i++) {
-
-        // copy the current state
-        hstate2.shiftreg = hstate.shiftreg;
-        hstate2.lfsr = hstate.lfsr;
-
-        // get 48 bits of keystream from hstate2
-        // this is split into 2 x 24 bit
-        uint32_t ks1 = hitag2_nstep(&hstate2, 24);
-        uint32_t ks2 = hitag2_nstep(&hstate2, 24);
-
-        write_ks_s(ks1, ks2, hstate.shiftreg);
-
-        // jump hstate forward 2048 * NUM_BUILD_THREADS states using di table
-        // this is because we're running NUM_BUILD_THREADS threads at once, from NUM_BUILD_THREADS
-        // different offsets that are 2048 states apart.
-        jumpnsteps(&hstate, 1);
+    job->numentries = filestat.st_size / recsize;
+    if (job->numentries == 0) {
+        close(fdin);
+        unlink(infile);
+        return NULL;
     }
 
-    return NULL;
-}
-
-
-// make 'table/' (unsorted) and 'sorted/' dir structures
-static void makedirs(void) {
-    char path[32];
-    int i;
-
-    if (mkdir("table", 0755)) {
-        printf("cannot make dir table\n");
+    data = mmap((caddr_t)0, filestat.st_size, PROT_READ, MAP_PRIVATE, fdin, 0);
+    if (data == MAP_FAILED) {
+        printf("cannot mmap file %s\n", infile);
         exit(1);
     }
-    if (mkdir("sorted", 0755)) {
-        printf("cannot make dir sorted\n");
+
+    job->entries = (entry_t *)malloc(job->numentries * sizeof(entry_t));
+    if (!job->entries) {
+        printf("sorttable: cannot malloc %s\n", infile);
         exit(1);
     }
 
-    for (i = 0; i < 0x100; i++) {
-        sprintf(path, "table/%02x", i);
-        if (mkdir(path, 0755)) {
-            printf("cannot make dir %s\n", path);
-            exit(1);
+    for (uint64_t i = 0; i < job->numentries; i++) {
+        const unsigned char *p = data + (i * recsize);
+        job->entries[i].key = 0;
+        for (int j = 0; j < 6; j++) {
+            job->entries[i].key = (job->entries[i].key << 8) | p[j];
         }
-        sprintf(path, "sorted/%02x", i);
-        if (mkdir(path, 0755)) {
-            printf("cannot make dir %s\n", path);
-            exit(1);
+        job->entries[i].index = 0;
+        for (uint32_t j = 0; j < hdr.indexbytes; j++) {
+            job->entries[i].index = (job->entries[i].index << 8) | p[6 + j];
         }
     }
-}
 
-static int datacmp(const void *p1, const void *p2, void *dummy) {
-    unsigned char *d_1 = (unsigned char *)p1;
-    unsigned char *d_2 = (unsigned char *)p2;
+    // unmap file and close it
+    if (munmap(data, filestat.st_size)) {
+        printf("cannot munmap %s\n", infile);
+        exit(1);
+    }
 
-    return memcmp(d_1, d_2, DATASIZE);
-}
+    close(fdin);
 
-static void *sorttable(void *dd) {
-    int i, j;
-    int fdin;
-    int fdout;
-    char infile[64];
-    char outfile[64];
-    unsigned char *data = NULL;
-    struct stat filestat;
-    int index = (int)(long)dd;
-    int space = 0x100 / NUM_SORT_THREADS;
+    // sort it
+    qsort(job->entries, job->numentries, sizeof(entry_t), entrycmp);
 
-    // create table - 50MB should be enough
-    unsigned char *table = (unsigned char *)calloc(1, 50UL * 1024UL * 1024UL);
-    if (!table) {
-        printf("sorttable: cannot calloc table\n");
+    // remove input file
+    if (unlink(infile)) {
+        printf("cannot remove file %s\n", infile);
         exit(1);
     }
 
-    // loop over our first byte values
-    for (i = (index * space); i < ((index + 1) * space); i++) {
-        // loop over all second byte values
-        for (j = 0; j < 0x100; j++) {
-
-            printf("sorttable: processing bytes 0x%02x/0x%02x\n", i, j);
-
-            // open file, stat it and mmap it
-            sprintf(infile, "table/%02x/%02x.bin", i, j);
+    return NULL;
+}
 
-            fdin = open(infile, O_RDONLY);
-            if (fdin <= 0) {
-                printf("cannot open file %s\n", infile);
-                exit(1);
-            }
+// block encoder for the sorted entries, they must be added in order
+struct encoder {
+    int fd;
+    uint64_t count;
+    uint64_t lastkey;
+    uint64_t datapos;
+    unsigned char buf[1 << 20];
+    size_t len;
+    ht2_table_index_t index[1 << 14];
+    size_t indexlen;
+    uint64_t indexpos;
+};
 
-            if (fstat(fdin, &filestat)) {
-                printf("cannot stat file %s\n", infile);
-                exit(1);
-            }
+static void flushencoder(struct encoder *e) {
+    writeall(e->fd, e->buf, e->len, hdr.dataoffset + e->datapos, outfile);
+    e->datapos += e->len;
+    e->len = 0;
 
-            data = mmap((caddr_t)0, filestat.st_size, PROT_READ, MAP_PRIVATE, fdin, 0);
-            if (data == MAP_FAILED) {
-                printf("cannot mmap file %s\n", infile);
-                exit(1);
-            }
+    writeall(e->fd, (unsigned char *)e->index, e->indexlen * sizeof(ht2_table_index_t), hdr.indexoffset + (e->indexpos * sizeof(ht2_table_index_t)), outfile);
+    e->indexpos += e->indexlen;
+    e->indexlen = 0;
+}
 
-            // copy data into table
-            memcpy(table, data, filestat.st_size);
+static void encode(struct encoder *e, const entry_t *entry) {
+    // room for a delta and an index
+    if ((e->len + 16 > sizeof(e->buf)) || (e->indexlen == sizeof(e->index) / sizeof(e->index[0]))) {
+        flushencoder(e);
+    }
 
-            uint64_t numentries = filestat.st_size / DATASIZE;
+    if ((e->count % hdr.blockentries) == 0) {
+        e->index[e->indexlen].key = entry->key;
+        e->index[e->indexlen].offset = e->datapos + e->len;
+        e->indexlen++;
+    } else {
+        uint64_t delta = entry->key - e->lastkey;
+        while (delta >= 0x80) {
+            e->buf[e->len++] = (delta & 0x7f) | 0x80;
+            delta >>= 7;
+        }
+        e->buf[e->len++] = delta;
+    }
 
-            // unmap file and close it
-            if (munmap(data, filestat.st_size)) {
-                printf("cannot munmap %s\n", infile);
-                exit(1);
-            }
+    writebuf(e->buf + e->len, entry->index, hdr.indexbytes);
+    e->len += hdr.indexbytes;
+    e->lastkey = entry->key;
+    e->count++;
+}
 
-            close(fdin);
+int main(int argc, char *argv[]) {
+    pthread_t *threads;
+    void *status;
+    int c;
+
+    while ((c = getopt(argc, argv, "t:s:m:k:b:d:o:h")) != -1) {
+        switch (c) {
+            case 't':
+                num_build_threads = atoi(optarg);
+                break;
+            case 's':
+                num_sort_threads = atoi(optarg);
+                break;
+            case 'm':
+                memsize = strtoull(optarg, NULL, 0) * 1024ULL * 1024ULL;
+                break;
+            case 'k':
+                hdr.indexbits = atoi(optarg);
+                break;
+            case 'b':
+                blockentries = atoi(optarg);
+                break;
+            case 'd':
+                tmpdir = optarg;
+                break;
+            case 'o':
+                outfile = optarg;
+                break;
+            default:
+                usage();
+        }
+    }
 
-            // sort it
-            void *dummy = NULL; // clang
-            qsort_r(table, numentries, DATASIZE, datacmp, dummy);
+    if (hdr.indexbits == 0) {
+        hdr.indexbits = HT2_TABLE_FULLBITS;
+    }
 
-            // write to file
-            sprintf(outfile, "sorted/%02x/%02x.bin", i, j);
-            fdout = open(outfile, O_WRONLY | O_CREAT, 0644);
-            if (fdout <= 0) {
-                printf("cannot create outfile %s\n", outfile);
-                exit(1);
-            }
-            if (write(fdout, table, numentries * DATASIZE)) {
-                printf("writetable cannot write all of the data\n");
-                exit(1);
-            }
-            close(fdout);
+    if ((num_build_threads <= 0) || (num_sort_threads <= 0) || (memsize == 0) ||
+            (hdr.indexbits > HT2_TABLE_FULLBITS) || (blockentries == 0) || (strlen(tmpdir) > 200)) {
+        usage();
+    }
 
-            // remove input file
-            if (unlink(infile)) {
-                printf("cannot remove file %s\n", infile);
-                exit(1);
-            }
+    memcpy(hdr.magic, HT2_TABLE_MAGIC, sizeof(hdr.magic));
+    hdr.start = HT2_TABLE_START;
+    hdr.spacing = HT2_TABLE_SPACING;
+    hdr.indexbytes = (hdr.indexbits + 7) / 8;
+    hdr.blockentries = blockentries;
+    hdr.entries = 1ULL << hdr.indexbits;
+    hdr.blocks = (hdr.entries + blockentries - 1) / blockentries;
+    hdr.indexoffset = sizeof(ht2_table_header_t);
+    hdr.dataoffset = hdr.indexoffset + (hdr.blocks * sizeof(ht2_table_index_t));
+
+    recsize = 6 + hdr.indexbytes;
+
+    // enough buckets that a batch of them can be sorted at once in memory
+    for (bucketbits = 0; bucketbits <= 16; bucketbits++) {
+        numbuckets = 1U << bucketbits;
+        if ((hdr.entries / numbuckets) * sizeof(entry_t) * num_sort_threads <= memsize) {
+            break;
         }
     }
+    if (bucketbits > 16) {
+        printf("not enough memory to sort the table, use more with -m or fewer sort threads\n");
+        exit(1);
+    }
 
-    return NULL;
-}
+    // buffer sized to the expected bucket, with some slack, but within the memory limit
+    bucketmax = ((hdr.entries / numbuckets) + (hdr.entries / numbuckets / 8) + 1024) * recsize;
+    if (bucketmax > memsize / numbuckets) {
+        bucketmax = memsize / numbuckets;
+    }
+    if (bucketmax < recsize * 16) {
+        bucketmax = recsize * 16;
+    }
 
-int main(int argc, char *argv[]) {
-    pthread_t threads[NUM_BUILD_THREADS];
-    void *status;
+    printf("building %" PRIu64 " entries in %u buckets, %d build threads, %d sort threads\n",
+           hdr.entries, numbuckets, num_build_threads, num_sort_threads);
 
     // make the table of tables
-    t = (struct table *)malloc(sizeof(struct table) * 65536);
-    if (!t) {
+    t = (struct table *)malloc(sizeof(struct table) * numbuckets);
+    threads = (pthread_t *)malloc(sizeof(pthread_t) * ((num_build_threads > num_sort_threads) ? num_build_threads : num_sort_threads));
+    if (!t || !threads) {
         printf("malloc failed\n");
         exit(1);
     }
@@ -464,14 +449,14 @@ int main(int argc, char *argv[]) {
     // create the directories
     makedirs();
 
-    // build the jump table for incremental steps
-    builddi(2048 * NUM_BUILD_THREADS, 1);
-
-    // build the jump table for setting the offset
-    builddi(2048, 2);
+    // build the jump tables
+    ht2_jump_init();
+    for (int i = 0; i < 48; i++) {
+        spacingjump.col[i] = ht2_advance(1ULL << i, HT2_TABLE_SPACING);
+    }
 
     // start the threads
-    for (long i = 0; i < NUM_BUILD_THREADS; i++) {
+    for (long i = 0; i < num_build_threads; i++) {
         int ret = pthread_create(&(threads[i]), NULL, buildtable, (void *)(i));
         if (ret) {
             printf("cannot start buildtable thread %ld\n", i);
@@ -482,7 +467,7 @@ int main(int argc, char *argv[]) {
     if (debug) printf("main, started buildtable threads\n");
 
     // wait for threads to finish
-    for (long i = 0; i < NUM_BUILD_THREADS; i++) {
+    for (long i = 0; i < num_build_threads; i++) {
         int ret = pthread_join(threads[i], &status);
         if (ret) {
             printf("cannot join buildtable thread %ld\n", i);
@@ -492,7 +477,7 @@ int main(int argc, char *argv[]) {
     }
 
     // write all remaining files
-    for (long i = 0; i < 0x10000; i++) {
+    for (uint32_t i = 0; i < numbuckets; i++) {
         struct table *t1 = t + i;
         if (t1->ptr > t1->data) {
             writetable(t1);
@@ -501,39 +486,72 @@ int main(int argc, char *argv[]) {
 
     // dump the memory
     free_tables(t);
-    free(t);
 
 
 
-    // now for the sorting
+    // now for the sorting, batches of buckets are sorted in parallel and encoded in order
 
+    struct encoder *enc = (struct encoder *)calloc(1, sizeof(struct encoder));
+    struct sortjob *jobs = (struct sortjob *)calloc(num_sort_threads, sizeof(struct sortjob));
+    if (!enc || !jobs) {
+        printf("calloc failed\n");
+        exit(1);
+    }
 
-    // start the threads
-    for (long i = 0; i < NUM_SORT_THREADS; i++) {
-        int ret = pthread_create(&(threads[i]), NULL, sorttable, (void *)(i));
-        if (ret) {
-            printf("cannot start sorttable thread %ld\n", i);
-            exit(1);
-        }
+    enc->fd = open(outfile, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (enc->fd < 0) {
+        printf("cannot create table %s\n", outfile);
+        exit(1);
     }
 
-    if (debug) printf("main, started sorttable threads\n");
+    for (uint32_t b = 0; b < numbuckets; b += num_sort_threads) {
+        uint32_t n = (numbuckets - b < (uint32_t)num_sort_threads) ? numbuckets - b : (uint32_t)num_sort_threads;
 
-    // wait for threads to finish
-    for (long i = 0; i < NUM_SORT_THREADS; i++) {
-        int ret = pthread_join(threads[i], &status);
-        if (ret) {
-            printf("cannot join sorttable thread %ld\n", i);
-            exit(1);
+        printf("sorttable: processing buckets 0x%04x..0x%04x of 0x%04x\n", b, b + n - 1, numbuckets);
+
+        for (uint32_t i = 0; i < n; i++) {
+            jobs[i].bucket = b + i;
+            int ret = pthread_create(&(threads[i]), NULL, sorttable, &jobs[i]);
+            if (ret) {
+                printf("cannot start sorttable thread %u\n", i);
+                exit(1);
+            }
+        }
+
+        for (uint32_t i = 0; i < n; i++) {
+            int ret = pthread_join(threads[i], &status);
+            if (ret) {
+                printf("cannot join sorttable thread %u\n", i);
+                exit(1);
+            }
+        }
+
+        for (uint32_t i = 0; i < n; i++) {
+            for (uint64_t j = 0; j < jobs[i].numentries; j++) {
+                encode(enc, &jobs[i].entries[j]);
+            }
+            free(jobs[i].entries);
         }
-        printf("sorttable thread %ld finished\n", i);
     }
 
-    pthread_exit(NULL);
+    flushencoder(enc);
 
-    return 0;
-}
+    if (enc->count != hdr.entries) {
+        printf("table has %" PRIu64 " entries, expected %" PRIu64 "\n", enc->count, hdr.entries);
+        exit(1);
+    }
 
+    writeall(enc->fd, (unsigned char *)&hdr, sizeof(hdr), 0, outfile);
+    close(enc->fd);
 
+    uint64_t size = hdr.dataoffset + enc->datapos;
+    printf("table %s written, %" PRIu64 " bytes, %.2f bytes per entry\n", outfile, size, (double)size / hdr.entries);
 
+    rmdir(tmpdir);
+    free(enc);
+    free(jobs);
+    free(threads);
+    free(t);
 
+    return 0;
+}
@@ -1,9 +1,15 @@
 /*
  * ht2crack2gentests.c
  * this uses the RFIDler hitag2 PRNG code to generate test cases to test the tables
+ *
+ * With -k BITS the tests are made for a reduced keyspace table built with the same -k:
+ * the key is chosen so that the PRNG state after initialisation lies within the part
+ * of the sequence that table covers.
  */
 
-#include "ht2crackutils.h"
+#include "ht2crack2table.h"
+#include <getopt.h>
+#include <inttypes.h>
 
 static int makerandom(char *hex, unsigned int len, int fd) {
     unsigned char raw[32];
@@ -31,6 +37,39 @@ static int makerandom(char *hex, unsigned int len, int fd) {
     return 1;
 }
 
+static uint64_t makerandom64(int fd) {
+    uint64_t r;
+
+    if (read(fd, &r, sizeof(r)) != sizeof(r)) {
+        printf("makerandom64: cannot read random bytes\n");
+        exit(1);
+    }
+    return r;
+}
+
+// finds the key that initialises the PRNG to state, the reverse of recoverkey() in ht2crack2search
+static void makekey(char *key, uint64_t state, char *uid, char *nR) {
+    uint32_t uidtmp = rev32(hexreversetoulong(uid));
+    uint32_t nRenc = rev32(hexreversetoulong(nR));
+    uint64_t keyrev = state & 0xffff;
+    uint32_t nRxork = (state >> 16) & 0xffffffff;
+    uint32_t b = 0;
+
+    for (int i = 0; i < 32; i++) {
+        state = (state << 1) | ((uidtmp >> 31) & 0x1);
+        uidtmp = uidtmp << 1;
+        b = (b << 1) | fnf(state);
+    }
+
+    keyrev |= (uint64_t)(nRxork ^ nRenc ^ b) << 16;
+
+    uint64_t k = rev64(keyrev);
+    for (int i = 0; i < 6; i++) {
+        sprintf(key + (2 * i), "%02X", (int)(k & 0xff));
+        k = k >> 8;
+    }
+}
+
 
 int main(int argc, char *argv[]) {
     Hitag_State hstate;
@@ -41,18 +80,35 @@ int main(int argc, char *argv[]) {
     int i, j;
     int numtests;
     int urandomfd;
+    int indexbits = 0;
+    int c;
+
+    while ((c = getopt(argc, argv, "k:h")) != -1) {
+        switch (c) {
+            case 'k':
+                indexbits = atoi(optarg);
+                break;
+            default:
+                argc = 0;
+        }
+    }
 
-    if (argc < 2) {
-        printf("%s number\n", argv[0]);
+    if ((argc - optind < 1) || (indexbits < 0) || (indexbits > HT2_TABLE_FULLBITS)) {
+        printf("ht2crack2gentest [-k BITS] number\n");
+        printf(" -k make tests for a table built with ht2crack2buildtable -k BITS\n");
         exit(1);
     }
 
-    numtests = atoi(argv[1]);
+    numtests = atoi(argv[optind]);
     if (numtests <= 0) {
         printf("need positive number of tests\n");
         exit(1);
     }
 
+    if (indexbits) {
+        ht2_jump_init();
+    }
+
     urandomfd = open("/dev/urandom", O_RDONLY);
     if (urandomfd <= 0) {
         printf("cannot open /dev/urandom\n");
@@ -62,9 +118,20 @@ int main(int argc, char *argv[]) {
 
     for (i = 0; i < numtests; i++) {
 
-        makerandom(key, 6, urandomfd);
         makerandom(uid, 4, urandomfd);
         makerandom(nR, 4, urandomfd);
+
+        uint64_t state = 0;
+        if (indexbits) {
+            // the search reads 2048 - 48 bits of keystream after the 64 bits of auth, one
+            // table sample must fall into them
+            uint64_t sample = 1 + (makerandom64(urandomfd) % ((1ULL << indexbits) - 1));
+            uint64_t before = 64 + (makerandom64(urandomfd) % (HT2_TABLE_SPACING - 48));
+            state = ht2_advance(HT2_TABLE_START, (sample * HT2_TABLE_SPACING) - before);
+            makekey(key, state, uid, nR);
+        } else {
+            makerandom(key, 6, urandomfd);
+        }
         sprintf(filename, "keystream.key-%s.uid-%s.nR-%s", key, uid, nR);
 
         FILE *fp = fopen(filename, "w");
@@ -78,6 +145,11 @@ int main(int argc, char *argv[]) {
 
         hitag2_init(&hstate, rev64(hexreversetoulonglong(key)), rev32(hexreversetoulong(uid)), rev32(hexreversetoulong(nR)));
 
+        if (indexbits && (hstate.shiftreg != state)) {
+            printf("key %s does not initialise to state %012" PRIx64 "\n", key, state);
+            exit(1);
+        }
+
         hitag2_nstep(&hstate, 64);
 
         for (j = 0; j < 64; j++) {
@@ -2,13 +2,32 @@
  * ht2crack2search.c
  * this searches the sorted tables for the given RNG data, retrieves the matching
  * PRNG state, checks it is correct, and then rolls back the PRNG to recover the key
+ *
+ * It uses the compact table made by ht2crack2buildtable, or the sorted/ tree of the
+ * older table format when there is no compact table.  Tables stay mapped for the whole
+ * search and the bit offsets are checked in parallel batches.
  */
 
-#include "ht2crackutils.h"
+#include "ht2crack2table.h"
+#include <getopt.h>
 
 #define INPUTFILE "sorted/%02x/%02x.bin"
 #define DATASIZE 10
 
+// bit offsets handed out to a search thread at once
+#define BATCHBITS 100
+
+static ht2_table_t table;
+static int have_table = 0;
+
+// mappings of the sorted/ tree, opened on first use and kept until exit
+struct sortedmap {
+    unsigned char *data;
+    size_t size;
+};
+static struct sortedmap *sortedmaps;
+static pthread_mutex_t sortedmutex = PTHREAD_MUTEX_INITIALIZER;
+
 struct rngdata {
     unsigned char *data;
     int len;
@@ -113,19 +132,15 @@ static int makecand(unsigned char *c, struct rngdata *r, int bitoffset) {
 }
 
 
-// test the candidate against the next or previous rng data
-static int testcand(const unsigned char *f, unsigned char *rt, int fwd) {
+// test the candidate state against the next or previous rng data
+static int testcand(uint64_t state, const unsigned char *rt, int fwd) {
     Hitag_State hstate;
-    int i;
     uint32_t ks1;
     uint32_t ks2;
     unsigned char buf[6];
 
     // build the prng state at the candidate
-    hstate.shiftreg = 0;
-    for (i = 0; i < 6; i++) {
-        hstate.shiftreg = (hstate.shiftreg << 8) | f[i + 4];
-    }
+    hstate.shiftreg = state;
     buildlfsr(&hstate);
 
     if (fwd) {
@@ -152,60 +167,100 @@ static int testcand(const unsigned char *f, unsigned char *rt, int fwd) {
     }
 }
 
-static int searchcand(unsigned char *c, unsigned char *rt, int fwd, unsigned char *m, unsigned char *s) {
-    int fd;
-    struct stat filestat;
-    char file[64];
-    unsigned char *data;
-    unsigned char item[10];
-    unsigned char *found = NULL;
+// one search of the rng data, shared by the search threads
+struct search {
+    struct rngdata *r;
+    int bitlen;
+    int next;                   // next bit offset to hand out
+    int best;                   // lowest bit offset with a match so far
+    uint64_t beststate;
+    pthread_mutex_t mutex;
+};
 
+// a candidate with its test data, passed to the table lookup
+struct cand {
+    const unsigned char *rt;
+    int fwd;
+    uint64_t state;
+};
 
-    if (!c || !rt || !m || !s) {
-        printf("searchcand: invalid params\n");
-        return 0;
+static int foundcand(uint64_t index, void *arg) {
+    struct cand *cd = (struct cand *)arg;
+    uint64_t state = ht2_table_state(table.hdr, index);
+
+    if (testcand(state, cd->rt, cd->fwd)) {
+        cd->state = state;
+        return 1;
     }
+    return 0;
+}
 
-    sprintf(file, INPUTFILE, c[0], c[1]);
+static const struct sortedmap *getsortedmap(const unsigned char *c) {
+    struct sortedmap *sm = &sortedmaps[(c[0] << 8) | c[1]];
+    struct stat filestat;
+    char file[64];
+    int fd;
 
-    fd = open(file, O_RDONLY);
-    if (fd <= 0) {
-        printf("cannot open table file %s\n", file);
-        exit(1);
+    if (__atomic_load_n(&sm->data, __ATOMIC_ACQUIRE)) {
+        return sm;
     }
 
-    if (fstat(fd, &filestat)) {
-        printf("cannot stat file %s\n", file);
-        exit(1);
-    }
+    pthread_mutex_lock(&sortedmutex);
+    if (sm->data == NULL) {
+        sprintf(file, INPUTFILE, c[0], c[1]);
 
-    data = mmap((caddr_t)0, filestat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
-    if (data == MAP_FAILED) {
-        printf("cannot mmap file %s\n", file);
-        exit(1);
+        fd = open(file, O_RDONLY);
+        if (fd < 0) {
+            printf("cannot open table file %s\n", file);
+            exit(1);
+        }
+
+        if (fstat(fd, &filestat)) {
+            printf("cannot stat file %s\n", file);
+            exit(1);
+        }
+
+        // empty files can't be mapped, point them at something that isn't NULL
+        static unsigned char empty;
+        unsigned char *data = &empty;
+        if (filestat.st_size) {
+            data = mmap((caddr_t)0, filestat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        if (data == MAP_FAILED) {
+            printf("cannot mmap file %s\n", file);
+            exit(1);
+        }
+        close(fd);
+
+        sm->size = filestat.st_size;
+        __atomic_store_n(&sm->data, data, __ATOMIC_RELEASE);
     }
+    pthread_mutex_unlock(&sortedmutex);
+    return sm;
+}
 
-    memcpy(item, c + 2, 4);
+static int searchsorted(const unsigned char *c, struct cand *cd) {
+    const struct sortedmap *sm = getsortedmap(c);
+    unsigned char *found = NULL;
 
-    found = (unsigned char *)bsearch(item, data, filestat.st_size / DATASIZE, DATASIZE, datacmp);
+    found = (unsigned char *)bsearch(c + 2, sm->data, sm->size / DATASIZE, DATASIZE, datacmp);
 
     if (found) {
 
         // our candidate is in the table
         // go backwards and see if there are other matches
-        while (((found - data) >= DATASIZE) && (!memcmp(found - DATASIZE, item, 4))) {
+        while (((found - sm->data) >= DATASIZE) && (!memcmp(found - DATASIZE, c + 2, 4))) {
             found = found - DATASIZE;
         }
 
         // now test all matches
-        while (((found - data) <= (filestat.st_size - DATASIZE)) && (!memcmp(found, item, 4))) {
-            if (testcand(found, rt, fwd)) {
-                memcpy(m, c, 2);
-                memcpy(m + 2, found, 4);
-                memcpy(s, found + 4, 6);
-
-                munmap(data, filestat.st_size);
-                close(fd);
+        while (((found - sm->data) <= (sm->size - DATASIZE)) && (!memcmp(found, c + 2, 4))) {
+            uint64_t state = 0;
+            for (int i = 0; i < 6; i++) {
+                state = (state << 8) | found[i + 4];
+            }
+            if (testcand(state, cd->rt, cd->fwd)) {
+                cd->state = state;
                 return 1;
             }
 
@@ -213,62 +268,130 @@ static int searchcand(unsigned char *c, unsigned char *rt, int fwd, unsigned cha
         }
     }
 
-    munmap(data, filestat.st_size);
-    close(fd);
-
     return 0;
+}
+
+static int searchcand(unsigned char *c, unsigned char *rt, int fwd, uint64_t *s) {
+    struct cand cd = { rt, fwd, 0 };
+    int res;
 
+    if (!c || !rt || !s) {
+        printf("searchcand: invalid params\n");
+        return 0;
+    }
+
+    if (have_table) {
+        uint64_t key = 0;
+        for (int i = 0; i < 6; i++) {
+            key = (key << 8) | c[i];
+        }
+        res = ht2_table_lookup(&table, key, foundcand, &cd);
+    } else {
+        res = searchsorted(c, &cd);
+    }
+
+    if (res) {
+        *s = cd.state;
+    }
+    return res;
 }
 
-static int findmatch(struct rngdata *r, unsigned char *outmatch, unsigned char *outstate, int *bitoffset) {
-    int i;
-    int bitlen;
+static void *searchthread(void *arg) {
+    struct search *sr = (struct search *)arg;
     unsigned char cand[6];
     unsigned char rngtest[6];
     int fwd;
+    uint64_t state;
 
-    if (!r || !outmatch || !outstate || !bitoffset) {
-        printf("findmatch: invalid params\n");
-        return 0;
-    }
+    while (1) {
+        int start = __atomic_fetch_add(&sr->next, BATCHBITS, __ATOMIC_SEQ_CST);
 
-    bitlen = r->len * 8;
+        // nothing left, or an earlier offset already matched
+        if ((start > sr->bitlen - 48) || (start > __atomic_load_n(&sr->best, __ATOMIC_SEQ_CST))) {
+            break;
+        }
 
-    for (i = 0; i <= bitlen - 48; i++) {
         // print progress
-        if ((i % 100) == 0) {
-            printf("searching on bit %d\n", i);
-        }
+        printf("searching on bit %d\n", start);
 
-        if (!makecand(cand, r, i)) {
-            printf("cannot makecand, %d\n", i);
-            return 0;
-        }
-//        printf("cand: %02x %02x %02x %02x %02x %02x : ", cand[0], cand[1], cand[2], cand[3], cand[4], cand[5]);
-//        printbin(cand);
-
-        /* make following or preceding RNG test data to confirm match */
-        if (i < (bitlen - 96)) {
-            if (!makecand(rngtest, r, i + 48)) {
-                printf("cannot makecand rngtest %d + 48\n", i);
-                return 0;
+        for (int i = start; (i < start + BATCHBITS) && (i <= sr->bitlen - 48); i++) {
+            if (!makecand(cand, sr->r, i)) {
+                printf("cannot makecand, %d\n", i);
+                exit(1);
             }
-            fwd = 1;
-        } else {
-            if (!makecand(rngtest, r, i - 48)) {
-                printf("cannot makecand rngtest %d - 48\n", i);
-                return 0;
+
+            /* make following or preceding RNG test data to confirm match */
+            if (i < (sr->bitlen - 96)) {
+                if (!makecand(rngtest, sr->r, i + 48)) {
+                    printf("cannot makecand rngtest %d + 48\n", i);
+                    exit(1);
+                }
+                fwd = 1;
+            } else {
+                if (!makecand(rngtest, sr->r, i - 48)) {
+                    printf("cannot makecand rngtest %d - 48\n", i);
+                    exit(1);
+                }
+                fwd = 0;
+            }
+
+            if (searchcand(cand, rngtest, fwd, &state)) {
+                pthread_mutex_lock(&sr->mutex);
+                if (i < sr->best) {
+                    sr->best = i;
+                    sr->beststate = state;
+                }
+                pthread_mutex_unlock(&sr->mutex);
+                break;
             }
-            fwd = 0;
         }
+    }
+
+    return NULL;
+}
 
-        if (searchcand(cand, rngtest, fwd, outmatch, outstate)) {
-            *bitoffset = i;
-            return 1;
+static int findmatch(struct rngdata *r, unsigned char *outmatch, unsigned char *outstate, int *bitoffset, int numthreads) {
+    struct search sr;
+    pthread_t *threads;
+
+    if (!r || !outmatch || !outstate || !bitoffset) {
+        printf("findmatch: invalid params\n");
+        return 0;
+    }
+
+    sr.r = r;
+    sr.bitlen = r->len * 8;
+    sr.next = 0;
+    sr.best = sr.bitlen;
+    sr.beststate = 0;
+    pthread_mutex_init(&sr.mutex, NULL);
+
+    threads = (pthread_t *)calloc(numthreads, sizeof(pthread_t));
+    if (!threads) {
+        printf("cannot calloc\n");
+        exit(1);
+    }
+
+    for (int i = 0; i < numthreads; i++) {
+        if (pthread_create(&threads[i], NULL, searchthread, &sr)) {
+            printf("cannot start search thread %d\n", i);
+            exit(1);
         }
     }
+    for (int i = 0; i < numthreads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    pthread_mutex_destroy(&sr.mutex);
 
-    return 0;
+    if (sr.best == sr.bitlen) {
+        return 0;
+    }
+
+    *bitoffset = sr.best;
+    makecand(outmatch, r, sr.best);
+    writebuf(outstate, sr.beststate, 6);
+    return 1;
 }
 
 static void rollbackrng(Hitag_State *hstate, const unsigned char *s, int offset) {
@@ -362,30 +485,64 @@ int main(int argc, char *argv[]) {
     uint64_t key;
     int i;
 
-    if (argc < 4) {
-        printf("%s rngdatafile UID nR\n", argv[0]);
+    const char *tablefile = HT2_TABLE_FILE;
+    int numthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    int c;
+
+    while ((c = getopt(argc, argv, "t:j:h")) != -1) {
+        switch (c) {
+            case 't':
+                tablefile = optarg;
+                break;
+            case 'j':
+                numthreads = atoi(optarg);
+                break;
+            default:
+                argc = 0;
+        }
+    }
+    argc -= optind;
+    argv += optind;
+
+    if (argc < 3) {
+        printf("ht2crack2search [-t TABLEFILE] [-j THREADS] rngdatafile UID nR\n");
+        printf(" -t table made by ht2crack2buildtable (defaults to %s, sorted/ is used when it is missing)\n", HT2_TABLE_FILE);
+        printf(" -j number of search threads (defaults to the number of CPUs)\n");
         exit(1);
     }
 
-    if (!loadrngdata(&rng, argv[1])) {
+    if (numthreads <= 0) {
+        numthreads = 1;
+    }
+
+    if (!loadrngdata(&rng, argv[0])) {
         printf("loadrngdata failed\n");
         exit(1);
     }
 
-    if (!strncmp(argv[2], "0x", 2)) {
-        uidstr = argv[2] + 2;
+    if (!strncmp(argv[1], "0x", 2)) {
+        uidstr = argv[1] + 2;
     } else {
-        uidstr = argv[2];
+        uidstr = argv[1];
     }
 
-    if (!strncmp(argv[3], "0x", 2)) {
-        nRstr = argv[3] + 2;
+    if (!strncmp(argv[2], "0x", 2)) {
+        nRstr = argv[2] + 2;
     } else {
-        nRstr = argv[3];
+        nRstr = argv[2];
     }
 
+    ht2_jump_init();
+    have_table = ht2_table_open(&table, tablefile);
+    if (!have_table) {
+        sortedmaps = (struct sortedmap *)calloc(0x10000, sizeof(struct sortedmap));
+        if (!sortedmaps) {
+            printf("cannot calloc\n");
+            exit(1);
+        }
+    }
 
-    if (!findmatch(&rng, rngmatch, rngstate, &bitoffset)) {
+    if (!findmatch(&rng, rngmatch, rngstate, &bitoffset, numthreads)) {
         printf("couldn't find a match\n");
         exit(1);
     }
@@ -0,0 +1,216 @@
+/*
+ * ht2crack2table.c
+ * PRNG jumps and compact table access, see ht2crack2table.h for the format.
+ */
+
+#include "ht2crack2table.h"
+
+// jump tables for 2^i steps
+static ht2_jump_t pow2jump[48];
+
+// the shift register update is linear, so a jump is the xor of the jumped unit vectors
+uint64_t ht2_jump(uint64_t state, const ht2_jump_t *j) {
+    uint64_t output = 0;
+
+    for (int i = 0; state; i++, state >>= 1) {
+        if (state & 1) {
+            output ^= j->col[i];
+        }
+    }
+    return output;
+}
+
+void ht2_jump_init(void) {
+    Hitag_State hstate;
+
+    for (int i = 0; i < 48; i++) {
+        hstate.shiftreg = 1ULL << i;
+        buildlfsr(&hstate);
+        hitag2_nstep(&hstate, 1);
+        pow2jump[0].col[i] = hstate.shiftreg;
+    }
+
+    // jumping 2^k steps twice is a jump of 2^(k+1) steps
+    for (int k = 1; k < 48; k++) {
+        for (int i = 0; i < 48; i++) {
+            pow2jump[k].col[i] = ht2_jump(pow2jump[k - 1].col[i], &pow2jump[k - 1]);
+        }
+    }
+}
+
+uint64_t ht2_advance(uint64_t state, uint64_t steps) {
+    for (int k = 0; steps; k++, steps >>= 1) {
+        if (steps & 1) {
+            state = ht2_jump(state, &pow2jump[k]);
+        }
+    }
+    return state;
+}
+
+uint64_t ht2_table_state(const ht2_table_header_t *hdr, uint64_t index) {
+    return ht2_advance(hdr->start, index * hdr->spacing);
+}
+
+// the 48 bits of keystream following a state, as the search reads them from the rng data
+uint64_t ht2_keystream(uint64_t state) {
+    Hitag_State hstate;
+
+    hstate.shiftreg = state;
+    buildlfsr(&hstate);
+    uint64_t ks1 = hitag2_nstep(&hstate, 24);
+    uint64_t ks2 = hitag2_nstep(&hstate, 24);
+    return (ks1 << 24) | ks2;
+}
+
+int ht2_table_open(ht2_table_t *t, const char *path) {
+    struct stat filestat;
+
+    memset(t, 0, sizeof(ht2_table_t));
+
+    t->fd = open(path, O_RDONLY);
+    if (t->fd < 0) {
+        return 0;
+    }
+
+    if (fstat(t->fd, &filestat) || (filestat.st_size < sizeof(ht2_table_header_t))) {
+        printf("table %s is too small\n", path);
+        close(t->fd);
+        return 0;
+    }
+    t->size = filestat.st_size;
+
+    t->map = mmap((caddr_t)0, t->size, PROT_READ, MAP_PRIVATE, t->fd, 0);
+    if (t->map == MAP_FAILED) {
+        printf("cannot mmap table %s\n", path);
+        close(t->fd);
+        return 0;
+    }
+
+    t->hdr = (const ht2_table_header_t *)t->map;
+    if (memcmp(t->hdr->magic, HT2_TABLE_MAGIC, sizeof(t->hdr->magic)) ||
+            (t->hdr->indexoffset + (t->hdr->blocks * sizeof(ht2_table_index_t)) > t->size) ||
+            (t->hdr->dataoffset > t->size) || (t->hdr->blockentries == 0)) {
+        printf("%s is not a valid table\n", path);
+        ht2_table_close(t);
+        return 0;
+    }
+
+    t->index = (const ht2_table_index_t *)(t->map + t->hdr->indexoffset);
+    t->data = t->map + t->hdr->dataoffset;
+
+    // the whole table is searched randomly
+    madvise((void *)t->map, t->size, MADV_RANDOM);
+    return 1;
+}
+
+void ht2_table_close(ht2_table_t *t) {
+    if (t->map && (t->map != MAP_FAILED)) {
+        munmap((void *)t->map, t->size);
+    }
+    close(t->fd);
+    memset(t, 0, sizeof(ht2_table_t));
+}
+
+// last block whose first key is below key, block 0 if there is none
+static uint64_t findblock(const ht2_table_t *t, uint64_t key) {
+    uint64_t blocks = t->hdr->blocks;
+    uint64_t lo, hi;
+
+    // keys are close to uniform, so start at the interpolated position and gallop from there
+    uint64_t guess = (uint64_t)((double)key / (double)(1ULL << 48) * blocks);
+    if (guess >= blocks) {
+        guess = blocks - 1;
+    }
+
+    if (t->index[guess].key < key) {
+        lo = guess;
+        uint64_t step = 1;
+        hi = guess + step;
+        while ((hi < blocks) && (t->index[hi].key < key)) {
+            lo = hi;
+            step <<= 1;
+            hi = lo + step;
+        }
+        if (hi > blocks) {
+            hi = blocks;
+        }
+    } else {
+        hi = guess;
+        lo = 0;
+        uint64_t step = 1;
+        while (hi > 0) {
+            lo = (hi > step) ? hi - step : 0;
+            if (t->index[lo].key < key) {
+                break;
+            }
+            hi = lo;
+            step <<= 1;
+        }
+        if (hi == 0) {
+            return 0;
+        }
+    }
+
+    // index[lo].key < key <= index[hi].key (or hi == blocks)
+    while (hi - lo > 1) {
+        uint64_t mid = lo + ((hi - lo) / 2);
+        if (t->index[mid].key < key) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static uint64_t readindex(const unsigned char *p, uint32_t len) {
+    uint64_t index = 0;
+
+    for (uint32_t i = 0; i < len; i++) {
+        index = (index << 8) | p[i];
+    }
+    return index;
+}
+
+int ht2_table_lookup(const ht2_table_t *t, uint64_t key, int (*found)(uint64_t index, void *arg), void *arg) {
+    const ht2_table_header_t *hdr = t->hdr;
+
+    if (hdr->blocks == 0) {
+        return 0;
+    }
+
+    // equal keys may run on into the following blocks
+    for (uint64_t block = findblock(t, key); block < hdr->blocks; block++) {
+        const unsigned char *p = t->data + t->index[block].offset;
+        uint64_t n = hdr->entries - (block * hdr->blockentries);
+        if (n > hdr->blockentries) {
+            n = hdr->blockentries;
+        }
+
+        uint64_t k = t->index[block].key;
+        for (uint64_t i = 0; i < n; i++) {
+            if (i) {
+                uint64_t delta = 0;
+                int shift = 0;
+                do {
+                    delta |= (uint64_t)(*p & 0x7f) << shift;
+                    shift += 7;
+                } while (*p++ & 0x80);
+                k += delta;
+            }
+
+            if (k > key) {
+                return 0;
+            }
+
+            if (k == key) {
+                int res = found(readindex(p, hdr->indexbytes), arg);
+                if (res) {
+                    return res;
+                }
+            }
+            p += hdr->indexbytes;
+        }
+    }
+    return 0;
+}
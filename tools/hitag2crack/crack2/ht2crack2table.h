@@ -0,0 +1,72 @@
+/*
+ * ht2crack2table.h
+ * Compact table shared by ht2crack2buildtable, ht2crack2search and ht2crack2gentest.
+ *
+ * The table samples the PRNG sequence every HT2_TABLE_SPACING steps from HT2_TABLE_START.
+ * For each sample it stores the 48 bits of keystream the state produces and the sample
+ * index, from which the state is recomputed with the jump tables below.
+ *
+ * File layout, all values in host byte order:
+ *   ht2_table_header_t
+ *   ht2_table_index_t[blocks]  sparse index, first keystream of every block
+ *   block data                 entries sorted on keystream; the first entry of a block is only
+ *                              its sample index, every following entry is the keystream delta
+ *                              to its predecessor (LEB128) followed by its sample index
+ */
+
+#ifndef HT2CRACK2TABLE_H
+#define HT2CRACK2TABLE_H
+
+#include "ht2crackutils.h"
+
+#define HT2_TABLE_FILE      "ht2crack2.tbl"
+#define HT2_TABLE_MAGIC     "HT2TBL01"
+#define HT2_TABLE_START     0x123456789abcULL
+#define HT2_TABLE_SPACING   2048
+// 2^37 samples, 2048 steps apart, cover the whole PRNG cycle
+#define HT2_TABLE_FULLBITS  37
+
+typedef struct {
+    char magic[8];
+    uint64_t start;         // PRNG state of sample 0
+    uint32_t spacing;       // PRNG steps between samples
+    uint32_t indexbits;     // the table holds 2^indexbits samples
+    uint32_t indexbytes;    // bytes per stored sample index
+    uint32_t blockentries;  // entries per block
+    uint64_t entries;
+    uint64_t blocks;
+    uint64_t indexoffset;   // file offset of the sparse index
+    uint64_t dataoffset;    // file offset of the block data
+} ht2_table_header_t;
+
+typedef struct {
+    uint64_t key;           // keystream of the first entry of the block
+    uint64_t offset;        // of the block, from dataoffset
+} ht2_table_index_t;
+
+typedef struct {
+    int fd;
+    size_t size;
+    const unsigned char *map;
+    const ht2_table_header_t *hdr;
+    const ht2_table_index_t *index;
+    const unsigned char *data;
+} ht2_table_t;
+
+// jumps the PRNG state a fixed number of steps, column i is the state unit vector i jumps to
+typedef struct {
+    uint64_t col[48];
+} ht2_jump_t;
+
+void ht2_jump_init(void);
+uint64_t ht2_jump(uint64_t state, const ht2_jump_t *j);
+uint64_t ht2_advance(uint64_t state, uint64_t steps);
+uint64_t ht2_table_state(const ht2_table_header_t *hdr, uint64_t index);
+uint64_t ht2_keystream(uint64_t state);
+
+int ht2_table_open(ht2_table_t *t, const char *path);
+void ht2_table_close(ht2_table_t *t);
+// calls found() with the sample index of every entry for keystream key, stops when it returns nonzero
+int ht2_table_lookup(const ht2_table_t *t, uint64_t key, int (*found)(uint64_t index, void *arg), void *arg);
+
+#endif /* HT2CRACK2TABLE_H */
@@ -19,7 +19,13 @@ echo "UID           = $UIDV"
 echo "NR            = $NR"
 echo "Expected KEY  = $KEYV"
 
-./ht2crack2search $filename $UIDV $NR
+./ht2crack2search $HT2SEARCHOPTS $filename $UIDV $NR | tee runtest.out
 echo "Expected KEY  = $KEYV"
+if grep -qi "KEY:[[:space:]]*$KEYV" runtest.out; then
+echo "KEY MATCH"
+else
+echo "KEY MISMATCH"
+fi
+rm -f runtest.out
 echo "********************"
 echo ""
@@ -304,6 +304,8 @@ while true; do
       if ! CheckFileExist "ht2crack2search exists"         "$HT2CRACK2PATH/ht2crack2search"; then break; fi
       # 1.5Tb tables are supposed to be absent, so it's just a fast check without real cracking
       if ! CheckExecute "ht2crack2 quick test"             "cd $HT2CRACK2PATH; ./ht2crack2gentest 1 && ./runalltests.sh; rm keystream*" "searching on bit"; then break; fi
+      # both generated keystreams must give their key back, a single KEY MISMATCH fails the test
+      if ! CheckExecute "ht2crack2 reduced table test"     "cd $HT2CRACK2PATH; ./ht2crack2buildtable -k 16 -t 2 -s 2 -m 64 && ./ht2crack2gentest -k 16 2 && ./runalltests.sh|grep -c '^KEY MATCH$'|sed 's/^/KEY MATCHES: /'; rm -f keystream* ht2crack2.tbl" "KEY MATCHES: 2$"; then break; fi
 
       echo -e "\n${C_BLUE}Testing ht2crack3:${C_NC} ${HT2CRACK3PATH:=./tools/hitag2crack/crack3/}"
       if ! CheckFileExist "ht2crack3 exists"               "$HT2CRACK3PATH/ht2crack3"; then break; fi
@@ -365,10 +367,12 @@ while true; do
       if ! CheckExecute "proxmark multi stdin 2/4"         "echo 'rem foo;rem bar;quit' |$CLIENTBIN" "remark: bar"; then break; fi
       if ! CheckExecute "proxmark multi stdin 3/4"         "echo -e 'rem foo\nrem bar;quit' |$CLIENTBIN" "remark: foo"; then break; fi
       if ! CheckExecute "proxmark multi stdin 4/4"         "echo -e 'rem foo\nrem bar;quit' |$CLIENTBIN" "remark: bar"; then break; fi
+      if ! CheckExecute "proxmark hw bench"                "$CLIENTBIN -c 'hw bench -n 1'" "hardnested_bruteforce"; then break; fi
 
       echo -e "\n${C_BLUE}Testing scripts:${C_NC}"
       if ! CheckExecute "script run cmdscript"             "$CLIENTBIN -c 'script run example.cmd'" "remark: world"; then break; fi
       if ! CheckExecute "script run luascript"             "$CLIENTBIN -c 'script run data_hex_crc -b 010203040506070809'" "CDMA2000.*7B02"; then break; fi
+      if ! CheckExecute "script run buffer bench"          "$CLIENTBIN -c 'script run data_buffer_bench'" "buffer api self check  \\| ok"; then break; fi
 
       CheckExecute ignore "check Python support"        "$CLIENTBIN -c 'hw version'" "Python script.*present"
       if [ $RESULT -eq 0 ]; then
@@ -379,9 +383,12 @@ while true; do
       if ! CheckExecute "reveng readline test"    "$CLIENTBIN -c 'reveng -h;reveng -D'" "CRC-64/GO-ISO"; then break; fi
       if ! CheckExecute "reveng -g test"          "$CLIENTBIN -c 'reveng -g abda202c'" "CRC-16/ISO-IEC-14443-3-A"; then break; fi
       if ! CheckExecute "reveng -w test"          "$CLIENTBIN -c 'reveng -w 8 -s 01020304e3 010204039d'" "CRC-8/SMBUS"; then break; fi
+      if ! CheckExecute "reveng -F -s test"       "$CLIENTBIN -c 'reveng -F -w 16 -s 01020304059bed a1b2c3d4e56cd4 001122334473f1'" "poly=0x1021  init=0x0000  refin=true"; then break; fi
       if ! CheckExecute "mfu pwdgen test"         "$CLIENTBIN -c 'hf mfu pwdgen -t'" "Selftest OK"; then break; fi
       if ! CheckExecute "mfu keygen test"         "$CLIENTBIN -c 'hf mfu keygen --uid 11223344556677'" "80 B1 C2 71 D8 A0"; then break; fi
       if ! CheckExecute "jooki encode test"       "$CLIENTBIN -c 'hf jooki encode -t'" "04 28 F4 DA F0 4A 81  \( ok \)"; then break; fi
+      if ! CheckExecute "wiegand decode test"     "$CLIENTBIN -c 'wiegand decode -t'" "Tests \[ ok"; then break; fi
+      if ! CheckExecute "smart atr test"          "$CLIENTBIN -c 'smart atr -t'" "Tests \[ ok"; then break; fi
       if ! CheckExecute "trace load/list 14a"     "$CLIENTBIN -c 'trace load -f traces/hf_14a_mfu.trace; trace list -1 -t 14a;'" "READBLOCK\(8\)"; then break; fi
       if ! CheckExecute "trace load/list x"       "$CLIENTBIN -c 'trace load -f traces/hf_14a_mfu.trace; trace list -x1 -t 14a;'" "0.0101840425"; then break; fi
       if ! CheckExecute "nfc decode test - oob"           "$CLIENTBIN -c 'nfc decode -d DA2010016170706C69636174696F6E2F766E642E626C7565746F6F74682E65702E6F6F62301000649201B96DFB0709466C65782032'" "Flex 2"; then break; fi
@@ -407,6 +414,8 @@ while true; do
       if ! CheckExecute "lf PARADOX test"       "$CLIENTBIN -c 'data load -f traces/lf_Paradox-96_40426-APJN08.pm3;lf search -1'" "Paradox ID found"; then break; fi
       if ! CheckExecute "lf VIKING test"        "$CLIENTBIN -c 'data load -f traces/lf_Transit999-best.pm3;lf search -1'" "Viking ID found"; then break; fi
       if ! CheckExecute "lf VISA2000 test"      "$CLIENTBIN -c 'data load -f traces/lf_VISA2000.pm3;lf search -1'" "Visa2000 ID found"; then break; fi
+      if ! CheckExecute "lf T55 detect ASK test"  "$CLIENTBIN -c 'data load -f traces/lf_ATA5577_noralsy.pm3;lf t55xx detect -1'" "Block0.*00088CC1"; then break; fi
+      if ! CheckExecute "lf T55 detect PSK1 test" "$CLIENTBIN -c 'data load -f traces/lf_Q5_mod-psk1.pm3;lf t55xx detect -1'" "Block0.*1014181C"; then break; fi
 
       if ! CheckExecute slow "lf T55 awid 26 test"               "$CLIENTBIN -c 'data load -f traces/lf_ATA5577_awid_26.pm3; lf search -1'" "AWID ID found"; then break; fi
       if ! CheckExecute slow "lf T55 awid 26 test2"              "$CLIENTBIN -c 'data load -f traces/lf_ATA5577_awid_26.pm3; lf awid demod'" \
@@ -502,12 +511,25 @@ while true; do
       echo -e "\n${C_BLUE}Testing HF:${C_NC}"
       if ! CheckExecute "hf mf offline text"               "$CLIENTBIN -c 'hf mf'" "at_enc"; then break; fi
       if ! CheckExecute slow retry ignore "hf mf hardnested long test"  "$CLIENTBIN -c 'hf mf hardnested -t --tk 000000000000'" "found:"; then break; fi
+      if ! CheckExecute slow retry "hf mf hardnested sim test"  "$CLIENTBIN -c 'hf mf hardnested -t --tk a0a1a2a3a4a5'" "Key found: .*A0A1A2A3A4A5"; then break; fi
+      if ! CheckExecute slow "hf mf hardnested cand file test" "cp traces/hf_mf_hardnested_nonces.bin nonces.bin; \
+                                                                printf 'PM3CAND3\\x1a\\x2f\\x7e\\x8d\\x08\\x00\\xb8\\x0b\\x00\\x00\\x00\\x00\\x00\\x00\\x00\\x00\\x00\\x00\\x00\\x00\\x00\\x00\\x00\\x00\\x00\\x00' > nonces.bin.cand; \
+                                                                $CLIENTBIN -c 'hf mf hardnested -r'; rm -f nonces.bin nonces.bin.cand" \
+                                                                "belongs to block 8 key A"; then break; fi
+      if ! CheckExecute slow "hf mf hardnested cand reuse test" "cp traces/hf_mf_hardnested_nonces.bin nonces.bin; cp traces/hf_mf_hardnested_nonces.bin.cand nonces.bin.cand; \
+                                                                $CLIENTBIN -c 'hf mf hardnested -r' | tr '\\n' ' '; rm -f nonces.bin nonces.bin.cand" \
+                                                                "Key found: A0A1A2A3A4A5 .*Reused [0-9]+ persisted candidate lists"; then break; fi
+      if ! CheckExecute slow "hf mf hardnested parallel test" "cp traces/hf_mf_hardnested_nonces.bin n1.bin; cp traces/hf_mf_hardnested_nonces.bin.cand n1.bin.cand; \
+                                                                cp traces/hf_mf_hardnested_nonces.bin n2.bin; cp traces/hf_mf_hardnested_nonces.bin.cand n2.bin.cand; \
+                                                                $CLIENTBIN -c 'hf mf hardnested -f n1.bin -f n2.bin -j 2' | tr '\\n' ' '; rm -f n1.bin n1.bin.cand n2.bin n2.bin.cand" \
+                                                                "Cracking 2 nonce files, 2 at a time .*n1.bin -- found valid key \\[ a0a1a2a3a4a5 .*n2.bin -- found valid key \\[ a0a1a2a3a4a5"; then break; fi
       if ! CheckExecute slow "hf iclass loclass long test" "$CLIENTBIN -c 'hf iclass loclass --long'" "verified \(ok\)"; then break; fi
       if ! CheckExecute slow "emv long test"               "$CLIENTBIN -c 'emv test -l'" "Test\(s\) \[ ok"; then break; fi
       if ! CheckExecute "hf iclass lookup test"            "$CLIENTBIN -c 'hf iclass lookup --csn 9655a400f8ff12e0 --epurse f0ffffffffffffff --macs 0000000089cb984b -f $DICPATH/iclass_default_keys.dic'" \
                                                                       "valid key AE A6 84 A6 DA B2 32 78"; then break; fi
       if ! CheckExecute "hf iclass loclass test"         "$CLIENTBIN -c 'hf iclass loclass --test'" "key diversification \(ok\)"; then break; fi
       if ! CheckExecute "emv test"                       "$CLIENTBIN -c 'emv test'" "Test\(s\) \[ ok"; then break; fi
+      if ! CheckExecute "emv roca capk scan test"        "$CLIENTBIN -c 'emv roca -f $RESOURCEPATH/capk.txt'" "vulnerable none"; then break; fi
       if ! CheckExecute "hf cipurse test"                "$CLIENTBIN -c 'hf cipurse test'" "Tests \[ ok"; then break; fi
       if ! CheckExecute "hf mfdes test"                  "$CLIENTBIN -c 'hf mfdes test'"   "Tests \[ ok"; then break; fi
     fi